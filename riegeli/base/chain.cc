@@ -289,10 +289,24 @@ inline void Chain::FlatCordRef::PrependTo(absl::Cord& dest) const {
   dest.Prepend(src_);
 }
 
-inline Chain::RawBlock* Chain::RawBlock::NewInternal(size_t min_capacity) {
+inline Chain::RawBlock* Chain::RawBlock::NewInternal(size_t min_capacity,
+                                                     ChainArena* arena) {
   RIEGELI_ASSERT_GT(min_capacity, 0u)
       << "Failed precondition of Chain::RawBlock::NewInternal(): zero capacity";
   size_t raw_capacity;
+  if (arena != nullptr) {
+    static_assert(alignof(RawBlock) <= ChainArena::kAlignment,
+                  "ChainArena does not provide sufficient alignment");
+    raw_capacity = RoundUp<ChainArena::kAlignment>(kInternalAllocatedOffset() +
+                                                   min_capacity);
+    ChainArena::Slab* slab;
+    void* const ptr = arena->Allocate(raw_capacity, slab);
+    if (ptr != nullptr) {
+      RawBlock* const block = new (ptr) RawBlock(&raw_capacity);
+      block->slab_ = slab;
+      return block;
+    }
+  }
   return SizeReturningNewAligned<RawBlock>(
       kInternalAllocatedOffset() + min_capacity, &raw_capacity, &raw_capacity);
 }
@@ -1434,11 +1448,14 @@ absl::Span<char> Chain::AppendBuffer(size_t min_length,
       block->AppendWithExplicitSizeToCopy(short_data(), kMaxShortDataSize);
       PushBack(block);
       block = RawBlock::NewInternal(
-          NewBlockCapacity(0, min_length, recommended_length, options));
+          NewBlockCapacity(0, min_length, recommended_length, options),
+          options.arena());
     } else {
-      block = RawBlock::NewInternal(NewBlockCapacity(
-          size_, UnsignedMax(min_length, kMaxShortDataSize - size_),
-          recommended_length, options));
+      block = RawBlock::NewInternal(
+          NewBlockCapacity(size_,
+                           UnsignedMax(min_length, kMaxShortDataSize - size_),
+                           recommended_length, options),
+          options.arena());
       block->AppendWithExplicitSizeToCopy(short_data(), kMaxShortDataSize);
     }
     PushBack(block);
@@ -1454,8 +1471,10 @@ absl::Span<char> Chain::AppendBuffer(size_t min_length,
                                  RawBlock::kMaxCapacity - last->size())) {
       // The last block must be rewritten. Merge it with the new space to a
       // new block.
-      block = RawBlock::NewInternal(NewBlockCapacity(
-          last->size(), min_length, recommended_length, options));
+      block = RawBlock::NewInternal(
+          NewBlockCapacity(last->size(), min_length, recommended_length,
+                           options),
+          options.arena());
       block->Append(absl::string_view(*last));
       last->Unref();
       SetBack(block);
@@ -1476,7 +1495,8 @@ absl::Span<char> Chain::AppendBuffer(size_t min_length,
       if (block == nullptr) {
         // Append a new block.
         block = RawBlock::NewInternal(
-            NewBlockCapacity(0, min_length, recommended_length, options));
+            NewBlockCapacity(0, min_length, recommended_length, options),
+            options.arena());
       }
       PushBack(block);
     }
@@ -1528,10 +1548,12 @@ absl::Span<char> Chain::PrependBuffer(size_t min_length,
       block->AppendWithExplicitSizeToCopy(short_data(), kMaxShortDataSize);
       PushFront(block);
       block = RawBlock::NewInternal(
-          NewBlockCapacity(0, min_length, recommended_length, options));
+          NewBlockCapacity(0, min_length, recommended_length, options),
+          options.arena());
     } else {
       block = RawBlock::NewInternal(
-          NewBlockCapacity(size_, min_length, recommended_length, options));
+          NewBlockCapacity(size_, min_length, recommended_length, options),
+          options.arena());
       block->Prepend(short_data());
     }
     PushFront(block);
@@ -1547,8 +1569,10 @@ absl::Span<char> Chain::PrependBuffer(size_t min_length,
                                  RawBlock::kMaxCapacity - first->size())) {
       // The first block must be rewritten. Merge it with the new space to a
       // new block.
-      block = RawBlock::NewInternal(NewBlockCapacity(
-          first->size(), min_length, recommended_length, options));
+      block = RawBlock::NewInternal(
+          NewBlockCapacity(first->size(), min_length, recommended_length,
+                           options),
+          options.arena());
       block->Prepend(absl::string_view(*first));
       first->Unref();
       SetFront(block);
@@ -1569,7 +1593,8 @@ absl::Span<char> Chain::PrependBuffer(size_t min_length,
       if (block == nullptr) {
         // Prepend a new block.
         block = RawBlock::NewInternal(
-            NewBlockCapacity(0, min_length, recommended_length, options));
+            NewBlockCapacity(0, min_length, recommended_length, options),
+            options.arena());
       }
       PushFront(block);
     }
@@ -1653,7 +1678,8 @@ inline void Chain::AppendChain(ChainRef&& src, const Options& options) {
                       UnsignedMax(src_first->size(), kMaxShortDataSize - size_),
                       0, options)
                 : UnsignedMax(size_ + src_first->size(), kMaxShortDataSize);
-        RawBlock* const merged = RawBlock::NewInternal(capacity);
+        RawBlock* const merged =
+            RawBlock::NewInternal(capacity, options.arena());
         merged->AppendWithExplicitSizeToCopy(short_data(), kMaxShortDataSize);
         merged->Append(absl::string_view(*src_first));
         PushBack(merged);
@@ -1691,7 +1717,8 @@ inline void Chain::AppendChain(ChainRef&& src, const Options& options) {
             src.end_ - src.begin_ == 1
                 ? NewBlockCapacity(last->size(), src_first->size(), 0, options)
                 : last->size() + src_first->size();
-        RawBlock* const merged = RawBlock::NewInternal(capacity);
+        RawBlock* const merged =
+            RawBlock::NewInternal(capacity, options.arena());
         merged->Append(absl::string_view(*last));
         merged->Append(absl::string_view(*src_first));
         last->Unref();
@@ -1855,7 +1882,8 @@ inline void Chain::PrependChain(ChainRef&& src, const Options& options) {
             src.end_ - src.begin_ == 1
                 ? NewBlockCapacity(size_, src_last->size(), 0, options)
                 : size_ + src_last->size();
-        RawBlock* const merged = RawBlock::NewInternal(capacity);
+        RawBlock* const merged =
+            RawBlock::NewInternal(capacity, options.arena());
         merged->Prepend(short_data());
         merged->Prepend(absl::string_view(*src_last));
         PushFront(merged);
@@ -1894,7 +1922,8 @@ inline void Chain::PrependChain(ChainRef&& src, const Options& options) {
             src.end_ - src.begin_ == 1
                 ? NewBlockCapacity(first->size(), src_last->size(), 0, options)
                 : first->size() + src_last->size();
-        RawBlock* const merged = RawBlock::NewInternal(capacity);
+        RawBlock* const merged =
+            RawBlock::NewInternal(capacity, options.arena());
         merged->Prepend(absl::string_view(*first));
         merged->Prepend(absl::string_view(*src_last));
         first->Unref();
@@ -2021,7 +2050,8 @@ void Chain::AppendBlock(RawBlock* block, const Options& options) {
         const size_t capacity = NewBlockCapacity(
             size_, UnsignedMax(block->size(), kMaxShortDataSize - size_), 0,
             options);
-        RawBlock* const merged = RawBlock::NewInternal(capacity);
+        RawBlock* const merged =
+            RawBlock::NewInternal(capacity, options.arena());
         merged->AppendWithExplicitSizeToCopy(short_data(), kMaxShortDataSize);
         merged->Append(absl::string_view(*block));
         PushBack(merged);
@@ -2048,7 +2078,8 @@ void Chain::AppendBlock(RawBlock* block, const Options& options) {
         RIEGELI_ASSERT_LE(block->size(), RawBlock::kMaxCapacity - last->size())
             << "Sum of sizes of two tiny blocks exceeds RawBlock::kMaxCapacity";
         RawBlock* const merged = RawBlock::NewInternal(
-            NewBlockCapacity(last->size(), block->size(), 0, options));
+            NewBlockCapacity(last->size(), block->size(), 0, options),
+            options.arena());
         merged->Append(absl::string_view(*last));
         merged->Append(absl::string_view(*block));
         last->Unref();
@@ -2104,7 +2135,8 @@ void Chain::PrependBlock(RawBlock* block, const Options& options) {
                "RawBlock::kMaxCapacity";
         const size_t capacity =
             NewBlockCapacity(size_, block->size(), 0, options);
-        RawBlock* const merged = RawBlock::NewInternal(capacity);
+        RawBlock* const merged =
+            RawBlock::NewInternal(capacity, options.arena());
         merged->Prepend(short_data());
         merged->Prepend(absl::string_view(*block));
         PushFront(merged);
@@ -2132,7 +2164,8 @@ void Chain::PrependBlock(RawBlock* block, const Options& options) {
         RIEGELI_ASSERT_LE(block->size(), RawBlock::kMaxCapacity - first->size())
             << "Sum of sizes of two tiny blocks exceeds RawBlock::kMaxCapacity";
         RawBlock* const merged = RawBlock::NewInternal(
-            NewBlockCapacity(first->size(), block->size(), 0, options));
+            NewBlockCapacity(first->size(), block->size(), 0, options),
+            options.arena());
         merged->Prepend(absl::string_view(*first));
         merged->Prepend(absl::string_view(*block));
         first->Unref();
@@ -2211,8 +2244,10 @@ void Chain::RemoveSuffix(size_t length, const Options& options) {
                             RawBlock::kMaxCapacity - before_last->size())
               << "Sum of sizes of two tiny blocks exceeds "
                  "RawBlock::kMaxCapacity";
-          RawBlock* const merged = RawBlock::NewInternal(NewBlockCapacity(
-              before_last->size() + last->size(), 0, 0, options));
+          RawBlock* const merged = RawBlock::NewInternal(
+              NewBlockCapacity(before_last->size() + last->size(), 0, 0,
+                               options),
+              options.arena());
           merged->Append(absl::string_view(*before_last));
           merged->Append(absl::string_view(*last));
           before_last->Unref();
@@ -2300,8 +2335,10 @@ void Chain::RemovePrefix(size_t length, const Options& options) {
                             RawBlock::kMaxCapacity - after_first->size())
               << "Sum of sizes of two tiny blocks exceeds "
                  "RawBlock::kMaxCapacity";
-          RawBlock* const merged = RawBlock::NewInternal(NewBlockCapacity(
-              first->size() + after_first->size(), 0, 0, options));
+          RawBlock* const merged = RawBlock::NewInternal(
+              NewBlockCapacity(first->size() + after_first->size(), 0, 0,
+                               options),
+              options.arena());
           merged->Prepend(absl::string_view(*after_first));
           merged->Prepend(absl::string_view(*first));
           after_first->Unref();
@@ -38,6 +38,7 @@
 #include "absl/types/optional.h"
 #include "absl/types/span.h"
 #include "riegeli/base/base.h"
+#include "riegeli/base/chain_arena.h"
 #include "riegeli/base/intrusive_ref_count.h"
 #include "riegeli/base/memory.h"
 #include "riegeli/base/memory_estimator.h"
@@ -97,10 +98,26 @@ class ChainOptions {
   }
   size_t max_block_size() const { return max_block_size_; }
 
+  // If not `nullptr`, small blocks of allocated data are allocated from this
+  // `ChainArena` instead of separately. The `ChainArena` must be valid while
+  // the `Chain` is modified with these options, but blocks allocated from it
+  // can outlive it.
+  //
+  // Default: `nullptr`.
+  ChainOptions& set_arena(ChainArena* arena) & {
+    arena_ = arena;
+    return *this;
+  }
+  ChainOptions&& set_arena(ChainArena* arena) && {
+    return std::move(set_arena(arena));
+  }
+  ChainArena* arena() const { return arena_; }
+
  private:
   size_t size_hint_ = 0;
   size_t min_block_size_ = kMinBufferSize;
   size_t max_block_size_ = kMaxBufferSize;
+  ChainArena* arena_ = nullptr;
 };
 
 // `ChainBlock::Options` is defined at the namespace scope because clang has
@@ -951,8 +968,10 @@ class Chain::RawBlock {
   static constexpr size_t kInternalAllocatedOffset();
   static constexpr size_t kMaxCapacity = ChainBlock::kMaxSize;
 
-  // Creates an internal block.
-  static RawBlock* NewInternal(size_t min_capacity);
+  // Creates an internal block, allocated from `arena` if it is not `nullptr`
+  // and `min_capacity` is small enough.
+  static RawBlock* NewInternal(size_t min_capacity,
+                               ChainArena* arena = nullptr);
 
   // Constructs an internal block. This constructor is public for
   // `SizeReturningNewAligned()`.
@@ -1088,6 +1107,9 @@ class Chain::RawBlock {
   // If `is_internal()`, end of allocated space. If `is_external()`, `nullptr`.
   // This distinguishes internal from external blocks.
   char* allocated_end_ = nullptr;
+  // If `is_internal()` and the block is allocated from a `ChainArena`, its
+  // slab, otherwise `nullptr`.
+  ChainArena::Slab* slab_ = nullptr;
   union {
     // If `is_internal()`, beginning of data (actual allocated size is larger).
     char allocated_begin_[1];
@@ -1346,7 +1368,13 @@ void Chain::RawBlock::Unref() {
       (has_unique_owner() ||
        ref_count_.fetch_sub(1, std::memory_order_acq_rel) == 1)) {
     if (is_internal()) {
-      DeleteAligned<RawBlock>(this, kInternalAllocatedOffset() + capacity());
+      if (slab_ == nullptr) {
+        DeleteAligned<RawBlock>(this, kInternalAllocatedOffset() + capacity());
+      } else {
+        ChainArena::Slab* const slab = slab_;
+        this->~RawBlock();
+        ChainArena::Unref(slab);
+      }
     } else {
       external_.methods->delete_block(this);
     }
@@ -0,0 +1,73 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/base/chain_arena.h"
+
+#include <stddef.h>
+
+#include "riegeli/base/base.h"
+#include "riegeli/base/memory.h"
+
+namespace riegeli {
+
+// Before C++17 if a constexpr static data member is ODR-used, its definition at
+// namespace scope is required. Since C++17 these definitions are deprecated:
+// http://en.cppreference.com/w/cpp/language/static
+#if __cplusplus < 201703
+constexpr size_t ChainArena::kDefaultSlabSize;
+constexpr size_t ChainArena::kAlignment;
+#endif
+
+ChainArena::ChainArena(size_t slab_size)
+    : slab_size_(RoundUp<kAlignment>(slab_size)) {
+  RIEGELI_ASSERT_GT(slab_size, 0u)
+      << "Failed precondition of ChainArena::ChainArena(): zero slab size";
+}
+
+ChainArena::~ChainArena() {
+  for (Slab* const slab : used_slabs_) Unref(slab);
+  for (Slab* const slab : free_slabs_) Unref(slab);
+}
+
+void ChainArena::Reset() {
+  for (Slab* const slab : used_slabs_) {
+    if (slab->has_unique_owner()) {
+      free_slabs_.push_back(slab);
+    } else {
+      Unref(slab);
+    }
+  }
+  used_slabs_.clear();
+  cursor_ = nullptr;
+  limit_ = nullptr;
+}
+
+ChainArena::Slab* ChainArena::NewSlab() {
+  if (!free_slabs_.empty()) {
+    Slab* const slab = free_slabs_.back();
+    free_slabs_.pop_back();
+    return slab;
+  }
+  ++num_allocated_slabs_;
+  return NewAligned<Slab, kAlignment>(Slab::kDataOffset() + slab_size_,
+                                      slab_size_);
+}
+
+void ChainArena::Unref(Slab* slab) {
+  if (slab->Unref()) {
+    DeleteAligned<Slab, kAlignment>(slab, Slab::kDataOffset() + slab->size());
+  }
+}
+
+}  // namespace riegeli
@@ -0,0 +1,152 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_BASE_CHAIN_ARENA_H_
+#define RIEGELI_BASE_CHAIN_ARENA_H_
+
+#include <stddef.h>
+
+#include <atomic>
+#include <vector>
+
+#include "absl/base/optimization.h"
+#include "riegeli/base/base.h"
+
+namespace riegeli {
+
+// `ChainArena` allocates small blocks of a `Chain` from larger slabs, instead
+// of allocating each block separately.
+//
+// This is useful when many `Chain` objects receive small amounts of data and
+// are then cleared together, e.g. buffers of a chunk encoder: most blocks are
+// carved from a few slabs, and after `Reset()` the slabs are reused for the
+// next round without returning to the allocator.
+//
+// A slab is kept alive as long as any block carved from it is alive, so blocks
+// can outlive the `ChainArena` and the `Reset()` call, e.g. if they are shared
+// with another `Chain`. Such a slab is not reused.
+//
+// A `ChainArena` is attached to a `Chain` by `Chain::Options::set_arena()`,
+// or to a `ChainWriter` or `ChainBackwardWriter` by their options.
+//
+// Allocation from a `ChainArena` is not thread-safe, but blocks allocated from
+// it can be released from any thread.
+class ChainArena {
+ public:
+  // The header of a slab. Exposed for `Chain`.
+  class Slab;
+
+  // Default slab size.
+  static constexpr size_t kDefaultSlabSize = size_t{64} << 10;
+
+  // Creates a `ChainArena` with the given slab size. Requests larger than a
+  // quarter of the slab size are not served from the arena.
+  explicit ChainArena(size_t slab_size = kDefaultSlabSize);
+
+  ChainArena(const ChainArena&) = delete;
+  ChainArena& operator=(const ChainArena&) = delete;
+
+  ~ChainArena();
+
+  // Makes slabs used since the previous `Reset()` available for reuse, except
+  // for slabs which still contain live blocks.
+  //
+  // This should be called after clearing the `Chain` objects using the arena.
+  void Reset();
+
+  // Returns the slab size.
+  size_t slab_size() const { return slab_size_; }
+
+  // Returns the number of slabs allocated from the heap so far, for
+  // performance tuning.
+  size_t num_allocated_slabs() const { return num_allocated_slabs_; }
+
+  // Returns the alignment of memory returned by `Allocate()`.
+  static constexpr size_t kAlignment = alignof(max_align_t);
+
+  // Allocates `size` bytes aligned to `kAlignment`, sets `slab` to the slab
+  // containing them, and takes a reference to `slab` on behalf of the caller,
+  // to be released with `Unref()`.
+  //
+  // Returns `nullptr` if `size` is too large to be served from the arena.
+  void* Allocate(size_t size, Slab*& slab);
+
+  // Releases a reference to a slab obtained from `Allocate()`.
+  static void Unref(Slab* slab);
+
+ private:
+  Slab* NewSlab();
+
+  size_t slab_size_;
+  // Slabs allocated from since the previous `Reset()`. The last slab is the
+  // current one. The arena holds a reference to each of them.
+  std::vector<Slab*> used_slabs_;
+  // Slabs without live blocks, ready to be reused. The arena holds the only
+  // reference to each of them.
+  std::vector<Slab*> free_slabs_;
+  // Unused part of the current slab.
+  char* cursor_ = nullptr;
+  char* limit_ = nullptr;
+  size_t num_allocated_slabs_ = 0;
+};
+
+// Implementation details follow.
+
+class ChainArena::Slab {
+ public:
+  explicit Slab(size_t size) : size_(size) {}
+
+  Slab(const Slab&) = delete;
+  Slab& operator=(const Slab&) = delete;
+
+  void Ref() { ref_count_.fetch_add(1, std::memory_order_relaxed); }
+  // Returns `true` if this was the last reference.
+  bool Unref() {
+    return ref_count_.load(std::memory_order_acquire) == 1 ||
+           ref_count_.fetch_sub(1, std::memory_order_acq_rel) == 1;
+  }
+  bool has_unique_owner() const {
+    return ref_count_.load(std::memory_order_acquire) == 1;
+  }
+
+  size_t size() const { return size_; }
+  char* data() { return reinterpret_cast<char*>(this) + kDataOffset(); }
+
+  static constexpr size_t kDataOffset() {
+    return RoundUp<kAlignment>(sizeof(Slab));
+  }
+
+ private:
+  std::atomic<size_t> ref_count_{1};
+  size_t size_;
+};
+
+inline void* ChainArena::Allocate(size_t size, Slab*& slab) {
+  if (ABSL_PREDICT_FALSE(size > slab_size_ / 4)) return nullptr;
+  size = RoundUp<kAlignment>(size);
+  if (ABSL_PREDICT_FALSE(PtrDistance(cursor_, limit_) < size)) {
+    used_slabs_.push_back(NewSlab());
+    cursor_ = used_slabs_.back()->data();
+    limit_ = cursor_ + slab_size_;
+  }
+  slab = used_slabs_.back();
+  slab->Ref();
+  void* const ptr = cursor_;
+  cursor_ += size;
+  return ptr;
+}
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_BASE_CHAIN_ARENA_H_
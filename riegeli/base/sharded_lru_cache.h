@@ -0,0 +1,270 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_BASE_SHARDED_LRU_CACHE_H_
+#define RIEGELI_BASE_SHARDED_LRU_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <list>
+#include <memory>
+#include <utility>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/hash/hash.h"
+#include "absl/synchronization/mutex.h"
+#include "riegeli/base/base.h"
+
+namespace riegeli {
+namespace internal {
+
+// `ShardedLruCache<Key, Value, Hash, Eq>` maps keys to values, and evicts
+// least recently used entries when the memory used by the entries exceeds a
+// budget. The memory used by an entry is estimated by the caller of
+// `Insert()`.
+//
+// The cache is split into shards with separate locks, and the budget is applied
+// to each shard separately, with an equal part of it.
+//
+// `Hash` and `Eq` are used by `absl::flat_hash_map`. If they are transparent
+// (they declare `is_transparent`), `Find()` accepts other key types, e.g. a key
+// with `absl::string_view` in place of `std::string`, so that a `Key` does not
+// have to be constructed for a lookup.
+//
+// `ShardedLruCache` is thread-safe.
+template <typename Key, typename Value, typename Hash = absl::Hash<Key>,
+          typename Eq = std::equal_to<Key>>
+class ShardedLruCache {
+ public:
+  // Creates a cache using at most about `max_size` bytes, split into
+  // `num_shards` shards.
+  //
+  // `num_shards` must be at least 1.
+  explicit ShardedLruCache(size_t max_size, size_t num_shards);
+
+  ShardedLruCache(const ShardedLruCache&) = delete;
+  ShardedLruCache& operator=(const ShardedLruCache&) = delete;
+
+  // Looks up `key`.
+  //
+  // Return values:
+  //  * `true`  - found, `value` is set to the cached value
+  //  * `false` - not found, `value` is unchanged
+  template <typename LookupKey>
+  bool Find(const LookupKey& key, Value& value);
+
+  // Inserts `value` under `key`, estimating that it uses `memory` bytes,
+  // unless `key` is already cached.
+  //
+  // The entry just inserted is kept even if it alone exceeds the budget of its
+  // shard, so that it is shared by concurrent users.
+  //
+  // Returns the cached value, which is `value` unless `key` was already cached.
+  Value Insert(Key key, Value value, size_t memory);
+
+  // Removes all entries.
+  void Clear();
+
+  // Returns the amount of memory used by cached entries.
+  size_t size() const;
+
+  // Returns the number of calls to `Find()` which found and did not find the
+  // key.
+  uint64_t num_hits() const;
+  uint64_t num_misses() const;
+
+ private:
+  struct Entry {
+    explicit Entry(Key key, Value value, size_t memory)
+        : key(std::move(key)), value(std::move(value)), memory(memory) {}
+
+    Key key;
+    Value value;
+    size_t memory;
+  };
+
+  class Shard {
+   public:
+    Shard() noexcept {}
+
+    Shard(const Shard&) = delete;
+    Shard& operator=(const Shard&) = delete;
+
+    template <typename LookupKey>
+    bool Find(const LookupKey& key, Value& value);
+    Value Insert(Key key, Value value, size_t memory, size_t max_size);
+    void Clear();
+    size_t size() const;
+    uint64_t num_hits() const;
+    uint64_t num_misses() const;
+
+   private:
+    mutable absl::Mutex mutex_;
+    // Most recently used entries are at the front.
+    std::list<Entry> lru_ ABSL_GUARDED_BY(mutex_);
+    absl::flat_hash_map<Key, typename std::list<Entry>::iterator, Hash, Eq>
+        index_ ABSL_GUARDED_BY(mutex_);
+    size_t size_ ABSL_GUARDED_BY(mutex_) = 0;
+    uint64_t num_hits_ ABSL_GUARDED_BY(mutex_) = 0;
+    uint64_t num_misses_ ABSL_GUARDED_BY(mutex_) = 0;
+  };
+
+  template <typename LookupKey>
+  Shard& ShardFor(const LookupKey& key);
+
+  size_t max_shard_size_;
+  size_t num_shards_;
+  std::unique_ptr<Shard[]> shards_;
+};
+
+// Implementation details follow.
+
+template <typename Key, typename Value, typename Hash, typename Eq>
+ShardedLruCache<Key, Value, Hash, Eq>::ShardedLruCache(size_t max_size,
+                                                       size_t num_shards)
+    : max_shard_size_(max_size / num_shards),
+      num_shards_(num_shards),
+      shards_(new Shard[num_shards]) {
+  RIEGELI_ASSERT_GT(num_shards, 0u)
+      << "Failed precondition of ShardedLruCache: zero number of shards";
+}
+
+template <typename Key, typename Value, typename Hash, typename Eq>
+template <typename LookupKey>
+inline typename ShardedLruCache<Key, Value, Hash, Eq>::Shard&
+ShardedLruCache<Key, Value, Hash, Eq>::ShardFor(const LookupKey& key) {
+  // The low bits of the hash are used by `absl::flat_hash_map` within a shard,
+  // so the shard is selected by the high bits.
+  const size_t hash = Hash()(key);
+  return shards_[(hash >> (sizeof(size_t) * 8 / 2)) % num_shards_];
+}
+
+template <typename Key, typename Value, typename Hash, typename Eq>
+template <typename LookupKey>
+inline bool ShardedLruCache<Key, Value, Hash, Eq>::Find(const LookupKey& key,
+                                                        Value& value) {
+  return ShardFor(key).Find(key, value);
+}
+
+template <typename Key, typename Value, typename Hash, typename Eq>
+inline Value ShardedLruCache<Key, Value, Hash, Eq>::Insert(Key key,
+                                                           Value value,
+                                                           size_t memory) {
+  Shard& shard = ShardFor(key);
+  return shard.Insert(std::move(key), std::move(value), memory,
+                      max_shard_size_);
+}
+
+template <typename Key, typename Value, typename Hash, typename Eq>
+void ShardedLruCache<Key, Value, Hash, Eq>::Clear() {
+  for (size_t i = 0; i < num_shards_; ++i) shards_[i].Clear();
+}
+
+template <typename Key, typename Value, typename Hash, typename Eq>
+size_t ShardedLruCache<Key, Value, Hash, Eq>::size() const {
+  size_t size = 0;
+  for (size_t i = 0; i < num_shards_; ++i) size += shards_[i].size();
+  return size;
+}
+
+template <typename Key, typename Value, typename Hash, typename Eq>
+uint64_t ShardedLruCache<Key, Value, Hash, Eq>::num_hits() const {
+  uint64_t num_hits = 0;
+  for (size_t i = 0; i < num_shards_; ++i) num_hits += shards_[i].num_hits();
+  return num_hits;
+}
+
+template <typename Key, typename Value, typename Hash, typename Eq>
+uint64_t ShardedLruCache<Key, Value, Hash, Eq>::num_misses() const {
+  uint64_t num_misses = 0;
+  for (size_t i = 0; i < num_shards_; ++i) {
+    num_misses += shards_[i].num_misses();
+  }
+  return num_misses;
+}
+
+template <typename Key, typename Value, typename Hash, typename Eq>
+template <typename LookupKey>
+bool ShardedLruCache<Key, Value, Hash, Eq>::Shard::Find(const LookupKey& key,
+                                                        Value& value) {
+  absl::MutexLock l(&mutex_);
+  const auto iter = index_.find(key);
+  if (iter == index_.end()) {
+    ++num_misses_;
+    return false;
+  }
+  ++num_hits_;
+  lru_.splice(lru_.begin(), lru_, iter->second);
+  value = iter->second->value;
+  return true;
+}
+
+template <typename Key, typename Value, typename Hash, typename Eq>
+Value ShardedLruCache<Key, Value, Hash, Eq>::Shard::Insert(Key key,
+                                                           Value value,
+                                                           size_t memory,
+                                                           size_t max_size) {
+  absl::MutexLock l(&mutex_);
+  const auto inserted = index_.emplace(key, lru_.end());
+  if (!inserted.second) {
+    // Already cached.
+    lru_.splice(lru_.begin(), lru_, inserted.first->second);
+    return inserted.first->second->value;
+  }
+  lru_.emplace_front(std::move(key), value, memory);
+  inserted.first->second = lru_.begin();
+  size_ += memory;
+  // Evict least recently used entries, but keep the entry just inserted.
+  while (size_ > max_size && lru_.size() > 1) {
+    Entry& victim = lru_.back();
+    size_ -= victim.memory;
+    index_.erase(victim.key);
+    lru_.pop_back();
+  }
+  return value;
+}
+
+template <typename Key, typename Value, typename Hash, typename Eq>
+void ShardedLruCache<Key, Value, Hash, Eq>::Shard::Clear() {
+  absl::MutexLock l(&mutex_);
+  index_.clear();
+  lru_.clear();
+  size_ = 0;
+}
+
+template <typename Key, typename Value, typename Hash, typename Eq>
+size_t ShardedLruCache<Key, Value, Hash, Eq>::Shard::size() const {
+  absl::MutexLock l(&mutex_);
+  return size_;
+}
+
+template <typename Key, typename Value, typename Hash, typename Eq>
+uint64_t ShardedLruCache<Key, Value, Hash, Eq>::Shard::num_hits() const {
+  absl::MutexLock l(&mutex_);
+  return num_hits_;
+}
+
+template <typename Key, typename Value, typename Hash, typename Eq>
+uint64_t ShardedLruCache<Key, Value, Hash, Eq>::Shard::num_misses() const {
+  absl::MutexLock l(&mutex_);
+  return num_misses_;
+}
+
+}  // namespace internal
+}  // namespace riegeli
+
+#endif  // RIEGELI_BASE_SHARDED_LRU_CACHE_H_
@@ -15,11 +15,28 @@
 #include "riegeli/brotli/brotli_allocator.h"
 
 #include <stddef.h>
+#include <stdlib.h>
+
+#include <limits>
+#include <vector>
+
+#include "absl/base/optimization.h"
 
 namespace riegeli {
 
 namespace internal {
 
+namespace {
+
+// Each block allocated by `BrotliBlockCache` is preceded by its size, padded
+// to preserve alignment of the block.
+constexpr size_t kBlockHeaderSize = alignof(max_align_t);
+
+static_assert(kBlockHeaderSize >= sizeof(size_t),
+              "kBlockHeaderSize too small");
+
+}  // namespace
+
 void* RiegeliBrotliAllocFunc(void* opaque, size_t size) {
   return static_cast<const BrotliAllocator::Interface*>(opaque)->Alloc(size);
 }
@@ -28,6 +45,60 @@ void RiegeliBrotliFreeFunc(void* opaque, void* ptr) {
   static_cast<const BrotliAllocator::Interface*>(opaque)->Free(ptr);
 }
 
+void* RiegeliBrotliCachedAllocFunc(void* opaque, size_t size) {
+  return static_cast<BrotliBlockCache*>(opaque)->Alloc(size);
+}
+
+void RiegeliBrotliCachedFreeFunc(void* opaque, void* ptr) {
+  static_cast<BrotliBlockCache*>(opaque)->Free(ptr);
+}
+
+BrotliBlockCache::~BrotliBlockCache() {
+  for (const FreeBlock& block : free_blocks_) {
+    free(static_cast<char*>(block.ptr) - kBlockHeaderSize);
+  }
+}
+
+void BrotliBlockCache::Refurbish() {
+  std::vector<FreeBlock>::iterator kept = free_blocks_.begin();
+  for (FreeBlock& block : free_blocks_) {
+    if (block.used) {
+      block.used = false;
+      *kept++ = block;
+    } else {
+      free(static_cast<char*>(block.ptr) - kBlockHeaderSize);
+    }
+  }
+  free_blocks_.erase(kept, free_blocks_.end());
+}
+
+inline void* BrotliBlockCache::Alloc(size_t size) {
+  for (std::vector<FreeBlock>::iterator iter = free_blocks_.begin();
+       iter != free_blocks_.end(); ++iter) {
+    if (iter->size == size) {
+      void* const ptr = iter->ptr;
+      *iter = free_blocks_.back();
+      free_blocks_.pop_back();
+      return ptr;
+    }
+  }
+  if (ABSL_PREDICT_FALSE(size > std::numeric_limits<size_t>::max() -
+                                    kBlockHeaderSize)) {
+    return nullptr;
+  }
+  char* const allocated = static_cast<char*>(malloc(kBlockHeaderSize + size));
+  if (ABSL_PREDICT_FALSE(allocated == nullptr)) return nullptr;
+  *reinterpret_cast<size_t*>(allocated) = size;
+  return allocated + kBlockHeaderSize;
+}
+
+inline void BrotliBlockCache::Free(void* ptr) {
+  if (ptr == nullptr) return;
+  const size_t size = *reinterpret_cast<const size_t*>(
+      static_cast<const char*>(ptr) - kBlockHeaderSize);
+  free_blocks_.push_back(FreeBlock{ptr, size, true});
+}
+
 }  // namespace internal
 
 BrotliAllocator::Interface::~Interface() {}
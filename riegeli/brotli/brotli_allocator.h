@@ -20,6 +20,7 @@
 #include <memory>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "brotli/types.h"
 
@@ -30,7 +31,56 @@ namespace internal {
 extern "C" {
 void* RiegeliBrotliAllocFunc(void* opaque, size_t size);
 void RiegeliBrotliFreeFunc(void* opaque, void* ptr);
+void* RiegeliBrotliCachedAllocFunc(void* opaque, size_t size);
+void RiegeliBrotliCachedFreeFunc(void* opaque, void* ptr);
 }  // extern "C"
+
+// Memory blocks retained across Brotli encoder or decoder instances.
+//
+// The Brotli engine has no way to reset an encoder or decoder instance for a
+// new stream, so the instance itself cannot be recycled. Most of the cost of
+// setting up an instance is allocating its ring buffer and hash tables though,
+// and instances with the same parameters allocate blocks of the same sizes.
+// A `BrotliBlockCache`, kept in a `RecyclingPool` or `KeyedRecyclingPool`,
+// makes these blocks available to the next instance.
+//
+// A `BrotliBlockCache` must be used by one instance at a time. Blocks which
+// were not used since the previous `Refurbish()` are freed by `Refurbish()`,
+// so that the memory retained is bounded by what a single stream needs.
+class BrotliBlockCache {
+ public:
+  BrotliBlockCache() noexcept {}
+
+  BrotliBlockCache(const BrotliBlockCache&) = delete;
+  BrotliBlockCache& operator=(const BrotliBlockCache&) = delete;
+
+  ~BrotliBlockCache();
+
+  // Returns parameters for `Brotli{Encoder,Decoder}CreateInstance()`.
+  brotli_alloc_func alloc_func() const { return RiegeliBrotliCachedAllocFunc; }
+  brotli_free_func free_func() const { return RiegeliBrotliCachedFreeFunc; }
+  void* opaque() { return this; }
+
+  // Prepares the cache for a new stream.
+  void Refurbish();
+
+ private:
+  friend void* RiegeliBrotliCachedAllocFunc(void* opaque, size_t size);
+  friend void RiegeliBrotliCachedFreeFunc(void* opaque, void* ptr);
+
+  struct FreeBlock {
+    void* ptr;
+    size_t size;
+    // Whether the block was used since the previous `Refurbish()`.
+    bool used;
+  };
+
+  void* Alloc(size_t size);
+  void Free(void* ptr);
+
+  std::vector<FreeBlock> free_blocks_;
+};
+
 }  // namespace internal
 
 // Memory allocator used by the Brotli engine.
@@ -29,6 +29,7 @@
 #include "brotli/decode.h"
 #include "brotli/shared_dictionary.h"
 #include "riegeli/base/base.h"
+#include "riegeli/base/recycling_pool.h"
 #include "riegeli/base/status.h"
 #include "riegeli/bytes/pullable_reader.h"
 #include "riegeli/bytes/reader.h"
@@ -47,8 +48,24 @@ void BrotliReaderBase::Initialize(Reader* src) {
 }
 
 inline void BrotliReaderBase::InitializeDecompressor() {
-  decompressor_.reset(BrotliDecoderCreateInstance(
-      allocator_.alloc_func(), allocator_.free_func(), allocator_.opaque()));
+  if (allocator_.alloc_func() == nullptr) {
+    // The default allocator is used. Memory blocks of the decoder are recycled
+    // between decoders. The window size is not known before reading the stream
+    // header, so unlike in `BrotliWriter` the pool is not keyed by it.
+    if (block_cache_ == nullptr) {
+      block_cache_ = RecyclingPool<internal::BrotliBlockCache>::global().Get(
+          [] { return std::make_unique<internal::BrotliBlockCache>(); },
+          [](internal::BrotliBlockCache* block_cache) {
+            block_cache->Refurbish();
+          });
+    }
+    decompressor_.reset(BrotliDecoderCreateInstance(block_cache_->alloc_func(),
+                                                    block_cache_->free_func(),
+                                                    block_cache_->opaque()));
+  } else {
+    decompressor_.reset(BrotliDecoderCreateInstance(
+        allocator_.alloc_func(), allocator_.free_func(), allocator_.opaque()));
+  }
   if (ABSL_PREDICT_FALSE(decompressor_ == nullptr)) {
     Fail(absl::InternalError("BrotliDecoderCreateInstance() failed"));
     return;
@@ -87,6 +104,7 @@ void BrotliReaderBase::Done() {
   }
   PullableReader::Done();
   decompressor_.reset();
+  block_cache_.reset();
   allocator_ = BrotliAllocator();
   dictionary_ = BrotliDictionary();
 }
@@ -26,6 +26,7 @@
 #include "riegeli/base/base.h"
 #include "riegeli/base/dependency.h"
 #include "riegeli/base/object.h"
+#include "riegeli/base/recycling_pool.h"
 #include "riegeli/brotli/brotli_allocator.h"
 #include "riegeli/brotli/brotli_dictionary.h"
 #include "riegeli/bytes/pullable_reader.h"
@@ -132,6 +133,9 @@ class BrotliReaderBase : public PullableReader {
 
   BrotliDictionary dictionary_;
   BrotliAllocator allocator_;
+  // Memory of `decompressor_` if `allocator_` is the default allocator. It
+  // must outlive `decompressor_`.
+  RecyclingPool<internal::BrotliBlockCache>::Handle block_cache_;
   // If `true`, the source is truncated (without a clean end of the compressed
   // stream) at the current position. If the source does not grow, `Close()`
   // will fail.
@@ -234,6 +238,7 @@ inline BrotliReaderBase::BrotliReaderBase(BrotliReaderBase&& that) noexcept
       // part was moved.
       dictionary_(std::move(that.dictionary_)),
       allocator_(std::move(that.allocator_)),
+      block_cache_(std::move(that.block_cache_)),
       truncated_(that.truncated_),
       initial_compressed_pos_(that.initial_compressed_pos_),
       decompressor_(std::move(that.decompressor_)) {}
@@ -248,6 +253,7 @@ inline BrotliReaderBase& BrotliReaderBase::operator=(
   truncated_ = that.truncated_;
   initial_compressed_pos_ = that.initial_compressed_pos_;
   decompressor_ = std::move(that.decompressor_);
+  block_cache_ = std::move(that.block_cache_);
   return *this;
 }
 
@@ -256,6 +262,7 @@ inline void BrotliReaderBase::Reset(Closed) {
   truncated_ = false;
   initial_compressed_pos_ = 0;
   decompressor_.reset();
+  block_cache_.reset();
   dictionary_ = BrotliDictionary();
   allocator_ = BrotliAllocator();
 }
@@ -266,6 +273,7 @@ inline void BrotliReaderBase::Reset(BrotliDictionary&& dictionary,
   truncated_ = false;
   initial_compressed_pos_ = 0;
   decompressor_.reset();
+  block_cache_.reset();
   dictionary_ = std::move(dictionary);
   allocator_ = std::move(allocator);
 }
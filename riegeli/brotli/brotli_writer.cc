@@ -29,6 +29,7 @@
 #include "brotli/encode.h"
 #include "riegeli/base/base.h"
 #include "riegeli/base/port.h"
+#include "riegeli/base/recycling_pool.h"
 #include "riegeli/base/status.h"
 #include "riegeli/bytes/buffered_writer.h"
 #include "riegeli/bytes/writer.h"
@@ -67,19 +68,6 @@ void BrotliWriterBase::Initialize(Writer* dest, int compression_level,
     Fail(*dest);
     return;
   }
-  compressor_.reset(BrotliEncoderCreateInstance(
-      allocator_.alloc_func(), allocator_.free_func(), allocator_.opaque()));
-  if (ABSL_PREDICT_FALSE(compressor_ == nullptr)) {
-    Fail(absl::InternalError("BrotliEncoderCreateInstance() failed"));
-    return;
-  }
-  if (ABSL_PREDICT_FALSE(
-          !BrotliEncoderSetParameter(compressor_.get(), BROTLI_PARAM_QUALITY,
-                                     IntCast<uint32_t>(compression_level)))) {
-    Fail(absl::InternalError(
-        "BrotliEncoderSetParameter(BROTLI_PARAM_QUALITY) failed"));
-    return;
-  }
   // Reduce `window_log` if `size_hint` indicates that data will be smaller.
   // TODO(eustas): Do this automatically in the Brotli engine.
   if (size_hint != absl::nullopt) {
@@ -97,6 +85,35 @@ void BrotliWriterBase::Initialize(Writer* dest, int compression_level,
     }
 #endif
   }
+  if (allocator_.alloc_func() == nullptr) {
+    // The default allocator is used. Memory blocks of the encoder are recycled
+    // between encoders with the same parameters, which allocate blocks of the
+    // same sizes.
+    block_cache_ =
+        KeyedRecyclingPool<internal::BrotliBlockCache, BlockCacheKey>::global()
+            .Get(BlockCacheKey{compression_level, window_log},
+                 [] { return std::make_unique<internal::BrotliBlockCache>(); },
+                 [](internal::BrotliBlockCache* block_cache) {
+                   block_cache->Refurbish();
+                 });
+    compressor_.reset(BrotliEncoderCreateInstance(block_cache_->alloc_func(),
+                                                  block_cache_->free_func(),
+                                                  block_cache_->opaque()));
+  } else {
+    compressor_.reset(BrotliEncoderCreateInstance(
+        allocator_.alloc_func(), allocator_.free_func(), allocator_.opaque()));
+  }
+  if (ABSL_PREDICT_FALSE(compressor_ == nullptr)) {
+    Fail(absl::InternalError("BrotliEncoderCreateInstance() failed"));
+    return;
+  }
+  if (ABSL_PREDICT_FALSE(
+          !BrotliEncoderSetParameter(compressor_.get(), BROTLI_PARAM_QUALITY,
+                                     IntCast<uint32_t>(compression_level)))) {
+    Fail(absl::InternalError(
+        "BrotliEncoderSetParameter(BROTLI_PARAM_QUALITY) failed"));
+    return;
+  }
   if (ABSL_PREDICT_FALSE(!BrotliEncoderSetParameter(
           compressor_.get(), BROTLI_PARAM_LARGE_WINDOW,
           uint32_t{window_log > BROTLI_MAX_WINDOW_BITS}))) {
@@ -145,6 +162,7 @@ void BrotliWriterBase::DoneBehindBuffer(absl::string_view src) {
 void BrotliWriterBase::Done() {
   BufferedWriter::Done();
   compressor_.reset();
+  block_cache_.reset();
   dictionary_ = BrotliDictionary();
   allocator_ = BrotliAllocator();
 }
@@ -30,6 +30,7 @@
 #include "riegeli/base/base.h"
 #include "riegeli/base/dependency.h"
 #include "riegeli/base/object.h"
+#include "riegeli/base/recycling_pool.h"
 #include "riegeli/brotli/brotli_allocator.h"
 #include "riegeli/brotli/brotli_dictionary.h"
 #include "riegeli/bytes/buffered_writer.h"
@@ -217,11 +218,34 @@ class BrotliWriterBase : public BufferedWriter {
     }
   };
 
+  struct BlockCacheKey {
+    friend bool operator==(BlockCacheKey a, BlockCacheKey b) {
+      return a.compression_level == b.compression_level &&
+             a.window_log == b.window_log;
+    }
+    friend bool operator!=(BlockCacheKey a, BlockCacheKey b) {
+      return a.compression_level != b.compression_level ||
+             a.window_log != b.window_log;
+    }
+    template <typename HashState>
+    friend HashState AbslHashValue(HashState hash_state, BlockCacheKey self) {
+      return HashState::combine(std::move(hash_state), self.compression_level,
+                                self.window_log);
+    }
+
+    int compression_level;
+    int window_log;
+  };
+
   bool WriteInternal(absl::string_view src, Writer& dest,
                      BrotliEncoderOperation op);
 
   BrotliDictionary dictionary_;
   BrotliAllocator allocator_;
+  // Memory of `compressor_` if `allocator_` is the default allocator. It must
+  // outlive `compressor_`.
+  KeyedRecyclingPool<internal::BrotliBlockCache, BlockCacheKey>::Handle
+      block_cache_;
   std::unique_ptr<BrotliEncoderState, BrotliEncoderStateDeleter> compressor_;
 };
 
@@ -317,6 +341,7 @@ inline BrotliWriterBase::BrotliWriterBase(BrotliWriterBase&& that) noexcept
       // part was moved.
       dictionary_(std::move(that.dictionary_)),
       allocator_(std::move(that.allocator_)),
+      block_cache_(std::move(that.block_cache_)),
       compressor_(std::move(that.compressor_)) {}
 
 inline BrotliWriterBase& BrotliWriterBase::operator=(
@@ -327,12 +352,14 @@ inline BrotliWriterBase& BrotliWriterBase::operator=(
   dictionary_ = std::move(that.dictionary_);
   allocator_ = std::move(that.allocator_);
   compressor_ = std::move(that.compressor_);
+  block_cache_ = std::move(that.block_cache_);
   return *this;
 }
 
 inline void BrotliWriterBase::Reset(Closed) {
   BufferedWriter::Reset(kClosed);
   compressor_.reset();
+  block_cache_.reset();
   dictionary_ = BrotliDictionary();
   allocator_ = BrotliAllocator();
 }
@@ -343,6 +370,7 @@ inline void BrotliWriterBase::Reset(BrotliDictionary&& dictionary,
                                     absl::optional<Position> size_hint) {
   BufferedWriter::Reset(buffer_size, size_hint);
   compressor_.reset();
+  block_cache_.reset();
   dictionary_ = std::move(dictionary);
   allocator_ = std::move(allocator);
 }
@@ -0,0 +1,45 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/bytes/block_cache.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <utility>
+
+#include "riegeli/base/base.h"
+#include "riegeli/base/chain.h"
+
+namespace riegeli {
+
+// Before C++17 if a constexpr static data member is ODR-used, its definition at
+// namespace scope is required. Since C++17 these definitions are deprecated:
+// http://en.cppreference.com/w/cpp/language/static
+#if __cplusplus < 201703
+constexpr size_t BlockCache::Options::kDefaultMaxSize;
+constexpr size_t BlockCache::Options::kDefaultNumShards;
+#endif
+
+BlockCache::BlockCache(Options options)
+    : cache_(options.max_size(), options.num_shards()) {}
+
+ChainBlock BlockCache::Insert(uint64_t source_id, Position pos,
+                              ChainBlock block) {
+  const size_t memory = block.EstimateMemory();
+  return cache_.Insert(std::make_pair(source_id, pos), std::move(block),
+                       memory);
+}
+
+}  // namespace riegeli
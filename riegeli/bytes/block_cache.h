@@ -0,0 +1,138 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_BYTES_BLOCK_CACHE_H_
+#define RIEGELI_BYTES_BLOCK_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <utility>
+
+#include "riegeli/base/base.h"
+#include "riegeli/base/chain.h"
+#include "riegeli/base/sharded_lru_cache.h"
+
+namespace riegeli {
+
+// `BlockCache` keeps recently read blocks of data sources in memory, so that
+// concurrent readers of the same hot sources share them instead of reading and
+// buffering them separately.
+//
+// Blocks are `ChainBlock`s, shared by reference counting: a block found in the
+// cache can be appended to a `Chain` without copying, and it stays valid after
+// being evicted from the cache for as long as it is referenced.
+//
+// The cache is split into shards with separate locks, and each shard evicts
+// least recently used blocks when the memory used by its blocks exceeds its
+// part of the memory budget.
+//
+// A `BlockCache` is attached to a `ReaderFactory` by
+// `ReaderFactoryBase::Options::set_block_cache()`. The same `BlockCache` can
+// be shared by several `ReaderFactory` objects.
+//
+// `BlockCache` is thread-safe.
+class BlockCache {
+ public:
+  class Options {
+   public:
+    Options() noexcept {}
+
+    // Maximum amount of memory used by cached blocks. The limit is applied to
+    // each shard separately, with an equal part of the budget.
+    //
+    // Default: `kDefaultMaxSize` (64M).
+    static constexpr size_t kDefaultMaxSize = size_t{64} << 20;
+    Options& set_max_size(size_t max_size) & {
+      max_size_ = max_size;
+      return *this;
+    }
+    Options&& set_max_size(size_t max_size) && {
+      return std::move(set_max_size(max_size));
+    }
+    size_t max_size() const { return max_size_; }
+
+    // Number of independently locked shards. More shards reduce contention
+    // between threads, but make the eviction order less accurate.
+    //
+    // Default: `kDefaultNumShards` (16).
+    static constexpr size_t kDefaultNumShards = 16;
+    Options& set_num_shards(size_t num_shards) & {
+      RIEGELI_ASSERT_GT(num_shards, 0u)
+          << "Failed precondition of BlockCache::Options::set_num_shards(): "
+             "zero number of shards";
+      num_shards_ = num_shards;
+      return *this;
+    }
+    Options&& set_num_shards(size_t num_shards) && {
+      return std::move(set_num_shards(num_shards));
+    }
+    size_t num_shards() const { return num_shards_; }
+
+   private:
+    size_t max_size_ = kDefaultMaxSize;
+    size_t num_shards_ = kDefaultNumShards;
+  };
+
+  explicit BlockCache(Options options = Options());
+
+  BlockCache(const BlockCache&) = delete;
+  BlockCache& operator=(const BlockCache&) = delete;
+
+  // Returns a new identifier of a data source, different from all previously
+  // returned identifiers. Blocks of different sources are cached separately.
+  //
+  // Blocks of a source which is no longer read are not removed explicitly,
+  // they are eventually evicted.
+  uint64_t NewSourceId() {
+    return next_source_id_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Looks up the block of the source `source_id` beginning at position `pos`.
+  //
+  // Return values:
+  //  * `true`  - found, `block` is set to the cached block
+  //  * `false` - not found, `block` is unchanged
+  bool Find(uint64_t source_id, Position pos, ChainBlock& block) {
+    return cache_.Find(std::make_pair(source_id, pos), block);
+  }
+
+  // Inserts the block of the source `source_id` beginning at position `pos`,
+  // unless it is already cached, e.g. because it was read concurrently by
+  // another thread.
+  //
+  // Returns the cached block, which is `block` unless it was already cached.
+  ChainBlock Insert(uint64_t source_id, Position pos, ChainBlock block);
+
+  // Removes all blocks from the cache. Blocks which are still referenced
+  // elsewhere remain valid.
+  void Clear() { cache_.Clear(); }
+
+  // Returns the amount of memory used by cached blocks.
+  size_t size() const { return cache_.size(); }
+
+  // Returns the number of calls to `Find()` which found and did not find the
+  // block, for performance tuning.
+  uint64_t num_hits() const { return cache_.num_hits(); }
+  uint64_t num_misses() const { return cache_.num_misses(); }
+
+ private:
+  internal::ShardedLruCache<std::pair<uint64_t, Position>, ChainBlock> cache_;
+  std::atomic<uint64_t> next_source_id_{0};
+};
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_BYTES_BLOCK_CACHE_H_
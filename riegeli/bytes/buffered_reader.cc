@@ -56,22 +56,6 @@ void BufferedReader::VerifyEnd() {
   Reader::VerifyEnd();
 }
 
-inline void BufferedReader::SyncBuffer() {
-  set_buffer();
-  buffer_.Clear();
-}
-
-inline size_t BufferedReader::LengthToReadDirectly() const {
-  // Read directly at least `buffer_size_` of data. Even if the buffer is
-  // partially full, this ensures that at least every other read has length at
-  // least `buffer_size_`.
-  if (pos() < size_hint_) {
-    // Read directly also if `size_hint_` is reached.
-    return UnsignedMin(buffer_size_, size_hint_ - pos());
-  }
-  return buffer_size_;
-}
-
 bool BufferedReader::PullSlow(size_t min_length, size_t recommended_length) {
   RIEGELI_ASSERT_LT(available(), min_length)
       << "Failed precondition of Reader::PullSlow(): "
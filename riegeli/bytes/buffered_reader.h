@@ -76,6 +76,17 @@ class BufferedReader : public Reader {
   // Returns the current size hint, or 0 if it was unset.
   Position size_hint() const { return size_hint_; }
 
+  // Discards buffer contents and sets buffer pointers to `nullptr`.
+  //
+  // This can move `pos()` forwards to account for skipping over previously
+  // buffered data. `limit_pos()` remains unchanged.
+  void SyncBuffer();
+
+  // Minimum length for which it is better to append current contents of
+  // `buffer_` and read the remaining data directly than to read the data
+  // through `buffer_`.
+  size_t LengthToReadDirectly() const;
+
   // `BufferedReader::{Done,SyncImpl}()` seek the source back to the current
   // position if not all buffered data were read. This is feasible only if
   // `SupportsRandomAccess()`.
@@ -128,17 +139,6 @@ class BufferedReader : public Reader {
   bool SeekSlow(Position new_pos) override;
 
  private:
-  // Discards buffer contents and sets buffer pointers to `nullptr`.
-  //
-  // This can move `pos()` forwards to account for skipping over previously
-  // buffered data. `limit_pos()` remains unchanged.
-  void SyncBuffer();
-
-  // Minimum length for which it is better to append current contents of
-  // `buffer_` and read the remaining data directly than to read the data
-  // through `buffer_`.
-  size_t LengthToReadDirectly() const;
-
   // Invariant: if `is_open()` then `buffer_size_ > 0`
   size_t buffer_size_ = 0;
   Position size_hint_ = 0;
@@ -201,6 +201,22 @@ inline void BufferedReader::set_size_hint(absl::optional<Position> size_hint) {
   size_hint_ = size_hint.value_or(0);
 }
 
+inline void BufferedReader::SyncBuffer() {
+  set_buffer();
+  buffer_.Clear();
+}
+
+inline size_t BufferedReader::LengthToReadDirectly() const {
+  // Read directly at least `buffer_size_` of data. Even if the buffer is
+  // partially full, this ensures that at least every other read has length at
+  // least `buffer_size_`.
+  if (pos() < size_hint_) {
+    // Read directly also if `size_hint_` is reached.
+    return UnsignedMin(buffer_size_, size_hint_ - pos());
+  }
+  return buffer_size_;
+}
+
 }  // namespace riegeli
 
 #endif  // RIEGELI_BYTES_BUFFERED_READER_H_
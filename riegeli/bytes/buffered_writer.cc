@@ -54,19 +54,6 @@ bool BufferedWriter::SyncBuffer() {
   return WriteInternal(data);
 }
 
-inline size_t BufferedWriter::LengthToWriteDirectly() const {
-  // Write directly at least `buffer_size_` of data. Even if the buffer is
-  // partially full, this ensures that at least every other write has length at
-  // least `buffer_size_`.
-  if (pos() < size_hint_ &&
-      (start_to_cursor() == 0 || limit_pos() < size_hint_)) {
-    // Write directly also if `size_hint_` is reached, as long as the number of
-    // writes is not increased.
-    return UnsignedMin(buffer_size_, size_hint_ - pos());
-  }
-  return buffer_size_;
-}
-
 bool BufferedWriter::PushSlow(size_t min_length, size_t recommended_length) {
   RIEGELI_ASSERT_LT(available(), min_length)
       << "Failed precondition of Writer::PushSlow(): "
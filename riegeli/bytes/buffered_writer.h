@@ -69,6 +69,10 @@ class BufferedWriter : public Writer {
   // Returns the buffer size option passed to the constructor.
   size_t buffer_size() const { return buffer_size_; }
 
+  // Minimum length for which it is better to push current contents of `buffer_`
+  // and write the data directly than to write the data through `buffer_`.
+  size_t LengthToWriteDirectly() const;
+
   // `BufferedWriter::{Done,FlushImpl}()` call `{Done,Flush}BehindBuffer()` to
   // write the last piece of data and close/flush the destination.
   //
@@ -132,10 +136,6 @@ class BufferedWriter : public Writer {
  private:
   bool SyncBuffer();
 
-  // Minimum length for which it is better to push current contents of `buffer_`
-  // and write the data directly than to write the data through `buffer_`.
-  size_t LengthToWriteDirectly() const;
-
   // Invariant: if `is_open()` then `buffer_size_ > 0`
   size_t buffer_size_ = 0;
   Position size_hint_ = 0;
@@ -189,6 +189,19 @@ inline void BufferedWriter::Reset(size_t buffer_size,
   size_hint_ = size_hint.value_or(0);
 }
 
+inline size_t BufferedWriter::LengthToWriteDirectly() const {
+  // Write directly at least `buffer_size_` of data. Even if the buffer is
+  // partially full, this ensures that at least every other write has length at
+  // least `buffer_size_`.
+  if (pos() < size_hint_ &&
+      (start_to_cursor() == 0 || limit_pos() < size_hint_)) {
+    // Write directly also if `size_hint_` is reached, as long as the number of
+    // writes is not increased.
+    return UnsignedMin(buffer_size_, size_hint_ - pos());
+  }
+  return buffer_size_;
+}
+
 }  // namespace riegeli
 
 #endif  // RIEGELI_BYTES_BUFFERED_WRITER_H_
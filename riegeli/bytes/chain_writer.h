@@ -26,6 +26,7 @@
 #include "absl/types/span.h"
 #include "riegeli/base/base.h"
 #include "riegeli/base/chain.h"
+#include "riegeli/base/chain_arena.h"
 #include "riegeli/base/dependency.h"
 #include "riegeli/base/object.h"
 #include "riegeli/bytes/reader.h"
@@ -106,11 +107,26 @@ class ChainWriterBase : public Writer {
     }
     size_t max_block_size() const { return max_block_size_; }
 
+    // If not `nullptr`, small blocks of allocated data are allocated from this
+    // `ChainArena` instead of separately. The `ChainArena` must be valid while
+    // this `ChainWriter` is open.
+    //
+    // Default: `nullptr`.
+    Options& set_arena(ChainArena* arena) & {
+      arena_ = arena;
+      return *this;
+    }
+    Options&& set_arena(ChainArena* arena) && {
+      return std::move(set_arena(arena));
+    }
+    ChainArena* arena() const { return arena_; }
+
    private:
     bool append_ = false;
     absl::optional<Position> size_hint_;
     size_t min_block_size_ = kMinBufferSize;
     size_t max_block_size_ = kMaxBufferSize;
+    ChainArena* arena_ = nullptr;
   };
 
   // Returns the `Chain` being written to.
@@ -272,7 +288,8 @@ inline ChainWriterBase::ChainWriterBase(const Options& options)
                    .set_size_hint(SaturatingIntCast<size_t>(
                        options.size_hint().value_or(0)))
                    .set_min_block_size(options.min_block_size())
-                   .set_max_block_size(options.max_block_size())) {}
+                   .set_max_block_size(options.max_block_size())
+                   .set_arena(options.arena())) {}
 
 inline ChainWriterBase::ChainWriterBase(ChainWriterBase&& that) noexcept
     : Writer(std::move(that)),
@@ -303,7 +320,8 @@ inline void ChainWriterBase::Reset(const Options& options) {
                  .set_size_hint(
                      SaturatingIntCast<size_t>(options.size_hint().value_or(0)))
                  .set_min_block_size(options.min_block_size())
-                 .set_max_block_size(options.max_block_size());
+                 .set_max_block_size(options.max_block_size())
+                 .set_arena(options.arena());
   associated_reader_.Reset();
 }
 
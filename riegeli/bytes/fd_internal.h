@@ -0,0 +1,58 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_BYTES_FD_INTERNAL_H_
+#define RIEGELI_BYTES_FD_INTERNAL_H_
+
+#include "absl/types/optional.h"
+#include "riegeli/base/base.h"
+#include "riegeli/base/object.h"
+#include "riegeli/bytes/buffered_writer.h"
+
+namespace riegeli {
+namespace internal {
+
+// The part of `FdWriterBase` used by `FdReaderBase::CopySlow()`.
+//
+// `FdReaderBase` cannot depend on `FdWriterBase` directly, because
+// `FdWriterBase` depends on `FdReader` for `ReadMode()`.
+class FdWriterCommon : public BufferedWriter {
+ public:
+  // Copies up to `length` bytes from the fd `src` to the current position of
+  // this `Writer`, without passing them through user space, with
+  // `copy_file_range()` or `sendfile()`.
+  //
+  // Reads from `src_pos` without disturbing the current fd position of `src`
+  // if `src_pos != absl::nullopt`, otherwise reads from the current fd
+  // position.
+  //
+  // Returns the number of bytes copied. This is less than `length` if the
+  // source ends, if the kernel cannot copy between these fds, or if copying
+  // fails. Failures are not reported here: the caller is expected to copy the
+  // remaining data in user space, which reports them.
+  //
+  // Precondition: `healthy()`
+  virtual Position CopyFromFd(int src, absl::optional<Position> src_pos,
+                              Position length) = 0;
+
+  TypeId GetTypeId() const override { return TypeId::For<FdWriterCommon>(); }
+
+ protected:
+  using BufferedWriter::BufferedWriter;
+};
+
+}  // namespace internal
+}  // namespace riegeli
+
+#endif  // RIEGELI_BYTES_FD_INTERNAL_H_
@@ -49,6 +49,8 @@
 #include "riegeli/bytes/buffered_reader.h"
 #include "riegeli/bytes/chain_reader.h"
 #include "riegeli/bytes/fd_dependency.h"
+#include "riegeli/bytes/fd_internal.h"
+#include "riegeli/bytes/writer.h"
 
 namespace riegeli {
 
@@ -208,6 +210,42 @@ bool FdReaderBase::ReadInternal(size_t min_length, size_t max_length,
   }
 }
 
+bool FdReaderBase::CopySlow(Position length, Writer& dest) {
+  RIEGELI_ASSERT_LT(UnsignedMin(available(), kMaxBytesToCopy), length)
+      << "Failed precondition of Reader::CopySlow(Writer&): "
+         "enough data available, use Copy(Writer&) instead";
+  if (length >= LengthToReadDirectly() &&
+      dest.GetTypeId() == TypeId::For<internal::FdWriterCommon>() &&
+      ABSL_PREDICT_TRUE(healthy())) {
+    internal::FdWriterCommon& fd_dest =
+        static_cast<internal::FdWriterCommon&>(dest);
+    const size_t available_length = available();
+    if (available_length > 0) {
+      if (ABSL_PREDICT_FALSE(!dest.Write(cursor(), available_length))) {
+        move_cursor(available_length);
+        return false;
+      }
+      length -= available_length;
+    }
+    SyncBuffer();
+    if (ABSL_PREDICT_FALSE(!dest.healthy())) return false;
+    const Position length_copied = fd_dest.CopyFromFd(
+        src_fd(),
+        has_independent_pos_ ? absl::make_optional(limit_pos()) : absl::nullopt,
+        UnsignedMin(length, Position{std::numeric_limits<off_t>::max()} -
+                                limit_pos()));
+    RIEGELI_ASSERT_LE(length_copied, length)
+        << "FdWriterCommon::CopyFromFd() copied more than requested";
+    move_limit_pos(length_copied);
+    length -= length_copied;
+    if (length == 0) return true;
+    if (ABSL_PREDICT_FALSE(!dest.healthy())) return false;
+    // Copy the remaining data in user space. This reports the end of the source
+    // or a failure if that is why the kernel copy stopped.
+  }
+  return BufferedReader::CopySlow(length, dest);
+}
+
 inline bool FdReaderBase::SeekInternal(int src, Position new_pos) {
   RIEGELI_ASSERT_EQ(available(), 0u)
       << "Failed precondition of FdReaderBase::SeekInternal(): "
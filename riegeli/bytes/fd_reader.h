@@ -175,6 +175,8 @@ class FdReaderBase : public BufferedReader {
 
   void DefaultAnnotateStatus() override;
   bool ReadInternal(size_t min_length, size_t max_length, char* dest) override;
+  using BufferedReader::CopySlow;
+  bool CopySlow(Position length, Writer& dest) override;
   bool SeekBehindBuffer(Position new_pos) override;
   absl::optional<Position> SizeImpl() override;
   std::unique_ptr<Reader> NewReaderImpl(Position initial_pos) override;
@@ -311,6 +313,10 @@ class FdMMapReaderBase : public ChainReader<Chain> {
 //
 // `FdReader` supports `NewReader()` if it supports random access.
 //
+// On Linux, `Copy()` of a large amount of data to an `FdWriter` copies the data
+// in the kernel with `copy_file_range()` or `sendfile()`, without passing them
+// through user space, if the fds support that.
+//
 // The `Src` template parameter specifies the type of the object providing and
 // possibly owning the fd being read from. `Src` must support
 // `Dependency<int, Src>`, e.g. `OwnedFd` (owned, default), `UnownedFd`
@@ -18,6 +18,16 @@
 #define _XOPEN_SOURCE 500
 #endif
 
+// Make `pwritev()` available.
+#if !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE
+#endif
+
+// Make `copy_file_range()`, `fallocate()`, and `mremap()` available.
+#if !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
 // Make `off_t` 64-bit even on 32-bit systems.
 #undef _FILE_OFFSET_BITS
 #define _FILE_OFFSET_BITS 64
@@ -25,22 +35,32 @@
 #include "riegeli/bytes/fd_writer.h"
 
 #include <fcntl.h>
+#include <limits.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
 
+#include <array>
 #include <cerrno>
 #include <limits>
 #include <string>
 
 #include "absl/base/optimization.h"
 #include "absl/status/status.h"
+#include "absl/strings/cord.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
+#include "absl/types/span.h"
 #include "riegeli/base/base.h"
+#include "riegeli/base/chain.h"
 #include "riegeli/base/errno_mapping.h"
 #include "riegeli/bytes/buffered_writer.h"
 #include "riegeli/bytes/fd_dependency.h"
@@ -49,6 +69,40 @@
 
 namespace riegeli {
 
+// Before C++17 if a constexpr static data member is ODR-used, its definition at
+// namespace scope is required. Since C++17 these definitions are deprecated:
+// http://en.cppreference.com/w/cpp/language/static
+#if __cplusplus < 201703
+constexpr Position FdWriterBase::Options::kDefaultPreallocationStep;
+#endif
+
+namespace {
+
+// Maximum number of fragments passed to a single `writev()` or `pwritev()`.
+#ifdef IOV_MAX
+constexpr size_t kMaxFragments = UnsignedMin(size_t{64}, size_t{IOV_MAX});
+#else
+constexpr size_t kMaxFragments = 16;
+#endif
+
+// Minimum amount by which `FdMMapWriter` extends the file.
+constexpr Position kMinMMapGrowth = Position{1} << 20;
+
+#ifdef __linux__
+
+// Maximum length passed to a single `copy_file_range()` or `sendfile()`.
+constexpr size_t kMaxCopyLength = size_t{1} << 30;
+
+#if defined(__GLIBC__) && defined(__GLIBC_PREREQ)
+#if __GLIBC_PREREQ(2, 27)
+#define RIEGELI_INTERNAL_HAS_COPY_FILE_RANGE 1
+#endif
+#endif
+
+#endif
+
+}  // namespace
+
 void FdWriterBase::Initialize(int dest,
                               absl::optional<std::string>&& assumed_filename,
                               absl::optional<Position> assumed_pos,
@@ -147,6 +201,9 @@ void FdWriterBase::InitializePos(int dest, int flags,
 void FdWriterBase::Done() {
   FdWriterBase::WriteModeImpl();
   BufferedWriter::Done();
+  if (preallocated_end_ > 0 && ABSL_PREDICT_TRUE(healthy())) {
+    TrimPreallocation(dest_fd());
+  }
   associated_reader_.Reset();
 }
 
@@ -179,6 +236,7 @@ bool FdWriterBase::WriteInternal(absl::string_view src) {
                              start_pos())) {
     return FailOverflow();
   }
+  Preallocate(dest, start_pos() + src.size());
   do {
   again:
     const ssize_t length_written =
@@ -200,11 +258,267 @@ bool FdWriterBase::WriteInternal(absl::string_view src) {
         << (has_independent_pos_ ? "pwrite()" : "write()")
         << " wrote more than requested";
     move_start_pos(IntCast<size_t>(length_written));
+    file_end_ = UnsignedMax(file_end_, start_pos());
     src.remove_prefix(IntCast<size_t>(length_written));
   } while (!src.empty());
   return true;
 }
 
+bool FdWriterBase::WriteSlow(const Chain& src) {
+  RIEGELI_ASSERT_LT(UnsignedMin(available(), kMaxBytesToCopy), src.size())
+      << "Failed precondition of Writer::WriteSlow(Chain): "
+         "enough space available, use Write(Chain) instead";
+  if (src.size() < LengthToWriteDirectly()) {
+    return BufferedWriter::WriteSlow(src);
+  }
+  return WriteFragments(src.blocks());
+}
+
+bool FdWriterBase::WriteSlow(const absl::Cord& src) {
+  RIEGELI_ASSERT_LT(UnsignedMin(available(), kMaxBytesToCopy), src.size())
+      << "Failed precondition of Writer::WriteSlow(Cord): "
+         "enough space available, use Write(Cord) instead";
+  if (src.size() < LengthToWriteDirectly()) {
+    return BufferedWriter::WriteSlow(src);
+  }
+  return WriteFragments(src.Chunks());
+}
+
+template <typename Fragments>
+inline bool FdWriterBase::WriteFragments(const Fragments& fragments) {
+  std::array<absl::string_view, kMaxFragments> batch;
+  size_t batch_size = 0;
+  // Buffered data are written together with the first fragments.
+  const absl::string_view buffered(start(), start_to_cursor());
+  set_buffer();
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  if (!buffered.empty()) batch[batch_size++] = buffered;
+  for (const absl::string_view fragment : fragments) {
+    if (fragment.empty()) continue;
+    if (batch_size == batch.size()) {
+      if (ABSL_PREDICT_FALSE(!WriteFragmentsInternal(batch))) return false;
+      batch_size = 0;
+    }
+    batch[batch_size++] = fragment;
+  }
+  if (batch_size == 0) return true;
+  return WriteFragmentsInternal(absl::MakeConstSpan(batch.data(), batch_size));
+}
+
+bool FdWriterBase::WriteFragmentsInternal(
+    absl::Span<const absl::string_view> fragments) {
+  RIEGELI_ASSERT_LE(fragments.size(), kMaxFragments)
+      << "Failed precondition of FdWriterBase::WriteFragmentsInternal(): "
+         "too many fragments";
+  RIEGELI_ASSERT(healthy())
+      << "Failed precondition of FdWriterBase::WriteFragmentsInternal(): "
+      << status();
+  std::array<struct iovec, kMaxFragments> iov;
+  size_t length = 0;
+  for (size_t i = 0; i < fragments.size(); ++i) {
+    iov[i].iov_base = const_cast<char*>(fragments[i].data());
+    iov[i].iov_len = fragments[i].size();
+    length += fragments[i].size();
+  }
+#ifdef __linux__
+  constexpr bool kHasPwritev = true;
+#else
+  constexpr bool kHasPwritev = false;
+#endif
+  if (ABSL_PREDICT_FALSE(length >
+                         size_t{std::numeric_limits<ssize_t>::max()}) ||
+      (!kHasPwritev && has_independent_pos_)) {
+    // Writing would exceed the maximum length of a single `writev()`, or
+    // `pwritev()` is not available.
+    for (const absl::string_view fragment : fragments) {
+      if (ABSL_PREDICT_FALSE(!WriteInternal(fragment))) return false;
+    }
+    return true;
+  }
+  if (ABSL_PREDICT_FALSE(length > Position{std::numeric_limits<off_t>::max()} -
+                                      start_pos())) {
+    return FailOverflow();
+  }
+  const int dest = dest_fd();
+  Preallocate(dest, start_pos() + length);
+  struct iovec* iov_begin = iov.data();
+  int iov_count = IntCast<int>(fragments.size());
+  do {
+  again:
+    const ssize_t length_written =
+#ifdef __linux__
+        has_independent_pos_
+            ? pwritev(dest, iov_begin, iov_count, IntCast<off_t>(start_pos()))
+            :
+#endif
+            writev(dest, iov_begin, iov_count);
+    if (ABSL_PREDICT_FALSE(length_written < 0)) {
+      if (errno == EINTR) goto again;
+      return FailOperation(has_independent_pos_ ? "pwritev()" : "writev()");
+    }
+    RIEGELI_ASSERT_GT(length_written, 0)
+        << (has_independent_pos_ ? "pwritev()" : "writev()") << " returned 0";
+    RIEGELI_ASSERT_LE(IntCast<size_t>(length_written), length)
+        << (has_independent_pos_ ? "pwritev()" : "writev()")
+        << " wrote more than requested";
+    move_start_pos(IntCast<size_t>(length_written));
+    file_end_ = UnsignedMax(file_end_, start_pos());
+    length -= IntCast<size_t>(length_written);
+    // Skip fragments written fully, and the written part of the next one.
+    size_t remaining = IntCast<size_t>(length_written);
+    while (iov_count > 0 && remaining >= iov_begin->iov_len) {
+      remaining -= iov_begin->iov_len;
+      ++iov_begin;
+      --iov_count;
+    }
+    if (remaining > 0) {
+      iov_begin->iov_base = static_cast<char*>(iov_begin->iov_base) + remaining;
+      iov_begin->iov_len -= remaining;
+    }
+  } while (length > 0);
+  return true;
+}
+
+Position FdWriterBase::CopyFromFd(int src, absl::optional<Position> src_pos,
+                                  Position length) {
+  RIEGELI_ASSERT(healthy())
+      << "Failed precondition of FdWriterCommon::CopyFromFd(): " << status();
+#ifdef __linux__
+  if (ABSL_PREDICT_FALSE(!BufferedWriter::FlushImpl(FlushType::kFromObject))) {
+    return 0;
+  }
+  const int dest = dest_fd();
+  length = UnsignedMin(
+      length, Position{std::numeric_limits<off_t>::max()} - start_pos());
+  if (src_pos != absl::nullopt) {
+    length = UnsignedMin(
+        length, Position{std::numeric_limits<off_t>::max()} - *src_pos);
+  }
+#ifdef RIEGELI_INTERNAL_HAS_COPY_FILE_RANGE
+  // `copy_file_range()` can copy between regular files, possibly sharing
+  // extents on filesystems which support that. Otherwise `sendfile()` is used,
+  // which supports any destination, but not an independent destination
+  // position.
+  bool use_sendfile = false;
+#else
+  if (has_independent_pos_) return 0;
+  bool use_sendfile = true;
+#endif
+  Position length_copied = 0;
+  while (length_copied < length) {
+    const size_t length_to_copy =
+        IntCast<size_t>(UnsignedMin(length - length_copied, kMaxCopyLength));
+    Preallocate(dest, start_pos() + length_to_copy);
+    off_t src_offset = src_pos == absl::nullopt
+                           ? 0
+                           : IntCast<off_t>(*src_pos + length_copied);
+    ssize_t result;
+    if (use_sendfile) {
+      result = sendfile(dest, src,
+                        src_pos == absl::nullopt ? nullptr : &src_offset,
+                        length_to_copy);
+    } else {
+#ifdef RIEGELI_INTERNAL_HAS_COPY_FILE_RANGE
+      off_t dest_offset = IntCast<off_t>(start_pos());
+      result = copy_file_range(
+          src, src_pos == absl::nullopt ? nullptr : &src_offset, dest,
+          has_independent_pos_ ? &dest_offset : nullptr, length_to_copy, 0);
+      if (ABSL_PREDICT_FALSE(result < 0) && errno != EINTR &&
+          !has_independent_pos_) {
+        // The fds are not supported by `copy_file_range()`, e.g. they are on
+        // different filesystems, or `dest` is a pipe or a socket.
+        use_sendfile = true;
+        continue;
+      }
+#endif
+    }
+    if (ABSL_PREDICT_FALSE(result < 0)) {
+      if (errno == EINTR) continue;
+      break;
+    }
+    if (ABSL_PREDICT_FALSE(result == 0)) break;
+    RIEGELI_ASSERT_LE(IntCast<size_t>(result), length_to_copy)
+        << (use_sendfile ? "sendfile()" : "copy_file_range()")
+        << " copied more than requested";
+    move_start_pos(IntCast<size_t>(result));
+    file_end_ = UnsignedMax(file_end_, start_pos());
+    length_copied += IntCast<size_t>(result);
+  }
+  return length_copied;
+#else
+  return 0;
+#endif
+}
+
+inline void FdWriterBase::Preallocate(int dest, Position end) {
+  if (ABSL_PREDICT_TRUE(!preallocate_ || end <= preallocated_end_)) return;
+  PreallocateSlow(dest, end);
+}
+
+void FdWriterBase::PreallocateSlow(int dest, Position end) {
+#ifdef __linux__
+  if (!supports_random_access_) {
+    // `start_pos()` might not be the physical file position.
+    preallocate_ = false;
+    return;
+  }
+  if (preallocated_end_ == 0) {
+    // Data written before this writer started preallocating are not reflected
+    // in `file_end_`.
+    struct stat stat_info;
+    if (ABSL_PREDICT_FALSE(fstat(dest, &stat_info) < 0)) {
+      preallocate_ = false;
+      return;
+    }
+    file_end_ = UnsignedMax(file_end_, IntCast<Position>(stat_info.st_size));
+  }
+  const Position offset = UnsignedMax(preallocated_end_, start_pos());
+  Position new_end =
+      end <= size_hint_
+          ? size_hint_
+          : UnsignedMax(end, SaturatingAdd(offset, preallocation_step_));
+  new_end = UnsignedMin(new_end, Position{std::numeric_limits<off_t>::max()});
+  if (ABSL_PREDICT_FALSE(new_end <= offset)) return;
+again:
+  // `FALLOC_FL_KEEP_SIZE` leaves the file size unchanged, so that the
+  // preallocated space is invisible to readers and to `Size()`.
+  if (ABSL_PREDICT_FALSE(fallocate(dest, FALLOC_FL_KEEP_SIZE,
+                                   IntCast<off_t>(offset),
+                                   IntCast<off_t>(new_end - offset)) < 0)) {
+    if (errno == EINTR) goto again;
+    // Preallocation is only an optimization, e.g. it is not supported by the
+    // filesystem or there is not enough space for a whole step. Write without
+    // it.
+    preallocate_ = false;
+    return;
+  }
+  preallocated_end_ = new_end;
+#else
+  preallocate_ = false;
+#endif
+}
+
+bool FdWriterBase::TrimPreallocation(int dest) {
+  struct stat stat_info;
+  if (ABSL_PREDICT_FALSE(fstat(dest, &stat_info) < 0)) {
+    return FailOperation("fstat()");
+  }
+  if (IntCast<Position>(stat_info.st_size) >= preallocated_end_) return true;
+  // If the file ends elsewhere than where this writer left it, it might have
+  // been extended by another writer, which might still be extending it.
+  // Truncating it could then discard data written concurrently, so
+  // preallocated space is kept.
+  if (IntCast<Position>(stat_info.st_size) != file_end_) return true;
+again:
+  // Truncating to the current size releases space allocated after it.
+  if (ABSL_PREDICT_FALSE(ftruncate(dest, stat_info.st_size) < 0)) {
+    if (errno == EINTR) goto again;
+    return FailOperation("ftruncate()");
+  }
+  preallocated_end_ = 0;
+  return true;
+}
+
 bool FdWriterBase::FlushImpl(FlushType flush_type) {
   if (ABSL_PREDICT_FALSE(!BufferedWriter::FlushImpl(flush_type))) return false;
   switch (flush_type) {
@@ -298,6 +612,9 @@ again:
     if (errno == EINTR) goto again;
     return FailOperation("ftruncate()");
   }
+  // `ftruncate()` releases preallocated space after `new_size`.
+  preallocated_end_ = UnsignedMin(preallocated_end_, new_size);
+  file_end_ = new_size;
   return SeekInternal(dest, new_size);
 }
 
@@ -334,4 +651,236 @@ bool FdWriterBase::WriteModeImpl() {
   return SeekInternal(dest, start_pos());
 }
 
+void FdMMapWriterBase::MUnmapDeleter::operator()(char* ptr) const {
+  RIEGELI_CHECK_EQ(munmap(ptr, size), 0)
+      << ErrnoToCanonicalStatus(errno, "munmap() failed").message();
+}
+
+void FdMMapWriterBase::Initialize(
+    int dest, absl::optional<std::string>&& assumed_filename,
+    absl::optional<Position> independent_pos) {
+  RIEGELI_ASSERT_GE(dest, 0)
+      << "Failed precondition of FdMMapWriter: negative file descriptor";
+  filename_ = internal::ResolveFilename(dest, std::move(assumed_filename));
+  InitializePos(dest, independent_pos);
+}
+
+int FdMMapWriterBase::OpenFd(absl::string_view filename, int flags,
+                             mode_t permissions) {
+  RIEGELI_ASSERT((flags & O_ACCMODE) == O_RDWR)
+      << "Failed precondition of FdMMapWriter: flags must include O_RDWR";
+  // TODO: When `absl::string_view` becomes C++17 `std::string_view`:
+  // `filename_ = filename`
+  filename_.assign(filename.data(), filename.size());
+again:
+  const int dest = open(filename_.c_str(), flags, permissions);
+  if (ABSL_PREDICT_FALSE(dest < 0)) {
+    if (errno == EINTR) goto again;
+    FailOperation("open()");
+    return -1;
+  }
+  return dest;
+}
+
+void FdMMapWriterBase::InitializePos(int dest,
+                                     absl::optional<Position> independent_pos) {
+  Position initial_pos;
+  if (independent_pos != absl::nullopt) {
+    initial_pos = *independent_pos;
+  } else {
+    const int flags = fcntl(dest, F_GETFL);
+    if (ABSL_PREDICT_FALSE(flags < 0)) {
+      FailOperation("fcntl()");
+      return;
+    }
+    const off_t file_pos =
+        lseek(dest, 0, (flags & O_APPEND) != 0 ? SEEK_END : SEEK_CUR);
+    if (ABSL_PREDICT_FALSE(file_pos < 0)) {
+      FailOperation("lseek()");
+      return;
+    }
+    initial_pos = IntCast<Position>(file_pos);
+  }
+  if (ABSL_PREDICT_FALSE(initial_pos >
+                         Position{std::numeric_limits<off_t>::max()})) {
+    FailOverflow();
+    return;
+  }
+  set_start_pos(initial_pos);
+  struct stat stat_info;
+  if (ABSL_PREDICT_FALSE(fstat(dest, &stat_info) < 0)) {
+    FailOperation("fstat()");
+    return;
+  }
+  const Position file_size = IntCast<Position>(stat_info.st_size);
+  // If the file does not extend to `initial_pos`, the mapping is created when
+  // data are written.
+  if (file_size == 0 || file_size < initial_pos) return;
+  if (ABSL_PREDICT_FALSE(file_size > std::numeric_limits<size_t>::max())) {
+    FailFileTooLarge();
+    return;
+  }
+  void* const data = mmap(nullptr, IntCast<size_t>(file_size),
+                          PROT_READ | PROT_WRITE, MAP_SHARED, dest, 0);
+  if (ABSL_PREDICT_FALSE(data == MAP_FAILED)) {
+    FailOperation("mmap()");
+    return;
+  }
+  mapping_.reset(static_cast<char*>(data));
+  mapping_.get_deleter().size = IntCast<size_t>(file_size);
+  set_start_pos(0);
+  set_buffer(mapping_.get(), IntCast<size_t>(file_size),
+             IntCast<size_t>(initial_pos));
+}
+
+void FdMMapWriterBase::Done() {
+  if (ABSL_PREDICT_TRUE(healthy())) {
+    FdMMapWriterBase::FlushImpl(FlushType::kFromObject);
+  }
+  Writer::Done();
+  mapping_.reset();
+}
+
+bool FdMMapWriterBase::FailOperation(absl::string_view operation) {
+  const int error_number = errno;
+  RIEGELI_ASSERT_NE(error_number, 0)
+      << "Failed precondition of FdMMapWriterBase::FailOperation(): "
+         "zero errno";
+  return Fail(
+      ErrnoToCanonicalStatus(error_number, absl::StrCat(operation, " failed")));
+}
+
+bool FdMMapWriterBase::FailFileTooLarge() {
+  return Fail(absl::OutOfRangeError(absl::StrCat(
+      "mmap() cannot be used writing ", filename_, ": File too large")));
+}
+
+void FdMMapWriterBase::DefaultAnnotateStatus() {
+  RIEGELI_ASSERT(!not_failed())
+      << "Failed precondition of Object::DefaultAnnotateStatus(): "
+         "Object not failed";
+  AnnotateStatus(absl::StrCat("writing ", filename_));
+  Writer::DefaultAnnotateStatus();
+}
+
+bool FdMMapWriterBase::PushSlow(size_t min_length, size_t recommended_length) {
+  RIEGELI_ASSERT_LT(available(), min_length)
+      << "Failed precondition of Writer::PushSlow(): "
+         "enough space available, use Push() instead";
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  if (ABSL_PREDICT_FALSE(min_length >
+                         Position{std::numeric_limits<off_t>::max()} - pos())) {
+    return FailOverflow();
+  }
+  const Position file_size = start_pos() + start_to_limit();
+  const Position new_size = UnsignedMin(
+      UnsignedMax(SaturatingAdd(pos(), UnsignedMax(min_length,
+                                                   recommended_length)),
+                  size_hint_,
+                  // Extend the file in large steps, to amortize the cost of
+                  // `ftruncate()` and `mremap()`.
+                  SaturatingAdd(file_size,
+                                UnsignedMax(file_size, kMinMMapGrowth))),
+      Position{std::numeric_limits<off_t>::max()});
+  return Grow(dest_fd(), new_size);
+}
+
+inline bool FdMMapWriterBase::Grow(int dest, Position new_size) {
+  RIEGELI_ASSERT_GT(new_size, pos())
+      << "Failed precondition of FdMMapWriterBase::Grow(): "
+         "new size does not extend the file";
+  if (ABSL_PREDICT_FALSE(new_size > std::numeric_limits<size_t>::max())) {
+    return FailFileTooLarge();
+  }
+  const size_t cursor_index = IntCast<size_t>(pos());
+again:
+  if (ABSL_PREDICT_FALSE(ftruncate(dest, IntCast<off_t>(new_size)) < 0)) {
+    if (errno == EINTR) goto again;
+    return FailOperation("ftruncate()");
+  }
+  if (mapping_ == nullptr) {
+    void* const data = mmap(nullptr, IntCast<size_t>(new_size),
+                            PROT_READ | PROT_WRITE, MAP_SHARED, dest, 0);
+    if (ABSL_PREDICT_FALSE(data == MAP_FAILED)) return FailOperation("mmap()");
+    mapping_.reset(static_cast<char*>(data));
+    mapping_.get_deleter().size = IntCast<size_t>(new_size);
+  } else if (new_size > mapping_.get_deleter().size) {
+#ifdef __linux__
+    void* const data = mremap(mapping_.get(), mapping_.get_deleter().size,
+                              IntCast<size_t>(new_size), MREMAP_MAYMOVE);
+    if (ABSL_PREDICT_FALSE(data == MAP_FAILED)) {
+      return FailOperation("mremap()");
+    }
+    // The old mapping is gone.
+    mapping_.release();
+#else
+    void* const data = mmap(nullptr, IntCast<size_t>(new_size),
+                            PROT_READ | PROT_WRITE, MAP_SHARED, dest, 0);
+    if (ABSL_PREDICT_FALSE(data == MAP_FAILED)) return FailOperation("mmap()");
+#endif
+    mapping_.reset(static_cast<char*>(data));
+    mapping_.get_deleter().size = IntCast<size_t>(new_size);
+  }
+  set_start_pos(0);
+  set_buffer(mapping_.get(), IntCast<size_t>(new_size), cursor_index);
+  return true;
+}
+
+inline bool FdMMapWriterBase::TruncateToPos(int dest) {
+  if (mapping_ != nullptr && start_to_limit() == start_to_cursor()) {
+    return true;
+  }
+again:
+  if (ABSL_PREDICT_FALSE(ftruncate(dest, IntCast<off_t>(pos())) < 0)) {
+    if (errno == EINTR) goto again;
+    return FailOperation("ftruncate()");
+  }
+  if (mapping_ != nullptr) {
+    set_buffer(start(), start_to_cursor(), start_to_cursor());
+  }
+  return true;
+}
+
+bool FdMMapWriterBase::FlushImpl(FlushType flush_type) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  const int dest = dest_fd();
+  if (ABSL_PREDICT_FALSE(!TruncateToPos(dest))) return false;
+  if (!has_independent_pos_) {
+    if (ABSL_PREDICT_FALSE(lseek(dest, IntCast<off_t>(pos()), SEEK_SET) < 0)) {
+      return FailOperation("lseek()");
+    }
+  }
+  switch (flush_type) {
+    case FlushType::kFromObject:
+    case FlushType::kFromProcess:
+      return true;
+    case FlushType::kFromMachine:
+      if (mapping_ != nullptr && start_to_limit() > 0) {
+        if (ABSL_PREDICT_FALSE(
+                msync(mapping_.get(), start_to_limit(), MS_SYNC) < 0)) {
+          return FailOperation("msync()");
+        }
+      }
+      return true;
+  }
+  RIEGELI_ASSERT_UNREACHABLE()
+      << "Unknown flush type: " << static_cast<int>(flush_type);
+}
+
+absl::optional<Position> FdMMapWriterBase::SizeImpl() {
+  if (ABSL_PREDICT_FALSE(!healthy())) return absl::nullopt;
+  return pos();
+}
+
+bool FdMMapWriterBase::TruncateImpl(Position new_size) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  if (ABSL_PREDICT_FALSE(new_size > pos())) return false;
+  if (mapping_ == nullptr) {
+    set_start_pos(new_size);
+  } else {
+    set_cursor(start() + IntCast<size_t>(new_size));
+  }
+  return true;
+}
+
 }  // namespace riegeli
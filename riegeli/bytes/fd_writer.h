@@ -19,6 +19,7 @@
 #include <stddef.h>
 #include <sys/types.h>
 
+#include <memory>
 #include <string>
 #include <tuple>
 #include <type_traits>
@@ -26,14 +27,19 @@
 
 #include "absl/base/attributes.h"
 #include "absl/base/optimization.h"
+#include "absl/strings/cord.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
+#include "absl/types/span.h"
 #include "riegeli/base/base.h"
+#include "riegeli/base/chain.h"
 #include "riegeli/base/dependency.h"
 #include "riegeli/base/object.h"
 #include "riegeli/bytes/buffered_writer.h"
 #include "riegeli/bytes/fd_dependency.h"
+#include "riegeli/bytes/fd_internal.h"
 #include "riegeli/bytes/reader.h"
+#include "riegeli/bytes/writer.h"
 
 namespace riegeli {
 
@@ -41,7 +47,7 @@ template <typename Src>
 class FdReader;
 
 // Template parameter independent part of `FdWriter`.
-class FdWriterBase : public BufferedWriter {
+class FdWriterBase : public internal::FdWriterCommon {
  public:
   class Options {
    public:
@@ -151,12 +157,74 @@ class FdWriterBase : public BufferedWriter {
     }
     size_t buffer_size() const { return buffer_size_; }
 
+    // Expected final size of the file, or `absl::nullopt` if unknown. This
+    // avoids allocating a larger buffer than necessary, and with
+    // `preallocate()` determines how much space is preallocated initially.
+    //
+    // If the size hint turns out to not match reality, nothing breaks.
+    //
+    // Default: `absl::nullopt`.
+    Options& set_size_hint(absl::optional<Position> size_hint) & {
+      size_hint_ = size_hint;
+      return *this;
+    }
+    Options&& set_size_hint(absl::optional<Position> size_hint) && {
+      return std::move(set_size_hint(size_hint));
+    }
+    absl::optional<Position> size_hint() const { return size_hint_; }
+
+    // If `true`, disk space is preallocated with `fallocate()` ahead of
+    // writing: up to `size_hint()` if that is known, and then in steps of at
+    // least `preallocation_step()`. This keeps the file in fewer extents when
+    // many files are written concurrently, which makes reading it faster.
+    //
+    // Unused preallocated space is released by `Close()` with `ftruncate()`,
+    // but only if the file ends where this `FdWriter` left it: at the highest
+    // position written, including after seeking back. Since checking this and
+    // truncating are not atomic, the file should not be extended by other
+    // writers while this `FdWriter` is being closed.
+    //
+    // Preallocation is done only on Linux, and only if random access is
+    // supported. If the filesystem does not support preallocation, it is
+    // skipped.
+    //
+    // Default: `false`.
+    Options& set_preallocate(bool preallocate) & {
+      preallocate_ = preallocate;
+      return *this;
+    }
+    Options&& set_preallocate(bool preallocate) && {
+      return std::move(set_preallocate(preallocate));
+    }
+    bool preallocate() const { return preallocate_; }
+
+    // If `preallocate()`, the minimum amount of space preallocated at a time
+    // after `size_hint()` is exceeded.
+    //
+    // Default: `kDefaultPreallocationStep` (64M).
+    static constexpr Position kDefaultPreallocationStep = Position{64} << 20;
+    Options& set_preallocation_step(Position preallocation_step) & {
+      RIEGELI_ASSERT_GT(preallocation_step, 0u)
+          << "Failed precondition of "
+             "FdWriterBase::Options::set_preallocation_step(): "
+             "zero preallocation step";
+      preallocation_step_ = preallocation_step;
+      return *this;
+    }
+    Options&& set_preallocation_step(Position preallocation_step) && {
+      return std::move(set_preallocation_step(preallocation_step));
+    }
+    Position preallocation_step() const { return preallocation_step_; }
+
    private:
     absl::optional<std::string> assumed_filename_;
     mode_t permissions_ = 0666;
     absl::optional<Position> assumed_pos_;
     absl::optional<Position> independent_pos_;
     size_t buffer_size_ = kDefaultBufferSize;
+    absl::optional<Position> size_hint_;
+    bool preallocate_ = false;
+    Position preallocation_step_ = kDefaultPreallocationStep;
   };
 
   // Returns the fd being written to. If the fd is owned then changed to -1 by
@@ -170,16 +238,21 @@ class FdWriterBase : public BufferedWriter {
   bool SupportsRandomAccess() override { return supports_random_access_; }
   bool SupportsReadMode() override { return supports_read_mode_; }
 
+  Position CopyFromFd(int src, absl::optional<Position> src_pos,
+                      Position length) override;
+
  protected:
-  explicit FdWriterBase(Closed) noexcept : BufferedWriter(kClosed) {}
+  explicit FdWriterBase(Closed) noexcept : FdWriterCommon(kClosed) {}
 
-  explicit FdWriterBase(size_t buffer_size);
+  explicit FdWriterBase(size_t buffer_size, absl::optional<Position> size_hint,
+                        bool preallocate, Position preallocation_step);
 
   FdWriterBase(FdWriterBase&& that) noexcept;
   FdWriterBase& operator=(FdWriterBase&& that) noexcept;
 
   void Reset(Closed);
-  void Reset(size_t buffer_size);
+  void Reset(size_t buffer_size, absl::optional<Position> size_hint,
+             bool preallocate, Position preallocation_step);
   void Initialize(int dest, absl::optional<std::string>&& assumed_filename,
                   absl::optional<Position> assumed_pos,
                   absl::optional<Position> independent_pos);
@@ -193,6 +266,9 @@ class FdWriterBase : public BufferedWriter {
   void Done() override;
   void DefaultAnnotateStatus() override;
   bool WriteInternal(absl::string_view src) override;
+  using BufferedWriter::WriteSlow;
+  bool WriteSlow(const Chain& src) override;
+  bool WriteSlow(const absl::Cord& src) override;
   bool FlushImpl(FlushType flush_type) override;
   bool SeekBehindBuffer(Position new_pos) override;
   absl::optional<Position> SizeBehindBuffer() override;
@@ -201,12 +277,35 @@ class FdWriterBase : public BufferedWriter {
   bool WriteModeImpl() override;
 
  private:
+  // Writes buffered data followed by `fragments` with as few `writev()` or
+  // `pwritev()` calls as possible, without copying them to the buffer.
+  template <typename Fragments>
+  bool WriteFragments(const Fragments& fragments);
+  // Writes concatenated `fragments`, like `WriteInternal()`.
+  bool WriteFragmentsInternal(absl::Span<const absl::string_view> fragments);
   bool SeekInternal(int dest, Position new_pos);
+  // Ensures that space is preallocated up to at least `end` if
+  // `preallocate_`.
+  void Preallocate(int dest, Position end);
+  void PreallocateSlow(int dest, Position end);
+  // Releases preallocated space after the end of the file, if the file ends at
+  // `file_end_`.
+  bool TrimPreallocation(int dest);
 
   std::string filename_;
   bool supports_random_access_ = false;
   bool has_independent_pos_ = false;
   bool supports_read_mode_ = false;
+  Position size_hint_ = 0;
+  // Cleared if preallocation turns out to be not possible.
+  bool preallocate_ = false;
+  Position preallocation_step_ = 0;
+  // The file has space preallocated up to this position.
+  Position preallocated_end_ = 0;
+  // If `preallocated_end_ > 0`, the end of the file as left by this writer:
+  // its size when preallocation started or the highest position written since
+  // then, or the size set by `Truncate()`.
+  Position file_end_ = 0;
 
   AssociatedReader<FdReader<UnownedFd>> associated_reader_;
 
@@ -221,11 +320,17 @@ class FdWriterBase : public BufferedWriter {
 //  * `close()`     - if the fd is owned
 //  * `write()`     - if `Options::independent_pos() == absl::nullopt`
 //  * `pwrite()`    - if `Options::independent_pos() != absl::nullopt`
+//  * `writev()`    - for writing a large `Chain` or `absl::Cord`,
+//                    if `Options::independent_pos() == absl::nullopt`
+//  * `pwritev()`   - for writing a large `Chain` or `absl::Cord`,
+//                    if `Options::independent_pos() != absl::nullopt`
+//                    (on Linux)
 //  * `lseek()`     - for `Seek()`, `Size()`, or `Truncate()`,
 //                    if `Options::independent_pos() == absl::nullopt`
 //  * `fstat()`     - for `Seek()`, `Size()`, or `Truncate()`
 //  * `fsync()`     - for `Flush(FlushType::kFromMachine)`
-//  * `ftruncate()` - for `Truncate()`
+//  * `ftruncate()` - for `Truncate()`, or if `Options::preallocate()`
+//  * `fallocate()` - if `Options::preallocate()` (on Linux)
 //  * `read()`      - for `ReadMode()`
 //                    if `Options::independent_pos() == absl::nullopt`
 //                    (fd must be opened with `O_RDWR`)
@@ -337,19 +442,309 @@ explicit FdWriter(absl::string_view filename, int flags,
     ->FdWriter<>;
 #endif
 
+// Template parameter independent part of `FdMMapWriter`.
+class FdMMapWriterBase : public Writer {
+ public:
+  class Options {
+   public:
+    Options() noexcept {}
+
+    // If `FdMMapWriter` writes to an already open fd,
+    // `set_assumed_filename()` allows to override the filename which is
+    // included in failure messages and returned by `filename()`.
+    //
+    // If this is `absl::nullopt`, then "/dev/stdin", "/dev/stdout",
+    // "/dev/stderr", or "/proc/self/fd/<fd>" is assumed.
+    //
+    // If `FdMMapWriter` writes to a filename, `set_assumed_filename()` has no
+    // effect.
+    //
+    // Default: `absl::nullopt`
+    Options& set_assumed_filename(
+        absl::optional<absl::string_view> assumed_filename) & {
+      if (assumed_filename == absl::nullopt) {
+        assumed_filename_ = absl::nullopt;
+      } else {
+        // TODO: When `absl::string_view` becomes C++17
+        // `std::string_view`: `assumed_filename_.emplace(*assumed_filename)`
+        assumed_filename_.emplace(assumed_filename->data(),
+                                  assumed_filename->size());
+      }
+      return *this;
+    }
+    Options&& set_assumed_filename(
+        absl::optional<absl::string_view> assumed_filename) && {
+      return std::move(set_assumed_filename(assumed_filename));
+    }
+    absl::optional<std::string>& assumed_filename() {
+      return assumed_filename_;
+    }
+    const absl::optional<std::string>& assumed_filename() const {
+      return assumed_filename_;
+    }
+
+    // Permissions to use in case a new file is created (9 bits). The effective
+    // permissions are modified by the process's umask.
+    //
+    // Default: `0666`.
+    Options& set_permissions(mode_t permissions) & {
+      permissions_ = permissions;
+      return *this;
+    }
+    Options&& set_permissions(mode_t permissions) && {
+      return std::move(set_permissions(permissions));
+    }
+    mode_t permissions() const { return permissions_; }
+
+    // If `absl::nullopt`, `FdMMapWriter` writes starting from the current fd
+    // position (or from the end of the file if the fd was opened with
+    // `O_APPEND`). The `FdMMapWriter` position is synchronized back to the fd
+    // by `Close()` and `Flush()`.
+    //
+    // If not `absl::nullopt`, `FdMMapWriter` writes starting from this
+    // position, without disturbing the current fd position.
+    //
+    // Default: `absl::nullopt`.
+    Options& set_independent_pos(absl::optional<Position> independent_pos) & {
+      independent_pos_ = independent_pos;
+      return *this;
+    }
+    Options&& set_independent_pos(absl::optional<Position> independent_pos) && {
+      return std::move(set_independent_pos(independent_pos));
+    }
+    absl::optional<Position> independent_pos() const {
+      return independent_pos_;
+    }
+
+    // Expected final size of the file, or `absl::nullopt` if unknown. The file
+    // and the mapping are extended to this size at once, instead of growing
+    // them in steps.
+    //
+    // If the size hint turns out to not match reality, nothing breaks.
+    //
+    // Default: `absl::nullopt`.
+    Options& set_size_hint(absl::optional<Position> size_hint) & {
+      size_hint_ = size_hint;
+      return *this;
+    }
+    Options&& set_size_hint(absl::optional<Position> size_hint) && {
+      return std::move(set_size_hint(size_hint));
+    }
+    absl::optional<Position> size_hint() const { return size_hint_; }
+
+   private:
+    absl::optional<std::string> assumed_filename_;
+    mode_t permissions_ = 0666;
+    absl::optional<Position> independent_pos_;
+    absl::optional<Position> size_hint_;
+  };
+
+  // Returns the fd being written to. If the fd is owned then changed to -1 by
+  // `Close()`, otherwise unchanged.
+  virtual int dest_fd() const = 0;
+
+  // Returns the original name of the file being written to. Unchanged by
+  // `Close()`.
+  const std::string& filename() const { return filename_; }
+
+  bool SupportsSize() override { return true; }
+  bool SupportsTruncate() override { return true; }
+
+ protected:
+  explicit FdMMapWriterBase(Closed) noexcept : Writer(kClosed) {}
+
+  explicit FdMMapWriterBase(absl::optional<Position> size_hint,
+                            bool has_independent_pos);
+
+  FdMMapWriterBase(FdMMapWriterBase&& that) noexcept;
+  FdMMapWriterBase& operator=(FdMMapWriterBase&& that) noexcept;
+
+  void Reset(Closed);
+  void Reset(absl::optional<Position> size_hint, bool has_independent_pos);
+  void Initialize(int dest, absl::optional<std::string>&& assumed_filename,
+                  absl::optional<Position> independent_pos);
+  int OpenFd(absl::string_view filename, int flags, mode_t permissions);
+  void InitializePos(int dest, absl::optional<Position> independent_pos);
+  ABSL_ATTRIBUTE_COLD bool FailOperation(absl::string_view operation);
+
+  void Done() override;
+  void DefaultAnnotateStatus() override;
+  bool PushSlow(size_t min_length, size_t recommended_length) override;
+  bool FlushImpl(FlushType flush_type) override;
+  absl::optional<Position> SizeImpl() override;
+  bool TruncateImpl(Position new_size) override;
+
+ private:
+  struct MUnmapDeleter {
+    MUnmapDeleter() noexcept : size(0) {}
+
+    void operator()(char* ptr) const;
+
+    size_t size;
+  };
+
+  ABSL_ATTRIBUTE_COLD bool FailFileTooLarge();
+  // Extends the file and the mapping so that the file has `new_size`.
+  bool Grow(int dest, Position new_size);
+  // Truncates the file to `pos()`, and makes the buffer end there.
+  bool TruncateToPos(int dest);
+
+  std::string filename_;
+  Position size_hint_ = 0;
+  bool has_independent_pos_ = false;
+  // The mapping of the file, starting from file position 0. The file size is
+  // `start_to_limit()`; the mapping can extend further.
+  std::unique_ptr<char, MUnmapDeleter> mapping_;
+
+  // Invariants:
+  //   if `mapping_ != nullptr` then `start() == mapping_.get()`
+  //                            and `start_pos() == 0`
+  //   `start_to_limit() <= mapping_.get_deleter().size`
+};
+
+// A `Writer` which writes to a file descriptor by mapping the file to memory.
+//
+// Data are written directly to the mapping, avoiding `write()` calls and
+// copying through a buffer. The file is extended with `ftruncate()` in large
+// steps, and the mapping with `mremap()` (on Linux) or a new `mmap()`.
+//
+// This is suitable for outputs whose size is known or bounded in advance, e.g.
+// given by `Options::size_hint()`.
+//
+// The file is truncated to the final position by `Close()` and `Flush()`, so
+// data which were in the file after the final position are removed.
+//
+// The fd must support:
+//  * `fcntl()`     - for the constructor from fd,
+//                    if `Options::independent_pos() == absl::nullopt`
+//  * `close()`     - if the fd is owned
+//  * `fstat()`
+//  * `ftruncate()`
+//  * `mmap()`      - the fd must be opened with `O_RDWR`
+//  * `mremap()`    - on Linux
+//  * `munmap()`
+//  * `msync()`     - for `Flush(FlushType::kFromMachine)`
+//  * `lseek()`     - if `Options::independent_pos() == absl::nullopt`
+//
+// `FdMMapWriter` supports `Size()` and `Truncate()`, but not random access.
+//
+// The `Dest` template parameter specifies the type of the object providing and
+// possibly owning the fd being written to. `Dest` must support
+// `Dependency<int, Dest>`, e.g. `OwnedFd` (owned, default), `UnownedFd`
+// (not owned).
+//
+// By relying on CTAD the template argument can be deduced as `OwnedFd` if the
+// first constructor argument is a filename or an `int`, otherwise as the value
+// type of the first constructor argument. This requires C++17.
+//
+// Until the `FdMMapWriter` is closed or no longer used, the fd must not be
+// closed, and the file must not be truncated or written to by other means.
+template <typename Dest = OwnedFd>
+class FdMMapWriter : public FdMMapWriterBase {
+ public:
+  // Creates a closed `FdMMapWriter`.
+  explicit FdMMapWriter(Closed) noexcept : FdMMapWriterBase(kClosed) {}
+
+  // Will write to the fd provided by `dest`.
+  explicit FdMMapWriter(const Dest& dest, Options options = Options());
+  explicit FdMMapWriter(Dest&& dest, Options options = Options());
+
+  // Will write to the fd provided by a `Dest` constructed from elements of
+  // `dest_args`. This avoids constructing a temporary `Dest` and moving from
+  // it.
+  template <typename... DestArgs>
+  explicit FdMMapWriter(std::tuple<DestArgs...> dest_args,
+                        Options options = Options());
+
+  // Opens a file for writing.
+  //
+  // `flags` is the second argument of `open()`, typically
+  // `O_RDWR | O_CREAT | O_TRUNC`.
+  //
+  // `flags` must include `O_RDWR`.
+  //
+  // If opening the file fails, `FdMMapWriter` will be failed and closed.
+  explicit FdMMapWriter(absl::string_view filename, int flags,
+                        Options options = Options());
+
+  FdMMapWriter(FdMMapWriter&& that) noexcept;
+  FdMMapWriter& operator=(FdMMapWriter&& that) noexcept;
+
+  // Makes `*this` equivalent to a newly constructed `FdMMapWriter`. This avoids
+  // constructing a temporary `FdMMapWriter` and moving from it.
+  void Reset(Closed);
+  void Reset(const Dest& dest, Options options = Options());
+  void Reset(Dest&& dest, Options options = Options());
+  template <typename... DestArgs>
+  void Reset(std::tuple<DestArgs...> dest_args, Options options = Options());
+  void Reset(absl::string_view filename, int flags,
+             Options options = Options());
+
+  // Returns the object providing and possibly owning the fd being written to.
+  // If the fd is owned then changed to -1 by `Close()`, otherwise unchanged.
+  Dest& dest() { return dest_.manager(); }
+  const Dest& dest() const { return dest_.manager(); }
+  int dest_fd() const override { return dest_.get(); }
+
+ protected:
+  using FdMMapWriterBase::Initialize;
+  void Initialize(absl::string_view filename, int flags, Options&& options);
+
+  void Done() override;
+
+ private:
+  // The object providing and possibly owning the fd being written to.
+  Dependency<int, Dest> dest_;
+};
+
+// Support CTAD.
+#if __cpp_deduction_guides
+explicit FdMMapWriter(Closed)->FdMMapWriter<DeleteCtad<Closed>>;
+template <typename Dest>
+explicit FdMMapWriter(const Dest& dest, FdMMapWriterBase::Options options =
+                                            FdMMapWriterBase::Options())
+    -> FdMMapWriter<
+        std::conditional_t<std::is_convertible<const Dest&, int>::value,
+                           OwnedFd, std::decay_t<Dest>>>;
+template <typename Dest>
+explicit FdMMapWriter(Dest&& dest, FdMMapWriterBase::Options options =
+                                       FdMMapWriterBase::Options())
+    -> FdMMapWriter<std::conditional_t<std::is_convertible<Dest&&, int>::value,
+                                       OwnedFd, std::decay_t<Dest>>>;
+template <typename... DestArgs>
+explicit FdMMapWriter(
+    std::tuple<DestArgs...> dest_args,
+    FdMMapWriterBase::Options options = FdMMapWriterBase::Options())
+    -> FdMMapWriter<DeleteCtad<std::tuple<DestArgs...>>>;
+explicit FdMMapWriter(
+    absl::string_view filename, int flags,
+    FdMMapWriterBase::Options options = FdMMapWriterBase::Options())
+    ->FdMMapWriter<>;
+#endif
+
 // Implementation details follow.
 
-inline FdWriterBase::FdWriterBase(size_t buffer_size)
-    : BufferedWriter(buffer_size) {}
+inline FdWriterBase::FdWriterBase(size_t buffer_size,
+                                  absl::optional<Position> size_hint,
+                                  bool preallocate, Position preallocation_step)
+    : FdWriterCommon(buffer_size, size_hint),
+      size_hint_(size_hint.value_or(0)),
+      preallocate_(preallocate),
+      preallocation_step_(preallocation_step) {}
 
 inline FdWriterBase::FdWriterBase(FdWriterBase&& that) noexcept
-    : BufferedWriter(std::move(that)),
+    : FdWriterCommon(std::move(that)),
       // Using `that` after it was moved is correct because only the base class
       // part was moved.
       filename_(std::move(that.filename_)),
       supports_random_access_(that.supports_random_access_),
       has_independent_pos_(that.has_independent_pos_),
       supports_read_mode_(that.supports_read_mode_),
+      size_hint_(that.size_hint_),
+      preallocate_(that.preallocate_),
+      preallocation_step_(that.preallocation_step_),
+      preallocated_end_(that.preallocated_end_),
+      file_end_(that.file_end_),
       associated_reader_(std::move(that.associated_reader_)) {}
 
 inline FdWriterBase& FdWriterBase::operator=(FdWriterBase&& that) noexcept {
@@ -360,6 +755,11 @@ inline FdWriterBase& FdWriterBase::operator=(FdWriterBase&& that) noexcept {
   supports_random_access_ = that.supports_random_access_;
   has_independent_pos_ = that.has_independent_pos_;
   supports_read_mode_ = that.supports_read_mode_;
+  size_hint_ = that.size_hint_;
+  preallocate_ = that.preallocate_;
+  preallocation_step_ = that.preallocation_step_;
+  preallocated_end_ = that.preallocated_end_;
+  file_end_ = that.file_end_;
   associated_reader_ = std::move(that.associated_reader_);
   return *this;
 }
@@ -370,28 +770,44 @@ inline void FdWriterBase::Reset(Closed) {
   supports_random_access_ = false;
   has_independent_pos_ = false;
   supports_read_mode_ = false;
+  size_hint_ = 0;
+  preallocate_ = false;
+  preallocation_step_ = 0;
+  preallocated_end_ = 0;
+  file_end_ = 0;
   associated_reader_.Reset();
 }
 
-inline void FdWriterBase::Reset(size_t buffer_size) {
-  BufferedWriter::Reset(buffer_size);
+inline void FdWriterBase::Reset(size_t buffer_size,
+                                absl::optional<Position> size_hint,
+                                bool preallocate, Position preallocation_step) {
+  BufferedWriter::Reset(buffer_size, size_hint);
   // `filename_` was set by `OpenFd()` or will be set by `Initialize()`.
   supports_random_access_ = false;
   has_independent_pos_ = false;
   supports_read_mode_ = false;
+  size_hint_ = size_hint.value_or(0);
+  preallocate_ = preallocate;
+  preallocation_step_ = preallocation_step;
+  preallocated_end_ = 0;
+  file_end_ = 0;
   associated_reader_.Reset();
 }
 
 template <typename Dest>
 inline FdWriter<Dest>::FdWriter(const Dest& dest, Options options)
-    : FdWriterBase(options.buffer_size()), dest_(dest) {
+    : FdWriterBase(options.buffer_size(), options.size_hint(),
+                   options.preallocate(), options.preallocation_step()),
+      dest_(dest) {
   Initialize(dest_.get(), std::move(options.assumed_filename()),
              options.assumed_pos(), options.independent_pos());
 }
 
 template <typename Dest>
 inline FdWriter<Dest>::FdWriter(Dest&& dest, Options options)
-    : FdWriterBase(options.buffer_size()), dest_(std::move(dest)) {
+    : FdWriterBase(options.buffer_size(), options.size_hint(),
+                   options.preallocate(), options.preallocation_step()),
+      dest_(std::move(dest)) {
   Initialize(dest_.get(), std::move(options.assumed_filename()),
              options.assumed_pos(), options.independent_pos());
 }
@@ -400,7 +816,9 @@ template <typename Dest>
 template <typename... DestArgs>
 inline FdWriter<Dest>::FdWriter(std::tuple<DestArgs...> dest_args,
                                 Options options)
-    : FdWriterBase(options.buffer_size()), dest_(std::move(dest_args)) {
+    : FdWriterBase(options.buffer_size(), options.size_hint(),
+                   options.preallocate(), options.preallocation_step()),
+      dest_(std::move(dest_args)) {
   Initialize(dest_.get(), std::move(options.assumed_filename()),
              options.assumed_pos(), options.independent_pos());
 }
@@ -436,7 +854,8 @@ inline void FdWriter<Dest>::Reset(Closed) {
 
 template <typename Dest>
 inline void FdWriter<Dest>::Reset(const Dest& dest, Options options) {
-  FdWriterBase::Reset(options.buffer_size());
+  FdWriterBase::Reset(options.buffer_size(), options.size_hint(),
+                      options.preallocate(), options.preallocation_step());
   dest_.Reset(dest);
   Initialize(dest_.get(), std::move(options.assumed_filename()),
              options.assumed_pos(), options.independent_pos());
@@ -444,7 +863,8 @@ inline void FdWriter<Dest>::Reset(const Dest& dest, Options options) {
 
 template <typename Dest>
 inline void FdWriter<Dest>::Reset(Dest&& dest, Options options) {
-  FdWriterBase::Reset(options.buffer_size());
+  FdWriterBase::Reset(options.buffer_size(), options.size_hint(),
+                      options.preallocate(), options.preallocation_step());
   dest_.Reset(std::move(dest));
   Initialize(dest_.get(), std::move(options.assumed_filename()),
              options.assumed_pos(), options.independent_pos());
@@ -454,7 +874,8 @@ template <typename Dest>
 template <typename... DestArgs>
 inline void FdWriter<Dest>::Reset(std::tuple<DestArgs...> dest_args,
                                   Options options) {
-  FdWriterBase::Reset(options.buffer_size());
+  FdWriterBase::Reset(options.buffer_size(), options.size_hint(),
+                      options.preallocate(), options.preallocation_step());
   dest_.Reset(std::move(dest_args));
   Initialize(dest_.get(), std::move(options.assumed_filename()),
              options.assumed_pos(), options.independent_pos());
@@ -472,7 +893,8 @@ void FdWriter<Dest>::Initialize(absl::string_view filename, int flags,
                                 Options&& options) {
   const int dest = OpenFd(filename, flags, options.permissions());
   if (ABSL_PREDICT_FALSE(dest < 0)) return;
-  FdWriterBase::Reset(options.buffer_size());
+  FdWriterBase::Reset(options.buffer_size(), options.size_hint(),
+                      options.preallocate(), options.preallocation_step());
   dest_.Reset(std::forward_as_tuple(dest));
   InitializePos(dest_.get(), flags, options.assumed_pos(),
                 options.independent_pos());
@@ -490,6 +912,169 @@ void FdWriter<Dest>::Done() {
   }
 }
 
+inline FdMMapWriterBase::FdMMapWriterBase(absl::optional<Position> size_hint,
+                                          bool has_independent_pos)
+    : size_hint_(size_hint.value_or(0)),
+      has_independent_pos_(has_independent_pos) {}
+
+inline FdMMapWriterBase::FdMMapWriterBase(FdMMapWriterBase&& that) noexcept
+    : Writer(std::move(that)),
+      // Using `that` after it was moved is correct because only the base class
+      // part was moved.
+      filename_(std::move(that.filename_)),
+      size_hint_(that.size_hint_),
+      has_independent_pos_(that.has_independent_pos_),
+      mapping_(std::move(that.mapping_)) {}
+
+inline FdMMapWriterBase& FdMMapWriterBase::operator=(
+    FdMMapWriterBase&& that) noexcept {
+  Writer::operator=(std::move(that));
+  // Using `that` after it was moved is correct because only the base class part
+  // was moved.
+  filename_ = std::move(that.filename_);
+  size_hint_ = that.size_hint_;
+  has_independent_pos_ = that.has_independent_pos_;
+  mapping_ = std::move(that.mapping_);
+  return *this;
+}
+
+inline void FdMMapWriterBase::Reset(Closed) {
+  Writer::Reset(kClosed);
+  filename_ = std::string();
+  size_hint_ = 0;
+  has_independent_pos_ = false;
+  mapping_.reset();
+}
+
+inline void FdMMapWriterBase::Reset(absl::optional<Position> size_hint,
+                                    bool has_independent_pos) {
+  Writer::Reset();
+  // `filename_` was set by `OpenFd()` or will be set by `Initialize()`.
+  size_hint_ = size_hint.value_or(0);
+  has_independent_pos_ = has_independent_pos;
+  mapping_.reset();
+}
+
+template <typename Dest>
+inline FdMMapWriter<Dest>::FdMMapWriter(const Dest& dest, Options options)
+    : FdMMapWriterBase(options.size_hint(),
+                       options.independent_pos() != absl::nullopt),
+      dest_(dest) {
+  Initialize(dest_.get(), std::move(options.assumed_filename()),
+             options.independent_pos());
+}
+
+template <typename Dest>
+inline FdMMapWriter<Dest>::FdMMapWriter(Dest&& dest, Options options)
+    : FdMMapWriterBase(options.size_hint(),
+                       options.independent_pos() != absl::nullopt),
+      dest_(std::move(dest)) {
+  Initialize(dest_.get(), std::move(options.assumed_filename()),
+             options.independent_pos());
+}
+
+template <typename Dest>
+template <typename... DestArgs>
+inline FdMMapWriter<Dest>::FdMMapWriter(std::tuple<DestArgs...> dest_args,
+                                        Options options)
+    : FdMMapWriterBase(options.size_hint(),
+                       options.independent_pos() != absl::nullopt),
+      dest_(std::move(dest_args)) {
+  Initialize(dest_.get(), std::move(options.assumed_filename()),
+             options.independent_pos());
+}
+
+template <typename Dest>
+inline FdMMapWriter<Dest>::FdMMapWriter(absl::string_view filename, int flags,
+                                        Options options)
+    : FdMMapWriterBase(kClosed) {
+  Initialize(filename, flags, std::move(options));
+}
+
+template <typename Dest>
+inline FdMMapWriter<Dest>::FdMMapWriter(FdMMapWriter&& that) noexcept
+    : FdMMapWriterBase(std::move(that)),
+      // Using `that` after it was moved is correct because only the base class
+      // part was moved.
+      dest_(std::move(that.dest_)) {}
+
+template <typename Dest>
+inline FdMMapWriter<Dest>& FdMMapWriter<Dest>::operator=(
+    FdMMapWriter&& that) noexcept {
+  FdMMapWriterBase::operator=(std::move(that));
+  // Using `that` after it was moved is correct because only the base class part
+  // was moved.
+  dest_ = std::move(that.dest_);
+  return *this;
+}
+
+template <typename Dest>
+inline void FdMMapWriter<Dest>::Reset(Closed) {
+  FdMMapWriterBase::Reset(kClosed);
+  dest_.Reset();
+}
+
+template <typename Dest>
+inline void FdMMapWriter<Dest>::Reset(const Dest& dest, Options options) {
+  FdMMapWriterBase::Reset(options.size_hint(),
+                          options.independent_pos() != absl::nullopt);
+  dest_.Reset(dest);
+  Initialize(dest_.get(), std::move(options.assumed_filename()),
+             options.independent_pos());
+}
+
+template <typename Dest>
+inline void FdMMapWriter<Dest>::Reset(Dest&& dest, Options options) {
+  FdMMapWriterBase::Reset(options.size_hint(),
+                          options.independent_pos() != absl::nullopt);
+  dest_.Reset(std::move(dest));
+  Initialize(dest_.get(), std::move(options.assumed_filename()),
+             options.independent_pos());
+}
+
+template <typename Dest>
+template <typename... DestArgs>
+inline void FdMMapWriter<Dest>::Reset(std::tuple<DestArgs...> dest_args,
+                                      Options options) {
+  FdMMapWriterBase::Reset(options.size_hint(),
+                          options.independent_pos() != absl::nullopt);
+  dest_.Reset(std::move(dest_args));
+  Initialize(dest_.get(), std::move(options.assumed_filename()),
+             options.independent_pos());
+}
+
+template <typename Dest>
+inline void FdMMapWriter<Dest>::Reset(absl::string_view filename, int flags,
+                                      Options options) {
+  Reset(kClosed);
+  Initialize(filename, flags, std::move(options));
+}
+
+template <typename Dest>
+void FdMMapWriter<Dest>::Initialize(absl::string_view filename, int flags,
+                                    Options&& options) {
+  RIEGELI_ASSERT((flags & O_ACCMODE) == O_RDWR)
+      << "Failed precondition of FdMMapWriter: flags must include O_RDWR";
+  const int dest = OpenFd(filename, flags, options.permissions());
+  if (ABSL_PREDICT_FALSE(dest < 0)) return;
+  FdMMapWriterBase::Reset(options.size_hint(),
+                          options.independent_pos() != absl::nullopt);
+  dest_.Reset(std::forward_as_tuple(dest));
+  InitializePos(dest_.get(), options.independent_pos());
+}
+
+template <typename Dest>
+void FdMMapWriter<Dest>::Done() {
+  FdMMapWriterBase::Done();
+  if (dest_.is_owning()) {
+    const int dest = dest_.Release();
+    if (ABSL_PREDICT_FALSE(internal::CloseFd(dest) < 0) &&
+        ABSL_PREDICT_TRUE(healthy())) {
+      FailOperation(internal::kCloseFunctionName);
+    }
+  }
+}
+
 }  // namespace riegeli
 
 #endif  // RIEGELI_BYTES_FD_WRITER_H_
@@ -27,9 +27,11 @@
 #include "absl/strings/string_view.h"
 #include "absl/synchronization/mutex.h"
 #include "absl/types/optional.h"
+#include "absl/types/span.h"
 #include "riegeli/base/base.h"
 #include "riegeli/base/chain.h"
 #include "riegeli/base/object.h"
+#include "riegeli/bytes/block_cache.h"
 #include "riegeli/bytes/pullable_reader.h"
 #include "riegeli/bytes/reader.h"
 #include "riegeli/bytes/writer.h"
@@ -62,8 +64,22 @@ class ReaderFactoryBase::ConcurrentReader : public PullableReader {
 
  private:
   bool ReadSome();
+  bool ReadSomeFromCache();
+  bool ReadBlock(Position block_begin, ChainBlock& block);
+  bool ReadBlockFrom(Reader& src, Position block_begin, ChainBlock& block);
+  // Calls `function(src)` with a `Reader` of the original source, and returns
+  // its result: `*block_reader_` if `shared_->reader_supports_new_reader`,
+  // otherwise `*shared_->reader` under `shared_->mutex`.
+  //
+  // Returns `false` without calling `function` if `block_reader_` cannot be
+  // created.
+  template <typename Function>
+  bool WithSource(Function function);
 
   Shared* shared_;
+  // Reads data from the original source, bypassing `shared_->mutex`, if
+  // `shared_->reader_supports_new_reader`. Created lazily.
+  std::unique_ptr<Reader> block_reader_;
   // Buffered data, read directly before the original position which is
   // `start_pos() + (secondary_buffer_.size() - iter_.CharIndexInChain())`
   // when scratch is not used.
@@ -88,9 +104,11 @@ void ReaderFactoryBase::ConcurrentReader::Done() {
   PullableReader::Done();
   secondary_buffer_ = Chain();
   iter_ = Chain::BlockIterator();
+  block_reader_.reset();
 }
 
 inline bool ReaderFactoryBase::ConcurrentReader::ReadSome() {
+  if (shared_->block_cache != nullptr) return ReadSomeFromCache();
   size_t length;
   {
     absl::MutexLock l(&shared_->mutex);
@@ -113,6 +131,75 @@ inline bool ReaderFactoryBase::ConcurrentReader::ReadSome() {
   return true;
 }
 
+bool ReaderFactoryBase::ConcurrentReader::ReadSomeFromCache() {
+  const Position block_begin = limit_pos() - limit_pos() % shared_->buffer_size;
+  ChainBlock block;
+  if (!shared_->block_cache->Find(shared_->source_id, block_begin, block)) {
+    if (ABSL_PREDICT_FALSE(!ReadBlock(block_begin, block))) return false;
+    if (ABSL_PREDICT_FALSE(block.empty())) {
+      // Source ends.
+      return false;
+    }
+    block = shared_->block_cache->Insert(shared_->source_id, block_begin,
+                                         std::move(block));
+  }
+  const size_t offset = IntCast<size_t>(limit_pos() - block_begin);
+  if (ABSL_PREDICT_FALSE(offset >= block.size())) {
+    // Source ends. A block shorter than `shared_->buffer_size` is the last
+    // one.
+    set_limit_pos(block_begin + block.size());
+    return false;
+  }
+  block.AppendSubstrTo(
+      absl::string_view(block.data() + offset, block.size() - offset),
+      secondary_buffer_);
+  iter_ = secondary_buffer_.blocks().cbegin();
+  return true;
+}
+
+template <typename Function>
+inline bool ReaderFactoryBase::ConcurrentReader::WithSource(
+    Function function) {
+  if (shared_->reader_supports_new_reader) {
+    if (block_reader_ == nullptr) {
+      absl::MutexLock l(&shared_->mutex);
+      block_reader_ = shared_->reader->NewReader(limit_pos());
+      if (ABSL_PREDICT_FALSE(block_reader_ == nullptr)) {
+        return Fail(*shared_->reader);
+      }
+    }
+    return function(*block_reader_);
+  }
+  absl::MutexLock l(&shared_->mutex);
+  return function(*shared_->reader);
+}
+
+bool ReaderFactoryBase::ConcurrentReader::ReadBlock(Position block_begin,
+                                                    ChainBlock& block) {
+  return WithSource([&](Reader& src) {
+    return ReadBlockFrom(src, block_begin, block);
+  });
+}
+
+bool ReaderFactoryBase::ConcurrentReader::ReadBlockFrom(Reader& src,
+                                                        Position block_begin,
+                                                        ChainBlock& block) {
+  const absl::Span<char> buffer =
+      block.AppendFixedBuffer(shared_->buffer_size);
+  if (ABSL_PREDICT_FALSE(!src.Seek(block_begin) ||
+                         !src.Read(buffer.size(), buffer.data()))) {
+    if (ABSL_PREDICT_FALSE(!src.healthy())) return Fail(src);
+    // Source ends. Keep the part which was read. If nothing was read, the
+    // source ends at `src.pos()`, which might be before `block_begin`.
+    if (src.pos() < limit_pos()) set_limit_pos(src.pos());
+    block.RemoveSuffix(
+        buffer.size() -
+        (src.pos() > block_begin ? IntCast<size_t>(src.pos() - block_begin)
+                                 : size_t{0}));
+  }
+  return true;
+}
+
 bool ReaderFactoryBase::ConcurrentReader::PullBehindScratch() {
   RIEGELI_ASSERT_EQ(available(), 0u)
       << "Failed precondition of PullableReader::PullBehindScratch(): "
@@ -177,19 +264,16 @@ bool ReaderFactoryBase::ConcurrentReader::ReadBehindScratch(size_t length,
     secondary_buffer_.Clear();
     iter_ = secondary_buffer_.blocks().cend();
     if (length >= shared_->buffer_size) {
-      {
-        absl::MutexLock l(&shared_->mutex);
-        if (ABSL_PREDICT_FALSE(!shared_->reader->Seek(limit_pos()) ||
-                               !shared_->reader->Read(length, dest))) {
-          set_limit_pos(shared_->reader->pos());
-          if (ABSL_PREDICT_FALSE(!shared_->reader->healthy())) {
-            return Fail(*shared_->reader);
-          }
+      return WithSource([&](Reader& src) {
+        if (ABSL_PREDICT_FALSE(!src.Seek(limit_pos()) ||
+                               !src.Read(length, dest))) {
+          set_limit_pos(src.pos());
+          if (ABSL_PREDICT_FALSE(!src.healthy())) return Fail(src);
           return false;
         }
-      }
-      move_limit_pos(length);
-      return true;
+        move_limit_pos(length);
+        return true;
+      });
     }
     if (ABSL_PREDICT_FALSE(!ReadSome())) return false;
   }
@@ -235,19 +319,16 @@ bool ReaderFactoryBase::ConcurrentReader::ReadBehindScratch(size_t length,
     secondary_buffer_.Clear();
     iter_ = secondary_buffer_.blocks().cend();
     if (length >= shared_->buffer_size) {
-      {
-        absl::MutexLock l(&shared_->mutex);
-        if (ABSL_PREDICT_FALSE(!shared_->reader->Seek(limit_pos()) ||
-                               !shared_->reader->ReadAndAppend(length, dest))) {
-          set_limit_pos(shared_->reader->pos());
-          if (ABSL_PREDICT_FALSE(!shared_->reader->healthy())) {
-            return Fail(*shared_->reader);
-          }
+      return WithSource([&](Reader& src) {
+        if (ABSL_PREDICT_FALSE(!src.Seek(limit_pos()) ||
+                               !src.ReadAndAppend(length, dest))) {
+          set_limit_pos(src.pos());
+          if (ABSL_PREDICT_FALSE(!src.healthy())) return Fail(src);
           return false;
         }
-      }
-      move_limit_pos(length);
-      return true;
+        move_limit_pos(length);
+        return true;
+      });
     }
     if (ABSL_PREDICT_FALSE(!ReadSome())) return false;
   }
@@ -293,19 +374,16 @@ bool ReaderFactoryBase::ConcurrentReader::ReadBehindScratch(size_t length,
     secondary_buffer_.Clear();
     iter_ = secondary_buffer_.blocks().cend();
     if (length >= shared_->buffer_size) {
-      {
-        absl::MutexLock l(&shared_->mutex);
-        if (ABSL_PREDICT_FALSE(!shared_->reader->Seek(limit_pos()) ||
-                               !shared_->reader->ReadAndAppend(length, dest))) {
-          set_limit_pos(shared_->reader->pos());
-          if (ABSL_PREDICT_FALSE(!shared_->reader->healthy())) {
-            return Fail(*shared_->reader);
-          }
+      return WithSource([&](Reader& src) {
+        if (ABSL_PREDICT_FALSE(!src.Seek(limit_pos()) ||
+                               !src.ReadAndAppend(length, dest))) {
+          set_limit_pos(src.pos());
+          if (ABSL_PREDICT_FALSE(!src.healthy())) return Fail(src);
           return false;
         }
-      }
-      move_limit_pos(length);
-      return true;
+        move_limit_pos(length);
+        return true;
+      });
     }
     if (ABSL_PREDICT_FALSE(!ReadSome())) return false;
   }
@@ -354,19 +432,16 @@ bool ReaderFactoryBase::ConcurrentReader::CopyBehindScratch(Position length,
     iter_ = secondary_buffer_.blocks().cend();
     set_buffer();
     if (length >= shared_->buffer_size) {
-      {
-        absl::MutexLock l(&shared_->mutex);
-        if (ABSL_PREDICT_FALSE(!shared_->reader->Seek(limit_pos()) ||
-                               !shared_->reader->Copy(length, dest))) {
-          set_limit_pos(shared_->reader->pos());
-          if (ABSL_PREDICT_FALSE(!shared_->reader->healthy())) {
-            return Fail(*shared_->reader);
-          }
+      return WithSource([&](Reader& src) {
+        if (ABSL_PREDICT_FALSE(!src.Seek(limit_pos()) ||
+                               !src.Copy(length, dest))) {
+          set_limit_pos(src.pos());
+          if (ABSL_PREDICT_FALSE(!src.healthy())) return Fail(src);
           return false;
         }
-      }
-      move_limit_pos(length);
-      return true;
+        move_limit_pos(length);
+        return true;
+      });
     }
     if (ABSL_PREDICT_FALSE(!ReadSome())) return false;
   }
@@ -388,17 +463,15 @@ void ReaderFactoryBase::ConcurrentReader::ReadHintBehindScratch(size_t length) {
     secondary_buffer_.RemovePrefix(secondary_buffer_.size() -
                                    secondary_buffered_length);
     const size_t length_to_read = length - secondary_buffered_length;
-    {
-      absl::MutexLock l(&shared_->mutex);
+    WithSource([&](Reader& src) {
       if (ABSL_PREDICT_FALSE(
-              !shared_->reader->Seek(limit_pos() + secondary_buffered_length) ||
-              !shared_->reader->ReadAndAppend(length_to_read,
-                                              secondary_buffer_))) {
-        if (ABSL_PREDICT_FALSE(!shared_->reader->healthy())) {
-          Fail(*shared_->reader);
-        }
+              !src.Seek(limit_pos() + secondary_buffered_length) ||
+              !src.ReadAndAppend(length_to_read, secondary_buffer_))) {
+        if (ABSL_PREDICT_FALSE(!src.healthy())) return Fail(src);
+        return false;
       }
-    }
+      return true;
+    });
     iter_ = secondary_buffer_.blocks().cbegin();
     if (iter_ != secondary_buffer_.blocks().cend()) {
       set_buffer(iter_->data(), iter_->size());
@@ -442,14 +515,8 @@ bool ReaderFactoryBase::ConcurrentReader::SeekBehindScratch(Position new_pos) {
   set_limit_pos(secondary_buffer_end);
   if (new_pos > secondary_buffer_end) {
     // Seeking forwards.
-    absl::optional<Position> size;
-    {
-      absl::MutexLock l(&shared_->mutex);
-      size = shared_->reader->Size();
-      if (ABSL_PREDICT_FALSE(size == absl::nullopt)) {
-        return Fail(*shared_->reader);
-      }
-    }
+    const absl::optional<Position> size = SizeImpl();
+    if (ABSL_PREDICT_FALSE(size == absl::nullopt)) return false;
     if (ABSL_PREDICT_FALSE(new_pos > *size)) {
       // Source ends.
       set_limit_pos(*size);
@@ -462,9 +529,12 @@ bool ReaderFactoryBase::ConcurrentReader::SeekBehindScratch(Position new_pos) {
 
 absl::optional<Position> ReaderFactoryBase::ConcurrentReader::SizeImpl() {
   if (ABSL_PREDICT_FALSE(!healthy())) return absl::nullopt;
-  absl::MutexLock l(&shared_->mutex);
-  const absl::optional<Position> size = shared_->reader->Size();
-  if (ABSL_PREDICT_FALSE(size == absl::nullopt)) Fail(*shared_->reader);
+  absl::optional<Position> size;
+  WithSource([&](Reader& src) {
+    size = src.Size();
+    if (ABSL_PREDICT_FALSE(size == absl::nullopt)) return Fail(src);
+    return true;
+  });
   return size;
 }
 
@@ -473,13 +543,19 @@ std::unique_ptr<Reader> ReaderFactoryBase::ConcurrentReader::NewReaderImpl(
   return std::make_unique<ConcurrentReader>(initial_pos, shared_);
 }
 
-void ReaderFactoryBase::Initialize(size_t buffer_size, Reader* src) {
+void ReaderFactoryBase::Initialize(size_t buffer_size, BlockCache* block_cache,
+                                   Reader* src) {
   RIEGELI_ASSERT(src != nullptr)
       << "Failed precondition of ReaderFactory: null Reader pointer";
   RIEGELI_ASSERT(src->SupportsRandomAccess())
       << "Failed precondition of ReaderFactory: "
          "the original Reader does not support random access";
-  if (!src->SupportsNewReader()) {
+  if (block_cache != nullptr) {
+    shared_ = std::make_unique<Shared>(buffer_size, src);
+    shared_->block_cache = block_cache;
+    shared_->source_id = block_cache->NewSourceId();
+    shared_->reader_supports_new_reader = src->SupportsNewReader();
+  } else if (!src->SupportsNewReader()) {
     shared_ = std::make_unique<Shared>(buffer_size, src);
   }
 }
@@ -17,6 +17,8 @@
 
 #include <stddef.h>
 
+#include <stdint.h>
+
 #include <memory>
 #include <tuple>
 #include <type_traits>
@@ -28,6 +30,7 @@
 #include "riegeli/base/dependency.h"
 #include "riegeli/base/object.h"
 #include "riegeli/base/stable_dependency.h"
+#include "riegeli/bytes/block_cache.h"
 #include "riegeli/bytes/reader.h"
 
 namespace riegeli {
@@ -55,8 +58,35 @@ class ReaderFactoryBase : public Object {
     }
     size_t buffer_size() const { return buffer_size_; }
 
+    // If not `nullptr`, data are read in blocks of `buffer_size()` aligned to
+    // multiples of `buffer_size()`, which are looked up in and added to
+    // `*block_cache`. Readers of the same source then share blocks instead of
+    // buffering their own copies, and blocks found in the cache are not read
+    // from the source again. Reads of at least `buffer_size()` bytes bypass
+    // the cache.
+    //
+    // Blocks missing in the cache, reads bypassing the cache, and `Size()` use
+    // a `Reader` created by `Reader::NewReader()` of the original `Reader` if
+    // it is supported (e.g. `FdReader`, which reads with `pread()`), so that
+    // concurrent readers do not wait for each other. Otherwise they use the
+    // original `Reader` under a lock.
+    //
+    // `*block_cache` must outlive the `ReaderFactory` and readers created by
+    // it. It can be shared by several `ReaderFactory` objects.
+    //
+    // Default: `nullptr`.
+    Options& set_block_cache(BlockCache* block_cache) & {
+      block_cache_ = block_cache;
+      return *this;
+    }
+    Options&& set_block_cache(BlockCache* block_cache) && {
+      return std::move(set_block_cache(block_cache));
+    }
+    BlockCache* block_cache() const { return block_cache_; }
+
    private:
     size_t buffer_size_ = kDefaultBufferSize;
+    BlockCache* block_cache_ = nullptr;
   };
 
   // Returns the original `Reader`. Unchanged by `Close()`.
@@ -67,7 +97,7 @@ class ReaderFactoryBase : public Object {
   // `Reader`, but has an independent current position.
   //
   // This allows for interleaved or concurrent reading of several regions of the
-  // same source.
+  // same source. `NewReader()` may be called concurrently from several threads.
   //
   // The new `Reader` does not own the source, even if the original `Reader`
   // does. The original `Reader` must not be accessed until the new `Reader` is
@@ -85,7 +115,7 @@ class ReaderFactoryBase : public Object {
 
   void Reset(Closed);
   void Reset();
-  void Initialize(size_t buffer_size, Reader* src);
+  void Initialize(size_t buffer_size, BlockCache* block_cache, Reader* src);
 
   void Done() override;
 
@@ -99,6 +129,13 @@ class ReaderFactoryBase : public Object {
     size_t buffer_size;
     absl::Mutex mutex;
     Reader* reader;
+    // If not `nullptr`, blocks are shared through `*block_cache`, where they
+    // are identified by `source_id`.
+    BlockCache* block_cache = nullptr;
+    uint64_t source_id = 0;
+    // If `true`, readers access the source with readers created by
+    // `reader->NewReader()` instead of `reader` itself.
+    bool reader_supports_new_reader = false;
   };
 
   std::unique_ptr<Shared> shared_;
@@ -110,7 +147,8 @@ class ReaderFactoryBase : public Object {
 // The original `Reader` must support random access.
 //
 // If the original `Reader` actually supports `NewReader()`, `ReaderFactory`
-// uses the original `Reader::NewReader()` rather than a substitute.
+// uses the original `Reader::NewReader()` rather than a substitute, unless
+// `Options::set_block_cache()` is used.
 //
 // The `Src` template parameter specifies the type of the object providing and
 // possibly owning the original `Reader`. `Src` must support
@@ -213,13 +251,13 @@ inline void ReaderFactoryBase::Reset() {
 template <typename Src>
 inline ReaderFactory<Src>::ReaderFactory(const Src& src, Options options)
     : src_(src) {
-  Initialize(options.buffer_size(), src_.get());
+  Initialize(options.buffer_size(), options.block_cache(), src_.get());
 }
 
 template <typename Src>
 inline ReaderFactory<Src>::ReaderFactory(Src&& src, Options options)
     : src_(std::move(src)) {
-  Initialize(options.buffer_size(), src_.get());
+  Initialize(options.buffer_size(), options.block_cache(), src_.get());
 }
 
 template <typename Src>
@@ -227,7 +265,7 @@ template <typename... SrcArgs>
 inline ReaderFactory<Src>::ReaderFactory(std::tuple<SrcArgs...> src_args,
                                          Options options)
     : src_(std::move(src_args)) {
-  Initialize(options.buffer_size(), src_.get());
+  Initialize(options.buffer_size(), options.block_cache(), src_.get());
 }
 
 template <typename Src>
@@ -257,14 +295,14 @@ template <typename Src>
 inline void ReaderFactory<Src>::Reset(const Src& src, Options options) {
   ReaderFactoryBase::Reset();
   src_.Reset(src);
-  Initialize(options.buffer_size(), src_.get());
+  Initialize(options.buffer_size(), options.block_cache(), src_.get());
 }
 
 template <typename Src>
 inline void ReaderFactory<Src>::Reset(Src&& src, Options options) {
   ReaderFactoryBase::Reset();
   src_.Reset(std::move(src));
-  Initialize(options.buffer_size(), src_.get());
+  Initialize(options.buffer_size(), options.block_cache(), src_.get());
 }
 
 template <typename Src>
@@ -273,7 +311,7 @@ inline void ReaderFactory<Src>::Reset(std::tuple<SrcArgs...> src_args,
                                       Options options) {
   ReaderFactoryBase::Reset();
   src_.Reset(std::move(src_args));
-  Initialize(options.buffer_size(), src_.get());
+  Initialize(options.buffer_size(), options.block_cache(), src_.get());
 }
 
 template <typename Src>
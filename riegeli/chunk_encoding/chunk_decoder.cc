@@ -71,6 +71,22 @@ bool ChunkDecoder::Decode(const Chunk& chunk) {
   return true;
 }
 
+ChunkDecoder::Decoded ChunkDecoder::GetDecoded() const {
+  RIEGELI_ASSERT(healthy())
+      << "Failed precondition of ChunkDecoder::GetDecoded(): " << status();
+  return Decoded{limits_, values_reader_.src()};
+}
+
+void ChunkDecoder::SetDecoded(const Decoded& decoded) {
+  RIEGELI_ASSERT_EQ(decoded.limits.empty() ? size_t{0} : decoded.limits.back(),
+                    decoded.values.size())
+      << "Failed precondition of ChunkDecoder::SetDecoded(): "
+         "wrong last record end position";
+  Clear();
+  limits_ = decoded.limits;
+  values_reader_.Reset(decoded.values);
+}
+
 inline bool ChunkDecoder::Parse(const ChunkHeader& header, Reader& src,
                                 Chain& dest) {
   switch (header.chunk_type()) {
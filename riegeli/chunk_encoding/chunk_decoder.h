@@ -72,6 +72,16 @@ class ChunkDecoder : public Object {
     FieldProjection field_projection_ = FieldProjection::All();
   };
 
+  // Records of a chunk after decoding, which can be shared with another
+  // `ChunkDecoder` with the same field projection, avoiding decoding the same
+  // chunk again.
+  struct Decoded {
+    // Record end positions in `values`.
+    std::vector<size_t> limits;
+    // Concatenated records.
+    Chain values;
+  };
+
   // Creates an empty `ChunkDecoder`.
   explicit ChunkDecoder(Options options = Options());
 
@@ -92,6 +102,21 @@ class ChunkDecoder : public Object {
   //  * `false` - failure (`!healthy()`)
   bool Decode(const Chunk& chunk);
 
+  // Returns records of the chunk decoded by `Decode()`, to be given to
+  // `SetDecoded()` of a `ChunkDecoder` with the same field projection.
+  //
+  // Values share memory with this `ChunkDecoder` where possible.
+  //
+  // Precondition: `healthy()`
+  Decoded GetDecoded() const;
+
+  // Resets the `ChunkDecoder` to records returned by `GetDecoded()`, as if
+  // `Decode()` was called with the same chunk. Keeps options unchanged.
+  //
+  // The field projection is assumed to be the same as of the `ChunkDecoder`
+  // which decoded the records.
+  void SetDecoded(const Decoded& decoded);
+
   // Reads the next record.
   //
   // `ReadRecord(google::protobuf::MessageLite&)` parses raw bytes to a proto
@@ -134,6 +159,9 @@ class ChunkDecoder : public Object {
   // Returns the number of records. Unchanged by `Close()`.
   uint64_t num_records() const { return IntCast<uint64_t>(limits_.size()); }
 
+  // Returns the set of fields included in decoded records.
+  const FieldProjection& field_projection() const { return field_projection_; }
+
  protected:
   void Done() override;
 
@@ -79,7 +79,8 @@ void Compressor::Initialize() {
               .set_compression_level(compressor_options_.compression_level())
               .set_window_log(compressor_options_.zstd_window_log())
               .set_pledged_size(tuning_options_.pledged_size())
-              .set_size_hint(tuning_options_.size_hint()));
+              .set_size_hint(tuning_options_.size_hint())
+              .set_parallelism(compressor_options_.zstd_parallelism()));
       return;
     case CompressionType::kSnappy:
       writer_ = std::make_unique<SnappyWriter<ChainWriter<>>>(
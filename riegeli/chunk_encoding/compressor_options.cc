@@ -14,6 +14,7 @@
 
 #include "riegeli/chunk_encoding/compressor_options.h"
 
+#include <limits>
 #include <string>
 #include <utility>
 
@@ -78,6 +79,8 @@ absl::Status CompressorOptions::FromString(absl::string_view text) {
                       }));
     options_parser.AddOption("window_log",
                              [](ValueParser& value_parser) { return true; });
+    options_parser.AddOption("zstd_parallelism",
+                             [](ValueParser& value_parser) { return true; });
     if (ABSL_PREDICT_FALSE(!options_parser.FromString(text))) {
       return options_parser.status();
     }
@@ -140,6 +143,13 @@ absl::Status CompressorOptions::FromString(absl::string_view text) {
     RIEGELI_ASSERT_UNREACHABLE() << "Unknown compression type: "
                                  << static_cast<unsigned>(compression_type_);
   }());
+  options_parser.AddOption(
+      "zstd_parallelism",
+      ValueParser::Int(0,
+                       compression_type_ == CompressionType::kZstd
+                           ? std::numeric_limits<int>::max()
+                           : 0,
+                       &zstd_parallelism_));
   if (ABSL_PREDICT_FALSE(!options_parser.FromString(text))) {
     return options_parser.status();
   }
@@ -39,10 +39,12 @@ class CompressorOptions {
   //     "brotli" (":" brotli_level)? |
   //     "zstd" (":" zstd_level)? |
   //     "snappy" |
-  //     "window_log" ":" window_log
+  //     "window_log" ":" window_log |
+  //     "zstd_parallelism" ":" zstd_parallelism
   //   brotli_level ::= integer in the range [0..11] (default 6)
   //   zstd_level ::= integer in the range [-131072..22] (default 3)
   //   window_log ::= "auto" or integer in the range [10..31]
+  //   zstd_parallelism ::= non-negative integer
   // ```
   //
   // Returns status:
@@ -171,6 +173,28 @@ class CompressorOptions {
   }
   absl::optional<int> window_log() const { return window_log_; }
 
+  // Number of background threads which Zstd uses to compress a single chunk
+  // in parallel. This is useful for large chunks; see
+  // `ZstdWriterBase::Options::set_parallelism()`.
+  //
+  // This is independent from `RecordWriterBase::Options::parallelism()`, which
+  // encodes multiple chunks in parallel.
+  //
+  // For compression algorithms other than Zstd, `zstd_parallelism` must be 0.
+  //
+  // `zstd_parallelism` must be non-negative. Default: 0.
+  CompressorOptions& set_zstd_parallelism(int zstd_parallelism) & {
+    RIEGELI_ASSERT_GE(zstd_parallelism, 0)
+        << "Failed precondition of CompressorOptions::set_zstd_parallelism(): "
+           "negative parallelism";
+    zstd_parallelism_ = zstd_parallelism;
+    return *this;
+  }
+  CompressorOptions&& set_zstd_parallelism(int zstd_parallelism) && {
+    return std::move(set_zstd_parallelism(zstd_parallelism));
+  }
+  int zstd_parallelism() const { return zstd_parallelism_; }
+
   // Returns `window_log()` translated for `BrotliWriter`.
   //
   // Precondition: `compression_type() == CompressionType::kBrotli`
@@ -185,6 +209,7 @@ class CompressorOptions {
   CompressionType compression_type_ = CompressionType::kBrotli;
   int compression_level_ = kDefaultBrotli;
   absl::optional<int> window_log_;
+  int zstd_parallelism_ = 0;
 };
 
 }  // namespace riegeli
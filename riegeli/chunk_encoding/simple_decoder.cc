@@ -21,8 +21,10 @@
 #include <tuple>
 #include <vector>
 
+#include "absl/base/macros.h"
 #include "absl/base/optimization.h"
 #include "absl/status/status.h"
+#include "absl/types/span.h"
 #include "riegeli/base/base.h"
 #include "riegeli/base/object.h"
 #include "riegeli/bytes/limiting_reader.h"
@@ -74,19 +76,26 @@ bool SimpleDecoder::Decode(Reader* src, uint64_t num_records,
   }
   limits.clear();
   size_t limit = 0;
+  // Sizes are read in batches, which lets `ReadVarints64()` decode many of them
+  // at a time.
+  uint64_t sizes[256];
   while (limits.size() != num_records) {
-    uint64_t size;
-    if (ABSL_PREDICT_FALSE(!ReadVarint64(sizes_decompressor.reader(), size))) {
+    const absl::Span<uint64_t> batch(
+        sizes, UnsignedMin(num_records - limits.size(), ABSL_ARRAYSIZE(sizes)));
+    if (ABSL_PREDICT_FALSE(
+            !ReadVarints64(sizes_decompressor.reader(), batch))) {
       sizes_decompressor.reader().Fail(
           absl::InvalidArgumentError("Reading record size failed"));
       return Fail(sizes_decompressor.reader());
     }
-    if (ABSL_PREDICT_FALSE(size > decoded_data_size - limit)) {
-      return Fail(
-          absl::InvalidArgumentError("Decoded data size larger than expected"));
+    for (const uint64_t size : batch) {
+      if (ABSL_PREDICT_FALSE(size > decoded_data_size - limit)) {
+        return Fail(absl::InvalidArgumentError(
+            "Decoded data size larger than expected"));
+      }
+      limit += IntCast<size_t>(size);
+      limits.push_back(limit);
     }
-    limit += IntCast<size_t>(size);
-    limits.push_back(limit);
   }
   if (ABSL_PREDICT_FALSE(!sizes_decompressor.VerifyEndAndClose())) {
     return Fail(sizes_decompressor);
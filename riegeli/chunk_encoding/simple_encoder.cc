@@ -21,10 +21,12 @@
 #include <utility>
 #include <vector>
 
+#include "absl/base/macros.h"
 #include "absl/base/optimization.h"
 #include "absl/status/status.h"
 #include "absl/strings/cord.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "google/protobuf/message_lite.h"
 #include "riegeli/base/base.h"
 #include "riegeli/base/chain.h"
@@ -135,19 +137,28 @@ bool SimpleEncoder::AddRecords(Chain records, std::vector<size_t> limits) {
   }
   num_records_ += IntCast<uint64_t>(limits.size());
   decoded_data_size_ += IntCast<uint64_t>(records.size());
+  // Sizes are written in batches, which lets `WriteVarints64()` encode many of
+  // them at a time.
+  uint64_t sizes[256];
   size_t start = 0;
-  for (const size_t limit : limits) {
-    RIEGELI_ASSERT_GE(limit, start)
-        << "Failed precondition of ChunkEncoder::AddRecords(): "
-           "record end positions not sorted";
-    RIEGELI_ASSERT_LE(limit, records.size())
-        << "Failed precondition of ChunkEncoder::AddRecords(): "
-           "record end positions do not match concatenated record values";
-    if (ABSL_PREDICT_FALSE(!WriteVarint64(IntCast<uint64_t>(limit - start),
-                                          sizes_compressor_.writer()))) {
+  for (size_t i = 0; i < limits.size(); i += ABSL_ARRAYSIZE(sizes)) {
+    const absl::Span<uint64_t> batch(
+        sizes, UnsignedMin(limits.size() - i, ABSL_ARRAYSIZE(sizes)));
+    for (size_t j = 0; j < batch.size(); ++j) {
+      const size_t limit = limits[i + j];
+      RIEGELI_ASSERT_GE(limit, start)
+          << "Failed precondition of ChunkEncoder::AddRecords(): "
+             "record end positions not sorted";
+      RIEGELI_ASSERT_LE(limit, records.size())
+          << "Failed precondition of ChunkEncoder::AddRecords(): "
+             "record end positions do not match concatenated record values";
+      batch[j] = IntCast<uint64_t>(limit - start);
+      start = limit;
+    }
+    if (ABSL_PREDICT_FALSE(
+            !WriteVarints64(batch, sizes_compressor_.writer()))) {
       return Fail(sizes_compressor_.writer());
     }
-    start = limit;
   }
   if (ABSL_PREDICT_FALSE(
           !values_compressor_.writer().Write(std::move(records)))) {
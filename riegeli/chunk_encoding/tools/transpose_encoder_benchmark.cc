@@ -0,0 +1,257 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/flags/usage.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "riegeli/base/base.h"
+#include "riegeli/base/chain.h"
+#include "riegeli/base/chain_arena.h"
+#include "riegeli/bytes/chain_backward_writer.h"
+#include "riegeli/bytes/string_writer.h"
+#include "riegeli/chunk_encoding/compressor_options.h"
+#include "riegeli/chunk_encoding/constants.h"
+#include "riegeli/chunk_encoding/transpose_encoder.h"
+
+ABSL_FLAG(uint64_t, num_records, 1000, "Number of records per chunk");
+ABSL_FLAG(int32_t, num_fields, 50,
+          "Number of fields per record, each giving a separate buffer");
+ABSL_FLAG(int32_t, num_chunks, 200,
+          "Number of chunks encoded by each repetition");
+ABSL_FLAG(int32_t, repetitions, 5, "Number of times to repeat each benchmark");
+
+// Counts all allocations made by the process, so that the number of
+// allocations per chunk can be reported.
+namespace {
+std::atomic<uint64_t> num_allocations{0};
+}  // namespace
+
+void* operator new(size_t size) {
+  num_allocations.fetch_add(1, std::memory_order_relaxed);
+  void* const ptr = malloc(size == 0 ? 1 : size);
+  if (ptr == nullptr) throw std::bad_alloc();
+  return ptr;
+}
+
+void operator delete(void* ptr) noexcept { free(ptr); }
+
+void operator delete(void* ptr, size_t size) noexcept { free(ptr); }
+
+namespace {
+
+uint64_t CpuTimeNow_ns() {
+  struct timespec time_info;
+  RIEGELI_CHECK_EQ(clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time_info), 0);
+  return riegeli::IntCast<uint64_t>(time_info.tv_sec) * uint64_t{1000000000} +
+         riegeli::IntCast<uint64_t>(time_info.tv_nsec);
+}
+
+class Stats {
+ public:
+  void Add(double value);
+
+  double Median();
+
+ private:
+  std::vector<double> samples_;
+};
+
+void Stats::Add(double value) { samples_.push_back(value); }
+
+double Stats::Median() {
+  RIEGELI_CHECK(!samples_.empty()) << "No data";
+  const size_t middle = samples_.size() / 2;
+  std::nth_element(samples_.begin(),
+                   samples_.begin() + riegeli::IntCast<ptrdiff_t>(middle),
+                   samples_.end());
+  return samples_[middle];
+}
+
+void AppendVarint(uint64_t value, std::string& dest) {
+  while (value >= 0x80) {
+    dest.push_back(static_cast<char>(value | 0x80));
+    value >>= 7;
+  }
+  dest.push_back(static_cast<char>(value));
+}
+
+// Generates records in the protocol buffer wire format, with `num_fields`
+// fields alternating between varints and short strings. Each field is stored
+// by `TransposeEncoder` in a separate buffer.
+std::vector<std::string> GenerateRecords(size_t num_records, int num_fields) {
+  std::mt19937_64 random;
+  std::vector<std::string> records(num_records);
+  for (std::string& record : records) {
+    for (int field = 1; field <= num_fields; ++field) {
+      if (field % 2 == 1) {
+        AppendVarint(riegeli::IntCast<uint64_t>(field) << 3, record);
+        AppendVarint(random() >> (random() % 64), record);
+      } else {
+        AppendVarint((riegeli::IntCast<uint64_t>(field) << 3) | 2, record);
+        const size_t length = random() % 8;
+        AppendVarint(length, record);
+        for (size_t i = 0; i < length; ++i) {
+          record.push_back(static_cast<char>('a' + random() % 26));
+        }
+      }
+    }
+  }
+  return records;
+}
+
+struct Result {
+  double ns_per_chunk;
+  double allocations_per_chunk;
+};
+
+// Returns the median time and number of allocations of `function` per chunk.
+template <typename Function>
+Result Measure(int num_chunks, int repetitions, Function function) {
+  Stats time_stats;
+  Stats allocation_stats;
+  for (int i = 0; i < repetitions + 1; ++i) {
+    const uint64_t allocations_before =
+        num_allocations.load(std::memory_order_relaxed);
+    const uint64_t time_before_ns = CpuTimeNow_ns();
+    for (int chunk = 0; chunk < num_chunks; ++chunk) function();
+    const uint64_t time_after_ns = CpuTimeNow_ns();
+    const uint64_t allocations_after =
+        num_allocations.load(std::memory_order_relaxed);
+    // The first iteration is a warm-up.
+    if (i > 0) {
+      time_stats.Add(static_cast<double>(time_after_ns - time_before_ns) /
+                     static_cast<double>(num_chunks));
+      allocation_stats.Add(
+          static_cast<double>(allocations_after - allocations_before) /
+          static_cast<double>(num_chunks));
+    }
+  }
+  return Result{time_stats.Median(), allocation_stats.Median()};
+}
+
+// Writes the fields of `records` to separate buffers, like `TransposeEncoder`
+// does before encoding a chunk, allocating blocks from `arena` if it is not
+// `nullptr`.
+void FillBuffers(const std::vector<std::string>& records, int num_fields,
+                 riegeli::ChainArena* arena,
+                 std::vector<riegeli::Chain>& buffers) {
+  buffers.clear();
+  buffers.resize(riegeli::IntCast<size_t>(num_fields));
+  std::vector<riegeli::ChainBackwardWriter<>> writers;
+  writers.reserve(buffers.size());
+  for (riegeli::Chain& buffer : buffers) {
+    writers.emplace_back(
+        &buffer, riegeli::ChainBackwardWriterBase::Options().set_arena(arena));
+  }
+  for (const std::string& record : records) {
+    // Field contents are approximated by equal slices of the record.
+    const size_t slice_size = record.size() / writers.size() + 1;
+    for (size_t i = 0; i < writers.size(); ++i) {
+      const size_t begin = std::min(i * slice_size, record.size());
+      const size_t end = std::min(begin + slice_size, record.size());
+      RIEGELI_CHECK(writers[i].Write(
+          absl::string_view(record.data() + begin, end - begin)))
+          << writers[i].status();
+    }
+  }
+  for (riegeli::ChainBackwardWriter<>& writer : writers) {
+    RIEGELI_CHECK(writer.Close()) << writer.status();
+  }
+}
+
+void EncodeChunk(const std::vector<std::string>& records,
+                 riegeli::TransposeEncoder& encoder, std::string& dest) {
+  encoder.Clear();
+  for (const std::string& record : records) {
+    RIEGELI_CHECK(encoder.AddRecord(absl::string_view(record)))
+        << encoder.status();
+  }
+  dest.clear();
+  riegeli::StringWriter<> writer(&dest);
+  riegeli::ChunkType chunk_type;
+  uint64_t num_records, decoded_data_size;
+  RIEGELI_CHECK(encoder.EncodeAndClose(writer, chunk_type, num_records,
+                                       decoded_data_size))
+      << encoder.status();
+  RIEGELI_CHECK(writer.Close()) << writer.status();
+}
+
+const char kUsage[] =
+    "Usage: transpose_encoder_benchmark (OPTION)...\n"
+    "\n"
+    "Measures time and the number of allocations per chunk of encoding "
+    "transposed chunks, and of filling many small Chain buffers with and "
+    "without a ChainArena.\n";
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  absl::SetProgramUsageMessage(kUsage);
+  absl::ParseCommandLine(argc, argv);
+  const size_t num_records =
+      riegeli::SaturatingIntCast<size_t>(absl::GetFlag(FLAGS_num_records));
+  const int num_fields = absl::GetFlag(FLAGS_num_fields);
+  const int num_chunks = absl::GetFlag(FLAGS_num_chunks);
+  const int repetitions = absl::GetFlag(FLAGS_repetitions);
+  const std::vector<std::string> records =
+      GenerateRecords(num_records, num_fields);
+
+  std::vector<riegeli::Chain> buffers;
+  const Result heap_buffers = Measure(num_chunks, repetitions, [&] {
+    FillBuffers(records, num_fields, nullptr, buffers);
+  });
+  riegeli::ChainArena arena;
+  const Result arena_buffers = Measure(num_chunks, repetitions, [&] {
+    buffers.clear();
+    arena.Reset();
+    FillBuffers(records, num_fields, &arena, buffers);
+  });
+
+  riegeli::TransposeEncoder encoder(
+      riegeli::CompressorOptions().set_uncompressed(),
+      std::numeric_limits<uint64_t>::max());
+  std::string encoded;
+  const Result transpose = Measure(
+      num_chunks, repetitions, [&] { EncodeChunk(records, encoder, encoded); });
+
+  absl::Format(&std::cout, "%-24s %12s %14s\n", "", "us/chunk",
+               "allocs/chunk");
+  absl::Format(&std::cout, "%s\n", std::string(52, '-'));
+  absl::Format(&std::cout, "%-24s %12.1f %14.1f\n", "Buffers without arena",
+               heap_buffers.ns_per_chunk / 1000.0,
+               heap_buffers.allocations_per_chunk);
+  absl::Format(&std::cout, "%-24s %12.1f %14.1f\n", "Buffers with arena",
+               arena_buffers.ns_per_chunk / 1000.0,
+               arena_buffers.allocations_per_chunk);
+  absl::Format(&std::cout, "%-24s %12.1f %14.1f\n", "TransposeEncoder",
+               transpose.ns_per_chunk / 1000.0,
+               transpose.allocations_per_chunk);
+}
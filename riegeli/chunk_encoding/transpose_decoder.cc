@@ -32,6 +32,7 @@
 #include "absl/status/status.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
+#include "absl/types/span.h"
 #include "riegeli/base/base.h"
 #include "riegeli/base/chain.h"
 #include "riegeli/base/memory.h"
@@ -809,14 +810,15 @@ inline bool TransposeDecoder::ParseBuffers(Context& context,
     }
   }
 
+  std::vector<uint64_t> buffer_lengths(num_buffers);
+  if (ABSL_PREDICT_FALSE(
+          !ReadVarints64(header_reader, absl::MakeSpan(buffer_lengths)))) {
+    header_reader.Fail(
+        absl::InvalidArgumentError("Reading buffer length failed"));
+    return Fail(header_reader);
+  }
   uint32_t bucket_index = 0;
-  for (size_t buffer_index = 0; buffer_index < num_buffers; ++buffer_index) {
-    uint64_t buffer_length;
-    if (ABSL_PREDICT_FALSE(!ReadVarint64(header_reader, buffer_length))) {
-      header_reader.Fail(
-          absl::InvalidArgumentError("Reading buffer length failed"));
-      return Fail(header_reader);
-    }
+  for (const uint64_t buffer_length : buffer_lengths) {
     if (ABSL_PREDICT_FALSE(buffer_length >
                            std::numeric_limits<size_t>::max())) {
       return Fail(absl::ResourceExhaustedError("Buffer too large"));
@@ -197,6 +197,7 @@ void TransposeEncoder::Clear() {
   message_nodes_.clear();
   nonproto_lengths_writer_.Reset();
   next_message_id_ = internal::MessageId::kRoot + 1;
+  arena_.Reset();
 }
 
 bool TransposeEncoder::AddRecord(absl::string_view record) {
@@ -291,8 +292,9 @@ inline BackwardWriter* TransposeEncoder::GetBuffer(Node* node,
     std::vector<BufferWithMetadata>& buffers =
         data_[static_cast<uint32_t>(type)];
     buffers.emplace_back(node->first);
-    node->second.writer =
-        std::make_unique<ChainBackwardWriter<>>(buffers.back().buffer.get());
+    node->second.writer = std::make_unique<ChainBackwardWriter<>>(
+        buffers.back().buffer.get(),
+        ChainBackwardWriterBase::Options().set_arena(&arena_));
   }
   return node->second.writer.get();
 }
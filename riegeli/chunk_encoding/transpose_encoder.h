@@ -28,6 +28,7 @@
 #include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
 #include "riegeli/base/chain.h"
+#include "riegeli/base/chain_arena.h"
 #include "riegeli/bytes/backward_writer.h"
 #include "riegeli/bytes/chain_backward_writer.h"
 #include "riegeli/bytes/reader.h"
@@ -285,6 +286,9 @@ class TransposeEncoder : public ChunkEncoder {
   std::vector<EncodedTagInfo> tags_list_;
   // Sequence of tags on input as indices into `tags_list_`.
   std::vector<uint32_t> encoded_tags_;
+  // Allocates small blocks of data buffers, which are numerous and mostly tiny.
+  // Reset together with clearing `data_`.
+  ChainArena arena_;
   // Data buffers in separate vectors per buffer type.
   std::vector<BufferWithMetadata> data_[kNumBufferTypes];
   // Every group creates a new message ID. We keep track of open groups in this
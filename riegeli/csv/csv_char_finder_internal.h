@@ -0,0 +1,245 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_CSV_CSV_CHAR_FINDER_INTERNAL_H_
+#define RIEGELI_CSV_CSV_CHAR_FINDER_INTERNAL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+#include <limits>
+
+#include "absl/base/attributes.h"
+#include "absl/base/optimization.h"
+#include "absl/numeric/bits.h"
+#include "riegeli/base/base.h"
+#include "riegeli/bytes/reader.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RIEGELI_INTERNAL_CSV_CHAR_FINDER_SSE2 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define RIEGELI_INTERNAL_CSV_CHAR_FINDER_NEON 1
+#endif
+
+namespace riegeli {
+namespace internal {
+
+// Finds the first occurrence of any of a small set of characters in the buffer
+// of a `Reader`.
+//
+// This is used by `CsvReader` to skip over ordinary characters of a field,
+// classifying only structural characters: newlines, field separators, quotes
+// etc.
+//
+// With SSE2 or NEON, 64 bytes are classified at a time into a bitmask, in the
+// style of simdjson. The bitmask of the last block is kept, so that finding
+// the following characters in the same block, which is common for short
+// fields, needs only a shift and counting trailing zeros, without a
+// mispredicted branch per field. The block is identified by its position in
+// the source rather than by a pointer, so that it is not confused with other
+// data after the buffer is refilled. Without SIMD, and in the last bytes of
+// the buffer, a lookup table is used.
+class CsvCharFinder {
+ public:
+  static constexpr size_t kMaxChars = 6;
+
+  // Creates an empty `CsvCharFinder`. Characters must be added with `Add()`
+  // before `Find()` is called.
+  CsvCharFinder() noexcept {}
+
+  CsvCharFinder(const CsvCharFinder& that) noexcept;
+  CsvCharFinder& operator=(const CsvCharFinder& that) noexcept;
+
+  // Makes `*this` equivalent to a newly constructed `CsvCharFinder`.
+  void Reset();
+
+  // Adds a character to find. At most `kMaxChars` characters can be added.
+  void Add(char ch);
+
+  // Returns a pointer to the first added character in [`ptr`..`src.limit()`),
+  // or `src.limit()` if there is none.
+  //
+  // The same `CsvCharFinder` must not be used with different sources, unless
+  // `Reset()` is called in between.
+  //
+  // Preconditions:
+  //   at least one character was added
+  //   `ptr` is between `src.cursor()` and `src.limit()` inclusive
+  ABSL_ATTRIBUTE_ALWAYS_INLINE const char* Find(const Reader& src,
+                                                const char* ptr);
+
+ private:
+  // Continues `Find()` if the cached block does not contain the result.
+  const char* FindSlow(const Reader& src, const char* ptr);
+
+#if RIEGELI_INTERNAL_CSV_CHAR_FINDER_SSE2 || \
+    RIEGELI_INTERNAL_CSV_CHAR_FINDER_NEON
+  // Returns a bitmask of bytes among 64 bytes starting at `ptr` which match
+  // one of added characters, starting from the least significant bit.
+  uint64_t Matches(const char* ptr) const;
+#endif
+
+  size_t num_chars_ = 0;
+  // Unused entries of `patterns_` repeat `patterns_[0]`, so that all entries
+  // can be compared unconditionally.
+  std::array<std::array<char, 16>, kMaxChars> patterns_{};
+  // Lookup table for the last bytes which do not fill a block.
+  std::array<bool, std::numeric_limits<unsigned char>::max() + 1> table_{};
+
+  // The last block classified by `Matches()`: its position in the source and
+  // its bitmask. If `block_matches_ == 0`, there is no block.
+  Position block_pos_ = 0;
+  uint64_t block_matches_ = 0;
+};
+
+// Implementation details follow.
+
+inline CsvCharFinder::CsvCharFinder(const CsvCharFinder& that) noexcept
+    : num_chars_(that.num_chars_),
+      patterns_(that.patterns_),
+      table_(that.table_) {}
+
+inline CsvCharFinder& CsvCharFinder::operator=(
+    const CsvCharFinder& that) noexcept {
+  num_chars_ = that.num_chars_;
+  patterns_ = that.patterns_;
+  table_ = that.table_;
+  block_pos_ = 0;
+  block_matches_ = 0;
+  return *this;
+}
+
+inline void CsvCharFinder::Reset() {
+  num_chars_ = 0;
+  patterns_ = {};
+  table_ = {};
+  block_pos_ = 0;
+  block_matches_ = 0;
+}
+
+inline void CsvCharFinder::Add(char ch) {
+  RIEGELI_ASSERT(num_chars_ < kMaxChars)
+      << "Failed precondition of CsvCharFinder::Add(): too many characters";
+  if (num_chars_ == 0) {
+    for (std::array<char, 16>& pattern : patterns_) pattern.fill(ch);
+  } else {
+    patterns_[num_chars_].fill(ch);
+  }
+  ++num_chars_;
+  table_[static_cast<unsigned char>(ch)] = true;
+  block_matches_ = 0;
+}
+
+inline const char* CsvCharFinder::Find(const Reader& src, const char* ptr) {
+  RIEGELI_ASSERT_GT(num_chars_, 0u)
+      << "Failed precondition of CsvCharFinder::Find(): no characters added";
+  const size_t available = PtrDistance(ptr, src.limit());
+  const Position offset = src.limit_pos() - available - block_pos_;
+  if (offset < 64) {
+    const uint64_t matches = block_matches_ >> offset;
+    if (ABSL_PREDICT_TRUE(matches != 0)) {
+      // The cached block might extend beyond the buffer.
+      return ptr + UnsignedMin(IntCast<size_t>(absl::countr_zero(matches)),
+                               available);
+    }
+  }
+  return FindSlow(src, ptr);
+}
+
+#if RIEGELI_INTERNAL_CSV_CHAR_FINDER_SSE2
+
+inline uint64_t CsvCharFinder::Matches(const char* ptr) const {
+  uint64_t result = 0;
+  for (size_t block = 0; block < 4; ++block) {
+    const __m128i data =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr + block * 16));
+    __m128i matches = _mm_cmpeq_epi8(
+        data, _mm_loadu_si128(
+                  reinterpret_cast<const __m128i*>(patterns_[0].data())));
+    for (size_t i = 1; i < kMaxChars; ++i) {
+      matches = _mm_or_si128(
+          matches, _mm_cmpeq_epi8(data, _mm_loadu_si128(
+                                            reinterpret_cast<const __m128i*>(
+                                                patterns_[i].data()))));
+    }
+    result |= uint64_t{static_cast<uint16_t>(_mm_movemask_epi8(matches))}
+              << (block * 16);
+  }
+  return result;
+}
+
+#elif RIEGELI_INTERNAL_CSV_CHAR_FINDER_NEON
+
+inline uint64_t CsvCharFinder::Matches(const char* ptr) const {
+  static const uint8_t kBits[16] = {1, 2, 4, 8, 16, 32, 64, 128,
+                                    1, 2, 4, 8, 16, 32, 64, 128};
+  const uint8x16_t bits = vld1q_u8(kBits);
+  uint8x16_t masked[4];
+  for (size_t block = 0; block < 4; ++block) {
+    const uint8x16_t data =
+        vld1q_u8(reinterpret_cast<const uint8_t*>(ptr + block * 16));
+    uint8x16_t matches = vceqq_u8(
+        data, vld1q_u8(reinterpret_cast<const uint8_t*>(patterns_[0].data())));
+    for (size_t i = 1; i < kMaxChars; ++i) {
+      matches = vorrq_u8(
+          matches, vceqq_u8(data, vld1q_u8(reinterpret_cast<const uint8_t*>(
+                                      patterns_[i].data()))));
+    }
+    masked[block] = vandq_u8(matches, bits);
+  }
+  // Add adjacent bytes until each byte of the bitmask is in place.
+  uint8x16_t sum = vpaddq_u8(vpaddq_u8(masked[0], masked[1]),
+                             vpaddq_u8(masked[2], masked[3]));
+  sum = vpaddq_u8(sum, sum);
+  return vgetq_lane_u64(vreinterpretq_u64_u8(sum), 0);
+}
+
+#endif
+
+inline const char* CsvCharFinder::FindSlow(const Reader& src,
+                                           const char* ptr) {
+  const char* const limit = src.limit();
+#if RIEGELI_INTERNAL_CSV_CHAR_FINDER_SSE2 || \
+    RIEGELI_INTERNAL_CSV_CHAR_FINDER_NEON
+  {
+    const size_t available = PtrDistance(ptr, limit);
+    const Position offset = src.limit_pos() - available - block_pos_;
+    if (offset < 64 && block_matches_ != 0) {
+      // The rest of the cached block does not match. Continue after it.
+      if (ABSL_PREDICT_FALSE(64 - offset >= available)) return limit;
+      ptr += 64 - offset;
+    }
+  }
+  while (PtrDistance(ptr, limit) >= 64) {
+    const uint64_t matches = Matches(ptr);
+    if (matches != 0) {
+      block_pos_ = src.limit_pos() - PtrDistance(ptr, limit);
+      block_matches_ = matches;
+      return ptr + absl::countr_zero(matches);
+    }
+    ptr += 64;
+  }
+#endif
+  while (ptr != limit && !table_[static_cast<unsigned char>(*ptr)]) ++ptr;
+  return ptr;
+}
+
+}  // namespace internal
+}  // namespace riegeli
+
+#endif  // RIEGELI_CSV_CSV_CHAR_FINDER_INTERNAL_H_
@@ -0,0 +1,352 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/csv/csv_column_batch.h"
+
+#include <float.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <limits>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "absl/base/optimization.h"
+#include "absl/status/status.h"
+#include "absl/strings/charconv.h"
+#include "absl/strings/escaping.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "riegeli/base/base.h"
+#include "riegeli/csv/csv_reader.h"
+#include "riegeli/endian/endian_reading.h"
+
+namespace riegeli {
+
+namespace {
+
+// Returns `true` if all 8 bytes of `chunk` are ASCII digits.
+inline bool IsEightDigits(uint64_t chunk) {
+  return ((chunk & 0xf0f0f0f0f0f0f0f0) |
+          (((chunk + 0x0606060606060606) & 0xf0f0f0f0f0f0f0f0) >> 4)) ==
+         0x3333333333333333;
+}
+
+// Returns the value of 8 ASCII digits loaded as a little endian `chunk`, with
+// three multiplications instead of eight.
+inline uint64_t ParseEightDigits(uint64_t chunk) {
+  chunk -= 0x3030303030303030;
+  // Each 16-bit lane holds a 2-digit number in its low byte.
+  chunk = chunk * 10 + (chunk >> 8);
+  // Combine pairs of 2-digit numbers into 4-digit numbers, and those into an
+  // 8-digit number in the high 32 bits.
+  return (((chunk & 0x000000ff000000ff) * (100 + (uint64_t{1000000} << 32))) +
+          (((chunk >> 16) & 0x000000ff000000ff) *
+           (1 + (uint64_t{10000} << 32)))) >>
+         32;
+}
+
+// Accumulates decimal digits from `ptr` to `value`, 8 at a time when possible.
+// Returns a pointer after the digits.
+//
+// `value` overflows if there are too many digits, which is checked by the
+// caller.
+inline const char* ParseDigits(const char* ptr, const char* limit,
+                               uint64_t& value) {
+  while (PtrDistance(ptr, limit) >= 8) {
+    const uint64_t chunk = ReadLittleEndian64(ptr);
+    if (!IsEightDigits(chunk)) break;
+    value = value * 100000000 + ParseEightDigits(chunk);
+    ptr += 8;
+  }
+  while (ptr != limit) {
+    const uint8_t digit = static_cast<uint8_t>(*ptr - '0');
+    if (digit > 9) break;
+    value = value * 10 + digit;
+    ++ptr;
+  }
+  return ptr;
+}
+
+// Any 19 digits fit in `uint64_t`.
+constexpr size_t kMaxExactDigits = 19;
+
+inline bool ParseInt64(absl::string_view src, int64_t& dest) {
+  const char* ptr = src.data();
+  const char* const limit = src.data() + src.size();
+  bool negative = false;
+  if (ptr != limit && (*ptr == '-' || *ptr == '+')) {
+    negative = *ptr == '-';
+    ++ptr;
+  }
+  if (ABSL_PREDICT_FALSE(ptr == limit)) return false;
+  while (*ptr == '0') {
+    ++ptr;
+    if (ptr == limit) {
+      dest = 0;
+      return true;
+    }
+  }
+  const char* const digits = ptr;
+  uint64_t magnitude = 0;
+  ptr = ParseDigits(ptr, limit, magnitude);
+  if (ABSL_PREDICT_FALSE(ptr != limit ||
+                         PtrDistance(digits, ptr) > kMaxExactDigits)) {
+    return false;
+  }
+  if (negative) {
+    if (ABSL_PREDICT_FALSE(magnitude > uint64_t{1} << 63)) return false;
+    dest = magnitude == uint64_t{1} << 63
+               ? std::numeric_limits<int64_t>::min()
+               : -static_cast<int64_t>(magnitude);
+  } else {
+    if (ABSL_PREDICT_FALSE(magnitude >
+                           uint64_t{std::numeric_limits<int64_t>::max()})) {
+      return false;
+    }
+    dest = static_cast<int64_t>(magnitude);
+  }
+  return true;
+}
+
+// Parses uncommon syntax and numbers which are not exact in the fast path.
+bool ParseDoubleSlow(absl::string_view src, double& dest) {
+  // `absl::from_chars()` does not accept a leading '+'.
+  if (!src.empty() && src[0] == '+') {
+    src.remove_prefix(1);
+    if (ABSL_PREDICT_FALSE(!src.empty() && src[0] == '-')) return false;
+  }
+  const absl::from_chars_result result =
+      absl::from_chars(src.data(), src.data() + src.size(), dest);
+  return result.ec == std::errc() && result.ptr == src.data() + src.size();
+}
+
+// Whether floating point arithmetic on `double` is performed with `double`
+// precision, without double rounding.
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+constexpr bool kExactDoubleArithmetic = true;
+#else
+constexpr bool kExactDoubleArithmetic = false;
+#endif
+
+// Powers of 10 which are exactly representable as `double`.
+constexpr double kExactPowersOf10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+constexpr int kMaxExactPowerOf10 = 22;
+
+// Parses a decimal number. The common case of at most 15 significant digits
+// and a small exponent is computed exactly with one multiplication or division
+// (Clinger's fast path). Other numbers are parsed by `absl::from_chars()`.
+inline bool ParseDouble(absl::string_view src, double& dest) {
+  const char* ptr = src.data();
+  const char* const limit = src.data() + src.size();
+  bool negative = false;
+  if (ptr != limit && (*ptr == '-' || *ptr == '+')) {
+    negative = *ptr == '-';
+    ++ptr;
+  }
+  const char* const number = ptr;
+  // Leading zeros are not significant.
+  while (ptr != limit && *ptr == '0') ++ptr;
+  uint64_t mantissa = 0;
+  const char* significant = ptr;
+  ptr = ParseDigits(ptr, limit, mantissa);
+  size_t num_digits = PtrDistance(significant, ptr);
+  int64_t exponent = 0;
+  bool has_digits = ptr != number;
+  if (ptr != limit && *ptr == '.') {
+    ++ptr;
+    const char* const fraction = ptr;
+    if (num_digits == 0) {
+      while (ptr != limit && *ptr == '0') ++ptr;
+    }
+    significant = ptr;
+    ptr = ParseDigits(ptr, limit, mantissa);
+    num_digits += PtrDistance(significant, ptr);
+    exponent = -static_cast<int64_t>(PtrDistance(fraction, ptr));
+    has_digits |= ptr != fraction;
+  }
+  if (ABSL_PREDICT_FALSE(!has_digits)) return ParseDoubleSlow(src, dest);
+  if (ptr != limit && (*ptr == 'e' || *ptr == 'E')) {
+    ++ptr;
+    bool negative_exponent = false;
+    if (ptr != limit && (*ptr == '-' || *ptr == '+')) {
+      negative_exponent = *ptr == '-';
+      ++ptr;
+    }
+    const char* const exponent_digits = ptr;
+    int64_t explicit_exponent = 0;
+    while (ptr != limit) {
+      const uint8_t digit = static_cast<uint8_t>(*ptr - '0');
+      if (digit > 9) break;
+      // Large exponents are left to `ParseDoubleSlow()`.
+      if (ABSL_PREDICT_FALSE(explicit_exponent >= 100000)) {
+        return ParseDoubleSlow(src, dest);
+      }
+      explicit_exponent = explicit_exponent * 10 + digit;
+      ++ptr;
+    }
+    if (ABSL_PREDICT_FALSE(ptr == exponent_digits)) return false;
+    exponent += negative_exponent ? -explicit_exponent : explicit_exponent;
+  }
+  if (ABSL_PREDICT_FALSE(ptr != limit)) return ParseDoubleSlow(src, dest);
+  if (num_digits <= kMaxExactDigits) {
+    if (mantissa == 0) {
+      dest = negative ? -0.0 : 0.0;
+      return true;
+    }
+    if (kExactDoubleArithmetic && mantissa <= uint64_t{1} << 53 &&
+        exponent >= -kMaxExactPowerOf10 && exponent <= kMaxExactPowerOf10) {
+      // Both operands are exact, so the result is correctly rounded.
+      double value = static_cast<double>(mantissa);
+      if (exponent < 0) {
+        value /= kExactPowersOf10[-exponent];
+      } else {
+        value *= kExactPowersOf10[exponent];
+      }
+      dest = negative ? -value : value;
+      return true;
+    }
+  }
+  return ParseDoubleSlow(src, dest);
+}
+
+}  // namespace
+
+void CsvColumnBatch::Reset(const CsvSchema& schema) {
+  columns_.resize(schema.size());
+  for (size_t i = 0; i < columns_.size(); ++i) {
+    Column& column = columns_[i];
+    column.type = schema.type(i);
+    column.optional = schema.optional(i);
+    column.int64s.clear();
+    column.doubles.clear();
+    column.string_data.clear();
+    column.string_ends.clear();
+    column.present.clear();
+  }
+  num_rows_ = 0;
+}
+
+absl::Status CsvColumnBatch::AppendRow(
+    absl::Span<const absl::string_view> fields) {
+  if (ABSL_PREDICT_FALSE(fields.size() != columns_.size())) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Mismatched number of CSV fields: schema has ",
+                     columns_.size(), ", record has ", fields.size()));
+  }
+  size_t index = 0;
+  for (; index < columns_.size(); ++index) {
+    Column& column = columns_[index];
+    const absl::string_view field = fields[index];
+    if (column.optional) {
+      column.present.push_back(!field.empty());
+      if (field.empty()) {
+        switch (column.type) {
+          case CsvColumnType::kInt64:
+            column.int64s.push_back(0);
+            continue;
+          case CsvColumnType::kDouble:
+            column.doubles.push_back(0.0);
+            continue;
+          case CsvColumnType::kString:
+            column.string_ends.push_back(column.string_data.size());
+            continue;
+        }
+        RIEGELI_ASSERT_UNREACHABLE()
+            << "Unknown CSV column type: " << static_cast<int>(column.type);
+      }
+    }
+    switch (column.type) {
+      case CsvColumnType::kInt64: {
+        int64_t value;
+        if (ABSL_PREDICT_FALSE(!ParseInt64(field, value))) break;
+        column.int64s.push_back(value);
+        continue;
+      }
+      case CsvColumnType::kDouble: {
+        double value;
+        if (ABSL_PREDICT_FALSE(!ParseDouble(field, value))) break;
+        column.doubles.push_back(value);
+        continue;
+      }
+      case CsvColumnType::kString:
+        column.string_data.append(field.data(), field.size());
+        column.string_ends.push_back(column.string_data.size());
+        continue;
+    }
+    // Invalid value. Remove parts of the row appended so far.
+    if (column.optional) column.present.pop_back();
+    for (size_t i = 0; i < index; ++i) {
+      Column& appended_column = columns_[i];
+      if (appended_column.optional) appended_column.present.pop_back();
+      switch (appended_column.type) {
+        case CsvColumnType::kInt64:
+          appended_column.int64s.pop_back();
+          continue;
+        case CsvColumnType::kDouble:
+          appended_column.doubles.pop_back();
+          continue;
+        case CsvColumnType::kString:
+          appended_column.string_ends.pop_back();
+          appended_column.string_data.resize(
+              appended_column.string_ends.empty()
+                  ? size_t{0}
+                  : appended_column.string_ends.back());
+          continue;
+      }
+    }
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Invalid ",
+        column.type == CsvColumnType::kInt64 ? "int64" : "double",
+        " in CSV field ", index, ": \"", absl::CHexEscape(field), "\""));
+  }
+  ++num_rows_;
+  return absl::OkStatus();
+}
+
+bool ReadCsvColumns(CsvReaderBase& csv_reader, const CsvSchema& schema,
+                    size_t max_rows, CsvColumnBatch& batch) {
+  RIEGELI_ASSERT_GT(max_rows, 0u)
+      << "Failed precondition of ReadCsvColumns(): no rows requested";
+  batch.Reset(schema);
+  std::vector<absl::string_view> record;
+  while (batch.num_rows() < max_rows) {
+    if (ABSL_PREDICT_FALSE(!csv_reader.ReadRecord(record))) {
+      return batch.num_rows() > 0 && csv_reader.healthy();
+    }
+    absl::Status status = batch.AppendRow(record);
+    if (ABSL_PREDICT_FALSE(!status.ok())) {
+      --csv_reader.record_index_;
+      csv_reader.FailAtPreviousRecord(std::move(status));
+      if (csv_reader.recovery_ != nullptr) {
+        status = csv_reader.status();
+        csv_reader.MarkNotFailed();
+        if (csv_reader.recovery_(std::move(status))) continue;
+        // Recovery was cancelled. Reading ends as if the end of source was
+        // encountered.
+        return batch.num_rows() > 0;
+      }
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace riegeli
@@ -0,0 +1,279 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_CSV_CSV_COLUMN_BATCH_H_
+#define RIEGELI_CSV_CSV_COLUMN_BATCH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "riegeli/base/base.h"
+#include "riegeli/csv/csv_reader.h"
+
+namespace riegeli {
+
+// The type of values of a column decoded by `ReadCsvColumns()`.
+enum class CsvColumnType {
+  // A signed decimal integer in the range of `int64_t`: an optional sign
+  // followed by digits.
+  kInt64,
+  // A floating point number: an optional sign, digits with an optional
+  // decimal point, and an optional exponent; or anything accepted by
+  // `absl::from_chars()`, e.g. "inf" or "nan".
+  kDouble,
+  // A field value taken as is.
+  kString,
+};
+
+// Types of fields of each CSV record, in their order, for `ReadCsvColumns()`.
+class CsvSchema {
+ public:
+  // Creates an empty `CsvSchema`.
+  CsvSchema() noexcept {}
+
+  CsvSchema(const CsvSchema& that) = default;
+  CsvSchema& operator=(const CsvSchema& that) = default;
+
+  CsvSchema(CsvSchema&& that) noexcept = default;
+  CsvSchema& operator=(CsvSchema&& that) noexcept = default;
+
+  // Adds a column for the next field.
+  //
+  // If `optional` is `true`, an empty field is decoded as an absent value.
+  // Otherwise an empty field is invalid for numeric types, and is an empty
+  // string for `CsvColumnType::kString`.
+  CsvSchema& Add(CsvColumnType type, bool optional = false) & {
+    columns_.push_back(Column{type, optional});
+    return *this;
+  }
+  CsvSchema&& Add(CsvColumnType type, bool optional = false) && {
+    return std::move(Add(type, optional));
+  }
+
+  // Returns the number of columns.
+  size_t size() const { return columns_.size(); }
+
+  // Returns the type of the given column.
+  //
+  // Precondition: `index < size()`
+  CsvColumnType type(size_t index) const;
+
+  // Returns `true` if the given column is optional.
+  //
+  // Precondition: `index < size()`
+  bool optional(size_t index) const;
+
+ private:
+  struct Column {
+    CsvColumnType type;
+    bool optional;
+  };
+
+  std::vector<Column> columns_;
+};
+
+// Values of a batch of CSV records decoded by `ReadCsvColumns()`, stored by
+// columns: values of each column are contiguous.
+//
+// String values of a column are concatenated, with their end positions stored
+// separately, like in Apache Arrow.
+//
+// An absent value of an optional column is stored as 0 or an empty string.
+class CsvColumnBatch {
+ public:
+  // Creates an empty `CsvColumnBatch`.
+  CsvColumnBatch() noexcept {}
+
+  CsvColumnBatch(CsvColumnBatch&& that) noexcept = default;
+  CsvColumnBatch& operator=(CsvColumnBatch&& that) noexcept = default;
+
+  // Makes `*this` empty, with columns of `schema`.
+  //
+  // Memory allocated for values is kept, so that reusing a `CsvColumnBatch`
+  // for consecutive batches avoids allocating memory.
+  void Reset(const CsvSchema& schema);
+
+  // Returns the number of columns.
+  size_t num_columns() const { return columns_.size(); }
+
+  // Returns the number of rows, i.e. decoded records.
+  size_t num_rows() const { return num_rows_; }
+
+  // Returns values of a column of `CsvColumnType::kInt64`.
+  //
+  // Precondition: `column < num_columns()`, with type `CsvColumnType::kInt64`
+  absl::Span<const int64_t> int64s(size_t column) const;
+
+  // Returns values of a column of `CsvColumnType::kDouble`.
+  //
+  // Precondition: `column < num_columns()`, with type `CsvColumnType::kDouble`
+  absl::Span<const double> doubles(size_t column) const;
+
+  // Returns the value of a column of `CsvColumnType::kString` in the given
+  // row.
+  //
+  // Preconditions:
+  //   `column < num_columns()`, with type `CsvColumnType::kString`
+  //   `row < num_rows()`
+  absl::string_view string(size_t column, size_t row) const;
+
+  // Returns concatenated values of a column of `CsvColumnType::kString`.
+  //
+  // Precondition: `column < num_columns()`, with type `CsvColumnType::kString`
+  absl::string_view string_data(size_t column) const;
+
+  // Returns end positions of values of a column of `CsvColumnType::kString`
+  // in `string_data(column)`. The value in row `i` begins where the value in
+  // row `i - 1` ends, or at 0 for row 0.
+  //
+  // Precondition: `column < num_columns()`, with type `CsvColumnType::kString`
+  absl::Span<const size_t> string_ends(size_t column) const;
+
+  // Returns `true` if the value of the column in the given row is present,
+  // i.e. the column is not optional or the field is not empty.
+  //
+  // Preconditions:
+  //   `column < num_columns()`
+  //   `row < num_rows()`
+  bool present(size_t column, size_t row) const;
+
+ private:
+  friend bool ReadCsvColumns(CsvReaderBase& csv_reader,
+                             const CsvSchema& schema, size_t max_rows,
+                             CsvColumnBatch& batch);
+
+  struct Column {
+    CsvColumnType type = CsvColumnType::kString;
+    bool optional = false;
+    std::vector<int64_t> int64s;
+    std::vector<double> doubles;
+    std::string string_data;
+    std::vector<size_t> string_ends;
+    // Used if `optional`.
+    std::vector<bool> present;
+  };
+
+  // Decodes `fields` and appends them as a row. If decoding fails, returns an
+  // error and leaves `*this` unchanged.
+  absl::Status AppendRow(absl::Span<const absl::string_view> fields);
+
+  std::vector<Column> columns_;
+  size_t num_rows_ = 0;
+};
+
+// Reads up to `max_rows` records from `csv_reader` and decodes their fields
+// according to `schema` into `batch`, replacing its previous contents.
+//
+// Each record must have `schema.size()` fields, each valid for its type.
+// Otherwise `csv_reader` fails, which can be handled by the recovery function
+// of `csv_reader` like other invalid records, skipping the record.
+//
+// Fields are read with `CsvReaderBase::ReadRecord()` to a vector of views, so
+// that they are not copied before decoding.
+//
+// Return values:
+//  * `true`                                 - success (`batch.num_rows() > 0`)
+//  * `false` (when `csv_reader.healthy()`)  - source ends
+//                                             (`batch.num_rows() == 0`)
+//  * `false` (when `!csv_reader.healthy()`) - failure (`batch` contains rows
+//                                             preceding the failure)
+bool ReadCsvColumns(CsvReaderBase& csv_reader, const CsvSchema& schema,
+                    size_t max_rows, CsvColumnBatch& batch);
+
+// Implementation details follow.
+
+inline CsvColumnType CsvSchema::type(size_t index) const {
+  RIEGELI_ASSERT_LT(index, columns_.size())
+      << "Failed precondition of CsvSchema::type(): index out of range";
+  return columns_[index].type;
+}
+
+inline bool CsvSchema::optional(size_t index) const {
+  RIEGELI_ASSERT_LT(index, columns_.size())
+      << "Failed precondition of CsvSchema::optional(): index out of range";
+  return columns_[index].optional;
+}
+
+inline absl::Span<const int64_t> CsvColumnBatch::int64s(size_t column) const {
+  RIEGELI_ASSERT_LT(column, columns_.size())
+      << "Failed precondition of CsvColumnBatch::int64s(): "
+         "index out of range";
+  RIEGELI_ASSERT(columns_[column].type == CsvColumnType::kInt64)
+      << "Failed precondition of CsvColumnBatch::int64s(): "
+         "column type is not int64";
+  return columns_[column].int64s;
+}
+
+inline absl::Span<const double> CsvColumnBatch::doubles(size_t column) const {
+  RIEGELI_ASSERT_LT(column, columns_.size())
+      << "Failed precondition of CsvColumnBatch::doubles(): "
+         "index out of range";
+  RIEGELI_ASSERT(columns_[column].type == CsvColumnType::kDouble)
+      << "Failed precondition of CsvColumnBatch::doubles(): "
+         "column type is not double";
+  return columns_[column].doubles;
+}
+
+inline absl::string_view CsvColumnBatch::string(size_t column,
+                                                size_t row) const {
+  RIEGELI_ASSERT_LT(row, num_rows_)
+      << "Failed precondition of CsvColumnBatch::string(): "
+         "row out of range";
+  const absl::Span<const size_t> ends = string_ends(column);
+  const size_t begin = row == 0 ? size_t{0} : ends[row - 1];
+  return absl::string_view(columns_[column].string_data)
+      .substr(begin, ends[row] - begin);
+}
+
+inline absl::string_view CsvColumnBatch::string_data(size_t column) const {
+  RIEGELI_ASSERT_LT(column, columns_.size())
+      << "Failed precondition of CsvColumnBatch::string_data(): "
+         "index out of range";
+  RIEGELI_ASSERT(columns_[column].type == CsvColumnType::kString)
+      << "Failed precondition of CsvColumnBatch::string_data(): "
+         "column type is not string";
+  return columns_[column].string_data;
+}
+
+inline absl::Span<const size_t> CsvColumnBatch::string_ends(
+    size_t column) const {
+  RIEGELI_ASSERT_LT(column, columns_.size())
+      << "Failed precondition of CsvColumnBatch::string_ends(): "
+         "index out of range";
+  RIEGELI_ASSERT(columns_[column].type == CsvColumnType::kString)
+      << "Failed precondition of CsvColumnBatch::string_ends(): "
+         "column type is not string";
+  return columns_[column].string_ends;
+}
+
+inline bool CsvColumnBatch::present(size_t column, size_t row) const {
+  RIEGELI_ASSERT_LT(column, columns_.size())
+      << "Failed precondition of CsvColumnBatch::present(): "
+         "index out of range";
+  RIEGELI_ASSERT_LT(row, num_rows_)
+      << "Failed precondition of CsvColumnBatch::present(): "
+         "row out of range";
+  return !columns_[column].optional || columns_[column].present[row];
+}
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_CSV_CSV_COLUMN_BATCH_H_
@@ -18,6 +18,7 @@
 
 #include <array>
 #include <functional>
+#include <initializer_list>
 #include <string>
 #include <tuple>
 #include <utility>
@@ -76,6 +77,20 @@ void CsvReaderBase::Initialize(Reader* src, Options&& options) {
     char_classes_[static_cast<unsigned char>(*options.escape())] =
         CharClass::kEscape;
   }
+  for (const char ch : {'\n', '\r'}) {
+    field_finder_.Add(ch);
+    quoted_finder_.Add(ch);
+  }
+  if (options.comment() != absl::nullopt) field_finder_.Add(*options.comment());
+  field_finder_.Add(options.field_separator());
+  if (options.quote() != absl::nullopt) {
+    field_finder_.Add(*options.quote());
+    quoted_finder_.Add(*options.quote());
+  }
+  if (options.escape() != absl::nullopt) {
+    field_finder_.Add(*options.escape());
+    quoted_finder_.Add(*options.escape());
+  }
   quote_ = options.quote().value_or('\0');
   max_num_fields_ = UnsignedMin(options.max_num_fields(),
                                 std::vector<std::string>().max_size());
@@ -181,9 +196,10 @@ inline bool CsvReaderBase::ReadQuoted(Reader& src, std::string& field) {
       }
       ptr = src.cursor();
     }
+    ptr = quoted_finder_.Find(src, ptr);
+    if (ABSL_PREDICT_FALSE(ptr == src.limit())) continue;
     const CharClass char_class =
         char_classes_[static_cast<unsigned char>(*ptr++)];
-    if (ABSL_PREDICT_TRUE(char_class == CharClass::kOther)) continue;
     switch (char_class) {
       case CharClass::kLf:
         ++line_number_;
@@ -300,9 +316,10 @@ next_field:
       }
       ptr = src.cursor();
     }
+    ptr = field_finder_.Find(src, ptr);
+    if (ABSL_PREDICT_FALSE(ptr == src.limit())) continue;
     const CharClass char_class =
         char_classes_[static_cast<unsigned char>(*ptr++)];
-    if (ABSL_PREDICT_TRUE(char_class == CharClass::kOther)) continue;
     switch (char_class) {
       case CharClass::kComment:
         if (field_index == 0 && field.empty() && ptr - 1 == src.cursor()) {
@@ -500,6 +517,135 @@ try_again:
   return true;
 }
 
+bool CsvReaderBase::ReadRecord(std::vector<absl::string_view>& record) {
+  if (ABSL_PREDICT_FALSE(!healthy())) {
+    record.clear();
+    return false;
+  }
+  Reader& src = *src_reader();
+  if (ABSL_PREDICT_TRUE(src.Pull()) && ReadRecordFromBuffer(src, record)) {
+    return true;
+  }
+  // The record is not entirely available in the buffer, or it is unusual:
+  // read it in the general way.
+  if (ABSL_PREDICT_FALSE(!ReadRecordInternal(field_storage_))) {
+    record.clear();
+    return false;
+  }
+  record.assign(field_storage_.begin(), field_storage_.end());
+  return true;
+}
+
+// Reads a record if it is entirely available in the buffer of `src`, and it
+// is well-formed, without unquoted escapes, and not preceded by a comment
+// line. Otherwise returns `false` without changing the state, so that the
+// record can be read by `ReadRecordInternal()`, which handles these cases and
+// reports errors.
+inline bool CsvReaderBase::ReadRecordFromBuffer(
+    Reader& src, std::vector<absl::string_view>& record) {
+  const char* ptr = src.cursor();
+  const char* const limit = src.limit();
+  // Newlines inside quoted fields.
+  int64_t num_newlines = 0;
+  size_t num_stored = 0;
+  record.clear();
+  for (;;) {
+    // Read the next field.
+    if (ABSL_PREDICT_FALSE(record.size() == max_num_fields_)) return false;
+    if (ABSL_PREDICT_FALSE(ptr == limit)) return false;
+    CharClass char_class;
+    if (char_classes_[static_cast<unsigned char>(*ptr)] == CharClass::kQuote) {
+      const char* const field_begin = ++ptr;
+      bool needs_unescaping = false;
+      for (;;) {
+        ptr = quoted_finder_.Find(src, ptr);
+        if (ABSL_PREDICT_FALSE(ptr == limit)) return false;
+        char_class = char_classes_[static_cast<unsigned char>(*ptr++)];
+        if (char_class == CharClass::kQuote) {
+          if (ABSL_PREDICT_FALSE(ptr == limit)) return false;
+          if (*ptr != quote_) break;
+          // Quote written twice.
+          ++ptr;
+          needs_unescaping = true;
+        } else if (char_class == CharClass::kEscape) {
+          if (ABSL_PREDICT_FALSE(ptr == limit)) return false;
+          ++ptr;
+          needs_unescaping = true;
+        } else {
+          // LF, or CR possibly followed by LF.
+          ++num_newlines;
+          if (char_class == CharClass::kCr) {
+            if (ABSL_PREDICT_FALSE(ptr == limit)) return false;
+            if (*ptr == '\n') ++ptr;
+          }
+        }
+      }
+      absl::string_view field(field_begin, PtrDistance(field_begin, ptr - 1));
+      if (needs_unescaping) {
+        // Growing `field_storage_` would invalidate views of short fields
+        // stored earlier. It grows when reading in the general way.
+        if (ABSL_PREDICT_FALSE(num_stored == field_storage_.size())) {
+          return false;
+        }
+        std::string& unescaped = field_storage_[num_stored++];
+        unescaped.clear();
+        for (size_t i = 0; i < field.size(); ++i) {
+          const CharClass field_char_class =
+              char_classes_[static_cast<unsigned char>(field[i])];
+          if (field_char_class == CharClass::kQuote ||
+              field_char_class == CharClass::kEscape) {
+            ++i;
+          }
+          unescaped.push_back(field[i]);
+        }
+        field = unescaped;
+      }
+      if (ABSL_PREDICT_FALSE(field.size() > max_field_length_)) return false;
+      record.push_back(field);
+      if (ABSL_PREDICT_FALSE(ptr == limit)) return false;
+      char_class = char_classes_[static_cast<unsigned char>(*ptr++)];
+    } else {
+      const char* const field_begin = ptr;
+      for (;;) {
+        ptr = field_finder_.Find(src, ptr);
+        if (ABSL_PREDICT_FALSE(ptr == limit)) return false;
+        char_class = char_classes_[static_cast<unsigned char>(*ptr)];
+        if (char_class != CharClass::kComment) break;
+        // A comment character at the beginning of a record starts a comment
+        // line. Elsewhere it is an ordinary character.
+        if (ABSL_PREDICT_FALSE(record.empty() && ptr == src.cursor())) {
+          return false;
+        }
+        ++ptr;
+      }
+      const absl::string_view field(field_begin, PtrDistance(field_begin, ptr));
+      if (ABSL_PREDICT_FALSE(field.size() > max_field_length_)) return false;
+      record.push_back(field);
+      ++ptr;
+    }
+    switch (char_class) {
+      case CharClass::kFieldSeparator:
+        continue;
+      case CharClass::kLf:
+        break;
+      case CharClass::kCr:
+        if (ABSL_PREDICT_FALSE(ptr == limit)) return false;
+        if (*ptr == '\n') ++ptr;
+        break;
+      default:
+        // Unquoted data after closing quote, unquoted data before opening
+        // quote, or an escape outside quotes.
+        return false;
+    }
+    break;
+  }
+  src.set_cursor(ptr);
+  last_line_number_ = line_number_;
+  line_number_ += num_newlines + 1;
+  ++record_index_;
+  return true;
+}
+
 absl::Status ReadCsvRecordFromString(absl::string_view src,
                                      std::vector<std::string>& record,
                                      CsvReaderBase::Options options) {
@@ -36,17 +36,23 @@
 #include "riegeli/base/dependency.h"
 #include "riegeli/base/object.h"
 #include "riegeli/bytes/reader.h"
+#include "riegeli/csv/csv_char_finder_internal.h"
 #include "riegeli/csv/csv_record.h"
 
 namespace riegeli {
 
+class CsvColumnBatch;
 class CsvReaderBase;
+class CsvSchema;
 
 namespace internal {
 bool ReadStandaloneRecord(CsvReaderBase& csv_reader,
                           std::vector<std::string>& record);
 }  // namespace internal
 
+bool ReadCsvColumns(CsvReaderBase& csv_reader, const CsvSchema& schema,
+                    size_t max_rows, CsvColumnBatch& batch);
+
 // Template parameter independent part of `CsvReader`.
 class CsvReaderBase : public Object {
  public:
@@ -296,6 +302,22 @@ class CsvReaderBase : public Object {
   //  * `false` (when `!healthy()`) - failure (`record` is empty)
   bool ReadRecord(std::vector<std::string>& record);
 
+  // Reads the next record expressed as a vector of views of fields.
+  //
+  // This avoids copying fields. A field is a view into the buffer of the byte
+  // `Reader` if possible, i.e. if the whole record is available in the buffer,
+  // unless the field needs unescaping (contains a quote written twice or an
+  // escape character). Otherwise the field is stored in `CsvReader`.
+  //
+  // `record` is valid until the next non-const operation on this `CsvReader`
+  // or on the byte `Reader`.
+  //
+  // Return values:
+  //  * `true`                      - success (`record` is set)
+  //  * `false` (when `healthy()`)  - source ends (`record` is empty)
+  //  * `false` (when `!healthy()`) - failure (`record` is empty)
+  bool ReadRecord(std::vector<absl::string_view>& record);
+
   // The index of the most recently read record, starting from 0.
   //
   // The record count does not include any header read with
@@ -351,6 +373,9 @@ class CsvReaderBase : public Object {
  private:
   friend bool internal::ReadStandaloneRecord(CsvReaderBase& csv_reader,
                                              std::vector<std::string>& record);
+  friend bool ReadCsvColumns(CsvReaderBase& csv_reader,
+                             const CsvSchema& schema, size_t max_rows,
+                             CsvColumnBatch& batch);
 
   enum class CharClass : uint8_t {
     kOther,
@@ -367,6 +392,8 @@ class CsvReaderBase : public Object {
   bool ReadQuoted(Reader& src, std::string& field);
   bool ReadFields(Reader& src, std::vector<std::string>& fields,
                   size_t& field_index);
+  bool ReadRecordFromBuffer(Reader& src,
+                            std::vector<absl::string_view>& record);
   bool ReadRecordInternal(std::vector<std::string>& record);
 
   bool standalone_record_ = false;
@@ -375,11 +402,19 @@ class CsvReaderBase : public Object {
   // Lookup table for interpreting source characters.
   std::array<CharClass, std::numeric_limits<unsigned char>::max() + 1>
       char_classes_{};
+  // Finds characters which are not `CharClass::kOther` outside quotes.
+  internal::CsvCharFinder field_finder_;
+  // Finds characters which are meaningful inside quotes: newlines (to count
+  // lines), quote, and escape.
+  internal::CsvCharFinder quoted_finder_;
   // Meaningful if `char_classes_` contains `CharClass::kQuote`.
   char quote_ = '\0';
   size_t max_num_fields_ = 0;
   size_t max_field_length_ = 0;
   std::function<bool(absl::Status)> recovery_;
+  // Fields of the last record read by `ReadRecord()` to a vector of views
+  // which are not views into the buffer of the byte `Reader`.
+  std::vector<std::string> field_storage_;
   uint64_t record_index_ = 0;
   int64_t last_line_number_ = 1;
   int64_t line_number_ = 1;
@@ -511,10 +546,13 @@ inline CsvReaderBase::CsvReaderBase(CsvReaderBase&& that) noexcept
       has_header_(that.has_header_),
       header_(std::move(that.header_)),
       char_classes_(that.char_classes_),
+      field_finder_(that.field_finder_),
+      quoted_finder_(that.quoted_finder_),
       quote_(that.quote_),
       max_num_fields_(that.max_num_fields_),
       max_field_length_(that.max_field_length_),
       recovery_(std::move(that.recovery_)),
+      field_storage_(std::move(that.field_storage_)),
       record_index_(std::exchange(that.record_index_, 0)),
       last_line_number_(std::exchange(that.last_line_number_, 1)),
       line_number_(std::exchange(that.line_number_, 1)),
@@ -528,10 +566,13 @@ inline CsvReaderBase& CsvReaderBase::operator=(CsvReaderBase&& that) noexcept {
   has_header_ = that.has_header_;
   header_ = std::move(that.header_);
   char_classes_ = that.char_classes_;
+  field_finder_ = that.field_finder_;
+  quoted_finder_ = that.quoted_finder_;
   quote_ = that.quote_;
   max_num_fields_ = that.max_num_fields_;
   max_field_length_ = that.max_field_length_;
   recovery_ = std::move(that.recovery_);
+  field_storage_ = std::move(that.field_storage_);
   record_index_ = std::exchange(that.record_index_, 0);
   last_line_number_ = std::exchange(that.last_line_number_, 1);
   line_number_ = std::exchange(that.line_number_, 1);
@@ -545,6 +586,7 @@ inline void CsvReaderBase::Reset(Closed) {
   has_header_ = false;
   header_.Reset();
   recovery_ = nullptr;
+  field_storage_.clear();
   record_index_ = 0;
   last_line_number_ = 1;
   line_number_ = 1;
@@ -557,7 +599,10 @@ inline void CsvReaderBase::Reset() {
   has_header_ = false;
   header_.Reset();
   char_classes_ = {};
+  field_finder_.Reset();
+  quoted_finder_.Reset();
   recovery_ = nullptr;
+  field_storage_.clear();
   record_index_ = 0;
   last_line_number_ = 1;
   line_number_ = 1;
@@ -549,6 +549,7 @@ class CsvRecord {
 
  private:
   friend class CsvReaderBase;
+  friend class ParallelCsvReaderBase;
 
   absl::Status FailMerge(const std::vector<std::string>& unknown_fields) const;
 
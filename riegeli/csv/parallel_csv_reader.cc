@@ -0,0 +1,579 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/csv/parallel_csv_reader.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <limits>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/base/optimization.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/optional.h"
+#include "riegeli/base/base.h"
+#include "riegeli/base/parallelism.h"
+#include "riegeli/base/status.h"
+#include "riegeli/bytes/reader.h"
+#include "riegeli/csv/csv_char_finder_internal.h"
+#include "riegeli/csv/csv_reader.h"
+#include "riegeli/csv/csv_record.h"
+
+namespace riegeli {
+
+// Before C++17 if a constexpr static data member is ODR-used, its definition at
+// namespace scope is required. Since C++17 these definitions are deprecated:
+// http://en.cppreference.com/w/cpp/language/static
+#if __cplusplus < 201703
+constexpr int ParallelCsvReaderBase::Options::kDefaultParallelism;
+constexpr Position ParallelCsvReaderBase::Options::kDefaultRangeSize;
+#endif
+
+namespace {
+
+// States of a lexer which tracks only what is needed to find record
+// boundaries.
+enum LexerState : uint8_t {
+  kRecordStart,
+  // After CR at the end of a record. A following LF belongs to the newline.
+  kRecordStartAfterCr,
+  kUnquoted,
+  kQuoted,
+  kUnquotedEscape,
+  kQuotedEscape,
+  kCommentLine,
+  kNumLexerStates,
+};
+
+// The state preceding a range is not known because reading it failed.
+constexpr uint8_t kUnknownLexerState = kNumLexerStates;
+
+// Characters not listed are `kOtherChar`, including the field separator.
+enum LexerCharClass : uint8_t {
+  kOtherChar,
+  kLfChar,
+  kCrChar,
+  kCommentChar,
+  kQuoteChar,
+  kEscapeChar,
+  kNumLexerCharClasses,
+};
+
+constexpr uint8_t kLexerTransitions[kNumLexerStates][kNumLexerCharClasses] = {
+    // kRecordStart
+    {kUnquoted, kRecordStart, kRecordStartAfterCr, kCommentLine, kQuoted,
+     kUnquotedEscape},
+    // kRecordStartAfterCr
+    {kUnquoted, kRecordStart, kRecordStartAfterCr, kCommentLine, kQuoted,
+     kUnquotedEscape},
+    // kUnquoted
+    {kUnquoted, kRecordStart, kRecordStartAfterCr, kUnquoted, kQuoted,
+     kUnquotedEscape},
+    // kQuoted
+    {kQuoted, kQuoted, kQuoted, kQuoted, kUnquoted, kQuotedEscape},
+    // kUnquotedEscape
+    {kUnquoted, kUnquoted, kUnquoted, kUnquoted, kUnquoted, kUnquoted},
+    // kQuotedEscape
+    {kQuoted, kQuoted, kQuoted, kQuoted, kQuoted, kQuoted},
+    // kCommentLine
+    {kCommentLine, kRecordStart, kRecordStartAfterCr, kCommentLine,
+     kCommentLine, kCommentLine},
+};
+
+// Returns `true` if a record (or a comment line) begins at a character of
+// `char_class` read in `state`.
+inline bool IsRecordBoundary(uint8_t state, uint8_t char_class) {
+  return state == kRecordStart ||
+         (state == kRecordStartAfterCr && char_class != kLfChar);
+}
+
+// Returns `true` if `kOtherChar` does not change `state`, so that ordinary
+// characters can be skipped.
+inline bool IsStable(uint8_t state) {
+  return state == kUnquoted || state == kQuoted || state == kCommentLine;
+}
+
+// Maps characters to `LexerCharClass`.
+using LexerCharClasses =
+    std::array<uint8_t, std::numeric_limits<unsigned char>::max() + 1>;
+
+constexpr Position kNoRecordBoundary = std::numeric_limits<Position>::max();
+
+// Results of scanning a range from each possible lexer state at its beginning.
+struct RangeScan {
+  // Lexer state at the end of the range.
+  std::array<uint8_t, kNumLexerStates> end_states;
+  // Position of the first record boundary relative to the range beginning, or
+  // `kNoRecordBoundary`.
+  std::array<Position, kNumLexerStates> first_boundaries;
+};
+
+// Skips a comment line, including its newline.
+void SkipCommentLine(Reader& src) {
+  for (;;) {
+    if (ABSL_PREDICT_FALSE(!src.Pull())) return;
+    const char* const newline = static_cast<const char*>(
+        std::memchr(src.cursor(), '\n', src.available()));
+    const char* const cr = static_cast<const char*>(
+        std::memchr(src.cursor(), '\r', src.available()));
+    if (newline == nullptr && cr == nullptr) {
+      src.move_cursor(src.available());
+      continue;
+    }
+    if (cr == nullptr || (newline != nullptr && newline < cr)) {
+      src.set_cursor(newline + 1);
+      return;
+    }
+    src.set_cursor(cr + 1);
+    if (src.Pull() && *src.cursor() == '\n') src.move_cursor(1);
+    return;
+  }
+}
+
+}  // namespace
+
+struct ParallelCsvReaderBase::Config {
+  // `read_header()` is `false`.
+  CsvReaderBase::Options csv_options;
+  LexerCharClasses char_classes{};
+  // Finds characters other than `kOtherChar`.
+  internal::CsvCharFinder finder;
+};
+
+struct ParallelCsvReaderBase::SharedState {
+  absl::Mutex mutex;
+  // Parsed ranges not yet taken by `NextBatch()`, keyed by range index.
+  absl::flat_hash_map<uint64_t, Batch> completed ABSL_GUARDED_BY(mutex);
+  size_t num_running ABSL_GUARDED_BY(mutex) = 0;
+  // Asks background tasks to finish early.
+  std::atomic<bool> cancelled{false};
+};
+
+void ParallelCsvReaderBase::Initialize(Reader* src, Options&& options) {
+  RIEGELI_ASSERT(src != nullptr)
+      << "Failed precondition of ParallelCsvReader: null Reader pointer";
+  if (ABSL_PREDICT_FALSE(!src->healthy())) {
+    Fail(*src);
+    return;
+  }
+  if (ABSL_PREDICT_FALSE(!src->SupportsNewReader())) {
+    Fail(absl::UnimplementedError(
+        "ParallelCsvReader requires a source supporting NewReader()"));
+    return;
+  }
+  CsvReaderBase::Options& csv_options = options.csv_options();
+  if (csv_options.read_header()) {
+    has_header_ = true;
+    CsvReader<> header_reader(src, csv_options);
+    if (ABSL_PREDICT_FALSE(!header_reader.healthy())) {
+      Fail(header_reader);
+      return;
+    }
+    header_ = header_reader.header();
+    csv_options.set_read_header(false);
+  }
+  const absl::optional<Position> size = src->Size();
+  if (ABSL_PREDICT_FALSE(size == absl::nullopt)) {
+    Fail(*src);
+    return;
+  }
+
+  std::shared_ptr<Config> config = std::make_shared<Config>();
+  config->char_classes['\n'] = kLfChar;
+  config->char_classes['\r'] = kCrChar;
+  config->finder.Add('\n');
+  config->finder.Add('\r');
+  if (csv_options.comment() != absl::nullopt) {
+    config->char_classes[static_cast<unsigned char>(*csv_options.comment())] =
+        kCommentChar;
+    config->finder.Add(*csv_options.comment());
+  }
+  if (csv_options.quote() != absl::nullopt) {
+    config->char_classes[static_cast<unsigned char>(*csv_options.quote())] =
+        kQuoteChar;
+    config->finder.Add(*csv_options.quote());
+  }
+  if (csv_options.escape() != absl::nullopt) {
+    config->char_classes[static_cast<unsigned char>(*csv_options.escape())] =
+        kEscapeChar;
+    config->finder.Add(*csv_options.escape());
+  }
+  recovery_ = csv_options.recovery();
+  config->csv_options = std::move(csv_options);
+  config_ = std::move(config);
+  shared_ = std::make_shared<SharedState>();
+
+  parallelism_ = options.parallelism();
+  ordered_ = options.ordered();
+  data_begin_ = src->pos();
+  range_size_ = options.range_size();
+  size_ = *size;
+  num_ranges_ = size_ > data_begin_
+                    ? (size_ - data_begin_ - 1) / range_size_ + 1
+                    : uint64_t{0};
+  std::promise<uint8_t> first_state;
+  first_state.set_value(kRecordStart);
+  last_end_state_ = first_state.get_future().share();
+}
+
+void ParallelCsvReaderBase::Done() {
+  DoneBackground();
+  batch_ = Batch();
+  batch_index_ = 0;
+  config_.reset();
+  recovery_ = nullptr;
+}
+
+void ParallelCsvReaderBase::DoneBackground() {
+  if (shared_ == nullptr) return;
+  shared_->cancelled.store(true, std::memory_order_relaxed);
+  {
+    absl::MutexLock lock(&shared_->mutex);
+    shared_->mutex.Await(absl::Condition(
+        +[](size_t* num_running) { return *num_running == 0; },
+        &shared_->num_running));
+    shared_->completed.clear();
+  }
+  shared_.reset();
+}
+
+bool ParallelCsvReaderBase::ScheduleRanges() {
+  Reader& src = *src_reader();
+  while (num_scheduled_ < num_ranges_ &&
+         num_scheduled_ - num_delivered_ < IntCast<uint64_t>(parallelism_)) {
+    const uint64_t index = num_scheduled_;
+    const Position begin = data_begin_ + index * range_size_;
+    const Position end =
+        index == num_ranges_ - 1 ? size_ : begin + range_size_;
+    std::shared_ptr<Reader> range_src = src.NewReader(begin);
+    if (ABSL_PREDICT_FALSE(range_src == nullptr)) return Fail(src);
+    std::shared_ptr<std::promise<uint8_t>> end_state =
+        std::make_shared<std::promise<uint8_t>>();
+    std::shared_future<uint8_t> start_state =
+        std::exchange(last_end_state_, end_state->get_future().share());
+    {
+      absl::MutexLock lock(&shared_->mutex);
+      ++shared_->num_running;
+    }
+    internal::ThreadPool::global().Schedule(
+        [config = config_, shared = shared_, range_src = std::move(range_src),
+         index, begin, end, start_state = std::move(start_state),
+         end_state = std::move(end_state)]() mutable {
+          Batch batch = ParseRange(*config, *shared, *range_src, begin, end,
+                                   std::move(start_state), *end_state);
+          // The source must not be accessed after `num_running` drops to 0.
+          range_src.reset();
+          absl::MutexLock lock(&shared->mutex);
+          shared->completed.emplace(index, std::move(batch));
+          --shared->num_running;
+        });
+    ++num_scheduled_;
+  }
+  return true;
+}
+
+namespace {
+
+// Scans `length` bytes of `src` from each lexer state at once, skipping
+// ordinary characters with `finder`. States reached from different starting
+// states usually merge quickly, except that inside and outside quotes remain
+// separate.
+bool ScanRange(const LexerCharClasses& char_classes,
+               internal::CsvCharFinder& finder,
+               const std::atomic<bool>& cancelled, Reader& src,
+               Position length, RangeScan& scan) {
+  // Distinct current states, and the sets of starting states leading to them
+  // as bitmasks.
+  std::array<uint8_t, kNumLexerStates> states;
+  std::array<uint8_t, kNumLexerStates> starts;
+  size_t num_states = kNumLexerStates;
+  for (uint8_t i = 0; i < kNumLexerStates; ++i) {
+    states[i] = i;
+    starts[i] = uint8_t{1} << i;
+    scan.first_boundaries[i] = kNoRecordBoundary;
+  }
+  // Starting states for which a record boundary was not found yet.
+  uint8_t pending = (uint8_t{1} << kNumLexerStates) - 1;
+  bool stable = false;
+  Position pos = 0;
+  while (pos < length) {
+    if (ABSL_PREDICT_FALSE(cancelled.load(std::memory_order_relaxed))) {
+      return false;
+    }
+    if (ABSL_PREDICT_FALSE(!src.Pull())) {
+      if (ABSL_PREDICT_FALSE(!src.healthy())) return false;
+      break;
+    }
+    const char* ptr = src.cursor();
+    const char* const limit =
+        ptr + UnsignedMin(src.available(), length - pos);
+    while (ptr < limit) {
+      if (stable) {
+        ptr = finder.Find(src, ptr);
+        if (ptr >= limit) {
+          ptr = limit;
+          break;
+        }
+      }
+      const uint8_t char_class =
+          char_classes[static_cast<unsigned char>(*ptr)];
+      for (size_t i = 0; i < num_states; ++i) {
+        if ((starts[i] & pending) != 0 &&
+            IsRecordBoundary(states[i], char_class)) {
+          const Position boundary = pos + PtrDistance(src.cursor(), ptr);
+          for (uint8_t start = 0; start < kNumLexerStates; ++start) {
+            if ((starts[i] & pending & (uint8_t{1} << start)) != 0) {
+              scan.first_boundaries[start] = boundary;
+            }
+          }
+          pending &= ~starts[i];
+        }
+        states[i] = kLexerTransitions[states[i]][char_class];
+      }
+      stable = true;
+      for (size_t i = 0; i < num_states; ++i) {
+        for (size_t j = 0; j < i; ++j) {
+          if (states[j] == states[i]) {
+            starts[j] |= starts[i];
+            --num_states;
+            states[i] = states[num_states];
+            starts[i] = starts[num_states];
+            --i;
+            goto next_state;
+          }
+        }
+        stable &= IsStable(states[i]);
+      next_state:;
+      }
+      ++ptr;
+    }
+    pos += PtrDistance(src.cursor(), ptr);
+    src.set_cursor(ptr);
+  }
+  for (size_t i = 0; i < num_states; ++i) {
+    for (uint8_t start = 0; start < kNumLexerStates; ++start) {
+      if ((starts[i] & (uint8_t{1} << start)) != 0) {
+        scan.end_states[start] = states[i];
+      }
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+ParallelCsvReaderBase::Batch ParallelCsvReaderBase::ParseRange(
+    const Config& config, const SharedState& shared, Reader& src,
+    Position begin, Position end, std::shared_future<uint8_t> start_state,
+    std::promise<uint8_t>& end_state) {
+  Batch batch;
+  // Pass 1: find the end state and the first record boundary for each state
+  // at the range beginning, without waiting for preceding ranges.
+  RangeScan scan;
+  internal::CsvCharFinder finder = config.finder;
+  if (ABSL_PREDICT_FALSE(!ScanRange(config.char_classes, finder,
+                                    shared.cancelled, src, end - begin,
+                                    scan))) {
+    end_state.set_value(kUnknownLexerState);
+    if (!src.healthy()) batch.status = src.status();
+    return batch;
+  }
+  // Resolve the state at the range beginning, and pass the state at the range
+  // end to the next range.
+  const uint8_t start = start_state.get();
+  if (ABSL_PREDICT_FALSE(start == kUnknownLexerState)) {
+    end_state.set_value(kUnknownLexerState);
+    return batch;
+  }
+  end_state.set_value(scan.end_states[start]);
+
+  // Pass 2: parse records beginning in the range.
+  const Position first_boundary = scan.first_boundaries[start];
+  if (first_boundary == kNoRecordBoundary) return batch;
+  if (ABSL_PREDICT_FALSE(!src.Seek(begin + first_boundary))) {
+    batch.status = src.status();
+    return batch;
+  }
+  CsvReader<> csv_reader(&src, config.csv_options);
+  const absl::optional<char> comment = config.csv_options.comment();
+  std::vector<std::string> record;
+  while (src.pos() < end) {
+    if (ABSL_PREDICT_FALSE(shared.cancelled.load(std::memory_order_relaxed))) {
+      break;
+    }
+    // Skip comment lines here rather than in `CsvReader`, so that a record
+    // following a comment line is not read if it belongs to the next range.
+    if (comment != absl::nullopt) {
+      if (ABSL_PREDICT_FALSE(!src.Pull())) break;
+      if (*src.cursor() == *comment) {
+        SkipCommentLine(src);
+        continue;
+      }
+    }
+    if (ABSL_PREDICT_FALSE(!csv_reader.ReadRecord(record))) {
+      if (ABSL_PREDICT_FALSE(!csv_reader.healthy())) {
+        batch.status =
+            Annotate(csv_reader.status(),
+                     absl::StrCat("with lines counted from byte ",
+                                  begin + first_boundary));
+      } else if (src.Pull()) {
+        // The recovery function returned `false`.
+        batch.cancelled = true;
+      }
+      break;
+    }
+    for (const std::string& field : record) {
+      batch.fields.append(field);
+      batch.field_ends.push_back(batch.fields.size());
+    }
+    batch.record_ends.push_back(batch.field_ends.size());
+  }
+  if (ABSL_PREDICT_FALSE(!src.healthy()) && batch.status.ok()) {
+    batch.status = src.status();
+  }
+  return batch;
+}
+
+bool ParallelCsvReaderBase::NextBatch() {
+  if (ABSL_PREDICT_FALSE(!ScheduleRanges())) return false;
+  {
+    absl::MutexLock lock(&shared_->mutex);
+    absl::flat_hash_map<uint64_t, Batch>::iterator iter;
+    if (ordered_) {
+      struct Args {
+        absl::flat_hash_map<uint64_t, Batch>* completed;
+        uint64_t index;
+      } args{&shared_->completed, num_delivered_};
+      shared_->mutex.Await(absl::Condition(
+          +[](Args* args) {
+            return args->completed->find(args->index) !=
+                   args->completed->end();
+          },
+          &args));
+      iter = shared_->completed.find(num_delivered_);
+    } else {
+      shared_->mutex.Await(absl::Condition(
+          +[](absl::flat_hash_map<uint64_t, Batch>* completed) {
+            return !completed->empty();
+          },
+          &shared_->completed));
+      iter = shared_->completed.begin();
+    }
+    batch_ = std::move(iter->second);
+    shared_->completed.erase(iter);
+  }
+  batch_index_ = 0;
+  ++num_delivered_;
+  return true;
+}
+
+bool ParallelCsvReaderBase::ReadRecord(CsvRecord& record) {
+  RIEGELI_CHECK(has_header())
+      << "Failed precondition of "
+         "ParallelCsvReaderBase::ReadRecord(CsvRecord&): "
+         "CsvReaderBase::Options::read_header() is required";
+  if (ABSL_PREDICT_FALSE(!healthy())) {
+    record.Reset();
+    return false;
+  }
+try_again:
+  record.Reset(header_);
+  // Reading directly into `record.fields_` must be careful to maintain the
+  // invariant that `record.header_.size() == record.fields_.size()`.
+  if (ABSL_PREDICT_FALSE(!ReadRecordInternal(record.fields_))) {
+    record.Reset();
+    return false;
+  }
+  if (ABSL_PREDICT_FALSE(record.fields_.size() != header_.size())) {
+    const size_t record_size = record.fields_.size();
+    record.Reset();
+    Fail(absl::InvalidArgumentError(
+        absl::StrCat("Mismatched number of CSV fields: header has ",
+                     header_.size(), ", record has ", record_size)));
+    if (recovery_ != nullptr) {
+      absl::Status status = this->status();
+      MarkNotFailed();
+      if (recovery_(std::move(status))) goto try_again;
+    }
+    return false;
+  }
+  return true;
+}
+
+bool ParallelCsvReaderBase::ReadRecord(std::vector<std::string>& record) {
+  return ReadRecordInternal(record);
+}
+
+inline bool ParallelCsvReaderBase::ReadRecordInternal(
+    std::vector<std::string>& record) {
+  if (ABSL_PREDICT_FALSE(!healthy())) {
+    record.clear();
+    return false;
+  }
+  while (batch_index_ == batch_.num_records()) {
+    if (ABSL_PREDICT_FALSE(!batch_.status.ok())) {
+      Fail(std::move(batch_.status));
+      batch_.status = absl::OkStatus();
+      record.clear();
+      return false;
+    }
+    if (ABSL_PREDICT_FALSE(batch_.cancelled)) {
+      // Reading ends as if the end of source was encountered.
+      batch_.cancelled = false;
+      shared_->cancelled.store(true, std::memory_order_relaxed);
+      num_ranges_ = num_delivered_;
+    }
+    if (num_delivered_ == num_ranges_) {
+      record.clear();
+      return false;
+    }
+    if (ABSL_PREDICT_FALSE(!NextBatch())) {
+      record.clear();
+      return false;
+    }
+  }
+  const size_t fields_begin =
+      batch_index_ == 0 ? size_t{0} : batch_.record_ends[batch_index_ - 1];
+  const size_t fields_end = batch_.record_ends[batch_index_];
+  ++batch_index_;
+  // Assign to existing elements of `record` when possible and then `erase()`
+  // excess elements, to avoid losing existing `std::string` allocations.
+  const size_t num_fields = fields_end - fields_begin;
+  if (record.size() < num_fields) record.resize(num_fields);
+  size_t field_begin =
+      fields_begin == 0 ? size_t{0} : batch_.field_ends[fields_begin - 1];
+  for (size_t i = 0; i < num_fields; ++i) {
+    const size_t field_end = batch_.field_ends[fields_begin + i];
+    record[i].assign(batch_.fields.data() + field_begin,
+                     field_end - field_begin);
+    field_begin = field_end;
+  }
+  record.erase(record.begin() + num_fields, record.end());
+  return true;
+}
+
+}  // namespace riegeli
@@ -0,0 +1,505 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_CSV_PARALLEL_CSV_READER_H_
+#define RIEGELI_CSV_PARALLEL_CSV_READER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "absl/base/attributes.h"
+#include "absl/base/optimization.h"
+#include "absl/status/status.h"
+#include "riegeli/base/base.h"
+#include "riegeli/base/dependency.h"
+#include "riegeli/base/object.h"
+#include "riegeli/bytes/reader.h"
+#include "riegeli/csv/csv_reader.h"
+#include "riegeli/csv/csv_record.h"
+
+namespace riegeli {
+
+// Template parameter independent part of `ParallelCsvReader`.
+class ParallelCsvReaderBase : public Object {
+ public:
+  class Options {
+   public:
+    Options() noexcept {}
+
+    // Options of parsing CSV, with the same meaning as for `CsvReader`.
+    //
+    // If `csv_options().recovery()` is not `nullptr`, the recovery function may
+    // be called from background threads, concurrently with itself. If it
+    // returns `false`, reading ends after records preceding the invalid line.
+    //
+    // Default: `CsvReaderBase::Options()`.
+    Options& set_csv_options(const CsvReaderBase::Options& csv_options) & {
+      csv_options_ = csv_options;
+      return *this;
+    }
+    Options& set_csv_options(CsvReaderBase::Options&& csv_options) & {
+      csv_options_ = std::move(csv_options);
+      return *this;
+    }
+    Options&& set_csv_options(const CsvReaderBase::Options& csv_options) && {
+      return std::move(set_csv_options(csv_options));
+    }
+    Options&& set_csv_options(CsvReaderBase::Options&& csv_options) && {
+      return std::move(set_csv_options(std::move(csv_options)));
+    }
+    CsvReaderBase::Options& csv_options() { return csv_options_; }
+    const CsvReaderBase::Options& csv_options() const { return csv_options_; }
+
+    // Maximum number of ranges of the source being parsed in background at a
+    // time.
+    //
+    // Larger parallelism can increase throughput, up to a point where it no
+    // longer matters; smaller parallelism reduces memory usage, which is
+    // proportional to `parallelism() * range_size()`.
+    //
+    // `parallelism` must be at least 1.
+    // Default: 8.
+    static constexpr int kDefaultParallelism = 8;
+    Options& set_parallelism(int parallelism) & {
+      RIEGELI_ASSERT_GE(parallelism, 1)
+          << "Failed precondition of "
+             "ParallelCsvReaderBase::Options::set_parallelism(): "
+             "parallelism out of range";
+      parallelism_ = parallelism;
+      return *this;
+    }
+    Options&& set_parallelism(int parallelism) && {
+      return std::move(set_parallelism(parallelism));
+    }
+    int parallelism() const { return parallelism_; }
+
+    // Size of a range of the source parsed by one background task, in bytes.
+    //
+    // Records are assigned to the range containing their beginning. A record
+    // can extend beyond its range.
+    //
+    // A range is read twice. Keeping it small enough to stay in cache between
+    // the passes makes the second pass cheaper.
+    //
+    // `range_size` must be at least 1.
+    // Default: 1M.
+    static constexpr Position kDefaultRangeSize = Position{1} << 20;
+    Options& set_range_size(Position range_size) & {
+      RIEGELI_ASSERT_GT(range_size, 0u)
+          << "Failed precondition of "
+             "ParallelCsvReaderBase::Options::set_range_size(): "
+             "zero range size";
+      range_size_ = range_size;
+      return *this;
+    }
+    Options&& set_range_size(Position range_size) && {
+      return std::move(set_range_size(range_size));
+    }
+    Position range_size() const { return range_size_; }
+
+    // If `true`, records are returned in the order of the source.
+    //
+    // If `false`, records of a range are returned in their order, but ranges
+    // are returned in the order in which their parsing completes. This avoids
+    // waiting for a slow range while later ranges are ready.
+    //
+    // Default: `true`.
+    Options& set_ordered(bool ordered) & {
+      ordered_ = ordered;
+      return *this;
+    }
+    Options&& set_ordered(bool ordered) && {
+      return std::move(set_ordered(ordered));
+    }
+    bool ordered() const { return ordered_; }
+
+   private:
+    CsvReaderBase::Options csv_options_;
+    int parallelism_ = kDefaultParallelism;
+    Position range_size_ = kDefaultRangeSize;
+    bool ordered_ = true;
+  };
+
+  // Returns the byte `Reader` being read from. Unchanged by `Close()`.
+  virtual Reader* src_reader() = 0;
+  virtual const Reader* src_reader() const = 0;
+
+  // Returns `true` if reading the header was requested, i.e.
+  // `Options::csv_options().read_header()`.
+  //
+  // In this case `ReadRecord(CsvRecord&)` is supported.
+  bool has_header() const { return has_header_; }
+
+  // If `has_header()`, returns field names read from the first record. Returns
+  // an empty header if reading the header failed.
+  //
+  // If `!has_header()`, returns an empty header.
+  const CsvHeader& header() const { return header_; }
+
+  // Reads the next record expressed as `CsvRecord`, with named fields.
+  //
+  // See `CsvReaderBase::ReadRecord(CsvRecord&)` for details.
+  //
+  // Precondition:
+  //   `has_header()`, i.e. `Options::csv_options().read_header()`
+  //
+  // Return values:
+  //  * `true`                      - success (`record` is set)
+  //  * `false` (when `healthy()`)  - source ends (`record` is empty)
+  //  * `false` (when `!healthy()`) - failure (`record` is empty)
+  bool ReadRecord(CsvRecord& record);
+
+  // Reads the next record expressed as a vector of fields.
+  //
+  // Return values:
+  //  * `true`                      - success (`record` is set)
+  //  * `false` (when `healthy()`)  - source ends (`record` is empty)
+  //  * `false` (when `!healthy()`) - failure (`record` is empty)
+  bool ReadRecord(std::vector<std::string>& record);
+
+ protected:
+  using Object::Object;
+
+  ParallelCsvReaderBase(ParallelCsvReaderBase&& that) noexcept;
+  ParallelCsvReaderBase& operator=(ParallelCsvReaderBase&& that) noexcept;
+
+  void Reset(Closed);
+  void Reset();
+  void Initialize(Reader* src, Options&& options);
+  void Done() override;
+  // Stops background tasks and waits for them, because they read from
+  // `src_reader()`.
+  void DoneBackground();
+
+ private:
+  // Parsing configuration shared by background tasks.
+  struct Config;
+  // Records parsed from a range.
+  //
+  // Fields are concatenated in one buffer rather than stored as separate
+  // strings, so that neither parsing nor reading records needs to allocate
+  // memory for each field.
+  struct Batch {
+    size_t num_records() const { return record_ends.size(); }
+
+    // Concatenated values of all fields.
+    std::string fields;
+    // End positions of fields in `fields`.
+    std::vector<size_t> field_ends;
+    // End positions of records in `field_ends`.
+    std::vector<size_t> record_ends;
+    // Not OK if parsing the range failed after the records.
+    absl::Status status;
+    // `true` if the recovery function returned `false` after the records.
+    bool cancelled = false;
+  };
+  // State shared with background tasks.
+  struct SharedState;
+
+  static Batch ParseRange(const Config& config, const SharedState& shared,
+                          Reader& src, Position begin, Position end,
+                          std::shared_future<uint8_t> start_state,
+                          std::promise<uint8_t>& end_state);
+
+  bool ScheduleRanges();
+  bool NextBatch();
+  bool ReadRecordInternal(std::vector<std::string>& record);
+
+  bool has_header_ = false;
+  CsvHeader header_;
+  std::function<bool(absl::Status)> recovery_;
+  int parallelism_ = 0;
+  bool ordered_ = false;
+  std::shared_ptr<const Config> config_;
+  std::shared_ptr<SharedState> shared_;
+  // Ranges are [`data_begin_ + i * range_size_`..`+ range_size_`), with the
+  // last range ending at `size_`.
+  Position data_begin_ = 0;
+  Position range_size_ = 0;
+  Position size_ = 0;
+  uint64_t num_ranges_ = 0;
+  uint64_t num_scheduled_ = 0;
+  uint64_t num_delivered_ = 0;
+  // The lexer state at the end of the most recently scheduled range.
+  std::shared_future<uint8_t> last_end_state_;
+  Batch batch_;
+  // The index of the next record in `batch_`.
+  size_t batch_index_ = 0;
+};
+
+// `ParallelCsvReader` reads records of a CSV file like `CsvReader`, parsing
+// ranges of the file in parallel.
+//
+// The source must support `NewReader()` and `Size()`, e.g. `FdReader` with
+// random access, or `FdMMapReader`. Each background task reads its range with
+// a separate `Reader` returned by `NewReader()`.
+//
+// A range usually does not begin at a record boundary, and whether a newline
+// ends a record depends on whether it is inside quotes, which depends on all
+// preceding data. The ambiguity is resolved speculatively in two passes:
+//
+//  1. Each task scans its range from every possible lexer state at the range
+//     beginning (e.g. outside or inside quotes) at once, finding the state at
+//     the range end and the first record boundary for each starting state.
+//  2. The actual state at the range beginning is taken from the preceding task
+//     as soon as it is known, which needs only a lookup per range. Then
+//     records beginning in the range are parsed with `CsvReader`, starting from
+//     the first record boundary.
+//
+// Record boundaries are determined assuming that the data are well-formed.
+// If parsing fails with recovery enabled, records following the invalid line
+// up to the next range might differ from what `CsvReader` would return.
+//
+// The `Src` template parameter specifies the type of the object providing and
+// possibly owning the byte `Reader`. `Src` must support
+// `Dependency<Reader*, Src>`, e.g. `Reader*` (not owned, default),
+// `std::unique_ptr<Reader>` (owned), `FdReader<>` (owned).
+//
+// By relying on CTAD the template argument can be deduced as the value type of
+// the first constructor argument. This requires C++17.
+//
+// The byte `Reader` must not be accessed until the `ParallelCsvReader` is
+// closed or no longer used.
+template <typename Src = Reader*>
+class ParallelCsvReader : public ParallelCsvReaderBase {
+ public:
+  // Creates a closed `ParallelCsvReader`.
+  explicit ParallelCsvReader(Closed) noexcept
+      : ParallelCsvReaderBase(kClosed) {}
+
+  // Will read from the byte `Reader` provided by `src`.
+  explicit ParallelCsvReader(const Src& src, Options options = Options());
+  explicit ParallelCsvReader(Src&& src, Options options = Options());
+
+  // Will read from the byte `Reader` provided by a `Src` constructed from
+  // elements of `src_args`. This avoids constructing a temporary `Src` and
+  // moving from it.
+  template <typename... SrcArgs>
+  explicit ParallelCsvReader(std::tuple<SrcArgs...> src_args,
+                             Options options = Options());
+
+  ParallelCsvReader(ParallelCsvReader&& that) noexcept;
+  ParallelCsvReader& operator=(ParallelCsvReader&& that) noexcept;
+
+  ~ParallelCsvReader() { DoneBackground(); }
+
+  // Makes `*this` equivalent to a newly constructed `ParallelCsvReader`. This
+  // avoids constructing a temporary `ParallelCsvReader` and moving from it.
+  void Reset(Closed);
+  void Reset(const Src& src, Options options = Options());
+  void Reset(Src&& src, Options options = Options());
+  template <typename... SrcArgs>
+  void Reset(std::tuple<SrcArgs...> src_args, Options options = Options());
+
+  // Returns the object providing and possibly owning the byte `Reader`.
+  // Unchanged by `Close()`.
+  Src& src() { return src_.manager(); }
+  const Src& src() const { return src_.manager(); }
+  Reader* src_reader() override { return src_.get(); }
+  const Reader* src_reader() const override { return src_.get(); }
+
+ protected:
+  void Done() override;
+
+ private:
+  // The object providing and possibly owning the byte `Reader`.
+  Dependency<Reader*, Src> src_;
+};
+
+// Support CTAD.
+#if __cpp_deduction_guides
+explicit ParallelCsvReader(Closed)->ParallelCsvReader<DeleteCtad<Closed>>;
+template <typename Src>
+explicit ParallelCsvReader(const Src& src,
+                           ParallelCsvReaderBase::Options options =
+                               ParallelCsvReaderBase::Options())
+    -> ParallelCsvReader<std::decay_t<Src>>;
+template <typename Src>
+explicit ParallelCsvReader(Src&& src, ParallelCsvReaderBase::Options options =
+                                          ParallelCsvReaderBase::Options())
+    -> ParallelCsvReader<std::decay_t<Src>>;
+template <typename... SrcArgs>
+explicit ParallelCsvReader(
+    std::tuple<SrcArgs...> src_args,
+    ParallelCsvReaderBase::Options options = ParallelCsvReaderBase::Options())
+    -> ParallelCsvReader<DeleteCtad<std::tuple<SrcArgs...>>>;
+#endif
+
+// Implementation details follow.
+
+inline ParallelCsvReaderBase::ParallelCsvReaderBase(
+    ParallelCsvReaderBase&& that) noexcept
+    : Object(std::move(that)),
+      // Using `that` after it was moved is correct because only the base class
+      // part was moved.
+      has_header_(that.has_header_),
+      header_(std::move(that.header_)),
+      recovery_(std::move(that.recovery_)),
+      parallelism_(that.parallelism_),
+      ordered_(that.ordered_),
+      config_(std::move(that.config_)),
+      shared_(std::move(that.shared_)),
+      data_begin_(that.data_begin_),
+      range_size_(that.range_size_),
+      size_(that.size_),
+      num_ranges_(std::exchange(that.num_ranges_, 0)),
+      num_scheduled_(std::exchange(that.num_scheduled_, 0)),
+      num_delivered_(std::exchange(that.num_delivered_, 0)),
+      last_end_state_(std::move(that.last_end_state_)),
+      batch_(std::move(that.batch_)),
+      batch_index_(std::exchange(that.batch_index_, 0)) {}
+
+inline ParallelCsvReaderBase& ParallelCsvReaderBase::operator=(
+    ParallelCsvReaderBase&& that) noexcept {
+  Object::operator=(std::move(that));
+  // Using `that` after it was moved is correct because only the base class part
+  // was moved.
+  has_header_ = that.has_header_;
+  header_ = std::move(that.header_);
+  recovery_ = std::move(that.recovery_);
+  parallelism_ = that.parallelism_;
+  ordered_ = that.ordered_;
+  config_ = std::move(that.config_);
+  shared_ = std::move(that.shared_);
+  data_begin_ = that.data_begin_;
+  range_size_ = that.range_size_;
+  size_ = that.size_;
+  num_ranges_ = std::exchange(that.num_ranges_, 0);
+  num_scheduled_ = std::exchange(that.num_scheduled_, 0);
+  num_delivered_ = std::exchange(that.num_delivered_, 0);
+  last_end_state_ = std::move(that.last_end_state_);
+  batch_ = std::move(that.batch_);
+  batch_index_ = std::exchange(that.batch_index_, 0);
+  return *this;
+}
+
+inline void ParallelCsvReaderBase::Reset(Closed) {
+  DoneBackground();
+  Object::Reset(kClosed);
+  has_header_ = false;
+  header_.Reset();
+  recovery_ = nullptr;
+  config_.reset();
+  num_ranges_ = 0;
+  num_scheduled_ = 0;
+  num_delivered_ = 0;
+  last_end_state_ = std::shared_future<uint8_t>();
+  batch_ = Batch();
+  batch_index_ = 0;
+}
+
+inline void ParallelCsvReaderBase::Reset() {
+  DoneBackground();
+  Object::Reset();
+  has_header_ = false;
+  header_.Reset();
+  recovery_ = nullptr;
+  config_.reset();
+  num_ranges_ = 0;
+  num_scheduled_ = 0;
+  num_delivered_ = 0;
+  last_end_state_ = std::shared_future<uint8_t>();
+  batch_ = Batch();
+  batch_index_ = 0;
+}
+
+template <typename Src>
+inline ParallelCsvReader<Src>::ParallelCsvReader(const Src& src,
+                                                 Options options)
+    : src_(src) {
+  Initialize(src_.get(), std::move(options));
+}
+
+template <typename Src>
+inline ParallelCsvReader<Src>::ParallelCsvReader(Src&& src, Options options)
+    : src_(std::move(src)) {
+  Initialize(src_.get(), std::move(options));
+}
+
+template <typename Src>
+template <typename... SrcArgs>
+inline ParallelCsvReader<Src>::ParallelCsvReader(
+    std::tuple<SrcArgs...> src_args, Options options)
+    : src_(std::move(src_args)) {
+  Initialize(src_.get(), std::move(options));
+}
+
+template <typename Src>
+inline ParallelCsvReader<Src>::ParallelCsvReader(
+    ParallelCsvReader&& that) noexcept
+    : ParallelCsvReaderBase(std::move(that)),
+      // Using `that` after it was moved is correct because only the base class
+      // part was moved.
+      src_(std::move(that.src_)) {}
+
+template <typename Src>
+inline ParallelCsvReader<Src>& ParallelCsvReader<Src>::operator=(
+    ParallelCsvReader&& that) noexcept {
+  DoneBackground();
+  ParallelCsvReaderBase::operator=(std::move(that));
+  // Using `that` after it was moved is correct because only the base class part
+  // was moved.
+  src_ = std::move(that.src_);
+  return *this;
+}
+
+template <typename Src>
+inline void ParallelCsvReader<Src>::Reset(Closed) {
+  ParallelCsvReaderBase::Reset(kClosed);
+  src_.Reset();
+}
+
+template <typename Src>
+inline void ParallelCsvReader<Src>::Reset(const Src& src, Options options) {
+  ParallelCsvReaderBase::Reset();
+  src_.Reset(src);
+  Initialize(src_.get(), std::move(options));
+}
+
+template <typename Src>
+inline void ParallelCsvReader<Src>::Reset(Src&& src, Options options) {
+  ParallelCsvReaderBase::Reset();
+  src_.Reset(std::move(src));
+  Initialize(src_.get(), std::move(options));
+}
+
+template <typename Src>
+template <typename... SrcArgs>
+inline void ParallelCsvReader<Src>::Reset(std::tuple<SrcArgs...> src_args,
+                                          Options options) {
+  ParallelCsvReaderBase::Reset();
+  src_.Reset(std::move(src_args));
+  Initialize(src_.get(), std::move(options));
+}
+
+template <typename Src>
+void ParallelCsvReader<Src>::Done() {
+  ParallelCsvReaderBase::Done();
+  if (src_.is_owning()) {
+    if (ABSL_PREDICT_FALSE(!src_->Close())) Fail(*src_);
+  }
+}
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_CSV_PARALLEL_CSV_READER_H_
@@ -0,0 +1,265 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Make file offsets 64-bit even on 32-bit systems.
+#undef _FILE_OFFSET_BITS
+#define _FILE_OFFSET_BITS 64
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "absl/base/optimization.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/flags/usage.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "riegeli/base/base.h"
+#include "riegeli/bytes/fd_reader.h"
+#include "riegeli/bytes/string_reader.h"
+#include "riegeli/csv/csv_column_batch.h"
+#include "riegeli/csv/csv_reader.h"
+#include "riegeli/csv/parallel_csv_reader.h"
+
+ABSL_FLAG(std::string, field_separator, ",",
+          "Field separator, a single character");
+ABSL_FLAG(uint64_t, max_size, uint64_t{100} * 1000 * 1000,
+          "Maximum size of each file to read, in bytes");
+ABSL_FLAG(int32_t, repetitions, 5, "Number of times to repeat each benchmark");
+ABSL_FLAG(int32_t, parallelism, 0,
+          "If positive, parse with ParallelCsvReader with this parallelism");
+ABSL_FLAG(bool, views, false,
+          "If true, read records as views of fields (ignored if parallelism is "
+          "positive)");
+ABSL_FLAG(std::string, columns, "",
+          "If not empty, decode records with ReadCsvColumns() into batches of "
+          "rows, with one character per column: 'i' for int64, 'd' for double, "
+          "'s' for string; uppercase for optional (ignored if parallelism is "
+          "positive)");
+ABSL_FLAG(uint64_t, batch_size, 1024,
+          "Number of rows per batch for --columns");
+
+namespace {
+
+uint64_t CpuTimeNow_ns() {
+  struct timespec time_info;
+  RIEGELI_CHECK_EQ(clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time_info), 0);
+  return riegeli::IntCast<uint64_t>(time_info.tv_sec) * uint64_t{1000000000} +
+         riegeli::IntCast<uint64_t>(time_info.tv_nsec);
+}
+
+uint64_t RealTimeNow_ns() {
+  struct timespec time_info;
+  RIEGELI_CHECK_EQ(clock_gettime(CLOCK_MONOTONIC, &time_info), 0);
+  return riegeli::IntCast<uint64_t>(time_info.tv_sec) * uint64_t{1000000000} +
+         riegeli::IntCast<uint64_t>(time_info.tv_nsec);
+}
+
+class Stats {
+ public:
+  void Add(double value);
+
+  double Median();
+
+ private:
+  std::vector<double> samples_;
+};
+
+void Stats::Add(double value) { samples_.push_back(value); }
+
+double Stats::Median() {
+  RIEGELI_CHECK(!samples_.empty()) << "No data";
+  const size_t middle = samples_.size() / 2;
+  std::nth_element(samples_.begin(),
+                   samples_.begin() + riegeli::IntCast<ptrdiff_t>(middle),
+                   samples_.end());
+  return samples_[middle];
+}
+
+std::string ReadFile(absl::string_view filename, uint64_t max_size) {
+  riegeli::FdReader<> file_reader(filename, O_RDONLY);
+  if (ABSL_PREDICT_FALSE(!file_reader.healthy())) {
+    absl::Format(&std::cerr, "Could not open file: %s\n",
+                 file_reader.status().ToString());
+    std::exit(1);
+  }
+  std::string contents;
+  file_reader.Read(riegeli::SaturatingIntCast<size_t>(max_size), contents);
+  RIEGELI_CHECK(file_reader.Close()) << file_reader.status();
+  return contents;
+}
+
+// Parses `contents` as CSV, returning the number of records and fields.
+std::pair<uint64_t, uint64_t> ParseCsv(
+    absl::string_view contents, const riegeli::CsvReaderBase::Options& options,
+    int parallelism, bool views, const riegeli::CsvSchema* schema,
+    size_t batch_size) {
+  if (parallelism > 0) {
+    riegeli::ParallelCsvReader<riegeli::StringReader<>> csv_reader(
+        std::forward_as_tuple(contents),
+        riegeli::ParallelCsvReaderBase::Options()
+            .set_csv_options(options)
+            .set_parallelism(parallelism));
+    uint64_t num_records = 0;
+    uint64_t num_fields = 0;
+    std::vector<std::string> record;
+    while (csv_reader.ReadRecord(record)) {
+      ++num_records;
+      num_fields += record.size();
+    }
+    RIEGELI_CHECK(csv_reader.Close()) << csv_reader.status();
+    return std::make_pair(num_records, num_fields);
+  }
+  riegeli::CsvReader<riegeli::StringReader<>> csv_reader(
+      std::forward_as_tuple(contents), options);
+  uint64_t num_records = 0;
+  uint64_t num_fields = 0;
+  if (schema != nullptr) {
+    riegeli::CsvColumnBatch batch;
+    while (riegeli::ReadCsvColumns(csv_reader, *schema, batch_size, batch)) {
+      num_records += batch.num_rows();
+      num_fields += batch.num_rows() * batch.num_columns();
+    }
+  } else if (views) {
+    std::vector<absl::string_view> record;
+    while (csv_reader.ReadRecord(record)) {
+      ++num_records;
+      num_fields += record.size();
+    }
+  } else {
+    std::vector<std::string> record;
+    while (csv_reader.ReadRecord(record)) {
+      ++num_records;
+      num_fields += record.size();
+    }
+  }
+  RIEGELI_CHECK(csv_reader.Close()) << csv_reader.status();
+  return std::make_pair(num_records, num_fields);
+}
+
+void RunOne(absl::string_view filename, absl::string_view contents,
+            const riegeli::CsvReaderBase::Options& options, int parallelism,
+            bool views, const riegeli::CsvSchema* schema, size_t batch_size,
+            int repetitions, int max_name_width,
+            std::ostream& report) {
+  absl::Format(&report, "%-*s ", max_name_width, filename);
+  report.flush();
+  std::pair<uint64_t, uint64_t> counts;
+  Stats cpu_speed;
+  Stats real_speed;
+  for (int i = 0; i < repetitions + 1; ++i) {
+    const uint64_t cpu_time_before_ns = CpuTimeNow_ns();
+    const uint64_t real_time_before_ns = RealTimeNow_ns();
+    counts =
+        ParseCsv(contents, options, parallelism, views, schema, batch_size);
+    const uint64_t cpu_time_after_ns = CpuTimeNow_ns();
+    const uint64_t real_time_after_ns = RealTimeNow_ns();
+    if (i == 0) {
+      // Warm-up.
+    } else {
+      cpu_speed.Add(
+          static_cast<double>(contents.size()) /
+          static_cast<double>(cpu_time_after_ns - cpu_time_before_ns) * 1000.0);
+      real_speed.Add(
+          static_cast<double>(contents.size()) /
+          static_cast<double>(real_time_after_ns - real_time_before_ns) *
+          1000.0);
+    }
+  }
+  absl::Format(&report, "%9.3f %10u %11u  %5.0f %5.0f\n",
+               static_cast<double>(contents.size()) / 1000000.0, counts.first,
+               counts.second, cpu_speed.Median(), real_speed.Median());
+}
+
+const char kUsage[] =
+    "Usage: csv_benchmark (OPTION|FILE)...\n"
+    "\n"
+    "Measures parsing throughput of CsvReader or ParallelCsvReader over CSV "
+    "FILEs.\n";
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  absl::SetProgramUsageMessage(kUsage);
+  const std::vector<char*> args = absl::ParseCommandLine(argc, argv);
+  if (args.size() <= 1) {
+    absl::Format(&std::cerr, "%s\n", kUsage);
+    return 1;
+  }
+  const std::string field_separator = absl::GetFlag(FLAGS_field_separator);
+  if (field_separator.size() != 1) {
+    absl::Format(&std::cerr, "--field_separator must be a single character\n");
+    return 1;
+  }
+  riegeli::CsvReaderBase::Options options;
+  options.set_field_separator(field_separator[0]);
+  const std::string columns = absl::GetFlag(FLAGS_columns);
+  riegeli::CsvSchema schema;
+  for (const char column : columns) {
+    switch (column) {
+      case 'i':
+      case 'I':
+        schema.Add(riegeli::CsvColumnType::kInt64, column == 'I');
+        continue;
+      case 'd':
+      case 'D':
+        schema.Add(riegeli::CsvColumnType::kDouble, column == 'D');
+        continue;
+      case 's':
+      case 'S':
+        schema.Add(riegeli::CsvColumnType::kString, column == 'S');
+        continue;
+    }
+    absl::Format(&std::cerr, "--columns must consist of i, d, s, I, D, S\n");
+    return 1;
+  }
+  const uint64_t batch_size = absl::GetFlag(FLAGS_batch_size);
+  if (batch_size == 0) {
+    absl::Format(&std::cerr, "--batch_size must be positive\n");
+    return 1;
+  }
+  int max_name_width = 4;
+  for (size_t i = 1; i < args.size(); ++i) {
+    max_name_width = std::max(
+        max_name_width,
+        riegeli::IntCast<int>(absl::string_view(args[i]).size()));
+  }
+  absl::Format(&std::cout,
+               "%-*s      Size    Records      Fields   CPU  Real\n",
+               max_name_width, "");
+  absl::Format(&std::cout,
+               "%-*s        MB                         MB/s  MB/s\n",
+               max_name_width, "File");
+  absl::Format(&std::cout, "%s\n",
+               std::string(riegeli::IntCast<size_t>(max_name_width + 48), '-'));
+  for (size_t i = 1; i < args.size(); ++i) {
+    const std::string contents =
+        ReadFile(args[i], absl::GetFlag(FLAGS_max_size));
+    RunOne(args[i], contents, options, absl::GetFlag(FLAGS_parallelism),
+           absl::GetFlag(FLAGS_views), columns.empty() ? nullptr : &schema,
+           riegeli::SaturatingIntCast<size_t>(batch_size),
+           absl::GetFlag(FLAGS_repetitions),
+           max_name_width, std::cout);
+  }
+}
@@ -0,0 +1,147 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/endian/endian_internal.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RIEGELI_INTERNAL_ENDIAN_SSE2 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define RIEGELI_INTERNAL_ENDIAN_NEON 1
+#endif
+
+namespace riegeli {
+namespace internal {
+
+namespace {
+
+// Reverses bytes of 16 bytes starting at `src`, in groups of 2, 4, or 8 bytes,
+// storing them at `dest`.
+#if RIEGELI_INTERNAL_ENDIAN_SSE2
+
+inline __m128i ReverseBytesIn16BitLanes(__m128i data) {
+  return _mm_or_si128(_mm_slli_epi16(data, 8), _mm_srli_epi16(data, 8));
+}
+
+inline void ReverseBytes16x8(const char* src, char* dest) {
+  const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(dest),
+                   ReverseBytesIn16BitLanes(data));
+}
+
+inline void ReverseBytes32x4(const char* src, char* dest) {
+  __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+  // Swap 16-bit halves of each 32-bit lane, then bytes of each 16-bit half.
+  data = _mm_shufflelo_epi16(data, _MM_SHUFFLE(2, 3, 0, 1));
+  data = _mm_shufflehi_epi16(data, _MM_SHUFFLE(2, 3, 0, 1));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(dest),
+                   ReverseBytesIn16BitLanes(data));
+}
+
+inline void ReverseBytes64x2(const char* src, char* dest) {
+  __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+  // Reverse 16-bit quarters of each 64-bit lane, then bytes of each quarter.
+  data = _mm_shufflelo_epi16(data, _MM_SHUFFLE(0, 1, 2, 3));
+  data = _mm_shufflehi_epi16(data, _MM_SHUFFLE(0, 1, 2, 3));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(dest),
+                   ReverseBytesIn16BitLanes(data));
+}
+
+#elif RIEGELI_INTERNAL_ENDIAN_NEON
+
+inline void ReverseBytes16x8(const char* src, char* dest) {
+  vst1q_u8(reinterpret_cast<uint8_t*>(dest),
+           vrev16q_u8(vld1q_u8(reinterpret_cast<const uint8_t*>(src))));
+}
+
+inline void ReverseBytes32x4(const char* src, char* dest) {
+  vst1q_u8(reinterpret_cast<uint8_t*>(dest),
+           vrev32q_u8(vld1q_u8(reinterpret_cast<const uint8_t*>(src))));
+}
+
+inline void ReverseBytes64x2(const char* src, char* dest) {
+  vst1q_u8(reinterpret_cast<uint8_t*>(dest),
+           vrev64q_u8(vld1q_u8(reinterpret_cast<const uint8_t*>(src))));
+}
+
+#endif
+
+// Reverses bytes of a single value of `width` bytes. `src` and `dest` can be
+// equal.
+template <size_t width>
+inline void ReverseBytes(const char* src, char* dest) {
+  char value[width];
+  std::memcpy(value, src, width);
+  for (size_t i = 0; i < width; ++i) dest[i] = value[width - 1 - i];
+}
+
+}  // namespace
+
+void CopyReversingBytes16(const char* src, size_t num_values, char* dest) {
+  const char* const limit = src + num_values * sizeof(uint16_t);
+#if RIEGELI_INTERNAL_ENDIAN_SSE2 || RIEGELI_INTERNAL_ENDIAN_NEON
+  while (limit - src >= 16) {
+    ReverseBytes16x8(src, dest);
+    src += 16;
+    dest += 16;
+  }
+#endif
+  while (src != limit) {
+    ReverseBytes<sizeof(uint16_t)>(src, dest);
+    src += sizeof(uint16_t);
+    dest += sizeof(uint16_t);
+  }
+}
+
+void CopyReversingBytes32(const char* src, size_t num_values, char* dest) {
+  const char* const limit = src + num_values * sizeof(uint32_t);
+#if RIEGELI_INTERNAL_ENDIAN_SSE2 || RIEGELI_INTERNAL_ENDIAN_NEON
+  while (limit - src >= 16) {
+    ReverseBytes32x4(src, dest);
+    src += 16;
+    dest += 16;
+  }
+#endif
+  while (src != limit) {
+    ReverseBytes<sizeof(uint32_t)>(src, dest);
+    src += sizeof(uint32_t);
+    dest += sizeof(uint32_t);
+  }
+}
+
+void CopyReversingBytes64(const char* src, size_t num_values, char* dest) {
+  const char* const limit = src + num_values * sizeof(uint64_t);
+#if RIEGELI_INTERNAL_ENDIAN_SSE2 || RIEGELI_INTERNAL_ENDIAN_NEON
+  while (limit - src >= 16) {
+    ReverseBytes64x2(src, dest);
+    src += 16;
+    dest += 16;
+  }
+#endif
+  while (src != limit) {
+    ReverseBytes<sizeof(uint64_t)>(src, dest);
+    src += sizeof(uint64_t);
+    dest += sizeof(uint64_t);
+  }
+}
+
+}  // namespace internal
+}  // namespace riegeli
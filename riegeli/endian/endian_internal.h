@@ -15,6 +15,7 @@
 #ifndef RIEGELI_ENDIAN_ENDIAN_INTERNAL_H_
 #define RIEGELI_ENDIAN_ENDIAN_INTERNAL_H_
 
+#include <stddef.h>
 #include <stdint.h>
 
 namespace riegeli {
@@ -36,6 +37,39 @@ inline bool IsBigEndian() {
   return reinterpret_cast<const unsigned char*>(&value)[3] == 1;
 }
 
+// Copies `num_values` values of `sizeof(uint{16,32,64}_t)` bytes from `src[]`
+// to `dest[]`, reversing the order of bytes in each value, i.e. converting them
+// between native and non-native endianness.
+//
+// This is vectorized with SSE2 or NEON if available.
+//
+// `src` and `dest` can be equal, but must not otherwise overlap.
+void CopyReversingBytes16(const char* src, size_t num_values, char* dest);
+void CopyReversingBytes32(const char* src, size_t num_values, char* dest);
+void CopyReversingBytes64(const char* src, size_t num_values, char* dest);
+
+// `CopyReversingBytes{16,32,64}()` selected by the width of a value in bytes.
+template <size_t width>
+void CopyReversingBytes(const char* src, size_t num_values, char* dest);
+
+template <>
+inline void CopyReversingBytes<2>(const char* src, size_t num_values,
+                                  char* dest) {
+  CopyReversingBytes16(src, num_values, dest);
+}
+
+template <>
+inline void CopyReversingBytes<4>(const char* src, size_t num_values,
+                                  char* dest) {
+  CopyReversingBytes32(src, num_values, dest);
+}
+
+template <>
+inline void CopyReversingBytes<8>(const char* src, size_t num_values,
+                                  char* dest) {
+  CopyReversingBytes64(src, num_values, dest);
+}
+
 }  // namespace internal
 }  // namespace riegeli
 
@@ -15,11 +15,14 @@
 #ifndef RIEGELI_ENDIAN_ENDIAN_READING_H_
 #define RIEGELI_ENDIAN_ENDIAN_READING_H_
 
+#include <stddef.h>
 #include <stdint.h>
 
 #include <cstring>
 
 #include "absl/base/optimization.h"
+#include "absl/types/span.h"
+#include "riegeli/base/base.h"
 #include "riegeli/bytes/reader.h"
 #include "riegeli/endian/endian_internal.h"
 
@@ -44,7 +47,8 @@ bool ReadBigEndian64(Reader& src, uint64_t& dest);
 
 // Reads an array of numbers in a fixed width Little/Big Endian encoding.
 //
-// This is faster than reading them individually for native endianness.
+// This is faster than reading them individually: for native endianness they
+// are read directly, otherwise bytes are reversed many values at a time.
 //
 // Return values:
 //  * `true`                          - success (`dest[]` is filled)
@@ -61,6 +65,25 @@ bool ReadBigEndian16s(Reader& src, absl::Span<uint16_t> dest);
 bool ReadBigEndian32s(Reader& src, absl::Span<uint32_t> dest);
 bool ReadBigEndian64s(Reader& src, absl::Span<uint64_t> dest);
 
+// Reads an array of floating point numbers (IEEE 754 binary32 or binary64) in a
+// fixed width Little/Big Endian encoding.
+//
+// This is faster than reading them individually: for native endianness they
+// are read directly, otherwise bytes are reversed many values at a time.
+//
+// Return values:
+//  * `true`                          - success (`dest[]` is filled)
+//  * `false` (when `src.healthy()`)  - source ends
+//                                      (`src` position is undefined,
+//                                      `dest[]` is undefined)
+//  * `false` (when `!src.healthy()`) - failure
+//                                      (`src` position is undefined,
+//                                      `dest[]` is undefined)
+bool ReadLittleEndianFloats(Reader& src, absl::Span<float> dest);
+bool ReadLittleEndianDoubles(Reader& src, absl::Span<double> dest);
+bool ReadBigEndianFloats(Reader& src, absl::Span<float> dest);
+bool ReadBigEndianDoubles(Reader& src, absl::Span<double> dest);
+
 // Reads a number in a fixed width Little/Big Endian encoding from an array.
 //
 // Reads `sizeof(uint{16,32,64}_t)` bytes  from `src[]`.
@@ -74,7 +97,8 @@ uint64_t ReadBigEndian64(const char* src);
 // Reads an array of numbers in a fixed width Little/Big Endian encoding from an
 // array.
 //
-// This is faster than reading them individually for native endianness.
+// This is faster than reading them individually: for native endianness they
+// are read directly, otherwise bytes are reversed many values at a time.
 //
 // Reads `dest.size() * sizeof(uint{16,32,64}_t)` bytes  from `src[]`.
 void ReadLittleEndian16s(const char* src, absl::Span<uint16_t> dest);
@@ -84,8 +108,70 @@ void ReadBigEndian16s(const char* src, absl::Span<uint16_t> dest);
 void ReadBigEndian32s(const char* src, absl::Span<uint32_t> dest);
 void ReadBigEndian64s(const char* src, absl::Span<uint64_t> dest);
 
+// Reads an array of floating point numbers (IEEE 754 binary32 or binary64) in a
+// fixed width Little/Big Endian encoding from an array.
+//
+// Reads `dest.size() * sizeof({float,double})` bytes  from `src[]`.
+void ReadLittleEndianFloats(const char* src, absl::Span<float> dest);
+void ReadLittleEndianDoubles(const char* src, absl::Span<double> dest);
+void ReadBigEndianFloats(const char* src, absl::Span<float> dest);
+void ReadBigEndianDoubles(const char* src, absl::Span<double> dest);
+
 // Implementation details follow.
 
+namespace internal {
+
+static_assert(sizeof(float) == sizeof(uint32_t),
+              "float is expected to be IEEE 754 binary32");
+static_assert(sizeof(double) == sizeof(uint64_t),
+              "double is expected to be IEEE 754 binary64");
+
+// Reads `num_values` values of `width` bytes from `src` to `dest[]`, reversing
+// the order of bytes in each value.
+//
+// Values are converted directly from the buffer of `src`, as many at a time as
+// are available, rather than pulling each value separately.
+template <size_t width>
+inline bool ReadReversingBytes(Reader& src, size_t num_values, char* dest) {
+  while (num_values > 0) {
+    if (ABSL_PREDICT_FALSE(!src.Pull(width, num_values * width))) return false;
+    const size_t length = UnsignedMin(src.available() / width, num_values);
+    CopyReversingBytes<width>(src.cursor(), length, dest);
+    src.move_cursor(length * width);
+    dest += length * width;
+    num_values -= length;
+  }
+  return true;
+}
+
+// Reads `num_values` values of `width` bytes in native endianness if `native`,
+// or in non-native endianness otherwise, from `src[]` to `dest[]`.
+template <size_t width>
+inline void ReadValues(bool native, const char* src, size_t num_values,
+                       char* dest) {
+  if (native) {
+    if (ABSL_PREDICT_TRUE(
+            // `std::memcpy(nullptr, _, 0)` and `std::memcpy(_, nullptr, 0)` are
+            // undefined.
+            num_values > 0)) {
+      std::memcpy(dest, src, num_values * width);
+    }
+  } else {
+    CopyReversingBytes<width>(src, num_values, dest);
+  }
+}
+
+// Reads `num_values` values of `width` bytes in native endianness if `native`,
+// or in non-native endianness otherwise, from `src` to `dest[]`.
+template <size_t width>
+inline bool ReadValues(bool native, Reader& src, size_t num_values,
+                       char* dest) {
+  if (native) return src.Read(num_values * width, dest);
+  return ReadReversingBytes<width>(src, num_values, dest);
+}
+
+}  // namespace internal
+
 inline bool ReadLittleEndian16(Reader& src, uint16_t& dest) {
   if (ABSL_PREDICT_FALSE(!src.Pull(sizeof(uint16_t)))) return false;
   dest = ReadLittleEndian16(src.cursor());
@@ -133,12 +219,8 @@ inline bool ReadLittleEndian16s(Reader& src, absl::Span<uint16_t> dest) {
     return src.Read(dest.size() * sizeof(uint16_t),
                     reinterpret_cast<char*>(dest.data()));
   } else {
-    for (uint16_t& dest_value : dest) {
-      if (ABSL_PREDICT_FALSE(!ReadLittleEndian16(src, dest_value))) {
-        return false;
-      }
-    }
-    return true;
+    return internal::ReadReversingBytes<sizeof(uint16_t)>(
+        src, dest.size(), reinterpret_cast<char*>(dest.data()));
   }
 }
 
@@ -147,12 +229,8 @@ inline bool ReadLittleEndian32s(Reader& src, absl::Span<uint32_t> dest) {
     return src.Read(dest.size() * sizeof(uint32_t),
                     reinterpret_cast<char*>(dest.data()));
   } else {
-    for (uint32_t& dest_value : dest) {
-      if (ABSL_PREDICT_FALSE(!ReadLittleEndian32(src, dest_value))) {
-        return false;
-      }
-    }
-    return true;
+    return internal::ReadReversingBytes<sizeof(uint32_t)>(
+        src, dest.size(), reinterpret_cast<char*>(dest.data()));
   }
 }
 
@@ -161,12 +239,8 @@ inline bool ReadLittleEndian64s(Reader& src, absl::Span<uint64_t> dest) {
     return src.Read(dest.size() * sizeof(uint64_t),
                     reinterpret_cast<char*>(dest.data()));
   } else {
-    for (uint64_t& dest_value : dest) {
-      if (ABSL_PREDICT_FALSE(!ReadLittleEndian64(src, dest_value))) {
-        return false;
-      }
-    }
-    return true;
+    return internal::ReadReversingBytes<sizeof(uint64_t)>(
+        src, dest.size(), reinterpret_cast<char*>(dest.data()));
   }
 }
 
@@ -175,10 +249,8 @@ inline bool ReadBigEndian16s(Reader& src, absl::Span<uint16_t> dest) {
     return src.Read(dest.size() * sizeof(uint16_t),
                     reinterpret_cast<char*>(dest.data()));
   } else {
-    for (uint16_t& dest_value : dest) {
-      if (ABSL_PREDICT_FALSE(!ReadBigEndian16(src, dest_value))) return false;
-    }
-    return true;
+    return internal::ReadReversingBytes<sizeof(uint16_t)>(
+        src, dest.size(), reinterpret_cast<char*>(dest.data()));
   }
 }
 
@@ -187,10 +259,8 @@ inline bool ReadBigEndian32s(Reader& src, absl::Span<uint32_t> dest) {
     return src.Read(dest.size() * sizeof(uint32_t),
                     reinterpret_cast<char*>(dest.data()));
   } else {
-    for (uint32_t& dest_value : dest) {
-      if (ABSL_PREDICT_FALSE(!ReadBigEndian32(src, dest_value))) return false;
-    }
-    return true;
+    return internal::ReadReversingBytes<sizeof(uint32_t)>(
+        src, dest.size(), reinterpret_cast<char*>(dest.data()));
   }
 }
 
@@ -199,10 +269,8 @@ inline bool ReadBigEndian64s(Reader& src, absl::Span<uint64_t> dest) {
     return src.Read(dest.size() * sizeof(uint64_t),
                     reinterpret_cast<char*>(dest.data()));
   } else {
-    for (uint64_t& dest_value : dest) {
-      if (ABSL_PREDICT_FALSE(!ReadBigEndian64(src, dest_value))) return false;
-    }
-    return true;
+    return internal::ReadReversingBytes<sizeof(uint64_t)>(
+        src, dest.size(), reinterpret_cast<char*>(dest.data()));
   }
 }
 
@@ -302,10 +370,8 @@ inline void ReadLittleEndian16s(const char* src, absl::Span<uint16_t> dest) {
       std::memcpy(dest.data(), src, dest.size() * sizeof(uint16_t));
     }
   } else {
-    for (uint16_t& value : dest) {
-      value = ReadLittleEndian16(src);
-      src += sizeof(uint16_t);
-    }
+    internal::CopyReversingBytes16(src, dest.size(),
+                                   reinterpret_cast<char*>(dest.data()));
   }
 }
 
@@ -318,10 +384,8 @@ inline void ReadLittleEndian32s(const char* src, absl::Span<uint32_t> dest) {
       std::memcpy(dest.data(), src, dest.size() * sizeof(uint32_t));
     }
   } else {
-    for (uint32_t& value : dest) {
-      value = ReadLittleEndian32(src);
-      src += sizeof(uint32_t);
-    }
+    internal::CopyReversingBytes32(src, dest.size(),
+                                   reinterpret_cast<char*>(dest.data()));
   }
 }
 
@@ -334,10 +398,8 @@ inline void ReadLittleEndian64s(const char* src, absl::Span<uint64_t> dest) {
       std::memcpy(dest.data(), src, dest.size() * sizeof(uint64_t));
     }
   } else {
-    for (uint64_t& value : dest) {
-      value = ReadLittleEndian64(src);
-      src += sizeof(uint64_t);
-    }
+    internal::CopyReversingBytes64(src, dest.size(),
+                                   reinterpret_cast<char*>(dest.data()));
   }
 }
 
@@ -350,10 +412,8 @@ inline void ReadBigEndian16s(const char* src, absl::Span<uint16_t> dest) {
       std::memcpy(dest.data(), src, dest.size() * sizeof(uint16_t));
     }
   } else {
-    for (uint16_t& value : dest) {
-      value = ReadBigEndian16(src);
-      src += sizeof(uint16_t);
-    }
+    internal::CopyReversingBytes16(src, dest.size(),
+                                   reinterpret_cast<char*>(dest.data()));
   }
 }
 
@@ -366,10 +426,8 @@ inline void ReadBigEndian32s(const char* src, absl::Span<uint32_t> dest) {
       std::memcpy(dest.data(), src, dest.size() * sizeof(uint32_t));
     }
   } else {
-    for (uint32_t& value : dest) {
-      value = ReadBigEndian32(src);
-      src += sizeof(uint32_t);
-    }
+    internal::CopyReversingBytes32(src, dest.size(),
+                                   reinterpret_cast<char*>(dest.data()));
   }
 }
 
@@ -382,13 +440,59 @@ inline void ReadBigEndian64s(const char* src, absl::Span<uint64_t> dest) {
       std::memcpy(dest.data(), src, dest.size() * sizeof(uint64_t));
     }
   } else {
-    for (uint64_t& value : dest) {
-      value = ReadBigEndian64(src);
-      src += sizeof(uint64_t);
-    }
+    internal::CopyReversingBytes64(src, dest.size(),
+                                   reinterpret_cast<char*>(dest.data()));
   }
 }
 
+inline bool ReadLittleEndianFloats(Reader& src, absl::Span<float> dest) {
+  return internal::ReadValues<sizeof(float)>(
+      internal::IsLittleEndian(), src, dest.size(),
+      reinterpret_cast<char*>(dest.data()));
+}
+
+inline bool ReadLittleEndianDoubles(Reader& src, absl::Span<double> dest) {
+  return internal::ReadValues<sizeof(double)>(
+      internal::IsLittleEndian(), src, dest.size(),
+      reinterpret_cast<char*>(dest.data()));
+}
+
+inline bool ReadBigEndianFloats(Reader& src, absl::Span<float> dest) {
+  return internal::ReadValues<sizeof(float)>(
+      internal::IsBigEndian(), src, dest.size(),
+      reinterpret_cast<char*>(dest.data()));
+}
+
+inline bool ReadBigEndianDoubles(Reader& src, absl::Span<double> dest) {
+  return internal::ReadValues<sizeof(double)>(
+      internal::IsBigEndian(), src, dest.size(),
+      reinterpret_cast<char*>(dest.data()));
+}
+
+inline void ReadLittleEndianFloats(const char* src, absl::Span<float> dest) {
+  internal::ReadValues<sizeof(float)>(
+      internal::IsLittleEndian(), src, dest.size(),
+      reinterpret_cast<char*>(dest.data()));
+}
+
+inline void ReadLittleEndianDoubles(const char* src, absl::Span<double> dest) {
+  internal::ReadValues<sizeof(double)>(
+      internal::IsLittleEndian(), src, dest.size(),
+      reinterpret_cast<char*>(dest.data()));
+}
+
+inline void ReadBigEndianFloats(const char* src, absl::Span<float> dest) {
+  internal::ReadValues<sizeof(float)>(
+      internal::IsBigEndian(), src, dest.size(),
+      reinterpret_cast<char*>(dest.data()));
+}
+
+inline void ReadBigEndianDoubles(const char* src, absl::Span<double> dest) {
+  internal::ReadValues<sizeof(double)>(
+      internal::IsBigEndian(), src, dest.size(),
+      reinterpret_cast<char*>(dest.data()));
+}
+
 }  // namespace riegeli
 
 #endif  // RIEGELI_ENDIAN_ENDIAN_READING_H_
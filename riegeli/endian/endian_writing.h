@@ -15,12 +15,14 @@
 #ifndef RIEGELI_ENDIAN_ENDIAN_WRITING_H_
 #define RIEGELI_ENDIAN_ENDIAN_WRITING_H_
 
+#include <stddef.h>
 #include <stdint.h>
 
 #include <cstring>
 
 #include "absl/base/optimization.h"
 #include "absl/types/span.h"
+#include "riegeli/base/base.h"
 #include "riegeli/bytes/backward_writer.h"
 #include "riegeli/bytes/writer.h"
 #include "riegeli/endian/endian_internal.h"
@@ -47,7 +49,8 @@ bool WriteBigEndian64(uint64_t data, BackwardWriter& dest);
 
 // Writes an array of numbers in a fixed width Little/Big Endian encoding.
 //
-// This is faster than writing them individually for native endianness.
+// This is faster than writing them individually: for native endianness they
+// are written directly, otherwise bytes are reversed many values at a time.
 //
 // Return values:
 //  * `true`  - success (`dest.healthy()`)
@@ -59,6 +62,20 @@ bool WriteBigEndian16s(absl::Span<const uint16_t> data, Writer& dest);
 bool WriteBigEndian32s(absl::Span<const uint32_t> data, Writer& dest);
 bool WriteBigEndian64s(absl::Span<const uint64_t> data, Writer& dest);
 
+// Writes an array of floating point numbers (IEEE 754 binary32 or binary64) in
+// a fixed width Little/Big Endian encoding.
+//
+// This is faster than writing them individually: for native endianness they
+// are written directly, otherwise bytes are reversed many values at a time.
+//
+// Return values:
+//  * `true`  - success (`dest.healthy()`)
+//  * `false` - failure (`!dest.healthy()`)
+bool WriteLittleEndianFloats(absl::Span<const float> data, Writer& dest);
+bool WriteLittleEndianDoubles(absl::Span<const double> data, Writer& dest);
+bool WriteBigEndianFloats(absl::Span<const float> data, Writer& dest);
+bool WriteBigEndianDoubles(absl::Span<const double> data, Writer& dest);
+
 // Writes a number in a fixed width Little/Big Endian encoding to an array.
 //
 // Writes `sizeof(uint{16,32,64}_t)` bytes to `dest[]`.
@@ -72,7 +89,8 @@ void WriteBigEndian64(uint64_t data, char* dest);
 // Writes an array of numbers in a fixed width Little/Big Endian encoding to an
 // array.
 //
-// This is faster than writing them individually for native endianness.
+// This is faster than writing them individually: for native endianness they
+// are written directly, otherwise bytes are reversed many values at a time.
 //
 // Writes `data.size() * sizeof(uint{16,32,64}_t)` bytes to `dest[]`.
 void WriteLittleEndian16s(absl::Span<const uint16_t> data, char* dest);
@@ -82,8 +100,73 @@ void WriteBigEndian16s(absl::Span<const uint16_t> data, char* dest);
 void WriteBigEndian32s(absl::Span<const uint32_t> data, char* dest);
 void WriteBigEndian64s(absl::Span<const uint64_t> data, char* dest);
 
+// Writes an array of floating point numbers (IEEE 754 binary32 or binary64) in
+// a fixed width Little/Big Endian encoding to an array.
+//
+// Writes `data.size() * sizeof({float,double})` bytes to `dest[]`.
+void WriteLittleEndianFloats(absl::Span<const float> data, char* dest);
+void WriteLittleEndianDoubles(absl::Span<const double> data, char* dest);
+void WriteBigEndianFloats(absl::Span<const float> data, char* dest);
+void WriteBigEndianDoubles(absl::Span<const double> data, char* dest);
+
 // Implementation details follow.
 
+namespace internal {
+
+static_assert(sizeof(float) == sizeof(uint32_t),
+              "float is expected to be IEEE 754 binary32");
+static_assert(sizeof(double) == sizeof(uint64_t),
+              "double is expected to be IEEE 754 binary64");
+
+// Writes `num_values` values of `width` bytes from `src[]` to `dest`, reversing
+// the order of bytes in each value.
+//
+// Values are converted directly to the buffer of `dest`, as many at a time as
+// fit, rather than pushing each value separately.
+template <size_t width>
+inline bool WriteReversingBytes(const char* src, size_t num_values,
+                                Writer& dest) {
+  while (num_values > 0) {
+    if (ABSL_PREDICT_FALSE(!dest.Push(width, num_values * width))) {
+      return false;
+    }
+    const size_t length = UnsignedMin(dest.available() / width, num_values);
+    CopyReversingBytes<width>(src, length, dest.cursor());
+    dest.move_cursor(length * width);
+    src += length * width;
+    num_values -= length;
+  }
+  return true;
+}
+
+// Writes `num_values` values of `width` bytes in native endianness if `native`,
+// or in non-native endianness otherwise, from `src[]` to `dest[]`.
+template <size_t width>
+inline void WriteValues(bool native, const char* src, size_t num_values,
+                        char* dest) {
+  if (native) {
+    if (ABSL_PREDICT_TRUE(
+            // `std::memcpy(nullptr, _, 0)` and `std::memcpy(_, nullptr, 0)` are
+            // undefined.
+            num_values > 0)) {
+      std::memcpy(dest, src, num_values * width);
+    }
+  } else {
+    CopyReversingBytes<width>(src, num_values, dest);
+  }
+}
+
+// Writes `num_values` values of `width` bytes in native endianness if `native`,
+// or in non-native endianness otherwise, from `src[]` to `dest`.
+template <size_t width>
+inline bool WriteValues(bool native, const char* src, size_t num_values,
+                        Writer& dest) {
+  if (native) return dest.Write(src, num_values * width);
+  return WriteReversingBytes<width>(src, num_values, dest);
+}
+
+}  // namespace internal
+
 inline bool WriteLittleEndian16(uint16_t data, Writer& dest) {
   if (ABSL_PREDICT_FALSE(!dest.Push(sizeof(uint16_t)))) return false;
   WriteLittleEndian16(data, dest.cursor());
@@ -173,10 +256,8 @@ inline bool WriteLittleEndian16s(absl::Span<const uint16_t> data,
     return dest.Write(reinterpret_cast<const char*>(data.data()),
                       data.size() * sizeof(uint16_t));
   } else {
-    for (const uint16_t value : data) {
-      if (ABSL_PREDICT_FALSE(!WriteLittleEndian16(value, dest))) return false;
-    }
-    return true;
+    return internal::WriteReversingBytes<sizeof(uint16_t)>(
+        reinterpret_cast<const char*>(data.data()), data.size(), dest);
   }
 }
 
@@ -186,10 +267,8 @@ inline bool WriteLittleEndian32s(absl::Span<const uint32_t> data,
     return dest.Write(reinterpret_cast<const char*>(data.data()),
                       data.size() * sizeof(uint32_t));
   } else {
-    for (const uint32_t value : data) {
-      if (ABSL_PREDICT_FALSE(!WriteLittleEndian32(value, dest))) return false;
-    }
-    return true;
+    return internal::WriteReversingBytes<sizeof(uint32_t)>(
+        reinterpret_cast<const char*>(data.data()), data.size(), dest);
   }
 }
 
@@ -199,10 +278,8 @@ inline bool WriteLittleEndian64s(absl::Span<const uint64_t> data,
     return dest.Write(reinterpret_cast<const char*>(data.data()),
                       data.size() * sizeof(uint64_t));
   } else {
-    for (const uint64_t value : data) {
-      if (ABSL_PREDICT_FALSE(!WriteLittleEndian64(value, dest))) return false;
-    }
-    return true;
+    return internal::WriteReversingBytes<sizeof(uint64_t)>(
+        reinterpret_cast<const char*>(data.data()), data.size(), dest);
   }
 }
 
@@ -211,10 +288,8 @@ inline bool WriteBigEndian16s(absl::Span<const uint16_t> data, Writer& dest) {
     return dest.Write(reinterpret_cast<const char*>(data.data()),
                       data.size() * sizeof(uint16_t));
   } else {
-    for (const uint16_t value : data) {
-      if (ABSL_PREDICT_FALSE(!WriteBigEndian16(value, dest))) return false;
-    }
-    return true;
+    return internal::WriteReversingBytes<sizeof(uint16_t)>(
+        reinterpret_cast<const char*>(data.data()), data.size(), dest);
   }
 }
 
@@ -223,10 +298,8 @@ inline bool WriteBigEndian32s(absl::Span<const uint32_t> data, Writer& dest) {
     return dest.Write(reinterpret_cast<const char*>(data.data()),
                       data.size() * sizeof(uint32_t));
   } else {
-    for (const uint32_t value : data) {
-      if (ABSL_PREDICT_FALSE(!WriteBigEndian32(value, dest))) return false;
-    }
-    return true;
+    return internal::WriteReversingBytes<sizeof(uint32_t)>(
+        reinterpret_cast<const char*>(data.data()), data.size(), dest);
   }
 }
 
@@ -235,10 +308,8 @@ inline bool WriteBigEndian64s(absl::Span<const uint64_t> data, Writer& dest) {
     return dest.Write(reinterpret_cast<const char*>(data.data()),
                       data.size() * sizeof(uint64_t));
   } else {
-    for (const uint64_t value : data) {
-      if (ABSL_PREDICT_FALSE(!WriteBigEndian64(value, dest))) return false;
-    }
-    return true;
+    return internal::WriteReversingBytes<sizeof(uint64_t)>(
+        reinterpret_cast<const char*>(data.data()), data.size(), dest);
   }
 }
 
@@ -352,10 +423,8 @@ inline void WriteLittleEndian16s(absl::Span<const uint16_t> data, char* dest) {
       std::memcpy(dest, data.data(), data.size() * sizeof(uint16_t));
     }
   } else {
-    for (const uint16_t value : data) {
-      WriteLittleEndian16(value, dest);
-      dest += sizeof(uint16_t);
-    }
+    internal::CopyReversingBytes16(reinterpret_cast<const char*>(data.data()),
+                                   data.size(), dest);
   }
 }
 
@@ -368,10 +437,8 @@ inline void WriteLittleEndian32s(absl::Span<const uint32_t> data, char* dest) {
       std::memcpy(dest, data.data(), data.size() * sizeof(uint32_t));
     }
   } else {
-    for (const uint32_t value : data) {
-      WriteLittleEndian32(value, dest);
-      dest += sizeof(uint32_t);
-    }
+    internal::CopyReversingBytes32(reinterpret_cast<const char*>(data.data()),
+                                   data.size(), dest);
   }
 }
 
@@ -384,10 +451,8 @@ inline void WriteLittleEndian64s(absl::Span<const uint64_t> data, char* dest) {
       std::memcpy(dest, data.data(), data.size() * sizeof(uint64_t));
     }
   } else {
-    for (const uint64_t value : data) {
-      WriteLittleEndian64(value, dest);
-      dest += sizeof(uint64_t);
-    }
+    internal::CopyReversingBytes64(reinterpret_cast<const char*>(data.data()),
+                                   data.size(), dest);
   }
 }
 
@@ -400,10 +465,8 @@ inline void WriteBigEndian16s(absl::Span<const uint16_t> data, char* dest) {
       std::memcpy(dest, data.data(), data.size() * sizeof(uint16_t));
     }
   } else {
-    for (const uint16_t value : data) {
-      WriteBigEndian16(value, dest);
-      dest += sizeof(uint16_t);
-    }
+    internal::CopyReversingBytes16(reinterpret_cast<const char*>(data.data()),
+                                   data.size(), dest);
   }
 }
 
@@ -416,10 +479,8 @@ inline void WriteBigEndian32s(absl::Span<const uint32_t> data, char* dest) {
       std::memcpy(dest, data.data(), data.size() * sizeof(uint32_t));
     }
   } else {
-    for (const uint32_t value : data) {
-      WriteBigEndian32(value, dest);
-      dest += sizeof(uint32_t);
-    }
+    internal::CopyReversingBytes32(reinterpret_cast<const char*>(data.data()),
+                                   data.size(), dest);
   }
 }
 
@@ -432,13 +493,62 @@ inline void WriteBigEndian64s(absl::Span<const uint64_t> data, char* dest) {
       std::memcpy(dest, data.data(), data.size() * sizeof(uint64_t));
     }
   } else {
-    for (const uint64_t value : data) {
-      WriteBigEndian64(value, dest);
-      dest += sizeof(uint64_t);
-    }
+    internal::CopyReversingBytes64(reinterpret_cast<const char*>(data.data()),
+                                   data.size(), dest);
   }
 }
 
+inline bool WriteLittleEndianFloats(absl::Span<const float> data,
+                                    Writer& dest) {
+  return internal::WriteValues<sizeof(float)>(
+      internal::IsLittleEndian(), reinterpret_cast<const char*>(data.data()),
+      data.size(), dest);
+}
+
+inline bool WriteLittleEndianDoubles(absl::Span<const double> data,
+                                     Writer& dest) {
+  return internal::WriteValues<sizeof(double)>(
+      internal::IsLittleEndian(), reinterpret_cast<const char*>(data.data()),
+      data.size(), dest);
+}
+
+inline bool WriteBigEndianFloats(absl::Span<const float> data, Writer& dest) {
+  return internal::WriteValues<sizeof(float)>(
+      internal::IsBigEndian(), reinterpret_cast<const char*>(data.data()),
+      data.size(), dest);
+}
+
+inline bool WriteBigEndianDoubles(absl::Span<const double> data, Writer& dest) {
+  return internal::WriteValues<sizeof(double)>(
+      internal::IsBigEndian(), reinterpret_cast<const char*>(data.data()),
+      data.size(), dest);
+}
+
+inline void WriteLittleEndianFloats(absl::Span<const float> data, char* dest) {
+  internal::WriteValues<sizeof(float)>(
+      internal::IsLittleEndian(), reinterpret_cast<const char*>(data.data()),
+      data.size(), dest);
+}
+
+inline void WriteLittleEndianDoubles(absl::Span<const double> data,
+                                     char* dest) {
+  internal::WriteValues<sizeof(double)>(
+      internal::IsLittleEndian(), reinterpret_cast<const char*>(data.data()),
+      data.size(), dest);
+}
+
+inline void WriteBigEndianFloats(absl::Span<const float> data, char* dest) {
+  internal::WriteValues<sizeof(float)>(
+      internal::IsBigEndian(), reinterpret_cast<const char*>(data.data()),
+      data.size(), dest);
+}
+
+inline void WriteBigEndianDoubles(absl::Span<const double> data, char* dest) {
+  internal::WriteValues<sizeof(double)>(
+      internal::IsBigEndian(), reinterpret_cast<const char*>(data.data()),
+      data.size(), dest);
+}
+
 }  // namespace riegeli
 
 #endif  // RIEGELI_ENDIAN_ENDIAN_WRITING_H_
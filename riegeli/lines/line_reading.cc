@@ -15,12 +15,15 @@
 #include "riegeli/lines/line_reading.h"
 
 #include <stddef.h>
+#include <stdint.h>
 
 #include <cstring>
 #include <string>
+#include <vector>
 
 #include "absl/base/attributes.h"
 #include "absl/base/optimization.h"
+#include "absl/numeric/bits.h"
 #include "absl/status/status.h"
 #include "absl/strings/cord.h"
 #include "absl/strings/str_cat.h"
@@ -29,10 +32,74 @@
 #include "riegeli/base/chain.h"
 #include "riegeli/bytes/reader.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RIEGELI_INTERNAL_LINE_READING_SSE2 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define RIEGELI_INTERNAL_LINE_READING_NEON 1
+#endif
+
 namespace riegeli {
 
 namespace {
 
+// Returns a pointer to the first CR or LF in [`ptr`..`limit`), or `limit` if
+// there is none.
+//
+// This is like `std::memchr()` for two characters: with SSE2 or NEON, 16 bytes
+// are compared at a time.
+inline const char* FindCrOrLf(const char* ptr, const char* limit) {
+#if RIEGELI_INTERNAL_LINE_READING_SSE2
+  const __m128i lf = _mm_set1_epi8('\n');
+  const __m128i cr = _mm_set1_epi8('\r');
+  while (PtrDistance(ptr, limit) >= 16) {
+    const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+    const uint32_t matches = static_cast<uint32_t>(_mm_movemask_epi8(
+        _mm_or_si128(_mm_cmpeq_epi8(data, lf), _mm_cmpeq_epi8(data, cr))));
+    if (matches != 0) return ptr + absl::countr_zero(matches);
+    ptr += 16;
+  }
+#elif RIEGELI_INTERNAL_LINE_READING_NEON
+  const uint8x16_t lf = vdupq_n_u8('\n');
+  const uint8x16_t cr = vdupq_n_u8('\r');
+  while (PtrDistance(ptr, limit) >= 16) {
+    const uint8x16_t data = vld1q_u8(reinterpret_cast<const uint8_t*>(ptr));
+    const uint8x16_t matches =
+        vorrq_u8(vceqq_u8(data, lf), vceqq_u8(data, cr));
+    // Narrow each byte of `matches` to 4 bits.
+    const uint64_t nibbles = vget_lane_u64(
+        vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(matches), 4)), 0);
+    if (nibbles != 0) return ptr + absl::countr_zero(nibbles) / 4;
+    ptr += 16;
+  }
+#endif
+  while (ptr != limit && *ptr != '\n' && *ptr != '\r') ++ptr;
+  return ptr;
+}
+
+// Returns a pointer to the first character in [`ptr`..`limit`) which can end a
+// line, or `limit` if there is none.
+//
+// For `Newline::kCrLfOrLf` this is the LF, which might be preceded by a CR.
+inline const char* FindNewline(const char* ptr, const char* limit,
+                               ReadLineOptions::Newline newline) {
+  switch (newline) {
+    case ReadLineOptions::Newline::kLf:
+    case ReadLineOptions::Newline::kCrLfOrLf: {
+      if (ABSL_PREDICT_FALSE(ptr == limit)) return limit;
+      const char* const found = static_cast<const char*>(
+          std::memchr(ptr, '\n', PtrDistance(ptr, limit)));
+      return found == nullptr ? limit : found;
+    }
+    case ReadLineOptions::Newline::kAny:
+      return FindCrOrLf(ptr, limit);
+  }
+  RIEGELI_ASSERT_UNREACHABLE()
+      << "Unknown newline: " << static_cast<int>(newline);
+}
+
 // Reads `length_to_read` bytes from `src`, writes their prefix of
 // `length_to_write` bytes to `dest`, appending to existing contents
 // (unless `Dest` is `absl::string_view`).
@@ -115,23 +182,44 @@ inline bool ReadLineInternal(Reader& src, Dest& dest, ReadLineOptions options) {
         }
         goto continue_reading;
       }
-      case ReadLineOptions::Newline::kAny:
-        for (const char* newline = src.cursor(); newline < src.limit();
-             ++newline) {
-          if (ABSL_PREDICT_FALSE(*newline == '\n')) {
-            return FoundNewline(src, dest, options,
-                                PtrDistance(src.cursor(), newline), 1);
+      case ReadLineOptions::Newline::kCrLfOrLf: {
+        const char* const newline = static_cast<const char*>(
+            std::memchr(src.cursor(), '\n', src.available()));
+        if (ABSL_PREDICT_TRUE(newline != nullptr)) {
+          const size_t length = PtrDistance(src.cursor(), newline);
+          if (length > 0 && newline[-1] == '\r') {
+            return FoundNewline(src, dest, options, length - 1, 2);
+          }
+          return FoundNewline(src, dest, options, length, 1);
+        }
+        if (src.limit()[-1] == '\r') {
+          // The CR might begin CR LF. Keep it in the buffer until the next
+          // character is available.
+          const size_t length = src.available() - 1;
+          if (ABSL_PREDICT_FALSE(length > options.max_length())) {
+            return MaxLineLengthExceeded(src, dest, options.max_length());
           }
-          if (ABSL_PREDICT_FALSE(*newline == '\r')) {
-            const size_t length = PtrDistance(src.cursor(), newline);
-            return FoundNewline(src, dest, options, length,
-                                ABSL_PREDICT_TRUE(src.Pull(length + 2)) &&
-                                        src.cursor()[length + 1] == '\n'
-                                    ? size_t{2}
-                                    : size_t{1});
+          options.set_max_length(options.max_length() - length);
+          ReadFlat(src, length, dest);
+          if (ABSL_PREDICT_TRUE(src.Pull(2))) continue;
+        }
+        goto continue_reading;
+      }
+      case ReadLineOptions::Newline::kAny: {
+        const char* const newline = FindCrOrLf(src.cursor(), src.limit());
+        if (ABSL_PREDICT_TRUE(newline != src.limit())) {
+          const size_t length = PtrDistance(src.cursor(), newline);
+          if (*newline == '\n') {
+            return FoundNewline(src, dest, options, length, 1);
           }
+          return FoundNewline(src, dest, options, length,
+                              ABSL_PREDICT_TRUE(src.Pull(length + 2)) &&
+                                      src.cursor()[length + 1] == '\n'
+                                  ? size_t{2}
+                                  : size_t{1});
         }
         goto continue_reading;
+      }
     }
     RIEGELI_ASSERT_UNREACHABLE()
         << "Unknown newline: " << static_cast<int>(options.newline());
@@ -145,6 +233,40 @@ inline bool ReadLineInternal(Reader& src, Dest& dest, ReadLineOptions options) {
   return src.healthy();
 }
 
+// Finds a line which is complete in the buffer of `src`, beginning at
+// `src.cursor()`. Sets `length` to its length without the line terminator,
+// and `newline_length` to the length of the line terminator.
+//
+// Returns `false` if the buffer does not contain a complete line, or if it is
+// not known yet whether a CR at the end of the buffer is followed by LF.
+inline bool FindLineInBuffer(const Reader& src,
+                             ReadLineOptions::Newline newline_type,
+                             size_t& length, size_t& newline_length) {
+  const char* const newline =
+      FindNewline(src.cursor(), src.limit(), newline_type);
+  if (newline == src.limit()) return false;
+  length = PtrDistance(src.cursor(), newline);
+  newline_length = 1;
+  switch (newline_type) {
+    case ReadLineOptions::Newline::kLf:
+      return true;
+    case ReadLineOptions::Newline::kCrLfOrLf:
+      if (length > 0 && newline[-1] == '\r') {
+        --length;
+        newline_length = 2;
+      }
+      return true;
+    case ReadLineOptions::Newline::kAny:
+      if (*newline == '\r') {
+        if (ABSL_PREDICT_FALSE(newline + 1 == src.limit())) return false;
+        if (newline[1] == '\n') newline_length = 2;
+      }
+      return true;
+  }
+  RIEGELI_ASSERT_UNREACHABLE()
+      << "Unknown newline: " << static_cast<int>(newline_type);
+}
+
 }  // namespace
 
 bool ReadLine(Reader& src, absl::string_view& dest, ReadLineOptions options) {
@@ -165,23 +287,34 @@ bool ReadLine(Reader& src, absl::string_view& dest, ReadLineOptions options) {
         }
         goto continue_reading;
       }
-      case ReadLineOptions::Newline::kAny:
-        for (const char* newline = src.cursor() + length; newline < src.limit();
-             ++newline) {
-          if (ABSL_PREDICT_FALSE(*newline == '\n')) {
-            return FoundNewline(src, dest, options,
-                                PtrDistance(src.cursor(), newline), 1);
+      case ReadLineOptions::Newline::kCrLfOrLf: {
+        const char* const newline = static_cast<const char*>(
+            std::memchr(src.cursor() + length, '\n', src.available() - length));
+        if (ABSL_PREDICT_TRUE(newline != nullptr)) {
+          length = PtrDistance(src.cursor(), newline);
+          if (length > 0 && newline[-1] == '\r') {
+            return FoundNewline(src, dest, options, length - 1, 2);
           }
-          if (ABSL_PREDICT_FALSE(*newline == '\r')) {
-            length = PtrDistance(src.cursor(), newline);
-            return FoundNewline(src, dest, options, length,
-                                ABSL_PREDICT_TRUE(src.Pull(length + 2)) &&
-                                        src.cursor()[length + 1] == '\n'
-                                    ? size_t{2}
-                                    : size_t{1});
+          return FoundNewline(src, dest, options, length, 1);
+        }
+        goto continue_reading;
+      }
+      case ReadLineOptions::Newline::kAny: {
+        const char* const newline =
+            FindCrOrLf(src.cursor() + length, src.limit());
+        if (ABSL_PREDICT_TRUE(newline != src.limit())) {
+          length = PtrDistance(src.cursor(), newline);
+          if (*newline == '\n') {
+            return FoundNewline(src, dest, options, length, 1);
           }
+          return FoundNewline(src, dest, options, length,
+                              ABSL_PREDICT_TRUE(src.Pull(length + 2)) &&
+                                      src.cursor()[length + 1] == '\n'
+                                  ? size_t{2}
+                                  : size_t{1});
         }
         goto continue_reading;
+      }
     }
     RIEGELI_ASSERT_UNREACHABLE()
         << "Unknown newline: " << static_cast<int>(options.newline());
@@ -212,6 +345,31 @@ bool ReadLine(Reader& src, absl::Cord& dest, ReadLineOptions options) {
   return ReadLineInternal(src, dest, options);
 }
 
+bool ReadLines(Reader& src, std::vector<absl::string_view>& dest,
+               size_t max_lines, ReadLineOptions options) {
+  RIEGELI_ASSERT_GT(max_lines, 0u)
+      << "Failed precondition of ReadLines(): no lines requested";
+  dest.clear();
+  absl::string_view line;
+  if (ABSL_PREDICT_FALSE(!ReadLine(src, line, options))) {
+    if (!src.healthy()) dest.push_back(line);
+    return false;
+  }
+  dest.push_back(line);
+  size_t length;
+  size_t newline_length;
+  while (dest.size() < max_lines &&
+         FindLineInBuffer(src, options.newline(), length, newline_length)) {
+    const size_t length_with_newline = length + newline_length;
+    if (options.keep_newline()) length = length_with_newline;
+    // A line which is too long is left for the next `ReadLine()` to fail.
+    if (ABSL_PREDICT_FALSE(length > options.max_length())) break;
+    dest.emplace_back(src.cursor(), length);
+    src.move_cursor(length_with_newline);
+  }
+  return true;
+}
+
 void SkipBOM(Reader& src) {
   if (src.pos() != 0) return;
   src.Pull(3);
@@ -20,6 +20,7 @@
 #include <limits>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "absl/strings/cord.h"
 #include "absl/strings/string_view.h"
@@ -33,8 +34,9 @@ class ReadLineOptions {
  public:
   // Line terminator representations to recognize.
   enum class Newline {
-    kLf,   // LF ("\n")
-    kAny,  // LF | CR | CR LF ("\n" | "\r" | "\r\n")
+    kLf,        // LF ("\n")
+    kCrLfOrLf,  // LF | CR LF ("\n" | "\r\n")
+    kAny,       // LF | CR | CR LF ("\n" | "\r" | "\r\n")
   };
 
   ReadLineOptions() noexcept {}
@@ -111,6 +113,27 @@ bool ReadLine(Reader& src, Chain& dest,
 bool ReadLine(Reader& src, absl::Cord& dest,
               ReadLineOptions options = ReadLineOptions());
 
+// Reads up to `max_lines` lines, like a sequence of `ReadLine()` calls with
+// `absl::string_view`, appending them to `dest` after clearing it.
+//
+// The first line is read like by `ReadLine()`, pulling more data if needed.
+// Further lines are read only while they are complete in the buffer, so that
+// lines are returned in batches without pulling data in between. This makes
+// the cost of a call per line negligible for short lines.
+//
+// Lines are views of the buffer of `src`, valid until the next non-const
+// operation on `src`.
+//
+// Precondition: `max_lines > 0`
+//
+// Return values:
+//  * `true`                          - success (`!dest.empty()`)
+//  * `false` (when `src.healthy()`)  - source ends (`dest` is empty)
+//  * `false` (when `!src.healthy()`) - failure (`dest` contains the partial
+//                                               line read before the failure)
+bool ReadLines(Reader& src, std::vector<absl::string_view>& dest,
+               size_t max_lines, ReadLineOptions options = ReadLineOptions());
+
 // Skips an initial UTF-8 BOM if it is present.
 //
 // Does nothing unless `src.pos() == 0`.
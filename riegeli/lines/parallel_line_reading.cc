@@ -0,0 +1,179 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/lines/parallel_line_reading.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/base/optimization.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/optional.h"
+#include "absl/types/span.h"
+#include "riegeli/base/base.h"
+#include "riegeli/base/parallelism.h"
+#include "riegeli/bytes/reader.h"
+#include "riegeli/lines/line_reading.h"
+
+namespace riegeli {
+
+// Before C++17 if a constexpr static data member is ODR-used, its definition at
+// namespace scope is required. Since C++17 these definitions are deprecated:
+// http://en.cppreference.com/w/cpp/language/static
+#if __cplusplus < 201703
+constexpr int ParallelReadLinesOptions::kDefaultParallelism;
+constexpr Position ParallelReadLinesOptions::kDefaultRangeSize;
+#endif
+
+namespace {
+
+// State shared between `ReadLinesInParallel()` and its background tasks.
+struct SharedState {
+  explicit SharedState(size_t parallelism) : parallelism(parallelism) {}
+
+  // Returns `true` if another range can be scheduled, or if scheduling should
+  // stop because of a failure.
+  bool CanSchedule() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex) {
+    return num_running < parallelism || !status.ok();
+  }
+
+  const size_t parallelism;
+  absl::Mutex mutex;
+  size_t num_running ABSL_GUARDED_BY(mutex) = 0;
+  absl::Status status ABSL_GUARDED_BY(mutex);
+  // Asks background tasks to finish early.
+  std::atomic<bool> cancelled{false};
+};
+
+// Reads lines beginning in the range ending at `end` and passes them to
+// `process`.
+//
+// If `!at_line_start`, `src` starts one byte before the range, so that skipping
+// the line containing that byte skips exactly the part of a line which belongs
+// to the previous range, even if the line ends at the beginning of the range
+// or its CR LF straddles it.
+absl::Status ReadRange(
+    Reader& src, uint64_t range_index, bool at_line_start, Position end,
+    ReadLineOptions options,
+    const std::function<absl::Status(
+        uint64_t range_index, absl::Span<const absl::string_view> lines)>&
+        process,
+    const std::atomic<bool>& cancelled) {
+  if (!at_line_start) {
+    absl::string_view skipped;
+    if (ABSL_PREDICT_FALSE(!ReadLine(
+            src, skipped, ReadLineOptions().set_newline(options.newline())))) {
+      return src.status();
+    }
+  }
+  std::vector<absl::string_view> lines;
+  while (src.pos() < end && !cancelled.load(std::memory_order_relaxed)) {
+    if (ABSL_PREDICT_FALSE(!ReadLines(
+            src, lines, std::numeric_limits<size_t>::max(), options))) {
+      return src.status();
+    }
+    // Lines beginning at `end` or later belong to the next range. The first
+    // line begins before `end`.
+    size_t num_lines = 1;
+    while (num_lines < lines.size() &&
+           src.limit_pos() -
+                   PtrDistance(lines[num_lines].data(), src.limit()) <
+               end) {
+      ++num_lines;
+    }
+    absl::Status status =
+        process(range_index, absl::MakeConstSpan(lines.data(), num_lines));
+    if (ABSL_PREDICT_FALSE(!status.ok())) return status;
+    if (num_lines < lines.size()) break;
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace
+
+absl::Status ReadLinesInParallel(
+    Reader& src,
+    const std::function<absl::Status(uint64_t range_index,
+                                     absl::Span<const absl::string_view> lines)>&
+        process,
+    ParallelReadLinesOptions options) {
+  if (ABSL_PREDICT_FALSE(!src.healthy())) return src.status();
+  if (ABSL_PREDICT_FALSE(!src.SupportsNewReader())) {
+    return absl::UnimplementedError(
+        "ReadLinesInParallel() requires a source supporting NewReader()");
+  }
+  const Position data_begin = src.pos();
+  const absl::optional<Position> size = src.Size();
+  if (ABSL_PREDICT_FALSE(size == absl::nullopt)) return src.status();
+  const std::shared_ptr<SharedState> shared =
+      std::make_shared<SharedState>(IntCast<size_t>(options.parallelism()));
+  uint64_t range_index = 0;
+  for (Position begin = data_begin; begin < *size;
+       begin += UnsignedMin(options.range_size(), *size - begin)) {
+    {
+      absl::MutexLock lock(&shared->mutex);
+      shared->mutex.Await(
+          absl::Condition(shared.get(), &SharedState::CanSchedule));
+      if (ABSL_PREDICT_FALSE(!shared->status.ok())) break;
+    }
+    const bool at_line_start = begin == data_begin;
+    std::shared_ptr<Reader> range_src =
+        src.NewReader(at_line_start ? begin : begin - 1);
+    if (ABSL_PREDICT_FALSE(range_src == nullptr)) {
+      absl::MutexLock lock(&shared->mutex);
+      if (shared->status.ok()) shared->status = src.status();
+      break;
+    }
+    const Position end =
+        begin + UnsignedMin(options.range_size(), *size - begin);
+    {
+      absl::MutexLock lock(&shared->mutex);
+      ++shared->num_running;
+    }
+    internal::ThreadPool::global().Schedule(
+        [shared, range_src = std::move(range_src), range_index, at_line_start,
+         end, read_line_options = options.read_line_options(),
+         &process]() mutable {
+          absl::Status status =
+              ReadRange(*range_src, range_index, at_line_start, end,
+                        read_line_options, process, shared->cancelled);
+          // The source must not be accessed after `num_running` drops to 0.
+          range_src.reset();
+          absl::MutexLock lock(&shared->mutex);
+          if (ABSL_PREDICT_FALSE(!status.ok()) && shared->status.ok()) {
+            shared->status = std::move(status);
+            shared->cancelled.store(true, std::memory_order_relaxed);
+          }
+          --shared->num_running;
+        });
+    ++range_index;
+  }
+  absl::MutexLock lock(&shared->mutex);
+  shared->mutex.Await(absl::Condition(
+      +[](size_t* num_running) { return *num_running == 0; },
+      &shared->num_running));
+  return shared->status;
+}
+
+}  // namespace riegeli
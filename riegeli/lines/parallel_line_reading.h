@@ -0,0 +1,124 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_LINES_PARALLEL_LINE_READING_H_
+#define RIEGELI_LINES_PARALLEL_LINE_READING_H_
+
+#include <stdint.h>
+
+#include <functional>
+#include <utility>
+
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "riegeli/base/base.h"
+#include "riegeli/bytes/reader.h"
+#include "riegeli/lines/line_reading.h"
+
+namespace riegeli {
+
+// Options for `ReadLinesInParallel()`.
+class ParallelReadLinesOptions {
+ public:
+  ParallelReadLinesOptions() noexcept {}
+
+  // Options of reading lines, with the same meaning as for `ReadLine()`.
+  //
+  // Default: `ReadLineOptions()`.
+  ParallelReadLinesOptions& set_read_line_options(
+      ReadLineOptions read_line_options) & {
+    read_line_options_ = read_line_options;
+    return *this;
+  }
+  ParallelReadLinesOptions&& set_read_line_options(
+      ReadLineOptions read_line_options) && {
+    return std::move(set_read_line_options(read_line_options));
+  }
+  ReadLineOptions read_line_options() const { return read_line_options_; }
+
+  // Maximum number of ranges of the source being read at a time.
+  //
+  // `parallelism` must be at least 1.
+  // Default: 8.
+  static constexpr int kDefaultParallelism = 8;
+  ParallelReadLinesOptions& set_parallelism(int parallelism) & {
+    RIEGELI_ASSERT_GE(parallelism, 1)
+        << "Failed precondition of "
+           "ParallelReadLinesOptions::set_parallelism(): "
+           "parallelism out of range";
+    parallelism_ = parallelism;
+    return *this;
+  }
+  ParallelReadLinesOptions&& set_parallelism(int parallelism) && {
+    return std::move(set_parallelism(parallelism));
+  }
+  int parallelism() const { return parallelism_; }
+
+  // Size of a range of the source read by one background task, in bytes.
+  //
+  // Lines are assigned to the range containing their beginning. A line can
+  // extend beyond its range.
+  //
+  // `range_size` must be at least 1.
+  // Default: 4M.
+  static constexpr Position kDefaultRangeSize = Position{4} << 20;
+  ParallelReadLinesOptions& set_range_size(Position range_size) & {
+    RIEGELI_ASSERT_GT(range_size, 0u)
+        << "Failed precondition of "
+           "ParallelReadLinesOptions::set_range_size(): "
+           "zero range size";
+    range_size_ = range_size;
+    return *this;
+  }
+  ParallelReadLinesOptions&& set_range_size(Position range_size) && {
+    return std::move(set_range_size(range_size));
+  }
+  Position range_size() const { return range_size_; }
+
+ private:
+  ReadLineOptions read_line_options_;
+  int parallelism_ = kDefaultParallelism;
+  Position range_size_ = kDefaultRangeSize;
+};
+
+// Reads lines of `src` from its current position to its end, splitting the
+// source into ranges read in parallel by background threads, and passes them
+// to `process`.
+//
+// This is useful for processing large files where each line is independent,
+// e.g. logs.
+//
+// `process` is called with consecutive batches of lines from one range, and
+// the index of the range: ranges are numbered from 0 in the order of the
+// source. Batches of a range are passed in their order from a single thread,
+// but batches of different ranges are passed concurrently, so `process` must
+// be thread-safe. Lines are valid only during the call. If `process` returns
+// an error, reading is cancelled and the error is returned.
+//
+// `src` must support `NewReader()`. `src` itself is not read, and its position
+// is unchanged.
+//
+// Returns the first error of `process` or reading a range, or
+// `absl::OkStatus()` on success.
+absl::Status ReadLinesInParallel(
+    Reader& src,
+    const std::function<absl::Status(uint64_t range_index,
+                                     absl::Span<const absl::string_view> lines)>&
+        process,
+    ParallelReadLinesOptions options = ParallelReadLinesOptions());
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_LINES_PARALLEL_LINE_READING_H_
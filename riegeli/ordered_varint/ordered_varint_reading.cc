@@ -14,14 +14,158 @@
 
 #include "riegeli/ordered_varint/ordered_varint_reading.h"
 
+#include <stddef.h>
 #include <stdint.h>
 
+#include <limits>
+
 #include "absl/base/optimization.h"
+#include "absl/numeric/bits.h"
+#include "absl/types/optional.h"
+#include "absl/types/span.h"
 #include "riegeli/base/base.h"
 #include "riegeli/bytes/reader.h"
 #include "riegeli/endian/endian_reading.h"
+#include "riegeli/ordered_varint/ordered_varint_internal.h"
 
 namespace riegeli {
+
+namespace {
+
+// Returns the length of an ordered varint from its first byte.
+inline size_t LengthFromFirstByte(uint8_t first_byte) {
+  return IntCast<size_t>(absl::countl_one(first_byte)) + 1;
+}
+
+// Returns the smallest value which is canonically encoded as an ordered varint
+// of the given length.
+inline uint64_t MinValueOfLength(size_t length) {
+  // For `length == 1` this is 0, otherwise `uint64_t{1} << ((length - 1) * 7)`.
+  return (uint64_t{1} << ((length - 1) * 7)) & ~uint64_t{1};
+}
+
+inline bool ReadOrderedVarint(Reader& src, uint32_t& dest) {
+  return ReadOrderedVarint32(src, dest);
+}
+inline bool ReadOrderedVarint(Reader& src, uint64_t& dest) {
+  return ReadOrderedVarint64(src, dest);
+}
+
+template <typename T>
+inline absl::optional<const char*> ReadOrderedVarint(const char* src,
+                                                     const char* limit,
+                                                     T& dest) {
+  constexpr size_t kMaxLength = sizeof(T) == 4 ? kMaxLengthOrderedVarint32
+                                               : kMaxLengthOrderedVarint64;
+  if (ABSL_PREDICT_FALSE(src == limit)) return absl::nullopt;
+  const uint8_t first_byte = static_cast<uint8_t>(*src);
+  const size_t length = LengthFromFirstByte(first_byte);
+  if (ABSL_PREDICT_FALSE(length > kMaxLength ||
+                         length > PtrDistance(src, limit))) {
+    return absl::nullopt;
+  }
+  uint64_t value = first_byte & (0xff >> length);
+  for (size_t i = 1; i < length; ++i) {
+    value = (value << 8) | static_cast<uint8_t>(src[i]);
+  }
+  if (ABSL_PREDICT_FALSE(value < MinValueOfLength(length) ||
+                         value > std::numeric_limits<T>::max())) {
+    return absl::nullopt;
+  }
+  dest = static_cast<T>(value);
+  return src + length;
+}
+
+// Reads ordered varints from `src` to `dest` while at least 8 bytes are
+// available, updating `src` and `dest`.
+//
+// Stops early at an ordered varint which is not decoded by the fast path: one
+// of 9 bytes, or an invalid one.
+template <typename T>
+inline void ReadOrderedVarintsFast(const char*& src, const char* limit,
+                                   T*& dest, T* dest_end) {
+  constexpr size_t kMaxLength = sizeof(T) == 4 ? kMaxLengthOrderedVarint32 : 8;
+  while (dest != dest_end && PtrDistance(src, limit) >= 8) {
+    const uint64_t data = ReadBigEndian64(src);
+    if ((data & uint64_t{0x8080808080808080}) == 0 &&
+        PtrDistance(dest, dest_end) >= 8) {
+      // A common case of small values: 8 ordered varints take 1 byte each.
+      for (size_t i = 0; i < 8; ++i) {
+        dest[i] = static_cast<T>(static_cast<uint8_t>(src[i]));
+      }
+      src += 8;
+      dest += 8;
+      continue;
+    }
+    // The length prefix is at the highest bits of `data`. If the first byte is
+    // 0xff, `length` is at least 9, even if `data` has more leading ones.
+    const size_t length = IntCast<size_t>(absl::countl_zero(~data | 1)) + 1;
+    if (ABSL_PREDICT_FALSE(length > kMaxLength)) return;
+    // Take the highest `length` bytes of `data`, and remove the length prefix,
+    // leaving the lowest `length * 7` bits.
+    const uint64_t value =
+        (data >> (64 - length * 8)) & ~(~uint64_t{0} << (length * 7));
+    if (ABSL_PREDICT_FALSE(value < MinValueOfLength(length) ||
+                           value > std::numeric_limits<T>::max())) {
+      return;
+    }
+    *dest++ = static_cast<T>(value);
+    src += length;
+  }
+}
+
+template <typename T>
+inline absl::optional<const char*> ReadOrderedVarintsImpl(
+    const char* src, const char* limit, absl::Span<T> dest) {
+  T* iter = dest.data();
+  T* const end = dest.data() + dest.size();
+  for (;;) {
+    ReadOrderedVarintsFast(src, limit, iter, end);
+    if (iter == end) return src;
+    const absl::optional<const char*> cursor =
+        ReadOrderedVarint(src, limit, *iter);
+    if (ABSL_PREDICT_FALSE(cursor == absl::nullopt)) return absl::nullopt;
+    src = *cursor;
+    ++iter;
+  }
+}
+
+template <typename T>
+inline bool ReadOrderedVarintsImpl(Reader& src, absl::Span<T> dest) {
+  T* iter = dest.data();
+  T* const end = dest.data() + dest.size();
+  for (;;) {
+    const char* cursor = src.cursor();
+    ReadOrderedVarintsFast(cursor, src.limit(), iter, end);
+    src.set_cursor(cursor);
+    if (iter == end) return true;
+    if (ABSL_PREDICT_FALSE(!ReadOrderedVarint(src, *iter))) return false;
+    ++iter;
+  }
+}
+
+}  // namespace
+
+bool ReadOrderedVarints32(Reader& src, absl::Span<uint32_t> dest) {
+  return ReadOrderedVarintsImpl(src, dest);
+}
+
+bool ReadOrderedVarints64(Reader& src, absl::Span<uint64_t> dest) {
+  return ReadOrderedVarintsImpl(src, dest);
+}
+
+absl::optional<const char*> ReadOrderedVarints32(const char* src,
+                                                 const char* limit,
+                                                 absl::Span<uint32_t> dest) {
+  return ReadOrderedVarintsImpl(src, limit, dest);
+}
+
+absl::optional<const char*> ReadOrderedVarints64(const char* src,
+                                                 const char* limit,
+                                                 absl::Span<uint64_t> dest) {
+  return ReadOrderedVarintsImpl(src, limit, dest);
+}
+
 namespace internal {
 
 bool ReadOrderedVarint32Slow(Reader& src, uint32_t& dest) {
@@ -18,6 +18,8 @@
 #include <stdint.h>
 
 #include "absl/base/optimization.h"
+#include "absl/types/optional.h"
+#include "absl/types/span.h"
 #include "riegeli/bytes/reader.h"
 #include "riegeli/ordered_varint/ordered_varint_internal.h"
 
@@ -54,6 +56,37 @@ namespace riegeli {
 bool ReadOrderedVarint32(Reader& src, uint32_t& dest);
 bool ReadOrderedVarint64(Reader& src, uint64_t& dest);
 
+// Reads an array of ordered varints, filling `dest`.
+//
+// This is faster than reading them individually: the length of each value is
+// computed from its first byte without branching, and a value shorter than 9
+// bytes is extracted from a single 8-byte load.
+//
+// Return values:
+//  * `true`                          - success (`dest` is filled)
+//  * `false` (when `src.healthy()`)  - source ends
+//                                      (`src` position is at the ordered
+//                                      varint which could not be read,
+//                                      `dest` is undefined)
+//  * `false` (when `!src.healthy()`) - failure
+//                                      (`src` position is at the ordered
+//                                      varint which could not be read,
+//                                      `dest` is undefined)
+bool ReadOrderedVarints32(Reader& src, absl::Span<uint32_t> dest);
+bool ReadOrderedVarints64(Reader& src, absl::Span<uint64_t> dest);
+
+// Reads an array of ordered varints from an array, filling `dest`.
+//
+// Return values:
+//  * updated `src`   - success (`dest` is filled)
+//  * `absl::nullopt` - source ends (`dest` is undefined)
+absl::optional<const char*> ReadOrderedVarints32(const char* src,
+                                                 const char* limit,
+                                                 absl::Span<uint32_t> dest);
+absl::optional<const char*> ReadOrderedVarints64(const char* src,
+                                                 const char* limit,
+                                                 absl::Span<uint64_t> dest);
+
 // Implementation details follow.
 
 namespace internal {
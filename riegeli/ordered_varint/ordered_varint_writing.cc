@@ -14,14 +14,116 @@
 
 #include "riegeli/ordered_varint/ordered_varint_writing.h"
 
+#include <stddef.h>
 #include <stdint.h>
 
 #include "absl/base/optimization.h"
+#include "absl/types/span.h"
 #include "riegeli/base/base.h"
 #include "riegeli/bytes/writer.h"
 #include "riegeli/endian/endian_writing.h"
+#include "riegeli/ordered_varint/ordered_varint_internal.h"
 
 namespace riegeli {
+
+namespace {
+
+// Number of values written by one `Push()` in `WriteOrderedVarintsImpl()`.
+constexpr size_t kValuesPerPush = 256;
+
+// Writes an ordered varint of `data` to `dest`, possibly also writing zeros to
+// up to 8 bytes after `dest` in total.
+//
+// Returns the updated `dest` after the ordered varint.
+inline char* WriteOrderedVarintUnsafe(uint64_t data, char* dest) {
+  if (ABSL_PREDICT_FALSE(data >= uint64_t{1} << (8 * 7))) {
+    dest[0] = static_cast<char>(0xff);
+    WriteBigEndian64(data, dest + 1);
+    return dest + 9;
+  }
+  // An ordered varint of length N < 9 consists of N - 1 one bits, a zero bit,
+  // and `data` in the remaining bits, in big endian. It is stored as the
+  // highest N bytes of 8 bytes.
+  const size_t length = LengthOrderedVarint64(data);
+  WriteBigEndian64(
+      (data << (64 - length * 8)) | ~(~uint64_t{0} >> (length - 1)), dest);
+  return dest + length;
+}
+
+template <typename T>
+inline char* WriteOrderedVarintsImpl(absl::Span<const T> data, char* dest) {
+  const T* iter = data.data();
+  const T* const end = data.data() + data.size();
+  // Values are processed in blocks of 8 while at least 16 values remain.
+  //
+  // `WriteOrderedVarintUnsafe()` can write up to 7 bytes after the ordered
+  // varint. They are overwritten by the following ordered varints, each of
+  // which takes at least 1 byte.
+  while (PtrDistance(iter, end) >= 16) {
+    T all_bits = 0;
+    for (size_t i = 0; i < 8; ++i) all_bits |= iter[i];
+    if (all_bits < 0x80) {
+      // A common case of small values: all ordered varints take 1 byte.
+      for (size_t i = 0; i < 8; ++i) dest[i] = static_cast<char>(iter[i]);
+      dest += 8;
+    } else {
+      for (size_t i = 0; i < 8; ++i) {
+        dest = WriteOrderedVarintUnsafe(iter[i], dest);
+      }
+    }
+    iter += 8;
+  }
+  while (PtrDistance(iter, end) >= 8) {
+    dest = WriteOrderedVarintUnsafe(*iter++, dest);
+  }
+  // Write the remaining values without writing after them.
+  while (iter != end) {
+    const uint64_t value = *iter++;
+    const size_t length = LengthOrderedVarint64(value);
+    const uint64_t encoded =
+        length == 9 ? value
+                    : value | (~(~uint64_t{0} >> (length - 1)) >>
+                               (64 - length * 8));
+    if (length == 9) *dest++ = static_cast<char>(0xff);
+    for (size_t i = UnsignedMin(length, size_t{8}); i > 0; --i) {
+      *dest++ = static_cast<char>(encoded >> ((i - 1) * 8));
+    }
+  }
+  return dest;
+}
+
+template <typename T>
+inline bool WriteOrderedVarintsImpl(absl::Span<const T> data, Writer& dest) {
+  constexpr size_t kMaxLength = sizeof(T) == 4 ? kMaxLengthOrderedVarint32
+                                               : kMaxLengthOrderedVarint64;
+  while (!data.empty()) {
+    const size_t length = UnsignedMin(data.size(), kValuesPerPush);
+    if (ABSL_PREDICT_FALSE(!dest.Push(length * kMaxLength))) return false;
+    dest.set_cursor(
+        WriteOrderedVarintsImpl(data.subspan(0, length), dest.cursor()));
+    data.remove_prefix(length);
+  }
+  return true;
+}
+
+}  // namespace
+
+bool WriteOrderedVarints32(absl::Span<const uint32_t> data, Writer& dest) {
+  return WriteOrderedVarintsImpl(data, dest);
+}
+
+bool WriteOrderedVarints64(absl::Span<const uint64_t> data, Writer& dest) {
+  return WriteOrderedVarintsImpl(data, dest);
+}
+
+char* WriteOrderedVarints32(absl::Span<const uint32_t> data, char* dest) {
+  return WriteOrderedVarintsImpl(data, dest);
+}
+
+char* WriteOrderedVarints64(absl::Span<const uint64_t> data, char* dest) {
+  return WriteOrderedVarintsImpl(data, dest);
+}
+
 namespace internal {
 
 bool WriteOrderedVarint32Slow(uint32_t data, Writer& dest) {
@@ -19,6 +19,7 @@
 #include <stdint.h>
 
 #include "absl/base/optimization.h"
+#include "absl/types/span.h"
 #include "riegeli/base/base.h"
 #include "riegeli/base/port.h"
 #include "riegeli/bytes/writer.h"
@@ -54,6 +55,27 @@ namespace riegeli {
 bool WriteOrderedVarint32(uint32_t data, Writer& dest);
 bool WriteOrderedVarint64(uint64_t data, Writer& dest);
 
+// Writes an array of ordered varints.
+//
+// This is faster than writing them individually: lengths are computed without
+// branching, and each value shorter than 9 bytes is stored with a single 8-byte
+// store.
+//
+// Return values:
+//  * `true`  - success (`dest.healthy()`)
+//  * `false` - failure (`!dest.healthy()`)
+bool WriteOrderedVarints32(absl::Span<const uint32_t> data, Writer& dest);
+bool WriteOrderedVarints64(absl::Span<const uint64_t> data, Writer& dest);
+
+// Writes an array of ordered varints to an array.
+//
+// Writes the sum of `LengthOrderedVarint{32,64}()` of values in `data` to
+// `dest[]`.
+//
+// Returns the updated `dest` after the written values.
+char* WriteOrderedVarints32(absl::Span<const uint32_t> data, char* dest);
+char* WriteOrderedVarints64(absl::Span<const uint64_t> data, char* dest);
+
 // Returns the length needed to write a given value as an ordered varint, which
 // is at most `kMaxLengthOrderedVarint{32,64}`.
 size_t LengthOrderedVarint32(uint32_t data);
@@ -0,0 +1,193 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/flags/usage.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "riegeli/base/base.h"
+#include "riegeli/bytes/string_reader.h"
+#include "riegeli/bytes/string_writer.h"
+#include "riegeli/ordered_varint/ordered_varint_reading.h"
+#include "riegeli/ordered_varint/ordered_varint_writing.h"
+
+ABSL_FLAG(uint64_t, num_values, 1000 * 1000,
+          "Number of values encoded and decoded by each benchmark");
+ABSL_FLAG(int32_t, repetitions, 5, "Number of times to repeat each benchmark");
+
+namespace {
+
+uint64_t CpuTimeNow_ns() {
+  struct timespec time_info;
+  RIEGELI_CHECK_EQ(clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time_info), 0);
+  return riegeli::IntCast<uint64_t>(time_info.tv_sec) * uint64_t{1000000000} +
+         riegeli::IntCast<uint64_t>(time_info.tv_nsec);
+}
+
+class Stats {
+ public:
+  void Add(double value);
+
+  double Median();
+
+ private:
+  std::vector<double> samples_;
+};
+
+void Stats::Add(double value) { samples_.push_back(value); }
+
+double Stats::Median() {
+  RIEGELI_CHECK(!samples_.empty()) << "No data";
+  const size_t middle = samples_.size() / 2;
+  std::nth_element(samples_.begin(),
+                   samples_.begin() + riegeli::IntCast<ptrdiff_t>(middle),
+                   samples_.end());
+  return samples_[middle];
+}
+
+// Generates values with bit widths uniformly distributed in
+// [`min_bits`..`max_bits`].
+std::vector<uint64_t> GenerateValues(size_t num_values, int min_bits,
+                                     int max_bits) {
+  std::mt19937_64 random;
+  std::uniform_int_distribution<int> bits_distribution(min_bits, max_bits);
+  std::vector<uint64_t> values(num_values);
+  for (uint64_t& value : values) {
+    const int bits = bits_distribution(random);
+    value = bits == 0 ? 0 : random() >> (64 - bits);
+  }
+  return values;
+}
+
+void EncodeOneByOne(absl::Span<const uint64_t> values, std::string& encoded) {
+  encoded.clear();
+  riegeli::StringWriter<> writer(&encoded);
+  for (const uint64_t value : values) {
+    RIEGELI_CHECK(riegeli::WriteOrderedVarint64(value, writer))
+        << writer.status();
+  }
+  RIEGELI_CHECK(writer.Close()) << writer.status();
+}
+
+void EncodeBatch(absl::Span<const uint64_t> values, std::string& encoded) {
+  encoded.clear();
+  riegeli::StringWriter<> writer(&encoded);
+  RIEGELI_CHECK(riegeli::WriteOrderedVarints64(values, writer))
+      << writer.status();
+  RIEGELI_CHECK(writer.Close()) << writer.status();
+}
+
+void DecodeOneByOne(absl::string_view encoded, absl::Span<uint64_t> values) {
+  riegeli::StringReader<> reader(encoded);
+  for (uint64_t& value : values) {
+    RIEGELI_CHECK(riegeli::ReadOrderedVarint64(reader, value))
+        << reader.status();
+  }
+  RIEGELI_CHECK(reader.VerifyEndAndClose()) << reader.status();
+}
+
+void DecodeBatch(absl::string_view encoded, absl::Span<uint64_t> values) {
+  riegeli::StringReader<> reader(encoded);
+  RIEGELI_CHECK(riegeli::ReadOrderedVarints64(reader, values))
+      << reader.status();
+  RIEGELI_CHECK(reader.VerifyEndAndClose()) << reader.status();
+}
+
+// Returns the median time of `function` in nanoseconds per value.
+template <typename Function>
+double Measure(size_t num_values, int repetitions, Function function) {
+  Stats stats;
+  for (int i = 0; i < repetitions + 1; ++i) {
+    const uint64_t time_before_ns = CpuTimeNow_ns();
+    function();
+    const uint64_t time_after_ns = CpuTimeNow_ns();
+    // The first iteration is a warm-up.
+    if (i > 0) {
+      stats.Add(static_cast<double>(time_after_ns - time_before_ns) /
+                static_cast<double>(num_values));
+    }
+  }
+  return stats.Median();
+}
+
+void RunOne(absl::string_view name, int min_bits, int max_bits,
+            size_t num_values, int repetitions, std::ostream& report) {
+  const std::vector<uint64_t> values =
+      GenerateValues(num_values, min_bits, max_bits);
+  std::string encoded;
+  EncodeOneByOne(values, encoded);
+  std::string batch_encoded;
+  EncodeBatch(values, batch_encoded);
+  RIEGELI_CHECK(batch_encoded == encoded)
+      << "Batch encoding differs from encoding one by one";
+  std::vector<uint64_t> decoded(num_values);
+  DecodeBatch(encoded, absl::MakeSpan(decoded));
+  RIEGELI_CHECK(decoded == values)
+      << "Batch decoding differs from the original values";
+
+  const double encode_one_by_one = Measure(num_values, repetitions, [&] {
+    EncodeOneByOne(values, encoded);
+  });
+  const double encode_batch = Measure(
+      num_values, repetitions, [&] { EncodeBatch(values, batch_encoded); });
+  const double decode_one_by_one = Measure(num_values, repetitions, [&] {
+    DecodeOneByOne(encoded, absl::MakeSpan(decoded));
+  });
+  const double decode_batch = Measure(num_values, repetitions, [&] {
+    DecodeBatch(encoded, absl::MakeSpan(decoded));
+  });
+  absl::Format(&report, "%-10s %5.2f %5.2f  %5.2f %5.2f  %5.2f\n", name,
+               static_cast<double>(encoded.size()) /
+                   static_cast<double>(num_values),
+               encode_one_by_one, encode_batch, decode_one_by_one,
+               decode_batch);
+}
+
+const char kUsage[] =
+    "Usage: ordered_varint_benchmark (OPTION)...\n"
+    "\n"
+    "Measures encoding and decoding speed of ordered varints one by one and in "
+    "batches.\n";
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  absl::SetProgramUsageMessage(kUsage);
+  absl::ParseCommandLine(argc, argv);
+  const size_t num_values =
+      riegeli::SaturatingIntCast<size_t>(absl::GetFlag(FLAGS_num_values));
+  const int repetitions = absl::GetFlag(FLAGS_repetitions);
+  absl::Format(&std::cout,
+               "            Bytes    Encode       Decode\n"
+               "Bits       /value  Single Batch Single Batch\n"
+               "                   ns/value     ns/value\n");
+  absl::Format(&std::cout, "%s\n", std::string(48, '-'));
+  RunOne("0-7", 0, 7, num_values, repetitions, std::cout);
+  RunOne("8-14", 8, 14, num_values, repetitions, std::cout);
+  RunOne("0-21", 0, 21, num_values, repetitions, std::cout);
+  RunOne("22-35", 22, 35, num_values, repetitions, std::cout);
+  RunOne("0-64", 0, 64, num_values, repetitions, std::cout);
+}
@@ -0,0 +1,60 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/records/chunk_cache.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/strings/string_view.h"
+#include "riegeli/base/base.h"
+
+namespace riegeli {
+
+// Before C++17 if a constexpr static data member is ODR-used, its definition at
+// namespace scope is required. Since C++17 these definitions are deprecated:
+// http://en.cppreference.com/w/cpp/language/static
+#if __cplusplus < 201703
+constexpr size_t ChunkCache::Options::kDefaultMaxSize;
+constexpr size_t ChunkCache::Options::kDefaultNumShards;
+#endif
+
+ChunkCache::ChunkCache(Options options)
+    : cache_(options.max_size(), options.num_shards()) {}
+
+std::shared_ptr<const ChunkCache::CachedChunk> ChunkCache::Find(
+    absl::string_view file_id, Position chunk_begin) {
+  std::shared_ptr<const CachedChunk> chunk;
+  cache_.Find(KeyView(file_id, chunk_begin), chunk);
+  return chunk;
+}
+
+std::shared_ptr<const ChunkCache::CachedChunk> ChunkCache::Insert(
+    absl::string_view file_id, Position chunk_begin,
+    std::shared_ptr<const CachedChunk> chunk) {
+  const size_t memory = sizeof(CachedChunk) + file_id.size() +
+                        chunk->decoded.limits.capacity() * sizeof(size_t) +
+                        chunk->decoded.values.EstimateMemory();
+  // TODO: When `absl::string_view` becomes C++17 `std::string_view`:
+  // `Key(file_id, chunk_begin)`
+  return cache_.Insert(
+      Key(std::string(file_id.data(), file_id.size()), chunk_begin),
+      std::move(chunk), memory);
+}
+
+}  // namespace riegeli
@@ -0,0 +1,155 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_RECORDS_CHUNK_CACHE_H_
+#define RIEGELI_RECORDS_CHUNK_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/hash/hash.h"
+#include "absl/strings/string_view.h"
+#include "riegeli/base/base.h"
+#include "riegeli/base/sharded_lru_cache.h"
+#include "riegeli/chunk_encoding/chunk_decoder.h"
+
+namespace riegeli {
+
+// `ChunkCache` keeps recently decoded chunks of Riegeli/records files in
+// memory, so that `RecordReader`s seeking to the same chunks, possibly in
+// different threads, read and decode each chunk once.
+//
+// Chunks are identified by a file identifier chosen by the user, e.g. the
+// filename, and by the chunk position. Decoded records are shared between the
+// cache and the readers, and they stay valid after being evicted from the
+// cache for as long as they are used.
+//
+// The cache is split into shards with separate locks, and each shard evicts
+// least recently used chunks when the memory used by its chunks exceeds its
+// part of the memory budget.
+//
+// A `ChunkCache` is attached to a `RecordReader` by
+// `RecordReaderBase::Options::set_chunk_cache()`.
+//
+// `ChunkCache` is thread-safe.
+class ChunkCache {
+ public:
+  class Options {
+   public:
+    Options() noexcept {}
+
+    // Maximum amount of memory used by cached chunks. The limit is applied to
+    // each shard separately, with an equal part of the budget.
+    //
+    // Default: `kDefaultMaxSize` (256M).
+    static constexpr size_t kDefaultMaxSize = size_t{256} << 20;
+    Options& set_max_size(size_t max_size) & {
+      max_size_ = max_size;
+      return *this;
+    }
+    Options&& set_max_size(size_t max_size) && {
+      return std::move(set_max_size(max_size));
+    }
+    size_t max_size() const { return max_size_; }
+
+    // Number of independently locked shards. More shards reduce contention
+    // between threads, but make the eviction order less accurate.
+    //
+    // Default: `kDefaultNumShards` (16).
+    static constexpr size_t kDefaultNumShards = 16;
+    Options& set_num_shards(size_t num_shards) & {
+      RIEGELI_ASSERT_GT(num_shards, 0u)
+          << "Failed precondition of ChunkCache::Options::set_num_shards(): "
+             "zero number of shards";
+      num_shards_ = num_shards;
+      return *this;
+    }
+    Options&& set_num_shards(size_t num_shards) && {
+      return std::move(set_num_shards(num_shards));
+    }
+    size_t num_shards() const { return num_shards_; }
+
+   private:
+    size_t max_size_ = kDefaultMaxSize;
+    size_t num_shards_ = kDefaultNumShards;
+  };
+
+  // A chunk stored in the cache.
+  struct CachedChunk {
+    // Position after the chunk, where the next chunk begins.
+    Position chunk_end;
+    // Records of the chunk, decoded with all fields included.
+    ChunkDecoder::Decoded decoded;
+  };
+
+  explicit ChunkCache(Options options = Options());
+
+  ChunkCache(const ChunkCache&) = delete;
+  ChunkCache& operator=(const ChunkCache&) = delete;
+
+  // Looks up the chunk of the file `file_id` beginning at position
+  // `chunk_begin`.
+  //
+  // Returns `nullptr` if it is not cached.
+  std::shared_ptr<const CachedChunk> Find(absl::string_view file_id,
+                                          Position chunk_begin);
+
+  // Inserts the chunk of the file `file_id` beginning at position
+  // `chunk_begin`, unless it is already cached, e.g. because it was decoded
+  // concurrently by another thread.
+  //
+  // Returns the cached chunk, which is `chunk` unless it was already cached.
+  std::shared_ptr<const CachedChunk> Insert(
+      absl::string_view file_id, Position chunk_begin,
+      std::shared_ptr<const CachedChunk> chunk);
+
+  // Removes all chunks from the cache. Chunks which are still used elsewhere
+  // remain valid.
+  void Clear() { cache_.Clear(); }
+
+  // Returns the amount of memory used by cached chunks.
+  size_t size() const { return cache_.size(); }
+
+  // Returns the number of calls to `Find()` which found and did not find the
+  // chunk, for performance tuning.
+  uint64_t num_hits() const { return cache_.num_hits(); }
+  uint64_t num_misses() const { return cache_.num_misses(); }
+
+ private:
+  using Key = std::pair<std::string, Position>;
+  // Looked up without copying the file identifier to a `Key`.
+  using KeyView = std::pair<absl::string_view, Position>;
+
+  struct KeyHash {
+    using is_transparent = void;
+    size_t operator()(KeyView key) const { return absl::Hash<KeyView>()(key); }
+  };
+
+  struct KeyEq {
+    using is_transparent = void;
+    bool operator()(KeyView a, KeyView b) const { return a == b; }
+  };
+
+  internal::ShardedLruCache<Key, std::shared_ptr<const CachedChunk>, KeyHash,
+                            KeyEq>
+      cache_;
+};
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_RECORDS_CHUNK_CACHE_H_
@@ -0,0 +1,191 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/records/concat_records.h"
+
+#include <stddef.h>
+
+#include <deque>
+#include <future>
+#include <utility>
+#include <vector>
+
+#include "absl/base/optimization.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
+#include "riegeli/base/base.h"
+#include "riegeli/base/chain.h"
+#include "riegeli/base/parallelism.h"
+#include "riegeli/base/status.h"
+#include "riegeli/bytes/reader.h"
+#include "riegeli/bytes/writer.h"
+#include "riegeli/chunk_encoding/chunk.h"
+#include "riegeli/chunk_encoding/constants.h"
+#include "riegeli/records/chunk_reader.h"
+#include "riegeli/records/chunk_writer.h"
+
+namespace riegeli {
+
+namespace {
+
+// Chunks of a source, read in background.
+struct SourceChunks {
+  absl::Status status;
+  std::vector<Chunk> chunks;
+};
+
+class ChunkConcatenator {
+ public:
+  explicit ChunkConcatenator(ChunkWriter& dest)
+      : dest_(dest), write_header_(dest.pos() == 0) {}
+
+  // Writes the file signature if needed.
+  absl::Status Begin();
+
+  // Writes a chunk of the source with index `index` if it should be copied.
+  absl::Status WriteChunk(size_t index, const Chunk& chunk);
+
+ private:
+  ChunkWriter& dest_;
+  // Whether the file signature and metadata are written by this
+  // `ChunkConcatenator`.
+  bool write_header_;
+};
+
+absl::Status ChunkConcatenator::Begin() {
+  if (!write_header_) return absl::OkStatus();
+  Chunk chunk;
+  chunk.header = ChunkHeader(chunk.data, ChunkType::kFileSignature, 0, 0);
+  if (ABSL_PREDICT_FALSE(!dest_.WriteChunk(chunk))) return dest_.status();
+  return absl::OkStatus();
+}
+
+absl::Status ChunkConcatenator::WriteChunk(size_t index, const Chunk& chunk) {
+  switch (chunk.header.chunk_type()) {
+    case ChunkType::kFileSignature:
+    case ChunkType::kPadding:
+      return absl::OkStatus();
+    case ChunkType::kFileMetadata:
+      if (!write_header_ || index > 0) return absl::OkStatus();
+      break;
+    default:
+      break;
+  }
+  if (ABSL_PREDICT_FALSE(!dest_.WriteChunk(chunk))) return dest_.status();
+  return absl::OkStatus();
+}
+
+// Reads all chunks of `src`.
+SourceChunks ReadSourceChunks(Reader* src) {
+  SourceChunks source_chunks;
+  DefaultChunkReader<> chunk_reader(src);
+  Chunk chunk;
+  while (chunk_reader.ReadChunk(chunk)) {
+    source_chunks.chunks.push_back(std::move(chunk));
+    chunk = Chunk();
+  }
+  if (ABSL_PREDICT_FALSE(!chunk_reader.Close())) {
+    source_chunks.status = chunk_reader.status();
+  }
+  return source_chunks;
+}
+
+absl::Status AnnotateSource(absl::Status status, size_t index) {
+  return Annotate(status, absl::StrCat("reading source ", index));
+}
+
+absl::Status ConcatRecordsSerially(absl::Span<Reader* const> srcs,
+                                   ChunkConcatenator& concatenator) {
+  for (size_t index = 0; index < srcs.size(); ++index) {
+    DefaultChunkReader<> chunk_reader(srcs[index]);
+    Chunk chunk;
+    while (chunk_reader.ReadChunk(chunk)) {
+      absl::Status status = concatenator.WriteChunk(index, chunk);
+      if (ABSL_PREDICT_FALSE(!status.ok())) return status;
+    }
+    if (ABSL_PREDICT_FALSE(!chunk_reader.Close())) {
+      return AnnotateSource(chunk_reader.status(), index);
+    }
+  }
+  return absl::OkStatus();
+}
+
+absl::Status ConcatRecordsInParallel(absl::Span<Reader* const> srcs,
+                                     ChunkConcatenator& concatenator,
+                                     size_t parallelism) {
+  std::deque<std::future<SourceChunks>> pending;
+  size_t next_to_schedule = 0;
+  const auto schedule_more = [&] {
+    while (next_to_schedule < srcs.size() && pending.size() < parallelism) {
+      std::promise<SourceChunks>* const promise =
+          new std::promise<SourceChunks>();
+      pending.push_back(promise->get_future());
+      Reader* const src = srcs[next_to_schedule++];
+      internal::ThreadPool::global().Schedule([promise, src] {
+        promise->set_value(ReadSourceChunks(src));
+        delete promise;
+      });
+    }
+  };
+  absl::Status status;
+  for (size_t index = 0; index < srcs.size(); ++index) {
+    schedule_more();
+    SourceChunks source_chunks = pending.front().get();
+    pending.pop_front();
+    if (ABSL_PREDICT_FALSE(!source_chunks.status.ok())) {
+      status = AnnotateSource(source_chunks.status, index);
+      break;
+    }
+    for (const Chunk& chunk : source_chunks.chunks) {
+      status = concatenator.WriteChunk(index, chunk);
+      if (ABSL_PREDICT_FALSE(!status.ok())) break;
+    }
+    if (ABSL_PREDICT_FALSE(!status.ok())) break;
+  }
+  // Sources read in background must not be used after returning.
+  for (std::future<SourceChunks>& source_chunks : pending) {
+    source_chunks.wait();
+  }
+  return status;
+}
+
+}  // namespace
+
+absl::Status ConcatRecords(absl::Span<Reader* const> srcs, ChunkWriter& dest,
+                           ConcatRecordsOptions options) {
+  if (ABSL_PREDICT_FALSE(!dest.healthy())) return dest.status();
+  ChunkConcatenator concatenator(dest);
+  {
+    absl::Status status = concatenator.Begin();
+    if (ABSL_PREDICT_FALSE(!status.ok())) return status;
+  }
+  if (options.parallelism() == 0) {
+    return ConcatRecordsSerially(srcs, concatenator);
+  }
+  return ConcatRecordsInParallel(srcs, concatenator,
+                                 IntCast<size_t>(options.parallelism()));
+}
+
+absl::Status ConcatRecords(absl::Span<Reader* const> srcs, Writer& dest,
+                           ConcatRecordsOptions options) {
+  DefaultChunkWriter<> chunk_writer(&dest);
+  absl::Status status = ConcatRecords(srcs, chunk_writer, std::move(options));
+  if (ABSL_PREDICT_FALSE(!chunk_writer.Close())) {
+    if (status.ok()) status = chunk_writer.status();
+  }
+  return status;
+}
+
+}  // namespace riegeli
@@ -0,0 +1,80 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_RECORDS_CONCAT_RECORDS_H_
+#define RIEGELI_RECORDS_CONCAT_RECORDS_H_
+
+#include <utility>
+
+#include "absl/status/status.h"
+#include "absl/types/span.h"
+#include "riegeli/base/base.h"
+#include "riegeli/bytes/reader.h"
+#include "riegeli/bytes/writer.h"
+#include "riegeli/records/chunk_writer.h"
+
+namespace riegeli {
+
+class ConcatRecordsOptions {
+ public:
+  ConcatRecordsOptions() noexcept {}
+
+  // Number of sources read ahead in background, while chunks of an earlier
+  // source are being written. Each source read ahead is buffered in memory
+  // as a whole, so this should be small if sources are large.
+  //
+  // If 0, sources are read one after another, without buffering them.
+  //
+  // Default: 0.
+  ConcatRecordsOptions& set_parallelism(int parallelism) & {
+    RIEGELI_ASSERT_GE(parallelism, 0)
+        << "Failed precondition of ConcatRecordsOptions::set_parallelism(): "
+           "negative parallelism";
+    parallelism_ = parallelism;
+    return *this;
+  }
+  ConcatRecordsOptions&& set_parallelism(int parallelism) && {
+    return std::move(set_parallelism(parallelism));
+  }
+  int parallelism() const { return parallelism_; }
+
+ private:
+  int parallelism_ = 0;
+};
+
+// Concatenates Riegeli/records files read from `srcs`, writing them to `dest`,
+// without decoding and encoding chunks again. This is equivalent to reading
+// all records of `srcs` with `RecordReader` and writing them with
+// `RecordWriter`, but much faster, and chunks keep their original sizes and
+// compression.
+//
+// If `dest` is at position 0, a file signature is written first, followed by
+// file metadata copied from `srcs[0]` if it has any. Otherwise `dest` is
+// assumed to continue a Riegeli/records file, and this appends records to it.
+// File signatures, file metadata, and padding of `srcs` are not copied.
+//
+// `srcs` and `dest` are not closed. Sources are read from their current
+// positions, which should be 0.
+//
+// Returns the first failure of reading a source or of writing to `dest`.
+absl::Status ConcatRecords(
+    absl::Span<Reader* const> srcs, ChunkWriter& dest,
+    ConcatRecordsOptions options = ConcatRecordsOptions());
+absl::Status ConcatRecords(
+    absl::Span<Reader* const> srcs, Writer& dest,
+    ConcatRecordsOptions options = ConcatRecordsOptions());
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_RECORDS_CONCAT_RECORDS_H_
@@ -0,0 +1,129 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/records/record_dispenser.h"
+
+#include <string>
+#include <utility>
+
+#include "absl/base/optimization.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "riegeli/base/base.h"
+#include "riegeli/base/object.h"
+#include "riegeli/base/status.h"
+#include "riegeli/chunk_encoding/chunk_decoder.h"
+#include "riegeli/records/chunk_reader.h"
+#include "riegeli/records/skipped_region.h"
+
+namespace riegeli {
+
+RecordDispenserBase::RecordDispenserBase(RecordDispenserBase&& that) noexcept
+    : Object(std::move(that)),
+      // Using `that` after it was moved is correct because only the base class
+      // part was moved.
+      recovery_(std::move(that.recovery_)),
+      field_projection_(std::move(that.field_projection_)),
+      ended_(that.ended_) {}
+
+RecordDispenserBase& RecordDispenserBase::operator=(
+    RecordDispenserBase&& that) noexcept {
+  Object::operator=(std::move(that));
+  // Using `that` after it was moved is correct because only the base class part
+  // was moved.
+  recovery_ = std::move(that.recovery_);
+  field_projection_ = std::move(that.field_projection_);
+  ended_ = that.ended_;
+  return *this;
+}
+
+void RecordDispenserBase::Reset(Closed) {
+  Object::Reset(kClosed);
+  recovery_ = nullptr;
+  field_projection_ = FieldProjection::All();
+  ended_ = false;
+}
+
+void RecordDispenserBase::Reset() {
+  Object::Reset();
+  recovery_ = nullptr;
+  field_projection_ = FieldProjection::All();
+  ended_ = false;
+}
+
+void RecordDispenserBase::Initialize(ChunkReader* src, Options&& options) {
+  RIEGELI_ASSERT(src != nullptr)
+      << "Failed precondition of RecordDispenser: null ChunkReader pointer";
+  if (ABSL_PREDICT_FALSE(!src->healthy())) {
+    Fail(*src);
+    return;
+  }
+  recovery_ = std::move(options.recovery());
+  field_projection_ = std::move(options.field_projection());
+}
+
+bool RecordDispenserBase::NextBatch(Batch& batch) {
+  for (;;) {
+    {
+      absl::MutexLock lock(&mutex_);
+      if (ABSL_PREDICT_FALSE(!healthy() || ended_)) return false;
+      ChunkReader& src = *src_chunk_reader();
+      batch.chunk_begin_ = src.pos();
+      if (ABSL_PREDICT_FALSE(!src.ReadChunk(batch.chunk_))) {
+        batch.chunk_decoder_.Clear();
+        if (ABSL_PREDICT_FALSE(!src.healthy())) {
+          SkippedRegion skipped_region;
+          if (recovery_ != nullptr && src.Recover(&skipped_region)) {
+            if (ABSL_PREDICT_FALSE(!recovery_(skipped_region))) {
+              ended_ = true;
+              return false;
+            }
+            continue;
+          }
+          return Fail(src);
+        }
+        return false;
+      }
+      batch.chunk_end_ = src.pos();
+    }
+    // Decode outside the lock, in parallel with other consumers.
+    batch.chunk_decoder_.Reset(
+        ChunkDecoder::Options().set_field_projection(field_projection_));
+    if (ABSL_PREDICT_FALSE(!batch.chunk_decoder_.Decode(batch.chunk_))) {
+      absl::MutexLock lock(&mutex_);
+      if (recovery_ != nullptr) {
+        if (ABSL_PREDICT_FALSE(ended_)) return false;
+        const SkippedRegion skipped_region(
+            batch.chunk_begin_, batch.chunk_end_,
+            std::string(batch.chunk_decoder_.status().message()));
+        batch.chunk_decoder_.Clear();
+        if (ABSL_PREDICT_FALSE(!recovery_(skipped_region))) {
+          ended_ = true;
+          return false;
+        }
+        continue;
+      }
+      return Fail(Annotate(batch.chunk_decoder_.status(),
+                           absl::StrCat("at chunk ", batch.chunk_begin_)));
+    }
+    if (batch.chunk_decoder_.num_records() > 0) return true;
+  }
+}
+
+Position RecordDispenserBase::pos() const {
+  absl::MutexLock lock(&mutex_);
+  return src_chunk_reader()->pos();
+}
+
+}  // namespace riegeli
@@ -0,0 +1,464 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_RECORDS_RECORD_DISPENSER_H_
+#define RIEGELI_RECORDS_RECORD_DISPENSER_H_
+
+#include <stdint.h>
+
+#include <functional>
+#include <string>
+#include <tuple>
+#include <utility>
+
+#include "absl/base/optimization.h"
+#include "absl/strings/cord.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "google/protobuf/message_lite.h"
+#include "riegeli/base/base.h"
+#include "riegeli/base/chain.h"
+#include "riegeli/base/dependency.h"
+#include "riegeli/base/object.h"
+#include "riegeli/bytes/reader.h"
+#include "riegeli/chunk_encoding/chunk.h"
+#include "riegeli/chunk_encoding/chunk_decoder.h"
+#include "riegeli/chunk_encoding/field_projection.h"
+#include "riegeli/records/chunk_reader.h"
+#include "riegeli/records/chunk_reader_dependency.h"
+#include "riegeli/records/record_position.h"
+#include "riegeli/records/skipped_region.h"
+
+namespace riegeli {
+
+// Template parameter independent part of `RecordDispenser`.
+class RecordDispenserBase : public Object {
+ public:
+  class Options {
+   public:
+    Options() noexcept {}
+
+    // Specifies the set of fields to be included in returned records, like
+    // `RecordReaderBase::Options::set_field_projection()`.
+    //
+    // Default: `FieldProjection::All()`.
+    Options& set_field_projection(const FieldProjection& field_projection) & {
+      field_projection_ = field_projection;
+      return *this;
+    }
+    Options& set_field_projection(FieldProjection&& field_projection) & {
+      field_projection_ = std::move(field_projection);
+      return *this;
+    }
+    Options&& set_field_projection(const FieldProjection& field_projection) && {
+      return std::move(set_field_projection(field_projection));
+    }
+    Options&& set_field_projection(FieldProjection&& field_projection) && {
+      return std::move(set_field_projection(std::move(field_projection)));
+    }
+    FieldProjection& field_projection() { return field_projection_; }
+    const FieldProjection& field_projection() const {
+      return field_projection_;
+    }
+
+    // Recovery function to be called after skipping over invalid file
+    // contents, like `RecordReaderBase::Options::set_recovery()`.
+    //
+    // If the recovery function is set to `nullptr`, then invalid file contents
+    // cause `RecordDispenser` to fail, which ends `NextBatch()` for all
+    // consumers.
+    //
+    // If the recovery function is set to a value other than `nullptr`, then
+    // invalid file contents cause `RecordDispenser` to skip over the invalid
+    // region and call the recovery function. If the recovery function returns
+    // `true`, dispensing continues. If the recovery function returns `false`,
+    // dispensing ends for all consumers as if the end of source was
+    // encountered.
+    //
+    // Calls to the recovery function are serialized between consumers. They
+    // are made in the thread calling `NextBatch()`, or `Close()` if file
+    // contents were truncated.
+    //
+    // Default: `nullptr`.
+    Options& set_recovery(
+        const std::function<bool(const SkippedRegion&)>& recovery) & {
+      recovery_ = recovery;
+      return *this;
+    }
+    Options& set_recovery(
+        std::function<bool(const SkippedRegion&)>&& recovery) & {
+      recovery_ = std::move(recovery);
+      return *this;
+    }
+    Options&& set_recovery(
+        const std::function<bool(const SkippedRegion&)>& recovery) && {
+      return std::move(set_recovery(recovery));
+    }
+    Options&& set_recovery(
+        std::function<bool(const SkippedRegion&)>&& recovery) && {
+      return std::move(set_recovery(std::move(recovery)));
+    }
+    std::function<bool(const SkippedRegion&)>& recovery() { return recovery_; }
+    const std::function<bool(const SkippedRegion&)>& recovery() const {
+      return recovery_;
+    }
+
+   private:
+    FieldProjection field_projection_ = FieldProjection::All();
+    std::function<bool(const SkippedRegion&)> recovery_;
+  };
+
+  // Records of one chunk, given to one consumer by `NextBatch()`.
+  //
+  // A `Batch` is used by one thread at a time. It can be reused for subsequent
+  // calls to `NextBatch()`, which reuses its buffers.
+  class Batch {
+   public:
+    Batch() noexcept {}
+
+    Batch(Batch&& that) noexcept;
+    Batch& operator=(Batch&& that) noexcept;
+
+    // Reads the next record of the batch, like
+    // `RecordReaderBase::ReadRecord()`.
+    //
+    // Return values:
+    //  * `true`                      - success (`record` is set)
+    //  * `false` (when `ok()`)       - batch ends
+    //  * `false` (when `!ok()`)      - failure of parsing a message
+    bool ReadRecord(google::protobuf::MessageLite& record);
+    bool ReadRecord(absl::string_view& record);
+    bool ReadRecord(std::string& record);
+    bool ReadRecord(Chain& record);
+    bool ReadRecord(absl::Cord& record);
+
+    // If `ReadRecord(google::protobuf::MessageLite&)` failed, skips the
+    // unparsable message, allowing to read again.
+    //
+    // Return values:
+    //  * `true`  - success
+    //  * `false` - there was no failure
+    bool Recover() { return chunk_decoder_.Recover(); }
+
+    // Returns `true` unless `ReadRecord(google::protobuf::MessageLite&)`
+    // failed. `status()` describes the failure.
+    bool ok() const { return chunk_decoder_.healthy(); }
+    absl::Status status() const { return chunk_decoder_.status(); }
+
+    // Returns the canonical position of the last record read.
+    //
+    // Precondition: a record was successfully read from this batch.
+    RecordPosition LastPos() const;
+
+    // Returns the position of the next record in the batch, or of the chunk
+    // following the batch if the batch ends.
+    RecordPosition pos() const;
+
+    // Returns the number of records in the batch.
+    uint64_t num_records() const { return chunk_decoder_.num_records(); }
+
+   private:
+    friend class RecordDispenserBase;
+
+    Position chunk_begin_ = 0;
+    Position chunk_end_ = 0;
+    // Buffer for reading a chunk, reused between batches.
+    Chunk chunk_;
+    ChunkDecoder chunk_decoder_;
+  };
+
+  // Returns the Riegeli/records file being read from. Unchanged by `Close()`.
+  virtual ChunkReader* src_chunk_reader() = 0;
+  virtual const ChunkReader* src_chunk_reader() const = 0;
+
+  // Gives records of the next chunk of the file to the calling consumer.
+  //
+  // Reading the chunk is serialized between consumers, but it does not
+  // involve decompression. Decoding the chunk is done in the calling thread,
+  // in parallel with other consumers. Chunks containing no records are
+  // skipped.
+  //
+  // `NextBatch()` can be called concurrently from multiple threads, each with
+  // its own `batch`. Records are not given in the order of the file: each
+  // consumer sees batches in the order of the file, but batches of different
+  // consumers are processed concurrently.
+  //
+  // Return values:
+  //  * `true`  - success (`batch` is set)
+  //  * `false` - source ends, the recovery function returned `false`, or
+  //              failure
+  //
+  // Whether dispensing ended because of a failure is known only after all
+  // consumers finish, from the result of `Close()` and from `status()`.
+  // `healthy()` must not be called while consumers are active.
+  bool NextBatch(Batch& batch);
+
+  // Returns the position of the next chunk to be given by `NextBatch()`.
+  Position pos() const;
+
+ protected:
+  explicit RecordDispenserBase(Closed) noexcept : Object(kClosed) {}
+
+  RecordDispenserBase() noexcept {}
+
+  RecordDispenserBase(RecordDispenserBase&& that) noexcept;
+  RecordDispenserBase& operator=(RecordDispenserBase&& that) noexcept;
+
+  void Reset(Closed);
+  void Reset();
+  void Initialize(ChunkReader* src, Options&& options);
+
+  std::function<bool(const SkippedRegion&)> recovery_;
+
+ private:
+  FieldProjection field_projection_ = FieldProjection::All();
+  // Protects `src_chunk_reader()`, `ended_`, and the state of the `Object`
+  // while consumers are active.
+  mutable absl::Mutex mutex_;
+  // If `true`, the recovery function returned `false`, and `NextBatch()`
+  // returns `false` without reading further.
+  bool ended_ = false;
+};
+
+// `RecordDispenser` gives records of a Riegeli/records file to multiple
+// consumer threads, for processing the file in parallel when the order of
+// records does not matter.
+//
+// For consuming records, this kind of loop can be used in each consumer
+// thread:
+// ```
+//   riegeli::RecordDispenserBase::Batch batch;
+//   SomeProto record;
+//   while (record_dispenser_.NextBatch(batch)) {
+//     while (batch.ReadRecord(record)) {
+//       ... Process record.
+//     }
+//   }
+// ```
+// and after all consumers finish, which is the only time when a failure can
+// be checked:
+// ```
+//   if (!record_dispenser_.Close()) {
+//     ... Failed with reason: record_dispenser_.status()
+//   }
+// ```
+//
+// The `Src` template parameter specifies the type of the object providing and
+// possibly owning the byte `Reader` or `ChunkReader`, like for
+// `RecordReader`.
+//
+// By relying on CTAD the template argument can be deduced as the value type of
+// the first constructor argument. This requires C++17.
+//
+// Only `NextBatch()` and `pos()` can be called concurrently with other
+// functions. The byte `Reader` or `ChunkReader` must not be accessed until
+// the `RecordDispenser` is closed or no longer used.
+template <typename Src = Reader*>
+class RecordDispenser : public RecordDispenserBase {
+ public:
+  // Creates a closed `RecordDispenser`.
+  explicit RecordDispenser(Closed) noexcept : RecordDispenserBase(kClosed) {}
+
+  // Will read from the byte `Reader` or `ChunkReader` provided by `src`.
+  explicit RecordDispenser(const Src& src, Options options = Options());
+  explicit RecordDispenser(Src&& src, Options options = Options());
+
+  // Will read from the byte `Reader` or `ChunkReader` provided by a `Src`
+  // constructed from elements of `src_args`. This avoids constructing a
+  // temporary `Src` and moving from it.
+  template <typename... SrcArgs>
+  explicit RecordDispenser(std::tuple<SrcArgs...> src_args,
+                           Options options = Options());
+
+  RecordDispenser(RecordDispenser&& that) noexcept;
+  RecordDispenser& operator=(RecordDispenser&& that) noexcept;
+
+  // Makes `*this` equivalent to a newly constructed `RecordDispenser`. This
+  // avoids constructing a temporary `RecordDispenser` and moving from it.
+  void Reset(Closed);
+  void Reset(const Src& src, Options options = Options());
+  void Reset(Src&& src, Options options = Options());
+  template <typename... SrcArgs>
+  void Reset(std::tuple<SrcArgs...> src_args, Options options = Options());
+
+  // Returns the object providing and possibly owning the byte `Reader` or
+  // `ChunkReader`. Unchanged by `Close()`.
+  Src& src() { return src_.manager(); }
+  const Src& src() const { return src_.manager(); }
+  ChunkReader* src_chunk_reader() override { return src_.get(); }
+  const ChunkReader* src_chunk_reader() const override { return src_.get(); }
+
+ protected:
+  void Done() override;
+
+ private:
+  // The object providing and possibly owning the byte `Reader` or
+  // `ChunkReader`.
+  Dependency<ChunkReader*, Src> src_;
+};
+
+// Support CTAD.
+#if __cpp_deduction_guides
+explicit RecordDispenser(Closed)->RecordDispenser<DeleteCtad<Closed>>;
+template <typename Src>
+explicit RecordDispenser(const Src& src, RecordDispenserBase::Options options =
+                                             RecordDispenserBase::Options())
+    -> RecordDispenser<std::decay_t<Src>>;
+template <typename Src>
+explicit RecordDispenser(Src&& src, RecordDispenserBase::Options options =
+                                        RecordDispenserBase::Options())
+    -> RecordDispenser<std::decay_t<Src>>;
+template <typename... SrcArgs>
+explicit RecordDispenser(
+    std::tuple<SrcArgs...> src_args,
+    RecordDispenserBase::Options options = RecordDispenserBase::Options())
+    -> RecordDispenser<DeleteCtad<std::tuple<SrcArgs...>>>;
+#endif
+
+// Implementation details follow.
+
+inline RecordDispenserBase::Batch::Batch(Batch&& that) noexcept
+    : chunk_begin_(that.chunk_begin_),
+      chunk_end_(that.chunk_end_),
+      chunk_(std::move(that.chunk_)),
+      chunk_decoder_(std::move(that.chunk_decoder_)) {}
+
+inline RecordDispenserBase::Batch& RecordDispenserBase::Batch::operator=(
+    Batch&& that) noexcept {
+  chunk_begin_ = that.chunk_begin_;
+  chunk_end_ = that.chunk_end_;
+  chunk_ = std::move(that.chunk_);
+  chunk_decoder_ = std::move(that.chunk_decoder_);
+  return *this;
+}
+
+inline bool RecordDispenserBase::Batch::ReadRecord(
+    google::protobuf::MessageLite& record) {
+  return chunk_decoder_.ReadRecord(record);
+}
+
+inline bool RecordDispenserBase::Batch::ReadRecord(absl::string_view& record) {
+  return chunk_decoder_.ReadRecord(record);
+}
+
+inline bool RecordDispenserBase::Batch::ReadRecord(std::string& record) {
+  return chunk_decoder_.ReadRecord(record);
+}
+
+inline bool RecordDispenserBase::Batch::ReadRecord(Chain& record) {
+  return chunk_decoder_.ReadRecord(record);
+}
+
+inline bool RecordDispenserBase::Batch::ReadRecord(absl::Cord& record) {
+  return chunk_decoder_.ReadRecord(record);
+}
+
+inline RecordPosition RecordDispenserBase::Batch::LastPos() const {
+  RIEGELI_ASSERT_GT(chunk_decoder_.index(), 0u)
+      << "Failed precondition of RecordDispenserBase::Batch::LastPos(): "
+         "no record was read";
+  return RecordPosition(chunk_begin_, chunk_decoder_.index() - 1);
+}
+
+inline RecordPosition RecordDispenserBase::Batch::pos() const {
+  if (ABSL_PREDICT_TRUE(chunk_decoder_.index() <
+                        chunk_decoder_.num_records())) {
+    return RecordPosition(chunk_begin_, chunk_decoder_.index());
+  }
+  return RecordPosition(chunk_end_, 0);
+}
+
+template <typename Src>
+inline RecordDispenser<Src>::RecordDispenser(const Src& src, Options options)
+    : src_(src) {
+  Initialize(src_.get(), std::move(options));
+}
+
+template <typename Src>
+inline RecordDispenser<Src>::RecordDispenser(Src&& src, Options options)
+    : src_(std::move(src)) {
+  Initialize(src_.get(), std::move(options));
+}
+
+template <typename Src>
+template <typename... SrcArgs>
+inline RecordDispenser<Src>::RecordDispenser(std::tuple<SrcArgs...> src_args,
+                                             Options options)
+    : src_(std::move(src_args)) {
+  Initialize(src_.get(), std::move(options));
+}
+
+template <typename Src>
+inline RecordDispenser<Src>::RecordDispenser(RecordDispenser&& that) noexcept
+    : RecordDispenserBase(std::move(that)),
+      // Using `that` after it was moved is correct because only the base class
+      // part was moved.
+      src_(std::move(that.src_)) {}
+
+template <typename Src>
+inline RecordDispenser<Src>& RecordDispenser<Src>::operator=(
+    RecordDispenser&& that) noexcept {
+  RecordDispenserBase::operator=(std::move(that));
+  // Using `that` after it was moved is correct because only the base class part
+  // was moved.
+  src_ = std::move(that.src_);
+  return *this;
+}
+
+template <typename Src>
+inline void RecordDispenser<Src>::Reset(Closed) {
+  RecordDispenserBase::Reset(kClosed);
+  src_.Reset();
+}
+
+template <typename Src>
+inline void RecordDispenser<Src>::Reset(const Src& src, Options options) {
+  RecordDispenserBase::Reset();
+  src_.Reset(src);
+  Initialize(src_.get(), std::move(options));
+}
+
+template <typename Src>
+inline void RecordDispenser<Src>::Reset(Src&& src, Options options) {
+  RecordDispenserBase::Reset();
+  src_.Reset(std::move(src));
+  Initialize(src_.get(), std::move(options));
+}
+
+template <typename Src>
+template <typename... SrcArgs>
+inline void RecordDispenser<Src>::Reset(std::tuple<SrcArgs...> src_args,
+                                        Options options) {
+  RecordDispenserBase::Reset();
+  src_.Reset(std::move(src_args));
+  Initialize(src_.get(), std::move(options));
+}
+
+template <typename Src>
+void RecordDispenser<Src>::Done() {
+  if (src_.is_owning()) {
+    if (ABSL_PREDICT_FALSE(!src_->Close())) {
+      SkippedRegion skipped_region;
+      if (recovery_ != nullptr && src_->Recover(&skipped_region)) {
+        recovery_(skipped_region);
+      } else {
+        Fail(*src_);
+      }
+    }
+  }
+}
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_RECORDS_RECORD_DISPENSER_H_
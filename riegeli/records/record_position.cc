@@ -119,6 +119,10 @@ inline FutureChunkBegin::Unresolved::Unresolved(Position pos_before_chunks,
                                                 std::vector<Action> actions)
     : pos_before_chunks_(pos_before_chunks), actions_(std::move(actions)) {}
 
+inline FutureChunkBegin::Unresolved::Unresolved(
+    std::shared_future<FutureChunkBegin> chunk_begin)
+    : deferred_(std::move(chunk_begin)) {}
+
 void FutureChunkBegin::Unresolved::Resolve() const {
   struct Visitor {
     void operator()(const std::shared_future<ChunkHeader>& chunk_header) {
@@ -135,6 +139,10 @@ void FutureChunkBegin::Unresolved::Resolve() const {
 
     Position pos;
   };
+  if (deferred_.valid()) {
+    pos_before_chunks_ = deferred_.get().get();
+    deferred_ = std::shared_future<FutureChunkBegin>();
+  }
   Visitor visitor{pos_before_chunks_};
   for (const Action& action : actions_) {
     absl::visit(visitor, action);
@@ -150,6 +158,10 @@ FutureChunkBegin::FutureChunkBegin(Position pos_before_chunks,
                                         pos_before_chunks, std::move(actions))),
       resolved_(pos_before_chunks) {}
 
+FutureChunkBegin::FutureChunkBegin(
+    std::shared_future<FutureChunkBegin> chunk_begin)
+    : unresolved_(std::make_shared<Unresolved>(std::move(chunk_begin))) {}
+
 }  // namespace internal
 
 }  // namespace riegeli
@@ -117,6 +117,10 @@ class FutureChunkBegin {
   explicit FutureChunkBegin(Position pos_before_chunks,
                             std::vector<Action> actions);
 
+  // The chunk begin is `chunk_begin.get().get()`, for a chunk which is not
+  // scheduled for writing yet.
+  explicit FutureChunkBegin(std::shared_future<FutureChunkBegin> chunk_begin);
+
   FutureChunkBegin(const FutureChunkBegin& that) noexcept;
   FutureChunkBegin& operator=(const FutureChunkBegin& that) noexcept;
 
@@ -230,6 +234,7 @@ namespace internal {
 class FutureChunkBegin::Unresolved {
  public:
   explicit Unresolved(Position pos_before_chunks, std::vector<Action> actions);
+  explicit Unresolved(std::shared_future<FutureChunkBegin> chunk_begin);
 
   Unresolved(const Unresolved&) = delete;
   Unresolved& operator=(const Unresolved&) = delete;
@@ -244,12 +249,17 @@ class FutureChunkBegin::Unresolved {
   mutable Position pos_before_chunks_ = 0;
   // Headers of chunks to be written after `pos_before_chunks_`.
   mutable std::vector<Action> actions_;
+  // If valid, `pos_before_chunks_` is not known yet, and it is resolved from
+  // `deferred_` before applying `actions_`.
+  mutable std::shared_future<FutureChunkBegin> deferred_;
 };
 
 inline Position FutureChunkBegin::Unresolved::get() const {
   absl::call_once(flag_, &Unresolved::Resolve, this);
   RIEGELI_ASSERT(actions_.empty()) << "FutureChunkBegin::Unresolved::Resolve() "
                                       "did not clear actions_";
+  RIEGELI_ASSERT(!deferred_.valid())
+      << "FutureChunkBegin::Unresolved::Resolve() did not clear deferred_";
   return pos_before_chunks_;
 }
 
@@ -17,13 +17,17 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <chrono>
+#include <deque>
 #include <functional>
+#include <future>
 #include <memory>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include "absl/base/optimization.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/functional/function_ref.h"
 #include "absl/status/status.h"
 #include "absl/strings/cord.h"
@@ -31,6 +35,7 @@
 #include "absl/strings/string_view.h"
 #include "absl/types/compare.h"
 #include "absl/types/optional.h"
+#include "absl/types/span.h"
 #include "google/protobuf/descriptor.h"
 #include "google/protobuf/descriptor.pb.h"
 #include "google/protobuf/message.h"
@@ -39,8 +44,10 @@
 #include "riegeli/base/binary_search.h"
 #include "riegeli/base/chain.h"
 #include "riegeli/base/object.h"
+#include "riegeli/base/parallelism.h"
 #include "riegeli/bytes/chain_backward_writer.h"
 #include "riegeli/bytes/chain_reader.h"
+#include "riegeli/bytes/reader.h"
 #include "riegeli/chunk_encoding/chunk.h"
 #include "riegeli/chunk_encoding/chunk_decoder.h"
 #include "riegeli/chunk_encoding/constants.h"
@@ -54,6 +61,30 @@
 
 namespace riegeli {
 
+namespace {
+
+// The length of numeric positions read by a single task of
+// `RecordReaderBase::Prefetch(Position, Position)`.
+constexpr Position kPrefetchPartSize = Position{4} << 20;
+
+// The estimated memory used by a chunk being read by a task of
+// `RecordReaderBase::Prefetch(absl::Span<const RecordPosition>)`, before its
+// size is known. This is the default chunk size of `RecordWriter`.
+constexpr size_t kPrefetchChunkSizeEstimate = size_t{1} << 20;
+
+// The maximum number of tasks of `RecordReaderBase::Prefetch()` running at a
+// time for a single `RecordReader`.
+constexpr size_t kMaxPrefetchTasks = 16;
+
+}  // namespace
+
+// Before C++17 if a constexpr static data member is ODR-used, its definition at
+// namespace scope is required. Since C++17 these definitions are deprecated:
+// http://en.cppreference.com/w/cpp/language/static
+#if __cplusplus < 201703
+constexpr size_t RecordReaderBase::Options::kDefaultMaxPrefetchedSize;
+#endif
+
 class RecordsMetadataDescriptors::ErrorCollector
     : public google::protobuf::DescriptorPool::ErrorCollector {
  public:
@@ -100,6 +131,242 @@ const google::protobuf::Descriptor* RecordsMetadataDescriptors::descriptor()
   return pool_->FindMessageTypeByName(record_type_name_);
 }
 
+// Chunks read in the background by `RecordReaderBase::Prefetch()`.
+//
+// Reading is done by tasks in `internal::ThreadPool`, each with its own
+// `Reader` obtained from `Reader::NewReader()`. Their results are collected
+// in the thread using the `RecordReader`, which is the only thread accessing
+// the `Prefetcher`.
+//
+// Parts to read are queued, and tasks are started for them while the memory
+// used by prefetched chunks and estimated for tasks running does not exceed
+// `max_size`. More tasks are started as prefetched chunks are taken.
+class RecordReaderBase::Prefetcher {
+ public:
+  struct PrefetchedChunk {
+    Position chunk_begin = 0;
+    // Position after the chunk, where the next chunk begins.
+    Position chunk_end = 0;
+    // If `true`, `records` are set, otherwise `chunk` is set.
+    bool decoded = false;
+    Chunk chunk;
+    ChunkDecoder::Decoded records;
+    // Estimated memory used by `chunk` or `records`.
+    size_t memory = 0;
+  };
+
+  // Chunks are decoded using `field_projection` if `decode`.
+  explicit Prefetcher(size_t max_size, bool decode,
+                      const FieldProjection& field_projection)
+      : max_size_(max_size),
+        field_projection_(
+            decode ? std::make_shared<const FieldProjection>(field_projection)
+                   : nullptr) {}
+
+  Prefetcher(const Prefetcher&) = delete;
+  Prefetcher& operator=(const Prefetcher&) = delete;
+
+  // Waits for pending tasks, which use the source.
+  ~Prefetcher();
+
+  // Returns `true` if the chunk beginning at `chunk_begin` is prefetched or is
+  // queued to be prefetched as an exact chunk.
+  bool Contains(Position chunk_begin) const;
+
+  // Queues reading chunks in the background with readers created by
+  // `src.NewReader()`, and starts tasks for queued parts if the budget allows.
+  //
+  // If `exact_chunk`, reads the chunk beginning at `begin`. Otherwise reads
+  // chunks containing numeric positions from `begin` to `end`.
+  void Schedule(Reader& src, Position begin, Position end, bool exact_chunk);
+
+  // If the chunk beginning at `chunk_begin` has been prefetched, moves it to
+  // `chunk` and returns `true`. Waits for running tasks which may read it.
+  //
+  // Starts tasks for queued parts if the budget allows, with readers created
+  // by `src.NewReader()`.
+  bool Take(Reader& src, Position chunk_begin, PrefetchedChunk& chunk);
+
+ private:
+  struct Part {
+    Position begin;
+    Position end;
+    bool exact_chunk;
+  };
+
+  struct Task {
+    Part part;
+    // Memory estimated for chunks read by the task, included in
+    // `running_size_`.
+    size_t estimated_size;
+    std::future<std::vector<PrefetchedChunk>> chunks;
+  };
+
+  static std::vector<PrefetchedChunk> ReadChunks(
+      std::unique_ptr<Reader> src, Part part,
+      const FieldProjection* field_projection);
+
+  // Starts tasks for `parts_` while the number of tasks and the memory budget
+  // allow.
+  void StartTasks(Reader& src);
+
+  // Moves results of `task` to `chunks_`, discarding chunks prefetched
+  // earliest if `max_size_` is exceeded.
+  void Collect(Task& task);
+
+  size_t max_size_;
+  // Used for decoding chunks, or `nullptr` if chunks are not decoded.
+  std::shared_ptr<const FieldProjection> field_projection_;
+  // Parts for which tasks are not started yet, in the order of scheduling.
+  std::deque<Part> parts_;
+  std::vector<Task> tasks_;
+  // Sum of `estimated_size` of `tasks_`.
+  size_t running_size_ = 0;
+  absl::flat_hash_map<Position, PrefetchedChunk> chunks_;
+  // Keys of `chunks_` in the order of prefetching. May contain keys which are
+  // no longer present in `chunks_`.
+  std::deque<Position> order_;
+  // Sum of `memory` of `chunks_`.
+  size_t size_ = 0;
+};
+
+RecordReaderBase::Prefetcher::~Prefetcher() {
+  for (Task& task : tasks_) task.chunks.wait();
+}
+
+bool RecordReaderBase::Prefetcher::Contains(Position chunk_begin) const {
+  if (chunks_.find(chunk_begin) != chunks_.end()) return true;
+  for (const Task& task : tasks_) {
+    if (task.part.exact_chunk && task.part.begin == chunk_begin) return true;
+  }
+  for (const Part& part : parts_) {
+    if (part.exact_chunk && part.begin == chunk_begin) return true;
+  }
+  return false;
+}
+
+void RecordReaderBase::Prefetcher::Schedule(Reader& src, Position begin,
+                                            Position end, bool exact_chunk) {
+  parts_.push_back(Part{begin, end, exact_chunk});
+  StartTasks(src);
+}
+
+void RecordReaderBase::Prefetcher::StartTasks(Reader& src) {
+  while (!parts_.empty() && tasks_.size() < kMaxPrefetchTasks) {
+    const Part part = parts_.front();
+    const size_t estimated_size =
+        part.exact_chunk ? kPrefetchChunkSizeEstimate
+                         : IntCast<size_t>(part.end - part.begin);
+    // Start a task over the budget only if nothing else would use the memory,
+    // so that a part larger than the budget is still read.
+    if (size_ + running_size_ > 0 &&
+        size_ + running_size_ + estimated_size > max_size_) {
+      return;
+    }
+    std::unique_ptr<Reader> reader =
+        src.NewReader(part.exact_chunk ? part.begin : 0);
+    if (ABSL_PREDICT_FALSE(reader == nullptr)) {
+      parts_.clear();
+      return;
+    }
+    parts_.pop_front();
+    std::promise<std::vector<PrefetchedChunk>>* const promise =
+        new std::promise<std::vector<PrefetchedChunk>>();
+    tasks_.push_back(Task{part, estimated_size, promise->get_future()});
+    running_size_ += estimated_size;
+    Reader* const reader_ptr = reader.release();
+    internal::ThreadPool::global().Schedule(
+        [promise, reader_ptr, part, field_projection = field_projection_] {
+          promise->set_value(ReadChunks(std::unique_ptr<Reader>(reader_ptr),
+                                        part, field_projection.get()));
+          delete promise;
+        });
+  }
+}
+
+std::vector<RecordReaderBase::Prefetcher::PrefetchedChunk>
+RecordReaderBase::Prefetcher::ReadChunks(
+    std::unique_ptr<Reader> src, Part part,
+    const FieldProjection* field_projection) {
+  std::vector<PrefetchedChunk> chunks;
+  DefaultChunkReader<std::unique_ptr<Reader>> chunk_reader(std::move(src));
+  if (!part.exact_chunk) {
+    if (ABSL_PREDICT_FALSE(!chunk_reader.SeekToChunkContaining(part.begin))) {
+      return chunks;
+    }
+  }
+  ChunkDecoder chunk_decoder(ChunkDecoder::Options().set_field_projection(
+      field_projection != nullptr ? *field_projection
+                                  : FieldProjection::All()));
+  do {
+    PrefetchedChunk prefetched;
+    prefetched.chunk_begin = chunk_reader.pos();
+    if (ABSL_PREDICT_FALSE(!chunk_reader.ReadChunk(prefetched.chunk))) break;
+    prefetched.chunk_end = chunk_reader.pos();
+    if (field_projection != nullptr && chunk_decoder.Decode(prefetched.chunk)) {
+      // If decoding failed, the chunk is decoded again when it is needed, which
+      // reports the failure.
+      prefetched.decoded = true;
+      prefetched.chunk = Chunk();
+      prefetched.records = chunk_decoder.GetDecoded();
+      prefetched.memory =
+          prefetched.records.limits.capacity() * sizeof(size_t) +
+          prefetched.records.values.EstimateMemory();
+    } else {
+      prefetched.memory = prefetched.chunk.data.EstimateMemory();
+    }
+    chunks.push_back(std::move(prefetched));
+  } while (!part.exact_chunk && chunk_reader.pos() < part.end);
+  chunk_reader.Close();
+  return chunks;
+}
+
+void RecordReaderBase::Prefetcher::Collect(Task& task) {
+  running_size_ -= task.estimated_size;
+  for (PrefetchedChunk& prefetched : task.chunks.get()) {
+    const Position chunk_begin = prefetched.chunk_begin;
+    const size_t memory = prefetched.memory;
+    if (chunks_.emplace(chunk_begin, std::move(prefetched)).second) {
+      order_.push_back(chunk_begin);
+      size_ += memory;
+    }
+  }
+  while (size_ > max_size_ && chunks_.size() > 1) {
+    const auto iter = chunks_.find(order_.front());
+    order_.pop_front();
+    if (iter == chunks_.end()) continue;
+    size_ -= iter->second.memory;
+    chunks_.erase(iter);
+  }
+}
+
+bool RecordReaderBase::Prefetcher::Take(Reader& src, Position chunk_begin,
+                                        PrefetchedChunk& chunk) {
+  for (size_t i = 0; i < tasks_.size();) {
+    Task& task = tasks_[i];
+    if ((chunk_begin >= task.part.begin && chunk_begin < task.part.end) ||
+        task.chunks.wait_for(std::chrono::seconds(0)) ==
+            std::future_status::ready) {
+      Collect(task);
+      tasks_[i] = std::move(tasks_.back());
+      tasks_.pop_back();
+    } else {
+      ++i;
+    }
+  }
+  const auto iter = chunks_.find(chunk_begin);
+  if (iter == chunks_.end()) {
+    StartTasks(src);
+    return false;
+  }
+  chunk = std::move(iter->second);
+  size_ -= chunk.memory;
+  chunks_.erase(iter);
+  if (chunks_.empty()) order_.clear();
+  StartTasks(src);
+  return true;
+}
+
 RecordReaderBase::RecordReaderBase(Closed) noexcept : Object(kClosed) {}
 
 RecordReaderBase::RecordReaderBase() noexcept {}
@@ -112,10 +379,24 @@ RecordReaderBase::RecordReaderBase(RecordReaderBase&& that) noexcept
       chunk_decoder_(std::move(that.chunk_decoder_)),
       last_record_is_valid_(std::exchange(that.last_record_is_valid_, false)),
       recoverable_(std::exchange(that.recoverable_, Recoverable::kNo)),
-      recovery_(std::move(that.recovery_)) {}
+      recovery_(std::move(that.recovery_)),
+      chunk_cache_(std::exchange(that.chunk_cache_, nullptr)),
+      file_id_(std::move(that.file_id_)),
+      field_projection_includes_all_(that.field_projection_includes_all_),
+      max_prefetched_size_(that.max_prefetched_size_),
+      decode_prefetched_(that.decode_prefetched_) {
+  // Prefetching tasks read from readers which can point into the source of
+  // `that`, which is moved after this. Prefetched chunks are discarded.
+  that.DoneBackground();
+}
 
 RecordReaderBase& RecordReaderBase::operator=(
     RecordReaderBase&& that) noexcept {
+  // Prefetching tasks read from readers which can point into the sources of
+  // `*this` and `that`, which are moved after this. Prefetched chunks are
+  // discarded.
+  DoneBackground();
+  that.DoneBackground();
   Object::operator=(std::move(that));
   // Using `that` after it was moved is correct because only the base class part
   // was moved.
@@ -124,9 +405,16 @@ RecordReaderBase& RecordReaderBase::operator=(
   last_record_is_valid_ = std::exchange(that.last_record_is_valid_, false);
   recoverable_ = std::exchange(that.recoverable_, Recoverable::kNo);
   recovery_ = std::move(that.recovery_);
+  chunk_cache_ = std::exchange(that.chunk_cache_, nullptr);
+  file_id_ = std::move(that.file_id_);
+  field_projection_includes_all_ = that.field_projection_includes_all_;
+  max_prefetched_size_ = that.max_prefetched_size_;
+  decode_prefetched_ = that.decode_prefetched_;
   return *this;
 }
 
+RecordReaderBase::~RecordReaderBase() {}
+
 void RecordReaderBase::Reset(Closed) {
   Object::Reset(kClosed);
   chunk_begin_ = 0;
@@ -134,6 +422,12 @@ void RecordReaderBase::Reset(Closed) {
   last_record_is_valid_ = false;
   recoverable_ = Recoverable::kNo;
   recovery_ = nullptr;
+  chunk_cache_ = nullptr;
+  file_id_ = std::string();
+  field_projection_includes_all_ = true;
+  max_prefetched_size_ = Options::kDefaultMaxPrefetchedSize;
+  decode_prefetched_ = true;
+  prefetcher_.reset();
 }
 
 void RecordReaderBase::Reset() {
@@ -143,6 +437,12 @@ void RecordReaderBase::Reset() {
   last_record_is_valid_ = false;
   recoverable_ = Recoverable::kNo;
   recovery_ = nullptr;
+  chunk_cache_ = nullptr;
+  file_id_ = std::string();
+  field_projection_includes_all_ = true;
+  max_prefetched_size_ = Options::kDefaultMaxPrefetchedSize;
+  decode_prefetched_ = true;
+  prefetcher_.reset();
 }
 
 void RecordReaderBase::Initialize(ChunkReader* src, Options&& options) {
@@ -153,17 +453,27 @@ void RecordReaderBase::Initialize(ChunkReader* src, Options&& options) {
     return;
   }
   chunk_begin_ = src->pos();
+  field_projection_includes_all_ = options.field_projection().includes_all();
   chunk_decoder_.Reset(ChunkDecoder::Options().set_field_projection(
       std::move(options.field_projection())));
   recovery_ = std::move(options.recovery());
+  if (!options.file_id().empty()) {
+    chunk_cache_ = options.chunk_cache();
+    file_id_ = std::move(options.file_id());
+  }
+  max_prefetched_size_ = options.max_prefetched_size();
+  decode_prefetched_ = options.decode_prefetched();
 }
 
 void RecordReaderBase::Done() {
   last_record_is_valid_ = false;
   recoverable_ = Recoverable::kNo;
+  DoneBackground();
   if (ABSL_PREDICT_FALSE(!chunk_decoder_.Close())) Fail(chunk_decoder_);
 }
 
+void RecordReaderBase::DoneBackground() { prefetcher_.reset(); }
+
 inline bool RecordReaderBase::FailReading(const ChunkReader& src) {
   recoverable_ = Recoverable::kRecoverChunkReader;
   Fail(src);
@@ -332,6 +642,9 @@ bool RecordReaderBase::SetFieldProjection(FieldProjection field_projection) {
   if (ABSL_PREDICT_FALSE(!healthy())) return false;
   ChunkReader& src = *src_chunk_reader();
   const uint64_t record_index = chunk_decoder_.index();
+  field_projection_includes_all_ = field_projection.includes_all();
+  // Prefetched chunks may have been decoded with the previous projection.
+  prefetcher_.reset();
   chunk_decoder_.Reset(ChunkDecoder::Options().set_field_projection(
       std::move(field_projection)));
   if (ABSL_PREDICT_FALSE(!src.Seek(chunk_begin_))) return FailSeeking(src);
@@ -442,6 +755,47 @@ bool RecordReaderBase::Seek(Position new_pos) {
   return true;
 }
 
+inline RecordReaderBase::Prefetcher* RecordReaderBase::GetPrefetcher() {
+  if (prefetcher_ == nullptr) {
+    if (!src_chunk_reader()->src_reader()->SupportsNewReader()) return nullptr;
+    prefetcher_ = std::make_unique<Prefetcher>(
+        max_prefetched_size_, decode_prefetched_,
+        chunk_decoder_.field_projection());
+  }
+  return prefetcher_.get();
+}
+
+void RecordReaderBase::Prefetch(absl::Span<const RecordPosition> positions) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return;
+  Prefetcher* const prefetcher = GetPrefetcher();
+  if (prefetcher == nullptr) return;
+  ChunkReader& src = *src_chunk_reader();
+  for (const RecordPosition position : positions) {
+    const Position chunk_begin = position.chunk_begin();
+    // Skip the current chunk if it has been read.
+    if (chunk_begin == chunk_begin_ && src.pos() > chunk_begin_) continue;
+    if (prefetcher->Contains(chunk_begin)) continue;
+    prefetcher->Schedule(*src.src_reader(), chunk_begin, chunk_begin + 1,
+                         true);
+  }
+}
+
+void RecordReaderBase::Prefetch(Position begin, Position end) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return;
+  Prefetcher* const prefetcher = GetPrefetcher();
+  if (prefetcher == nullptr) return;
+  // Split the range into parts read by separate tasks, so that reading the
+  // first chunks does not wait for the whole range, and parts are read in
+  // parallel. A chunk crossing a boundary between parts is read by both tasks.
+  Reader& src = *src_chunk_reader()->src_reader();
+  while (begin < end) {
+    const Position part_end =
+        begin + UnsignedMin(end - begin, kPrefetchPartSize);
+    prefetcher->Schedule(src, begin, part_end, false);
+    begin = part_end;
+  }
+}
+
 bool RecordReaderBase::SeekBack() {
   if (ABSL_PREDICT_FALSE(!healthy())) return false;
   last_record_is_valid_ = false;
@@ -648,18 +1002,55 @@ inline bool RecordReaderBase::ReadChunk() {
       << "Failed precondition of RecordReaderBase::ReadChunk(): " << status();
   ChunkReader& src = *src_chunk_reader();
   chunk_begin_ = src.pos();
-  Chunk chunk;
-  if (ABSL_PREDICT_FALSE(!src.ReadChunk(chunk))) {
-    chunk_decoder_.Clear();
-    if (ABSL_PREDICT_FALSE(!src.healthy())) {
+  const bool use_chunk_cache =
+      chunk_cache_ != nullptr && field_projection_includes_all_;
+  if (use_chunk_cache) {
+    const std::shared_ptr<const ChunkCache::CachedChunk> cached_chunk =
+        chunk_cache_->Find(file_id_, chunk_begin_);
+    if (cached_chunk != nullptr) {
+      if (ABSL_PREDICT_FALSE(!src.Seek(cached_chunk->chunk_end))) {
+        chunk_decoder_.Clear();
+        recoverable_ = Recoverable::kRecoverChunkReader;
+        return Fail(src);
+      }
+      chunk_decoder_.SetDecoded(cached_chunk->decoded);
+      return true;
+    }
+  }
+  Prefetcher::PrefetchedChunk prefetched;
+  if (prefetcher_ != nullptr &&
+      prefetcher_->Take(*src.src_reader(), chunk_begin_, prefetched)) {
+    if (ABSL_PREDICT_FALSE(!src.Seek(prefetched.chunk_end))) {
+      chunk_decoder_.Clear();
       recoverable_ = Recoverable::kRecoverChunkReader;
       return Fail(src);
     }
-    return false;
+    if (prefetched.decoded) {
+      chunk_decoder_.SetDecoded(prefetched.records);
+    } else if (ABSL_PREDICT_FALSE(!chunk_decoder_.Decode(prefetched.chunk))) {
+      recoverable_ = Recoverable::kRecoverChunkDecoder;
+      return Fail(chunk_decoder_);
+    }
+  } else {
+    Chunk chunk;
+    if (ABSL_PREDICT_FALSE(!src.ReadChunk(chunk))) {
+      chunk_decoder_.Clear();
+      if (ABSL_PREDICT_FALSE(!src.healthy())) {
+        recoverable_ = Recoverable::kRecoverChunkReader;
+        return Fail(src);
+      }
+      return false;
+    }
+    if (ABSL_PREDICT_FALSE(!chunk_decoder_.Decode(chunk))) {
+      recoverable_ = Recoverable::kRecoverChunkDecoder;
+      return Fail(chunk_decoder_);
+    }
   }
-  if (ABSL_PREDICT_FALSE(!chunk_decoder_.Decode(chunk))) {
-    recoverable_ = Recoverable::kRecoverChunkDecoder;
-    return Fail(chunk_decoder_);
+  if (use_chunk_cache) {
+    chunk_cache_->Insert(
+        file_id_, chunk_begin_,
+        std::make_shared<const ChunkCache::CachedChunk>(
+            ChunkCache::CachedChunk{src.pos(), chunk_decoder_.GetDecoded()}));
   }
   return true;
 }
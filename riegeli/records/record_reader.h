@@ -15,6 +15,8 @@
 #ifndef RIEGELI_RECORDS_RECORD_READER_H_
 #define RIEGELI_RECORDS_RECORD_READER_H_
 
+#include <stddef.h>
+
 #include <functional>
 #include <memory>
 #include <string>
@@ -28,6 +30,7 @@
 #include "absl/strings/string_view.h"
 #include "absl/types/compare.h"
 #include "absl/types/optional.h"
+#include "absl/types/span.h"
 #include "google/protobuf/descriptor.h"
 #include "google/protobuf/message_lite.h"
 #include "riegeli/base/base.h"
@@ -38,6 +41,7 @@
 #include "riegeli/chunk_encoding/chunk.h"
 #include "riegeli/chunk_encoding/chunk_decoder.h"
 #include "riegeli/chunk_encoding/field_projection.h"
+#include "riegeli/records/chunk_cache.h"
 #include "riegeli/records/chunk_reader.h"
 #include "riegeli/records/chunk_reader_dependency.h"
 #include "riegeli/records/record_position.h"
@@ -158,11 +162,88 @@ class RecordReaderBase : public Object {
       return recovery_;
     }
 
+    // If not `nullptr` and `file_id()` is not empty, decoded chunks are looked
+    // up in and added to `*chunk_cache`, where they are identified by
+    // `file_id()` and their position. Seeking to a chunk found in the cache,
+    // including by `Search()`, skips reading and decoding it.
+    //
+    // `*chunk_cache` must outlive the `RecordReader`. It can be shared by
+    // `RecordReader`s reading the same or different files, possibly in
+    // different threads.
+    //
+    // The cache is used only while the field projection includes all fields.
+    //
+    // Default: `nullptr`.
+    Options& set_chunk_cache(ChunkCache* chunk_cache) & {
+      chunk_cache_ = chunk_cache;
+      return *this;
+    }
+    Options&& set_chunk_cache(ChunkCache* chunk_cache) && {
+      return std::move(set_chunk_cache(chunk_cache));
+    }
+    ChunkCache* chunk_cache() const { return chunk_cache_; }
+
+    // Identifies the file in `chunk_cache()`, e.g. its filename.
+    // `RecordReader`s sharing the cache must use the same identifier for the
+    // same file, and different identifiers for different files.
+    //
+    // Default: "" (the chunk cache is not used).
+    Options& set_file_id(absl::string_view file_id) & {
+      // TODO: When `absl::string_view` becomes C++17 `std::string_view`:
+      // `file_id_ = file_id`
+      file_id_.assign(file_id.data(), file_id.size());
+      return *this;
+    }
+    Options&& set_file_id(absl::string_view file_id) && {
+      return std::move(set_file_id(file_id));
+    }
+    std::string& file_id() { return file_id_; }
+    const std::string& file_id() const { return file_id_; }
+
+    // Maximum amount of memory used by chunks read by `Prefetch()` and not
+    // read by the `RecordReader` yet, including an estimate for chunks being
+    // read. Reading more chunks is deferred while this would be exceeded, and
+    // it continues as the `RecordReader` reads prefetched chunks. If this is
+    // exceeded anyway, chunks prefetched earliest are discarded.
+    //
+    // Default: `kDefaultMaxPrefetchedSize` (64M).
+    static constexpr size_t kDefaultMaxPrefetchedSize = size_t{64} << 20;
+    Options& set_max_prefetched_size(size_t max_prefetched_size) & {
+      max_prefetched_size_ = max_prefetched_size;
+      return *this;
+    }
+    Options&& set_max_prefetched_size(size_t max_prefetched_size) && {
+      return std::move(set_max_prefetched_size(max_prefetched_size));
+    }
+    size_t max_prefetched_size() const { return max_prefetched_size_; }
+
+    // If `true`, `Prefetch()` also decodes chunks in the background, so that
+    // reading them later needs no decompression.
+    //
+    // If `false`, `Prefetch()` only reads chunks, which takes less memory, and
+    // they are decoded when needed.
+    //
+    // Default: `true`.
+    Options& set_decode_prefetched(bool decode_prefetched) & {
+      decode_prefetched_ = decode_prefetched;
+      return *this;
+    }
+    Options&& set_decode_prefetched(bool decode_prefetched) && {
+      return std::move(set_decode_prefetched(decode_prefetched));
+    }
+    bool decode_prefetched() const { return decode_prefetched_; }
+
    private:
     FieldProjection field_projection_ = FieldProjection::All();
     std::function<bool(const SkippedRegion&)> recovery_;
+    ChunkCache* chunk_cache_ = nullptr;
+    std::string file_id_;
+    size_t max_prefetched_size_ = kDefaultMaxPrefetchedSize;
+    bool decode_prefetched_ = true;
   };
 
+  ~RecordReaderBase();
+
   // Returns the Riegeli/records file being read from. Unchanged by `Close()`.
   virtual ChunkReader* src_chunk_reader() = 0;
   virtual const ChunkReader* src_chunk_reader() const = 0;
@@ -301,6 +382,24 @@ class RecordReaderBase : public Object {
   bool Seek(RecordPosition new_pos);
   bool Seek(Position new_pos);
 
+  // Starts reading chunks in the background, so that seeking to them later
+  // does not wait for reading them, nor for decoding them if
+  // `Options::decode_prefetched()`.
+  //
+  // `Prefetch(absl::Span<const RecordPosition>)` reads chunks containing the
+  // given positions. `Prefetch(Position, Position)` reads chunks containing
+  // numeric positions from `begin` to `end` (exclusive), as interpreted by
+  // `Seek(Position)`.
+  //
+  // At most `Options::max_prefetched_size()` is read ahead. The rest is queued
+  // and read as the `RecordReader` reads chunks prefetched earlier.
+  //
+  // `Prefetch()` is only a hint. It does nothing if the byte `Reader` does not
+  // support `NewReader()`, or if `!healthy()`. Failures of reading are not
+  // reported by `Prefetch()`, but by reading the chunk later.
+  void Prefetch(absl::Span<const RecordPosition> positions);
+  void Prefetch(Position begin, Position end);
+
   // Seeks back by one record.
   //
   // Return values:
@@ -399,6 +498,9 @@ class RecordReaderBase : public Object {
   void Initialize(ChunkReader* src, Options&& options);
 
   void Done() override;
+  // Waits for background tasks of `Prefetch()`, because they read from the
+  // byte `Reader`.
+  void DoneBackground();
 
   bool TryRecovery();
 
@@ -435,8 +537,17 @@ class RecordReaderBase : public Object {
 
   std::function<bool(const SkippedRegion&)> recovery_;
 
+  // `Options::chunk_cache()` if `Options::file_id()` is not empty, otherwise
+  // `nullptr`.
+  ChunkCache* chunk_cache_ = nullptr;
+  std::string file_id_;
+  // Whether the current field projection includes all fields, i.e. whether
+  // `chunk_cache_` can be used.
+  bool field_projection_includes_all_ = true;
+
  private:
   class ChunkSearchTraits;
+  class Prefetcher;
 
   bool FailReading(const ChunkReader& src);
   bool FailSeeking(const ChunkReader& src);
@@ -447,10 +558,20 @@ class RecordReaderBase : public Object {
   bool ReadRecordImpl(Record& record);
 
   // Reads the next chunk from `chunk_reader_` and decodes it into
-  // `chunk_decoder_` and `chunk_begin_`. On failure resets `chunk_decoder_`.
+  // `chunk_decoder_` and `chunk_begin_`, or finds it in `chunk_cache_`. On
+  // failure resets `chunk_decoder_`.
   //
   // Precondition: `healthy()`
   bool ReadChunk();
+
+  // Returns `prefetcher_`, creating it if needed, or `nullptr` if the byte
+  // `Reader` does not support `NewReader()`.
+  Prefetcher* GetPrefetcher();
+
+  size_t max_prefetched_size_ = Options::kDefaultMaxPrefetchedSize;
+  bool decode_prefetched_ = true;
+  // Chunks read by `Prefetch()`, or `nullptr` if `Prefetch()` was not called.
+  std::unique_ptr<Prefetcher> prefetcher_;
 };
 
 // `RecordReader` reads records of a Riegeli/records file. A record is
@@ -539,6 +660,8 @@ class RecordReader : public RecordReaderBase {
   RecordReader(RecordReader&& that) noexcept;
   RecordReader& operator=(RecordReader&& that) noexcept;
 
+  ~RecordReader() { DoneBackground(); }
+
   // Makes `*this` equivalent to a newly constructed `RecordReader`. This avoids
   // constructing a temporary `RecordReader` and moving from it.
   void Reset(Closed);
@@ -122,6 +122,8 @@ absl::Status RecordWriterBase::Options::FromString(absl::string_view text) {
   options_parser.AddOption("zstd", ValueParser::CopyTo(&compressor_text));
   options_parser.AddOption("snappy", ValueParser::CopyTo(&compressor_text));
   options_parser.AddOption("window_log", ValueParser::CopyTo(&compressor_text));
+  options_parser.AddOption("zstd_parallelism",
+                           ValueParser::CopyTo(&compressor_text));
   options_parser.AddOption(
       "chunk_size",
       ValueParser::Or(
@@ -192,6 +194,31 @@ class RecordWriterBase::Worker {
 
   virtual Position EstimatedSize() const = 0;
 
+  // Returns `true` if `CloseProducerChunk()` is supported.
+  virtual bool SupportsProducers() const { return false; }
+
+  // Called when the first `Producer` is created. Afterwards positions of
+  // records written by the `RecordWriter` itself are determined when their
+  // chunk is closed, because chunks of `Producer`s can be written before it.
+  //
+  // Precondition: `SupportsProducers()`, chunk is open and empty.
+  virtual void EnableProducers();
+
+  // Returns `true` if `EnableProducers()` was called.
+  virtual bool producers_enabled() const { return false; }
+
+  // Encodes and writes a chunk filled by a `Producer`, and sets `chunk_begin`
+  // to its position. Can be called concurrently with other functions.
+  //
+  // Precondition: `SupportsProducers()`
+  //
+  // If the result is `false` then `!healthy()` and `chunk_begin` is not set.
+  virtual bool CloseProducerChunk(
+      std::unique_ptr<ChunkEncoder> chunk_encoder,
+      std::promise<internal::FutureChunkBegin>& chunk_begin);
+
+  std::unique_ptr<ChunkEncoder> MakeChunkEncoder();
+
  protected:
   void Initialize(Position initial_pos);
 
@@ -204,7 +231,6 @@ class RecordWriterBase::Worker {
   virtual bool WriteMetadata() = 0;
   virtual bool PadToBlockBoundary() = 0;
 
-  std::unique_ptr<ChunkEncoder> MakeChunkEncoder();
   void EncodeSignature(Chunk& chunk);
   bool EncodeMetadata(Chunk& chunk);
   bool EncodeChunk(ChunkEncoder& chunk_encoder, Chunk& chunk);
@@ -219,6 +245,20 @@ class RecordWriterBase::Worker {
 
 RecordWriterBase::Worker::~Worker() {}
 
+void RecordWriterBase::Worker::EnableProducers() {
+  RIEGELI_ASSERT_UNREACHABLE()
+      << "Failed precondition of RecordWriterBase::Worker::EnableProducers(): "
+         "producers not supported";
+}
+
+bool RecordWriterBase::Worker::CloseProducerChunk(
+    std::unique_ptr<ChunkEncoder> chunk_encoder,
+    std::promise<internal::FutureChunkBegin>& chunk_begin) {
+  RIEGELI_ASSERT_UNREACHABLE()
+      << "Failed precondition of RecordWriterBase::Worker::CloseProducerChunk(): "
+         "producers not supported";
+}
+
 bool RecordWriterBase::Worker::Close() {
   if (ABSL_PREDICT_FALSE(!state_.is_open())) return state_.not_failed();
   Done();
@@ -474,6 +514,12 @@ class RecordWriterBase::ParallelWorker : public Worker {
   FutureRecordPosition LastPos() const override;
   FutureRecordPosition Pos() const override;
   Position EstimatedSize() const override;
+  bool SupportsProducers() const override { return true; }
+  void EnableProducers() override;
+  bool producers_enabled() const override { return producers_enabled_; }
+  bool CloseProducerChunk(
+      std::unique_ptr<ChunkEncoder> chunk_encoder,
+      std::promise<internal::FutureChunkBegin>& chunk_begin) override;
 
  protected:
   void Done() override;
@@ -510,6 +556,18 @@ class RecordWriterBase::ParallelWorker : public Worker {
 
   bool HasCapacityForRequest() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   internal::FutureChunkBegin ChunkBegin() const;
+  internal::FutureChunkBegin ChunkBeginLocked() const
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // If `chunk_begin != nullptr`, sets `*chunk_begin` to the position of the
+  // chunk.
+  bool WriteChunk(std::unique_ptr<ChunkEncoder> chunk_encoder,
+                  std::promise<internal::FutureChunkBegin>* chunk_begin);
+
+  // If `true`, `chunk_begin_promise_` is set to the beginning of the current
+  // chunk when it is closed, and `chunk_begin_` is its future.
+  bool producers_enabled_ = false;
+  std::promise<internal::FutureChunkBegin> chunk_begin_promise_;
+  std::shared_future<internal::FutureChunkBegin> chunk_begin_;
 
   mutable absl::Mutex mutex_;
   std::deque<ChunkWriterRequest> chunk_writer_requests_ ABSL_GUARDED_BY(mutex_);
@@ -593,6 +651,11 @@ RecordWriterBase::ParallelWorker::~ParallelWorker() {
 }
 
 void RecordWriterBase::ParallelWorker::Done() {
+  if (producers_enabled_) {
+    // No more chunks are written. Resolve positions referring to the chunk
+    // which would be written next.
+    chunk_begin_promise_.set_value(ChunkBegin());
+  }
   std::promise<void> done_promise;
   std::future<void> done_future = done_promise.get_future();
   {
@@ -662,11 +725,47 @@ bool RecordWriterBase::ParallelWorker::WriteMetadata() {
 }
 
 bool RecordWriterBase::ParallelWorker::CloseChunk() {
+  if (!producers_enabled_) {
+    return WriteChunk(std::move(chunk_encoder_), nullptr);
+  }
+  const bool result =
+      WriteChunk(std::move(chunk_encoder_), &chunk_begin_promise_);
+  if (ABSL_PREDICT_FALSE(!result)) {
+    // Resolve positions of records which will not be written, instead of
+    // breaking the promise.
+    chunk_begin_promise_.set_value(internal::FutureChunkBegin());
+  }
+  chunk_begin_promise_ = std::promise<internal::FutureChunkBegin>();
+  chunk_begin_ = chunk_begin_promise_.get_future().share();
+  return result;
+}
+
+void RecordWriterBase::ParallelWorker::EnableProducers() {
+  RIEGELI_ASSERT(!producers_enabled_)
+      << "Failed precondition of "
+         "RecordWriterBase::ParallelWorker::EnableProducers(): "
+         "producers already enabled";
+  producers_enabled_ = true;
+  chunk_begin_ = chunk_begin_promise_.get_future().share();
+}
+
+bool RecordWriterBase::ParallelWorker::CloseProducerChunk(
+    std::unique_ptr<ChunkEncoder> chunk_encoder,
+    std::promise<internal::FutureChunkBegin>& chunk_begin) {
+  return WriteChunk(std::move(chunk_encoder), &chunk_begin);
+}
+
+inline bool RecordWriterBase::ParallelWorker::WriteChunk(
+    std::unique_ptr<ChunkEncoder> owned_chunk_encoder,
+    std::promise<internal::FutureChunkBegin>* chunk_begin) {
   if (ABSL_PREDICT_FALSE(!healthy())) return false;
-  ChunkEncoder* const chunk_encoder = chunk_encoder_.release();
+  ChunkEncoder* const chunk_encoder = owned_chunk_encoder.release();
   ChunkPromises* const chunk_promises = new ChunkPromises();
   mutex_.LockWhen(
       absl::Condition(this, &ParallelWorker::HasCapacityForRequest));
+  // The chunk is written after chunks requested before, so its position is
+  // determined by them.
+  if (chunk_begin != nullptr) chunk_begin->set_value(ChunkBeginLocked());
   chunk_writer_requests_.emplace_back(
       WriteChunkRequest{chunk_promises->chunk_header.get_future(),
                         chunk_promises->chunk.get_future()});
@@ -710,6 +809,12 @@ std::future<bool> RecordWriterBase::ParallelWorker::FutureFlush(
 
 internal::FutureChunkBegin RecordWriterBase::ParallelWorker::ChunkBegin()
     const {
+  absl::MutexLock lock(&mutex_);
+  return ChunkBeginLocked();
+}
+
+internal::FutureChunkBegin
+RecordWriterBase::ParallelWorker::ChunkBeginLocked() const {
   struct Visitor {
     void operator()(const DoneRequest&) {}
     void operator()(const WriteChunkRequest& request) {
@@ -723,7 +828,6 @@ internal::FutureChunkBegin RecordWriterBase::ParallelWorker::ChunkBegin()
     std::vector<internal::FutureChunkBegin::Action> actions;
   };
   Visitor visitor;
-  absl::MutexLock lock(&mutex_);
   visitor.actions.reserve(chunk_writer_requests_.size());
   for (const ChunkWriterRequest& request : chunk_writer_requests_) {
     absl::visit(visitor, request);
@@ -741,13 +845,18 @@ FutureRecordPosition RecordWriterBase::ParallelWorker::LastPos() const {
   RIEGELI_ASSERT_GT(chunk_encoder_->num_records(), 0u)
       << "Failed invariant of RecordWriterBase::ParallelWorker: "
          "last position should be valid but no record was encoded";
-  return FutureRecordPosition(ChunkBegin(), chunk_encoder_->num_records() - 1);
+  return FutureRecordPosition(
+      producers_enabled_ ? internal::FutureChunkBegin(chunk_begin_)
+                         : ChunkBegin(),
+      chunk_encoder_->num_records() - 1);
 }
 
 FutureRecordPosition RecordWriterBase::ParallelWorker::Pos() const {
   // `chunk_encoder_` is `nullptr` when the current chunk is closed, e.g. when
   // `RecordWriter` is closed or if `RecordWriter::Flush()` failed.
-  return FutureRecordPosition(ChunkBegin(),
+  return FutureRecordPosition(producers_enabled_
+                                  ? internal::FutureChunkBegin(chunk_begin_)
+                                  : ChunkBegin(),
                               ABSL_PREDICT_FALSE(chunk_encoder_ == nullptr)
                                   ? uint64_t{0}
                                   : chunk_encoder_->num_records());
@@ -1009,4 +1118,185 @@ Position RecordWriterBase::EstimatedSize() const {
   return worker_->EstimatedSize();
 }
 
+RecordWriterBase::Producer RecordWriterBase::NewProducer() {
+  Producer producer(worker_.get(), desired_chunk_size_);
+  if (ABSL_PREDICT_FALSE(!healthy())) {
+    producer.Fail(status());
+  } else if (ABSL_PREDICT_FALSE(!worker_->SupportsProducers())) {
+    producer.Fail(absl::FailedPreconditionError(
+        "RecordWriterBase::NewProducer() requires "
+        "RecordWriterBase::Options::parallelism() > 0"));
+  } else if (!worker_->producers_enabled()) {
+    // Positions of records in the current chunk assume that no chunk is written
+    // before it. Close the chunk, so that chunks of `Producer`s are written
+    // after it.
+    if (chunk_size_so_far_ != 0) {
+      last_record_is_valid_ = false;
+      if (ABSL_PREDICT_FALSE(!worker_->CloseChunk())) {
+        Fail(worker_->status());
+        producer.Fail(status());
+        return producer;
+      }
+      worker_->OpenChunk();
+      chunk_size_so_far_ = 0;
+    }
+    worker_->EnableProducers();
+  }
+  return producer;
+}
+
+RecordWriterBase::Producer::Producer(Closed) noexcept : Object(kClosed) {}
+
+inline RecordWriterBase::Producer::Producer(Worker* worker,
+                                            uint64_t desired_chunk_size)
+    : worker_(worker), desired_chunk_size_(desired_chunk_size) {}
+
+RecordWriterBase::Producer::Producer(Producer&& that) noexcept
+    : Object(std::move(that)),
+      // Using `that` after it was moved is correct because only the base class
+      // part was moved.
+      worker_(that.worker_),
+      desired_chunk_size_(that.desired_chunk_size_),
+      chunk_size_so_far_(std::exchange(that.chunk_size_so_far_, 0)),
+      last_record_is_valid_(std::exchange(that.last_record_is_valid_, false)),
+      chunk_encoder_(std::move(that.chunk_encoder_)),
+      chunk_begin_promise_(std::move(that.chunk_begin_promise_)),
+      chunk_begin_(std::move(that.chunk_begin_)) {}
+
+RecordWriterBase::Producer& RecordWriterBase::Producer::operator=(
+    Producer&& that) noexcept {
+  Object::operator=(std::move(that));
+  // Using `that` after it was moved is correct because only the base class part
+  // was moved.
+  worker_ = that.worker_;
+  desired_chunk_size_ = that.desired_chunk_size_;
+  chunk_size_so_far_ = std::exchange(that.chunk_size_so_far_, 0);
+  last_record_is_valid_ = std::exchange(that.last_record_is_valid_, false);
+  chunk_encoder_ = std::move(that.chunk_encoder_);
+  chunk_begin_promise_ = std::move(that.chunk_begin_promise_);
+  chunk_begin_ = std::move(that.chunk_begin_);
+  return *this;
+}
+
+RecordWriterBase::Producer::~Producer() {}
+
+void RecordWriterBase::Producer::Done() {
+  last_record_is_valid_ = false;
+  if (chunk_size_so_far_ != 0) {
+    if (ABSL_PREDICT_TRUE(healthy())) {
+      CloseChunk();
+    } else {
+      // Resolve positions of records which will not be written, instead of
+      // breaking the promise.
+      chunk_begin_promise_.set_value(internal::FutureChunkBegin());
+      chunk_size_so_far_ = 0;
+    }
+  }
+  chunk_encoder_.reset();
+}
+
+bool RecordWriterBase::Producer::WriteRecord(
+    const google::protobuf::MessageLite& record,
+    SerializeOptions serialize_options) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  last_record_is_valid_ = false;
+  const size_t size = serialize_options.GetByteSize(record);
+  const uint64_t added_size =
+      SaturatingAdd(IntCast<uint64_t>(size), uint64_t{sizeof(uint64_t)});
+  if (ABSL_PREDICT_FALSE(!PrepareChunk(added_size))) return false;
+  if (ABSL_PREDICT_FALSE(
+          !chunk_encoder_->AddRecord(record, std::move(serialize_options)))) {
+    return Fail(*chunk_encoder_);
+  }
+  last_record_is_valid_ = true;
+  return true;
+}
+
+bool RecordWriterBase::Producer::WriteRecord(absl::string_view record) {
+  return WriteRecordImpl(record);
+}
+
+template <typename Src,
+          std::enable_if_t<std::is_same<Src, std::string>::value, int>>
+bool RecordWriterBase::Producer::WriteRecord(Src&& record) {
+  // `std::move(record)` is correct and `std::forward<Src>(record)` is not
+  // necessary: `Src` is always `std::string`, never an lvalue reference.
+  return WriteRecordImpl(std::move(record));
+}
+
+template bool RecordWriterBase::Producer::WriteRecord(std::string&& record);
+
+bool RecordWriterBase::Producer::WriteRecord(const Chain& record) {
+  return WriteRecordImpl(record);
+}
+
+bool RecordWriterBase::Producer::WriteRecord(Chain&& record) {
+  return WriteRecordImpl(std::move(record));
+}
+
+bool RecordWriterBase::Producer::WriteRecord(const absl::Cord& record) {
+  return WriteRecordImpl(record);
+}
+
+bool RecordWriterBase::Producer::WriteRecord(absl::Cord&& record) {
+  return WriteRecordImpl(std::move(record));
+}
+
+template <typename Record>
+inline bool RecordWriterBase::Producer::WriteRecordImpl(Record&& record) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  last_record_is_valid_ = false;
+  const uint64_t added_size = SaturatingAdd(IntCast<uint64_t>(record.size()),
+                                            uint64_t{sizeof(uint64_t)});
+  if (ABSL_PREDICT_FALSE(!PrepareChunk(added_size))) return false;
+  if (ABSL_PREDICT_FALSE(
+          !chunk_encoder_->AddRecord(std::forward<Record>(record)))) {
+    return Fail(*chunk_encoder_);
+  }
+  last_record_is_valid_ = true;
+  return true;
+}
+
+inline bool RecordWriterBase::Producer::PrepareChunk(uint64_t added_size) {
+  // Matches `RecordWriterBase::WriteRecordImpl()`.
+  if (ABSL_PREDICT_FALSE(chunk_size_so_far_ > desired_chunk_size_ ||
+                         added_size >
+                             desired_chunk_size_ - chunk_size_so_far_) &&
+      chunk_size_so_far_ > 0) {
+    if (ABSL_PREDICT_FALSE(!CloseChunk())) return false;
+  }
+  if (chunk_size_so_far_ == 0) {
+    chunk_encoder_ = worker_->MakeChunkEncoder();
+    chunk_begin_promise_ = std::promise<internal::FutureChunkBegin>();
+    chunk_begin_ = chunk_begin_promise_.get_future().share();
+  }
+  chunk_size_so_far_ += added_size;
+  return true;
+}
+
+inline bool RecordWriterBase::Producer::CloseChunk() {
+  chunk_size_so_far_ = 0;
+  if (ABSL_PREDICT_FALSE(!worker_->CloseProducerChunk(
+          std::move(chunk_encoder_), chunk_begin_promise_))) {
+    chunk_begin_promise_.set_value(internal::FutureChunkBegin());
+    return Fail(worker_->status());
+  }
+  return true;
+}
+
+bool RecordWriterBase::Producer::Flush() {
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  last_record_is_valid_ = false;
+  if (chunk_size_so_far_ == 0) return true;
+  return CloseChunk();
+}
+
+FutureRecordPosition RecordWriterBase::Producer::LastPos() const {
+  RIEGELI_ASSERT(last_record_is_valid())
+      << "Failed precondition of RecordWriterBase::Producer::LastPos(): "
+         "no record was recently written";
+  return FutureRecordPosition(internal::FutureChunkBegin(chunk_begin_),
+                              chunk_encoder_->num_records() - 1);
+}
+
 }  // namespace riegeli
@@ -47,6 +47,8 @@
 
 namespace riegeli {
 
+class ChunkEncoder;
+
 // Sets `record_type_name` and `file_descriptor` in metadata, based on the
 // message descriptor of the type of records.
 //
@@ -73,6 +75,7 @@ class RecordWriterBase : public Object {
     //     "zstd" (":" zstd_level)? |
     //     "snappy" |
     //     "window_log" ":" window_log |
+    //     "zstd_parallelism" ":" zstd_parallelism |
     //     "chunk_size" ":" chunk_size |
     //     "bucket_fraction" ":" bucket_fraction |
     //     "pad_to_block_boundary" (":" ("true" | "false"))? |
@@ -80,6 +83,7 @@ class RecordWriterBase : public Object {
     //   brotli_level ::= integer in the range [0..11] (default 6)
     //   zstd_level ::= integer in the range [-131072..22] (default 3)
     //   window_log ::= "auto" or integer in the range [10..31]
+    //   zstd_parallelism ::= non-negative integer
     //   chunk_size ::= "auto" or positive integer expressed as real with
     //     optional suffix [BkKMGTPE]
     //   bucket_fraction ::= real in the range [0..1]
@@ -424,6 +428,8 @@ class RecordWriterBase : public Object {
   // `get()` returns the resolved value. Can block.
   using FutureBool = std::shared_future<bool>;
 
+  class Producer;
+
   ~RecordWriterBase();
 
   // Returns the Riegeli/records file being written to. Unchanged by `Close()`.
@@ -502,9 +508,14 @@ class RecordWriterBase : public Object {
   // `LastPos().get().numeric()` returns the position as an integer of type
   // `Position`.
   //
+  // After `NewProducer()`, the position is determined when the chunk
+  // containing the record is closed, i.e. when the chunk is filled, or by
+  // `Flush()` or `Close()`. Until then `LastPos().get()` blocks; called in the
+  // thread using the `RecordWriter`, it never returns.
+  //
   // Precondition: a record was successfully written and there was no
-  // intervening call to `Close()`, `Flush()` or `FutureFlush()` (this can be
-  // checked with `last_record_is_valid()`).
+  // intervening call to `Close()`, `Flush()`, `FutureFlush()`, or the first
+  // `NewProducer()` (this can be checked with `last_record_is_valid()`).
   FutureRecordPosition LastPos() const;
 
   // Returns `true` if calling `LastPos()` is valid.
@@ -522,6 +533,12 @@ class RecordWriterBase : public Object {
   //
   // After opening the file, `Close()`, or `Flush()`, `Pos()` is the canonical
   // position of the next record, and `Pos().get().record_index() == 0`.
+  //
+  // After `NewProducer()`, the position is determined when the chunk which
+  // contains or would contain the next record written by the `RecordWriter`
+  // is closed, i.e. when the chunk is filled, or by `Flush()` or `Close()`.
+  // Until then `Pos().get()` blocks; called in the thread using the
+  // `RecordWriter`, it never returns.
   FutureRecordPosition Pos() const;
 
   // Returns an estimation of the file size if no more data is written, without
@@ -538,6 +555,33 @@ class RecordWriterBase : public Object {
   // background work to complete.
   Position EstimatedSize() const;
 
+  // Returns a `Producer`, which writes records to this `RecordWriter` from
+  // another thread.
+  //
+  // Each `Producer` collects records in its own chunk, without
+  // synchronization with other `Producer`s. Filled chunks are passed to the
+  // `RecordWriter`, which encodes them in background and writes them in the
+  // order in which they were filled. Records of different `Producer`s can be
+  // interleaved in the file at chunk granularity. Records of one `Producer`
+  // are written in the order of writing them.
+  //
+  // This replaces a mutex around `WriteRecord()` shared by all threads.
+  //
+  // `Producer`s require `Options::parallelism() > 0`, otherwise the returned
+  // `Producer` is failed.
+  //
+  // Functions of different `Producer`s can be called concurrently with each
+  // other, and with functions of the `RecordWriter` called from a single
+  // thread, including `NewProducer()`. All `Producer`s must be closed before
+  // the `RecordWriter` is closed.
+  //
+  // The first `NewProducer()` closes the currently open chunk of the
+  // `RecordWriter` if it contains records, like `Flush()` does. Afterwards the
+  // position of a chunk of the `RecordWriter` itself is determined when the
+  // chunk is closed, because chunks of `Producer`s can be written before it
+  // (see `LastPos()` and `Pos()`).
+  Producer NewProducer();
+
  protected:
   explicit RecordWriterBase(Closed) noexcept;
 
@@ -570,6 +614,89 @@ class RecordWriterBase : public Object {
   std::unique_ptr<Worker> worker_;
 };
 
+// `RecordWriterBase::Producer` writes records to a `RecordWriter` concurrently
+// with other `Producer`s. It is returned by `RecordWriterBase::NewProducer()`.
+//
+// A `Producer` is used by one thread at a time. `Close()` passes the remaining
+// records to the `RecordWriter`. `Close()` does not report failures of writing
+// them, which are reported by `RecordWriter::Close()` or `Flush()`.
+class RecordWriterBase::Producer : public Object {
+ public:
+  // Creates a closed `Producer`.
+  explicit Producer(Closed) noexcept;
+
+  Producer(Producer&& that) noexcept;
+  Producer& operator=(Producer&& that) noexcept;
+
+  ~Producer();
+
+  // Writes the next record, like `RecordWriterBase::WriteRecord()`.
+  //
+  // Return values:
+  //  * `true`  - success (`healthy()`)
+  //  * `false` - failure (`!healthy()`)
+  bool WriteRecord(const google::protobuf::MessageLite& record);
+  bool WriteRecord(const google::protobuf::MessageLite& record,
+                   SerializeOptions serialize_options);
+  bool WriteRecord(absl::string_view record);
+  template <typename Src,
+            std::enable_if_t<std::is_same<Src, std::string>::value, int> = 0>
+  bool WriteRecord(Src&& record);
+  bool WriteRecord(const Chain& record);
+  bool WriteRecord(Chain&& record);
+  bool WriteRecord(const absl::Cord& record);
+  bool WriteRecord(absl::Cord&& record);
+
+  // Passes records written so far to the `RecordWriter`, closing the current
+  // chunk. This does not flush the `RecordWriter`.
+  //
+  // This degrades compression density if used too often.
+  //
+  // Return values:
+  //  * `true`  - success (`healthy()`)
+  //  * `false` - failure (`!healthy()`)
+  bool Flush();
+
+  // Returns the canonical position of the last record written.
+  //
+  // The chunk containing the record is placed in the file when it is passed to
+  // the `RecordWriter`, hence `LastPos().get()` blocks until then, i.e. until
+  // the chunk is filled, or until `Flush()` or `Close()` of this `Producer`.
+  //
+  // Precondition: a record was successfully written and there was no
+  // intervening call to `Close()` or `Flush()` (this can be checked with
+  // `last_record_is_valid()`).
+  FutureRecordPosition LastPos() const;
+
+  // Returns `true` if calling `LastPos()` is valid.
+  bool last_record_is_valid() const { return last_record_is_valid_; }
+
+ protected:
+  void Done() override;
+
+ private:
+  friend class RecordWriterBase;
+
+  explicit Producer(Worker* worker, uint64_t desired_chunk_size);
+
+  template <typename Record>
+  bool WriteRecordImpl(Record&& record);
+  bool PrepareChunk(uint64_t added_size);
+  bool CloseChunk();
+
+  Worker* worker_ = nullptr;
+  uint64_t desired_chunk_size_ = 0;
+  uint64_t chunk_size_so_far_ = 0;
+  bool last_record_is_valid_ = false;
+  // If `chunk_size_so_far_ > 0`, the chunk being filled, otherwise `nullptr`
+  // or an unused encoder.
+  std::unique_ptr<ChunkEncoder> chunk_encoder_;
+  // Set to the beginning of the chunk being filled when it is passed to the
+  // `RecordWriter`. `chunk_begin_` is its future.
+  std::promise<internal::FutureChunkBegin> chunk_begin_promise_;
+  std::shared_future<internal::FutureChunkBegin> chunk_begin_;
+};
+
 // `RecordWriter` writes records to a Riegeli/records file. A record is
 // conceptually a binary string; usually it is a serialized proto message.
 //
@@ -679,6 +806,14 @@ inline bool RecordWriterBase::WriteRecord(
   return WriteRecord(record, SerializeOptions());
 }
 
+extern template bool RecordWriterBase::Producer::WriteRecord(
+    std::string&& record);
+
+inline bool RecordWriterBase::Producer::WriteRecord(
+    const google::protobuf::MessageLite& record) {
+  return WriteRecord(record, SerializeOptions());
+}
+
 template <typename Dest>
 inline RecordWriter<Dest>::RecordWriter(const Dest& dest, Options options)
     : dest_(dest) {
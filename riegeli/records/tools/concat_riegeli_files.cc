@@ -0,0 +1,104 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <fcntl.h>
+#include <stddef.h>
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/flags/usage.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_format.h"
+#include "riegeli/base/base.h"
+#include "riegeli/bytes/fd_reader.h"
+#include "riegeli/bytes/fd_writer.h"
+#include "riegeli/bytes/reader.h"
+#include "riegeli/records/chunk_writer.h"
+#include "riegeli/records/concat_records.h"
+
+ABSL_FLAG(std::string, output, "", "Output Riegeli/records file.");
+ABSL_FLAG(int, parallelism, 8,
+          "Number of input files read ahead in background.");
+ABSL_FLAG(int, max_open_files, 256,
+          "Maximum number of input files open at the same time.");
+
+namespace riegeli {
+namespace tools {
+namespace {
+
+// Concatenates `filenames` to `dest`, opening at most `max_open_files` at a
+// time.
+absl::Status ConcatFiles(const std::vector<std::string>& filenames,
+                         ChunkWriter& dest, size_t max_open_files) {
+  for (size_t begin = 0; begin < filenames.size(); begin += max_open_files) {
+    const size_t end = std::min(begin + max_open_files, filenames.size());
+    std::vector<FdReader<>> readers;
+    readers.reserve(end - begin);
+    for (size_t i = begin; i < end; ++i) {
+      readers.emplace_back(filenames[i], O_RDONLY);
+    }
+    std::vector<Reader*> srcs;
+    srcs.reserve(readers.size());
+    for (FdReader<>& reader : readers) srcs.push_back(&reader);
+    // Sources after the first group are appended to `dest`, which is at a
+    // non-zero position, so their metadata are not copied.
+    const absl::Status status =
+        ConcatRecords(srcs, dest,
+                      ConcatRecordsOptions().set_parallelism(
+                          absl::GetFlag(FLAGS_parallelism)));
+    if (!status.ok()) return status;
+    for (FdReader<>& reader : readers) {
+      if (!reader.Close()) return reader.status();
+    }
+  }
+  return absl::OkStatus();
+}
+
+const char kUsage[] =
+    "Usage: concat_riegeli_files --output=FILE (OPTION|FILE)...\n"
+    "\n"
+    "Concatenates Riegeli/records files without decoding their chunks.\n"
+    "File metadata are copied from the first file.\n";
+
+}  // namespace
+}  // namespace tools
+}  // namespace riegeli
+
+int main(int argc, char** argv) {
+  absl::SetProgramUsageMessage(riegeli::tools::kUsage);
+  const std::vector<char*> args = absl::ParseCommandLine(argc, argv);
+  const std::string output = absl::GetFlag(FLAGS_output);
+  if (output.empty() || absl::GetFlag(FLAGS_parallelism) < 0 ||
+      absl::GetFlag(FLAGS_max_open_files) <= 0) {
+    absl::Format(&std::cerr, "%s\n", riegeli::tools::kUsage);
+    return 1;
+  }
+  const std::vector<std::string> filenames(args.begin() + 1, args.end());
+  riegeli::DefaultChunkWriter<riegeli::FdWriter<>> chunk_writer(
+      std::forward_as_tuple(output, O_WRONLY | O_CREAT | O_TRUNC));
+  absl::Status status = riegeli::tools::ConcatFiles(
+      filenames, chunk_writer,
+      riegeli::IntCast<size_t>(absl::GetFlag(FLAGS_max_open_files)));
+  if (!chunk_writer.Close() && status.ok()) status = chunk_writer.status();
+  if (!status.ok()) {
+    absl::Format(&std::cerr, "%s\n", status.message());
+    return 1;
+  }
+}
@@ -0,0 +1,437 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/records/tools/convert_to_riegeli.h"
+
+#include <fcntl.h>
+#include <stddef.h>
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "absl/base/optimization.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include "riegeli/base/base.h"
+#include "riegeli/base/object.h"
+#include "riegeli/base/parallelism.h"
+#include "riegeli/base/status.h"
+#include "riegeli/bytes/fd_reader.h"
+#include "riegeli/bytes/fd_writer.h"
+#include "riegeli/csv/csv_reader.h"
+#include "riegeli/csv/csv_writer.h"
+#include "riegeli/lines/line_reading.h"
+#include "riegeli/records/record_writer.h"
+#include "riegeli/records/tools/tfrecord_recognizer.h"
+#include "tensorflow/core/lib/io/record_reader.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/file_system.h"
+#include "tensorflow/core/platform/status.h"
+#include "tensorflow/core/platform/tstring.h"
+
+namespace riegeli {
+
+// Before C++17 if a constexpr static data member is ODR-used, its definition at
+// namespace scope is required. Since C++17 these definitions are deprecated:
+// http://en.cppreference.com/w/cpp/language/static
+#if __cplusplus < 201703
+constexpr int ConvertToRiegeliOptions::kDefaultParallelism;
+constexpr size_t ConvertToRiegeliOptions::kDefaultBatchSize;
+#endif
+
+namespace {
+
+// Maximum number of batches of an input file decoded ahead of the batch being
+// written.
+constexpr size_t kMaxBufferedBatches = 2;
+
+// Maximum number of lines read by one call to `ReadLines()`.
+constexpr size_t kMaxLinesPerCall = 256;
+
+// Records stored contiguously, to avoid an allocation per record.
+struct RecordBatch {
+  // Estimates the memory used by the batch.
+  size_t EstimateMemory() const {
+    return data.size() + limits.size() * sizeof(size_t);
+  }
+
+  // Concatenated records.
+  std::string data;
+  // Positions in `data` where each record ends.
+  std::vector<size_t> limits;
+};
+
+// Records of an input file, decoded by a background thread and consumed in
+// order by the thread writing output.
+class DecodedInput {
+ public:
+  DecodedInput() noexcept {}
+
+  DecodedInput(const DecodedInput&) = delete;
+  DecodedInput& operator=(const DecodedInput&) = delete;
+
+  // Called by the decoding thread. Waits until there is room for the batch.
+  //
+  // Returns `false` if decoding should stop because the input was cancelled.
+  bool Push(RecordBatch&& batch);
+
+  // Called by the decoding thread after the last `Push()`.
+  void Finish(absl::Status status);
+
+  // Called by the writing thread. Waits until a batch is available.
+  //
+  // Return values:
+  //  * `true`  - success (`batch` is set)
+  //  * `false` - input ends (`status()` is set)
+  bool Pop(RecordBatch& batch);
+
+  // The result of decoding. Valid after `Pop()` returned `false`.
+  absl::Status status() const;
+
+  // Asks the decoding thread to stop, and waits until it finishes.
+  void CancelAndWait();
+
+ private:
+  bool HasRoom() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    return batches_.size() < kMaxBufferedBatches || cancelled_;
+  }
+  bool HasBatchOrFinished() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    return !batches_.empty() || finished_;
+  }
+  bool IsFinished() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    return finished_;
+  }
+
+  mutable absl::Mutex mutex_;
+  std::deque<RecordBatch> batches_ ABSL_GUARDED_BY(mutex_);
+  bool cancelled_ ABSL_GUARDED_BY(mutex_) = false;
+  bool finished_ ABSL_GUARDED_BY(mutex_) = false;
+  absl::Status status_ ABSL_GUARDED_BY(mutex_);
+};
+
+bool DecodedInput::Push(RecordBatch&& batch) {
+  absl::MutexLock lock(&mutex_);
+  mutex_.Await(absl::Condition(this, &DecodedInput::HasRoom));
+  if (ABSL_PREDICT_FALSE(cancelled_)) return false;
+  batches_.push_back(std::move(batch));
+  return true;
+}
+
+void DecodedInput::Finish(absl::Status status) {
+  absl::MutexLock lock(&mutex_);
+  status_ = std::move(status);
+  finished_ = true;
+}
+
+bool DecodedInput::Pop(RecordBatch& batch) {
+  absl::MutexLock lock(&mutex_);
+  mutex_.Await(absl::Condition(this, &DecodedInput::HasBatchOrFinished));
+  if (batches_.empty()) return false;
+  batch = std::move(batches_.front());
+  batches_.pop_front();
+  return true;
+}
+
+absl::Status DecodedInput::status() const {
+  absl::MutexLock lock(&mutex_);
+  return status_;
+}
+
+void DecodedInput::CancelAndWait() {
+  absl::MutexLock lock(&mutex_);
+  cancelled_ = true;
+  mutex_.Await(absl::Condition(this, &DecodedInput::IsFinished));
+  batches_.clear();
+}
+
+// Collects decoded records into batches of the given size and passes them to
+// a `DecodedInput`.
+class BatchBuilder {
+ public:
+  explicit BatchBuilder(size_t batch_size, DecodedInput& input)
+      : batch_size_(batch_size), input_(input) {}
+
+  BatchBuilder(const BatchBuilder&) = delete;
+  BatchBuilder& operator=(const BatchBuilder&) = delete;
+
+  // Returns `false` if decoding should stop because the input was cancelled.
+  bool AddRecord(absl::string_view record) {
+    batch_.data.append(record.data(), record.size());
+    batch_.limits.push_back(batch_.data.size());
+    if (batch_.EstimateMemory() >= batch_size_) return Flush();
+    return true;
+  }
+
+  // Passes the remaining records.
+  //
+  // Returns `false` if decoding should stop because the input was cancelled.
+  bool Flush() {
+    if (batch_.limits.empty()) return true;
+    const bool pushed = input_.Push(std::move(batch_));
+    batch_ = RecordBatch();
+    return pushed;
+  }
+
+ private:
+  size_t batch_size_;
+  DecodedInput& input_;
+  RecordBatch batch_;
+};
+
+absl::Status FromTFStatus(const tensorflow::Status& status) {
+  return absl::Status(static_cast<absl::StatusCode>(status.code()),
+                      status.error_message());
+}
+
+absl::Status DecodeTFRecord(const std::string& filename, BatchBuilder& batch) {
+  tensorflow::io::RecordReaderOptions record_reader_options;
+  {
+    FdReader<> file_reader(filename, O_RDONLY);
+    TFRecordRecognizer tfrecord_recognizer(&file_reader);
+    if (!tfrecord_recognizer.CheckFileFormat(record_reader_options)) {
+      // An empty file has no records.
+      return tfrecord_recognizer.status();
+    }
+    if (ABSL_PREDICT_FALSE(!tfrecord_recognizer.Close())) {
+      return tfrecord_recognizer.status();
+    }
+    if (ABSL_PREDICT_FALSE(!file_reader.Close())) return file_reader.status();
+  }
+  tensorflow::Env* const env = tensorflow::Env::Default();
+  std::unique_ptr<tensorflow::RandomAccessFile> file_reader;
+  {
+    const tensorflow::Status status =
+        env->NewRandomAccessFile(filename, &file_reader);
+    if (ABSL_PREDICT_FALSE(!status.ok())) return FromTFStatus(status);
+  }
+  tensorflow::io::SequentialRecordReader record_reader(file_reader.get(),
+                                                       record_reader_options);
+  tensorflow::tstring record;
+  for (;;) {
+    const tensorflow::Status status = record_reader.ReadRecord(&record);
+    if (!status.ok()) {
+      if (tensorflow::errors::IsOutOfRange(status)) break;
+      return FromTFStatus(status);
+    }
+    if (ABSL_PREDICT_FALSE(!batch.AddRecord(
+            absl::string_view(record.data(), record.size())))) {
+      return absl::OkStatus();
+    }
+  }
+  batch.Flush();
+  return absl::OkStatus();
+}
+
+absl::Status DecodeLines(const std::string& filename,
+                         ReadLineOptions read_line_options,
+                         BatchBuilder& batch) {
+  FdReader<> src(filename, O_RDONLY);
+  SkipBOM(src);
+  std::vector<absl::string_view> lines;
+  while (ReadLines(src, lines, kMaxLinesPerCall, read_line_options)) {
+    for (const absl::string_view line : lines) {
+      if (ABSL_PREDICT_FALSE(!batch.AddRecord(line))) return absl::OkStatus();
+    }
+  }
+  if (ABSL_PREDICT_FALSE(!src.healthy())) return src.status();
+  batch.Flush();
+  if (ABSL_PREDICT_FALSE(!src.Close())) return src.status();
+  return absl::OkStatus();
+}
+
+absl::Status DecodeCsv(const std::string& filename,
+                       const CsvReaderBase::Options& csv_options,
+                       BatchBuilder& batch) {
+  CsvReader<FdReader<>> csv_reader(std::forward_as_tuple(filename, O_RDONLY),
+                                   csv_options);
+  const CsvWriterBase::Options csv_writer_options =
+      CsvWriterBase::Options()
+          .set_field_separator(csv_options.field_separator())
+          .set_quote(csv_options.quote().value_or('"'));
+  std::vector<std::string> fields;
+  while (csv_reader.ReadRecord(fields)) {
+    if (ABSL_PREDICT_FALSE(!batch.AddRecord(
+            WriteCsvRecordToString(fields, csv_writer_options)))) {
+      return absl::OkStatus();
+    }
+  }
+  if (ABSL_PREDICT_FALSE(!csv_reader.healthy())) return csv_reader.status();
+  batch.Flush();
+  if (ABSL_PREDICT_FALSE(!csv_reader.Close())) return csv_reader.status();
+  return absl::OkStatus();
+}
+
+// Decodes records of `filename` and passes them to `input`.
+absl::Status DecodeInput(const std::string& filename,
+                         const ConvertToRiegeliOptions& options,
+                         DecodedInput& input) {
+  BatchBuilder batch(options.batch_size(), input);
+  switch (options.input_format()) {
+    case InputFormat::kTFRecord:
+      return DecodeTFRecord(filename, batch);
+    case InputFormat::kLines:
+      return DecodeLines(filename, options.read_line_options(), batch);
+    case InputFormat::kCsv:
+      return DecodeCsv(filename, options.csv_options(), batch);
+  }
+  RIEGELI_ASSERT_UNREACHABLE()
+      << "Unknown input format: " << static_cast<int>(options.input_format());
+}
+
+// Writes records to `RecordWriter`s, starting a new shard when the current
+// shard reaches its maximum size.
+class ShardedRecordWriter {
+ public:
+  explicit ShardedRecordWriter(absl::string_view output_filename,
+                               const ConvertToRiegeliOptions& options,
+                               ConvertToRiegeliStats& stats)
+      : output_filename_(output_filename), options_(options), stats_(stats) {}
+
+  ShardedRecordWriter(const ShardedRecordWriter&) = delete;
+  ShardedRecordWriter& operator=(const ShardedRecordWriter&) = delete;
+
+  // Starts the first shard, so that output exists even if there are no
+  // records.
+  absl::Status Open() { return OpenShard(); }
+
+  absl::Status WriteBatch(const RecordBatch& batch);
+
+  absl::Status Close();
+
+ private:
+  absl::Status OpenShard();
+  absl::Status CloseShard();
+
+  std::string output_filename_;
+  const ConvertToRiegeliOptions& options_;
+  ConvertToRiegeliStats& stats_;
+  RecordWriter<FdWriter<>> record_writer_{kClosed};
+};
+
+absl::Status ShardedRecordWriter::WriteBatch(const RecordBatch& batch) {
+  if (!record_writer_.is_open()) {
+    absl::Status status = OpenShard();
+    if (ABSL_PREDICT_FALSE(!status.ok())) return status;
+  }
+  size_t begin = 0;
+  for (const size_t limit : batch.limits) {
+    if (ABSL_PREDICT_FALSE(!record_writer_.WriteRecord(
+            absl::string_view(batch.data.data() + begin, limit - begin)))) {
+      return record_writer_.status();
+    }
+    begin = limit;
+  }
+  stats_.num_records += batch.limits.size();
+  stats_.num_record_bytes += batch.data.size();
+  // The size is checked once per batch because `EstimatedSize()` can involve
+  // synchronization with background threads.
+  if (options_.max_shard_size() > 0 &&
+      record_writer_.EstimatedSize() >= options_.max_shard_size()) {
+    return CloseShard();
+  }
+  return absl::OkStatus();
+}
+
+absl::Status ShardedRecordWriter::Close() {
+  if (!record_writer_.is_open()) return absl::OkStatus();
+  return CloseShard();
+}
+
+absl::Status ShardedRecordWriter::OpenShard() {
+  std::string filename =
+      options_.max_shard_size() > 0
+          ? absl::StrCat(output_filename_, "-",
+                         absl::Dec(stats_.output_filenames.size(),
+                                   absl::kZeroPad5))
+          : output_filename_;
+  record_writer_.Reset(
+      std::forward_as_tuple(filename, O_WRONLY | O_CREAT | O_TRUNC),
+      options_.record_writer_options());
+  stats_.output_filenames.push_back(std::move(filename));
+  if (ABSL_PREDICT_FALSE(!record_writer_.healthy())) {
+    return record_writer_.status();
+  }
+  return absl::OkStatus();
+}
+
+absl::Status ShardedRecordWriter::CloseShard() {
+  if (ABSL_PREDICT_FALSE(!record_writer_.Close())) {
+    return record_writer_.status();
+  }
+  stats_.num_output_bytes += record_writer_.dest().pos();
+  return absl::OkStatus();
+}
+
+}  // namespace
+
+absl::Status ConvertToRiegeli(absl::Span<const std::string> input_filenames,
+                              absl::string_view output_filename,
+                              ConvertToRiegeliOptions options,
+                              ConvertToRiegeliStats* stats) {
+  ConvertToRiegeliStats local_stats;
+  if (stats == nullptr) stats = &local_stats;
+  *stats = ConvertToRiegeliStats();
+  ShardedRecordWriter writer(output_filename, options, *stats);
+  absl::Status status = writer.Open();
+  // Inputs being decoded in background, beginning with the input being
+  // written.
+  std::deque<std::shared_ptr<DecodedInput>> pending;
+  size_t next_to_schedule = 0;
+  const size_t parallelism = IntCast<size_t>(options.parallelism());
+  for (size_t index = 0; status.ok() && index < input_filenames.size();
+       ++index) {
+    while (next_to_schedule < input_filenames.size() &&
+           pending.size() < parallelism) {
+      std::shared_ptr<DecodedInput> input = std::make_shared<DecodedInput>();
+      pending.push_back(input);
+      const std::string* const filename = &input_filenames[next_to_schedule++];
+      internal::ThreadPool::global().Schedule([input, filename, &options] {
+        input->Finish(DecodeInput(*filename, options, *input));
+      });
+    }
+    DecodedInput& input = *pending.front();
+    RecordBatch batch;
+    while (input.Pop(batch)) {
+      status = writer.WriteBatch(batch);
+      if (ABSL_PREDICT_FALSE(!status.ok())) break;
+    }
+    if (ABSL_PREDICT_FALSE(!status.ok())) break;
+    status = input.status();
+    if (ABSL_PREDICT_FALSE(!status.ok())) {
+      status = Annotate(status,
+                        absl::StrCat("converting ", input_filenames[index]));
+      break;
+    }
+    pending.pop_front();
+  }
+  // Inputs decoded in background refer to `input_filenames` and `options`,
+  // which must not be used after returning.
+  for (const std::shared_ptr<DecodedInput>& input : pending) {
+    input->CancelAndWait();
+  }
+  absl::Status close_status = writer.Close();
+  if (status.ok()) status = std::move(close_status);
+  return status;
+}
+
+}  // namespace riegeli
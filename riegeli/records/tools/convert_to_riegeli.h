@@ -0,0 +1,239 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_RECORDS_TOOLS_CONVERT_TO_RIEGELI_H_
+#define RIEGELI_RECORDS_TOOLS_CONVERT_TO_RIEGELI_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "riegeli/base/base.h"
+#include "riegeli/csv/csv_reader.h"
+#include "riegeli/lines/line_reading.h"
+#include "riegeli/records/record_writer.h"
+
+namespace riegeli {
+
+// Format of files converted by `ConvertToRiegeli()`.
+enum class InputFormat {
+  // TFRecord, uncompressed or compressed with zlib or gzip. Compression is
+  // detected automatically. Each TFRecord record becomes a record.
+  kTFRecord,
+  // Text split into lines. Each line without its terminator becomes a record.
+  kLines,
+  // CSV. Each CSV record becomes a record holding its fields encoded as a
+  // single CSV record, without a record terminator.
+  kCsv,
+};
+
+class ConvertToRiegeliOptions {
+ public:
+  ConvertToRiegeliOptions() noexcept {}
+
+  // Format of input files.
+  //
+  // Default: `InputFormat::kTFRecord`.
+  ConvertToRiegeliOptions& set_input_format(InputFormat input_format) & {
+    input_format_ = input_format;
+    return *this;
+  }
+  ConvertToRiegeliOptions&& set_input_format(InputFormat input_format) && {
+    return std::move(set_input_format(input_format));
+  }
+  InputFormat input_format() const { return input_format_; }
+
+  // Options of reading lines, used if `input_format() == InputFormat::kLines`.
+  //
+  // Default: `ReadLineOptions()`.
+  ConvertToRiegeliOptions& set_read_line_options(
+      ReadLineOptions read_line_options) & {
+    read_line_options_ = read_line_options;
+    return *this;
+  }
+  ConvertToRiegeliOptions&& set_read_line_options(
+      ReadLineOptions read_line_options) && {
+    return std::move(set_read_line_options(read_line_options));
+  }
+  ReadLineOptions read_line_options() const { return read_line_options_; }
+
+  // Options of parsing CSV, used if `input_format() == InputFormat::kCsv`.
+  //
+  // If `csv_options().read_header()`, the header is not converted to a record.
+  //
+  // If `csv_options().recovery()` is not `nullptr`, the recovery function may
+  // be called from background threads, concurrently with itself.
+  //
+  // Default: `CsvReaderBase::Options()`.
+  ConvertToRiegeliOptions& set_csv_options(
+      const CsvReaderBase::Options& csv_options) & {
+    csv_options_ = csv_options;
+    return *this;
+  }
+  ConvertToRiegeliOptions& set_csv_options(
+      CsvReaderBase::Options&& csv_options) & {
+    csv_options_ = std::move(csv_options);
+    return *this;
+  }
+  ConvertToRiegeliOptions&& set_csv_options(
+      const CsvReaderBase::Options& csv_options) && {
+    return std::move(set_csv_options(csv_options));
+  }
+  ConvertToRiegeliOptions&& set_csv_options(
+      CsvReaderBase::Options&& csv_options) && {
+    return std::move(set_csv_options(std::move(csv_options)));
+  }
+  CsvReaderBase::Options& csv_options() { return csv_options_; }
+  const CsvReaderBase::Options& csv_options() const { return csv_options_; }
+
+  // Options of writing output files.
+  //
+  // `record_writer_options().parallelism()` specifies how many chunks are
+  // encoded in background, which is usually what limits the throughput of
+  // conversion. It should be increased together with `parallelism()`.
+  //
+  // Default: `RecordWriterBase::Options()`.
+  ConvertToRiegeliOptions& set_record_writer_options(
+      const RecordWriterBase::Options& record_writer_options) & {
+    record_writer_options_ = record_writer_options;
+    return *this;
+  }
+  ConvertToRiegeliOptions& set_record_writer_options(
+      RecordWriterBase::Options&& record_writer_options) & {
+    record_writer_options_ = std::move(record_writer_options);
+    return *this;
+  }
+  ConvertToRiegeliOptions&& set_record_writer_options(
+      const RecordWriterBase::Options& record_writer_options) && {
+    return std::move(set_record_writer_options(record_writer_options));
+  }
+  ConvertToRiegeliOptions&& set_record_writer_options(
+      RecordWriterBase::Options&& record_writer_options) && {
+    return std::move(
+        set_record_writer_options(std::move(record_writer_options)));
+  }
+  RecordWriterBase::Options& record_writer_options() {
+    return record_writer_options_;
+  }
+  const RecordWriterBase::Options& record_writer_options() const {
+    return record_writer_options_;
+  }
+
+  // Maximum number of input files being decoded in background at a time.
+  //
+  // Records are written in the order of input files, so inputs decoded ahead
+  // wait for earlier inputs, each buffering a few batches of `batch_size()`.
+  //
+  // `parallelism` must be at least 1.
+  // Default: 8.
+  static constexpr int kDefaultParallelism = 8;
+  ConvertToRiegeliOptions& set_parallelism(int parallelism) & {
+    RIEGELI_ASSERT_GE(parallelism, 1)
+        << "Failed precondition of "
+           "ConvertToRiegeliOptions::set_parallelism(): "
+           "parallelism out of range";
+    parallelism_ = parallelism;
+    return *this;
+  }
+  ConvertToRiegeliOptions&& set_parallelism(int parallelism) && {
+    return std::move(set_parallelism(parallelism));
+  }
+  int parallelism() const { return parallelism_; }
+
+  // Approximate memory used by records passed at a time from a background
+  // thread decoding an input file to the `RecordWriter`, in bytes.
+  //
+  // `batch_size` must be at least 1.
+  // Default: 1M.
+  static constexpr size_t kDefaultBatchSize = size_t{1} << 20;
+  ConvertToRiegeliOptions& set_batch_size(size_t batch_size) & {
+    RIEGELI_ASSERT_GT(batch_size, 0u)
+        << "Failed precondition of "
+           "ConvertToRiegeliOptions::set_batch_size(): "
+           "zero batch size";
+    batch_size_ = batch_size;
+    return *this;
+  }
+  ConvertToRiegeliOptions&& set_batch_size(size_t batch_size) && {
+    return std::move(set_batch_size(batch_size));
+  }
+  size_t batch_size() const { return batch_size_; }
+
+  // If not 0, output is split into shards named `output_filename` followed by
+  // "-00000", "-00001", etc. A shard is closed and the next shard is started
+  // when `RecordWriterBase::EstimatedSize()` reaches `max_shard_size`. This is
+  // checked after each batch (see `set_batch_size()`), and the estimation does
+  // not include chunks being encoded, so shards can be somewhat larger,
+  // especially if `record_writer_options().parallelism() > 0`.
+  //
+  // If 0, output is written to `output_filename`.
+  //
+  // Default: 0.
+  ConvertToRiegeliOptions& set_max_shard_size(Position max_shard_size) & {
+    max_shard_size_ = max_shard_size;
+    return *this;
+  }
+  ConvertToRiegeliOptions&& set_max_shard_size(Position max_shard_size) && {
+    return std::move(set_max_shard_size(max_shard_size));
+  }
+  Position max_shard_size() const { return max_shard_size_; }
+
+ private:
+  InputFormat input_format_ = InputFormat::kTFRecord;
+  ReadLineOptions read_line_options_;
+  CsvReaderBase::Options csv_options_;
+  RecordWriterBase::Options record_writer_options_;
+  int parallelism_ = kDefaultParallelism;
+  size_t batch_size_ = kDefaultBatchSize;
+  Position max_shard_size_ = 0;
+};
+
+// Counters filled by `ConvertToRiegeli()`, e.g. for reporting throughput.
+struct ConvertToRiegeliStats {
+  // Number of records written.
+  uint64_t num_records = 0;
+  // Total size of records written, before encoding.
+  Position num_record_bytes = 0;
+  // Total size of output files.
+  Position num_output_bytes = 0;
+  // Names of output files, in the order of their records.
+  std::vector<std::string> output_filenames;
+};
+
+// Converts records of `input_filenames` in the format specified by
+// `options.input_format()` to Riegeli/records, writing them to
+// `output_filename` or to its shards (see
+// `ConvertToRiegeliOptions::set_max_shard_size()`).
+//
+// Input files are decoded by background threads, several at a time. Records
+// are written in the order of input files.
+//
+// If `stats` is not `nullptr`, it is filled with counters, also on failure.
+//
+// Returns the first failure of reading an input file or of writing output.
+absl::Status ConvertToRiegeli(
+    absl::Span<const std::string> input_filenames,
+    absl::string_view output_filename,
+    ConvertToRiegeliOptions options = ConvertToRiegeliOptions(),
+    ConvertToRiegeliStats* stats = nullptr);
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_RECORDS_TOOLS_CONVERT_TO_RIEGELI_H_
@@ -0,0 +1,136 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdint.h>
+
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/flags/usage.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "riegeli/base/base.h"
+#include "riegeli/csv/csv_reader.h"
+#include "riegeli/records/record_writer.h"
+#include "riegeli/records/tools/convert_to_riegeli.h"
+
+ABSL_FLAG(std::string, output, "",
+          "Output Riegeli/records file, or a prefix of shard names if "
+          "--max_shard_size is not 0.");
+ABSL_FLAG(std::string, input_format, "tfrecord",
+          "Format of input files: tfrecord (uncompressed, zlib, or gzip), "
+          "lines, or csv.");
+ABSL_FLAG(std::string, field_separator, ",",
+          "CSV field separator, a single character.");
+ABSL_FLAG(std::string, record_writer_options, "parallelism:8",
+          "Riegeli/records writer options. See "
+          "riegeli::RecordWriterBase::Options::FromString().");
+ABSL_FLAG(int, parallelism, 8,
+          "Number of input files decoded in background at a time.");
+ABSL_FLAG(uint64_t, max_shard_size, 0,
+          "If not 0, output is split into shards of approximately this size, "
+          "named by --output followed by -00000, -00001, etc.");
+
+namespace riegeli {
+namespace tools {
+namespace {
+
+const char kUsage[] =
+    "Usage: convert_to_riegeli_files --output=FILE (OPTION|FILE)...\n"
+    "\n"
+    "Converts TFRecord files, text files split into lines, or CSV files to "
+    "Riegeli/records, and reports throughput.\n";
+
+bool ParseInputFormat(absl::string_view text, InputFormat& input_format) {
+  if (text == "tfrecord") {
+    input_format = InputFormat::kTFRecord;
+  } else if (text == "lines") {
+    input_format = InputFormat::kLines;
+  } else if (text == "csv") {
+    input_format = InputFormat::kCsv;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+}  // namespace tools
+}  // namespace riegeli
+
+int main(int argc, char** argv) {
+  absl::SetProgramUsageMessage(riegeli::tools::kUsage);
+  const std::vector<char*> args = absl::ParseCommandLine(argc, argv);
+  const std::string output = absl::GetFlag(FLAGS_output);
+  riegeli::InputFormat input_format;
+  if (output.empty() ||
+      !riegeli::tools::ParseInputFormat(absl::GetFlag(FLAGS_input_format),
+                                        input_format) ||
+      absl::GetFlag(FLAGS_field_separator).size() != 1 ||
+      absl::GetFlag(FLAGS_parallelism) < 1) {
+    absl::Format(&std::cerr, "%s\n", riegeli::tools::kUsage);
+    return 1;
+  }
+  riegeli::RecordWriterBase::Options record_writer_options;
+  {
+    const absl::Status status = record_writer_options.FromString(
+        absl::GetFlag(FLAGS_record_writer_options));
+    if (!status.ok()) {
+      absl::Format(&std::cerr, "%s\n", status.message());
+      return 1;
+    }
+  }
+  riegeli::ConvertToRiegeliOptions options;
+  options.set_input_format(input_format)
+      .set_record_writer_options(std::move(record_writer_options))
+      .set_parallelism(absl::GetFlag(FLAGS_parallelism))
+      .set_max_shard_size(absl::GetFlag(FLAGS_max_shard_size));
+  options.csv_options().set_field_separator(
+      absl::GetFlag(FLAGS_field_separator)[0]);
+  const std::vector<std::string> filenames(args.begin() + 1, args.end());
+  riegeli::ConvertToRiegeliStats stats;
+  const absl::Time start_time = absl::Now();
+  const absl::Status status =
+      riegeli::ConvertToRiegeli(filenames, output, std::move(options), &stats);
+  const double seconds = absl::ToDoubleSeconds(absl::Now() - start_time);
+  if (!status.ok()) {
+    absl::Format(&std::cerr, "%s\n", status.message());
+    return 1;
+  }
+  absl::Format(&std::cout,
+               "Converted %u files to %u files in %.3f s\n"
+               "Records:      %u (%.1f records/s)\n"
+               "Record bytes: %u (%.3f MB/s)\n"
+               "Output bytes: %u (%.3f of record bytes)\n",
+               filenames.size(), stats.output_filenames.size(), seconds,
+               stats.num_records,
+               seconds > 0.0 ? static_cast<double>(stats.num_records) / seconds
+                             : 0.0,
+               stats.num_record_bytes,
+               seconds > 0.0 ? static_cast<double>(stats.num_record_bytes) /
+                                   1000000.0 / seconds
+                             : 0.0,
+               stats.num_output_bytes,
+               stats.num_record_bytes > 0
+                   ? static_cast<double>(stats.num_output_bytes) /
+                         static_cast<double>(stats.num_record_bytes)
+                   : 0.0);
+}
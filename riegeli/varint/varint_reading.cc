@@ -18,10 +18,272 @@
 #include <stdint.h>
 
 #include "absl/base/optimization.h"
+#include "absl/numeric/bits.h"
 #include "absl/types/optional.h"
+#include "absl/types/span.h"
+#include "riegeli/base/base.h"
 #include "riegeli/bytes/reader.h"
+#include "riegeli/endian/endian_reading.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RIEGELI_INTERNAL_VARINT_READING_SSE2 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define RIEGELI_INTERNAL_VARINT_READING_NEON 1
+#endif
 
 namespace riegeli {
+
+namespace {
+
+// If 16 bytes starting at `src` are all single-byte varints and `dest` has
+// room for them, stores them to `dest[0..15]` and returns `true`.
+//
+// Otherwise sets `continuations` to a bitmask of these bytes which have the
+// continuation bit set, starting from the least significant bit, and returns
+// `false`.
+#if RIEGELI_INTERNAL_VARINT_READING_SSE2
+
+inline bool ReadSingleByteVarints16(const char* src, uint32_t* dest,
+                                    uint32_t* dest_end,
+                                    uint32_t& continuations) {
+  const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+  continuations = static_cast<uint32_t>(_mm_movemask_epi8(data));
+  if (continuations != 0 || PtrDistance(dest, dest_end) < 16) return false;
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i data16[2] = {_mm_unpacklo_epi8(data, zero),
+                             _mm_unpackhi_epi8(data, zero)};
+  for (size_t i = 0; i < 2; ++i) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i * 8),
+                     _mm_unpacklo_epi16(data16[i], zero));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i * 8 + 4),
+                     _mm_unpackhi_epi16(data16[i], zero));
+  }
+  return true;
+}
+
+inline bool ReadSingleByteVarints16(const char* src, uint64_t* dest,
+                                    uint64_t* dest_end,
+                                    uint32_t& continuations) {
+  const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+  continuations = static_cast<uint32_t>(_mm_movemask_epi8(data));
+  if (continuations != 0 || PtrDistance(dest, dest_end) < 16) return false;
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i data16[2] = {_mm_unpacklo_epi8(data, zero),
+                             _mm_unpackhi_epi8(data, zero)};
+  for (size_t i = 0; i < 2; ++i) {
+    const __m128i data32[2] = {_mm_unpacklo_epi16(data16[i], zero),
+                               _mm_unpackhi_epi16(data16[i], zero)};
+    for (size_t j = 0; j < 2; ++j) {
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i * 8 + j * 4),
+                       _mm_unpacklo_epi32(data32[j], zero));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i * 8 + j * 4 + 2),
+                       _mm_unpackhi_epi32(data32[j], zero));
+    }
+  }
+  return true;
+}
+
+#elif RIEGELI_INTERNAL_VARINT_READING_NEON
+
+// Returns a bitmask of bytes of `data` with the highest bit set, starting from
+// the least significant bit.
+inline uint32_t HighBits(uint8x16_t data) {
+  static const uint8_t kBits[16] = {1, 2, 4, 8, 16, 32, 64, 128,
+                                    1, 2, 4, 8, 16, 32, 64, 128};
+  const uint8x16_t masked =
+      vandq_u8(vcltq_s8(vreinterpretq_s8_u8(data), vdupq_n_s8(0)),
+               vld1q_u8(kBits));
+  return uint32_t{vaddv_u8(vget_low_u8(masked))} |
+         (uint32_t{vaddv_u8(vget_high_u8(masked))} << 8);
+}
+
+inline bool ReadSingleByteVarints16(const char* src, uint32_t* dest,
+                                    uint32_t* dest_end,
+                                    uint32_t& continuations) {
+  const uint8x16_t data = vld1q_u8(reinterpret_cast<const uint8_t*>(src));
+  continuations = HighBits(data);
+  if (continuations != 0 || PtrDistance(dest, dest_end) < 16) return false;
+  const uint16x8_t data16[2] = {vmovl_u8(vget_low_u8(data)),
+                                vmovl_u8(vget_high_u8(data))};
+  for (size_t i = 0; i < 2; ++i) {
+    vst1q_u32(dest + i * 8, vmovl_u16(vget_low_u16(data16[i])));
+    vst1q_u32(dest + i * 8 + 4, vmovl_u16(vget_high_u16(data16[i])));
+  }
+  return true;
+}
+
+inline bool ReadSingleByteVarints16(const char* src, uint64_t* dest,
+                                    uint64_t* dest_end,
+                                    uint32_t& continuations) {
+  const uint8x16_t data = vld1q_u8(reinterpret_cast<const uint8_t*>(src));
+  continuations = HighBits(data);
+  if (continuations != 0 || PtrDistance(dest, dest_end) < 16) return false;
+  const uint16x8_t data16[2] = {vmovl_u8(vget_low_u8(data)),
+                                vmovl_u8(vget_high_u8(data))};
+  for (size_t i = 0; i < 2; ++i) {
+    const uint32x4_t data32[2] = {vmovl_u16(vget_low_u16(data16[i])),
+                                  vmovl_u16(vget_high_u16(data16[i]))};
+    for (size_t j = 0; j < 2; ++j) {
+      vst1q_u64(dest + i * 8 + j * 4, vmovl_u32(vget_low_u32(data32[j])));
+      vst1q_u64(dest + i * 8 + j * 4 + 2,
+                vmovl_u32(vget_high_u32(data32[j])));
+    }
+  }
+  return true;
+}
+
+#else
+
+template <typename T>
+inline bool ReadSingleByteVarints16(const char* src, T* dest, T* dest_end,
+                                    uint32_t& continuations) {
+  continuations = 0;
+  for (size_t i = 0; i < 16; ++i) {
+    continuations |= uint32_t{static_cast<uint8_t>(src[i]) >> 7} << i;
+  }
+  if (continuations != 0 || PtrDistance(dest, dest_end) < 16) return false;
+  for (size_t i = 0; i < 16; ++i) dest[i] = static_cast<uint8_t>(src[i]);
+  return true;
+}
+
+#endif
+
+// Removes continuation bits from the little endian representation of a varint
+// of up to 8 bytes, concatenating its 7-bit groups. Bytes after the varint must
+// be zero.
+inline uint64_t GatherVarintBits(uint64_t data) {
+  data &= 0x7f7f7f7f7f7f7f7f;
+  // Concatenate pairs of 7-bit groups to 14-bit groups, then those to 28-bit
+  // groups, and finally to 56 bits.
+  data = (data & 0x007f007f007f007f) | ((data & 0x7f007f007f007f00) >> 1);
+  data = (data & 0x00003fff00003fff) | ((data & 0x3fff00003fff0000) >> 2);
+  return (data & 0x000000000fffffff) | ((data & 0x0fffffff00000000) >> 4);
+}
+
+inline bool ReadVarint(Reader& src, uint32_t& dest) {
+  return ReadVarint32(src, dest);
+}
+
+inline bool ReadVarint(Reader& src, uint64_t& dest) {
+  return ReadVarint64(src, dest);
+}
+
+inline absl::optional<const char*> ReadVarint(const char* src,
+                                              const char* limit,
+                                              uint32_t& dest) {
+  return ReadVarint32(src, limit, dest);
+}
+
+inline absl::optional<const char*> ReadVarint(const char* src,
+                                              const char* limit,
+                                              uint64_t& dest) {
+  return ReadVarint64(src, limit, dest);
+}
+
+// Reads varints from `src` to `dest` while at least 24 bytes are available,
+// updating `src` and `dest`.
+//
+// Returns `false` if a varint is invalid, leaving `src` at its beginning.
+template <typename T>
+inline bool ReadVarintsFast(const char*& src, const char* limit, T*& dest,
+                            T* dest_end) {
+  // Varints with more bytes are left for `ReadVarint{32,64}()`, which also
+  // validates them.
+  constexpr size_t kMaxGatheredLength = sizeof(T) == 4 ? 4 : 8;
+  while (dest != dest_end && PtrDistance(src, limit) >= 24) {
+    uint32_t continuations;
+    if (ReadSingleByteVarints16(src, dest, dest_end, continuations)) {
+      src += 16;
+      dest += 16;
+      continue;
+    }
+    // Decode varints ending in the 16 bytes classified by
+    // `ReadSingleByteVarints16()`. Their beginnings are at most 15 bytes after
+    // `src`, so 8 bytes can be loaded from there.
+    uint32_t terminators = ~continuations & 0xffff;
+    size_t begin = 0;
+    while (terminators != 0) {
+      const size_t end = IntCast<size_t>(absl::countr_zero(terminators)) + 1;
+      if (ABSL_PREDICT_FALSE(end - begin > kMaxGatheredLength)) break;
+      *dest++ = static_cast<T>(GatherVarintBits(
+          ReadLittleEndian64(src + begin) &
+          (~uint64_t{0} >> (64 - (end - begin) * 8))));
+      begin = end;
+      if (dest == dest_end) break;
+      terminators &= terminators - 1;
+    }
+    src += begin;
+    if (begin == 0) {
+      // The first varint is longer.
+      const absl::optional<const char*> cursor = ReadVarint(src, limit, *dest);
+      if (ABSL_PREDICT_FALSE(cursor == absl::nullopt)) return false;
+      src = *cursor;
+      ++dest;
+    }
+  }
+  return true;
+}
+
+template <typename T>
+inline absl::optional<const char*> ReadVarintsImpl(const char* src,
+                                                   const char* limit,
+                                                   absl::Span<T> dest) {
+  T* dest_ptr = dest.data();
+  T* const dest_end = dest.data() + dest.size();
+  if (ABSL_PREDICT_FALSE(!ReadVarintsFast(src, limit, dest_ptr, dest_end))) {
+    return absl::nullopt;
+  }
+  while (dest_ptr != dest_end) {
+    const absl::optional<const char*> cursor =
+        ReadVarint(src, limit, *dest_ptr);
+    if (ABSL_PREDICT_FALSE(cursor == absl::nullopt)) return absl::nullopt;
+    src = *cursor;
+    ++dest_ptr;
+  }
+  return src;
+}
+
+template <typename T>
+inline bool ReadVarintsImpl(Reader& src, absl::Span<T> dest) {
+  T* dest_ptr = dest.data();
+  T* const dest_end = dest.data() + dest.size();
+  while (dest_ptr != dest_end) {
+    const char* cursor = src.cursor();
+    const bool ok = ReadVarintsFast(cursor, src.limit(), dest_ptr, dest_end);
+    src.set_cursor(cursor);
+    if (ABSL_PREDICT_FALSE(!ok)) return false;
+    if (dest_ptr == dest_end) break;
+    // Fewer than 24 bytes are available. Read one varint individually, which
+    // pulls more data if needed.
+    if (ABSL_PREDICT_FALSE(!ReadVarint(src, *dest_ptr))) return false;
+    ++dest_ptr;
+  }
+  return true;
+}
+
+}  // namespace
+
+bool ReadVarints32(Reader& src, absl::Span<uint32_t> dest) {
+  return ReadVarintsImpl(src, dest);
+}
+
+bool ReadVarints64(Reader& src, absl::Span<uint64_t> dest) {
+  return ReadVarintsImpl(src, dest);
+}
+
+absl::optional<const char*> ReadVarints32(const char* src, const char* limit,
+                                          absl::Span<uint32_t> dest) {
+  return ReadVarintsImpl(src, limit, dest);
+}
+
+absl::optional<const char*> ReadVarints64(const char* src, const char* limit,
+                                          absl::Span<uint64_t> dest) {
+  return ReadVarintsImpl(src, limit, dest);
+}
+
 namespace internal {
 
 absl::optional<const char*> ReadVarint32Slow(const char* src, const char* limit,
@@ -0,0 +1,146 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/varint/varint_writing.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "absl/base/optimization.h"
+#include "absl/types/span.h"
+#include "riegeli/base/base.h"
+#include "riegeli/bytes/backward_writer.h"
+#include "riegeli/bytes/writer.h"
+#include "riegeli/endian/endian_writing.h"
+#include "riegeli/varint/varint_internal.h"
+
+namespace riegeli {
+
+namespace {
+
+// Spreads 7-bit groups of the lowest 56 bits of `data` to consecutive bytes,
+// with the highest bits clear.
+inline uint64_t SpreadVarintBits(uint64_t data) {
+  // Split 56 bits to 28-bit groups, then those to 14-bit groups, and finally to
+  // 7-bit groups.
+  data = (data & 0x000000000fffffff) | ((data & 0x00fffffff0000000) << 4);
+  data = (data & 0x00003fff00003fff) | ((data & 0x0fffc0000fffc000) << 2);
+  return (data & 0x007f007f007f007f) | ((data & 0x3f803f803f803f80) << 1);
+}
+
+inline size_t LengthVarint(uint32_t data) { return LengthVarint32(data); }
+inline size_t LengthVarint(uint64_t data) { return LengthVarint64(data); }
+
+inline char* WriteVarint(uint32_t data, char* dest) {
+  return WriteVarint32(data, dest);
+}
+inline char* WriteVarint(uint64_t data, char* dest) {
+  return WriteVarint64(data, dest);
+}
+
+// Number of values written by one `Push()` in `WriteVarintsImpl()`.
+constexpr size_t kValuesPerPush = 256;
+
+template <typename T>
+inline char* WriteVarintsImpl(absl::Span<const T> data, char* dest) {
+  const T* iter = data.data();
+  const T* const end = data.data() + data.size();
+  // Values are processed in blocks of 8 while at least 16 values remain.
+  //
+  // Storing 8 bytes can write up to 7 bytes after the varint. They are
+  // overwritten by the following varints, each of which takes at least 1 byte.
+  while (PtrDistance(iter, end) >= 16) {
+    T all_bits = 0;
+    for (size_t i = 0; i < 8; ++i) all_bits |= iter[i];
+    if (all_bits < 0x80) {
+      // A common case of small values: all varints take 1 byte.
+      for (size_t i = 0; i < 8; ++i) dest[i] = static_cast<char>(iter[i]);
+      iter += 8;
+      dest += 8;
+      continue;
+    }
+    for (size_t i = 0; i < 8; ++i) {
+      const uint64_t value = *iter++;
+      if (ABSL_PREDICT_FALSE(value >= uint64_t{1} << 56)) {
+        dest = WriteVarint64(value, dest);
+        continue;
+      }
+      const size_t length = LengthVarint64(value);
+      WriteLittleEndian64(
+          SpreadVarintBits(value) |
+              (0x8080808080808080 & ~(~uint64_t{0} << ((length - 1) * 8))),
+          dest);
+      dest += length;
+    }
+  }
+  while (iter != end) dest = WriteVarint(*iter++, dest);
+  return dest;
+}
+
+template <typename T>
+inline bool WriteVarintsImpl(absl::Span<const T> data, Writer& dest) {
+  constexpr size_t kMaxLength =
+      sizeof(T) == 4 ? kMaxLengthVarint32 : kMaxLengthVarint64;
+  while (!data.empty()) {
+    const size_t length = UnsignedMin(data.size(), kValuesPerPush);
+    if (ABSL_PREDICT_FALSE(!dest.Push(length * kMaxLength))) return false;
+    dest.set_cursor(WriteVarintsImpl(data.subspan(0, length), dest.cursor()));
+    data.remove_prefix(length);
+  }
+  return true;
+}
+
+template <typename T>
+inline bool WriteVarintsImpl(absl::Span<const T> data, BackwardWriter& dest) {
+  // Write the last values first, so that the whole array is written backwards.
+  while (!data.empty()) {
+    const size_t length = UnsignedMin(data.size(), kValuesPerPush);
+    const absl::Span<const T> last = data.subspan(data.size() - length);
+    size_t encoded_length = 0;
+    for (const T value : last) encoded_length += LengthVarint(value);
+    if (ABSL_PREDICT_FALSE(!dest.Push(encoded_length))) return false;
+    dest.move_cursor(encoded_length);
+    WriteVarintsImpl(last, dest.cursor());
+    data.remove_suffix(length);
+  }
+  return true;
+}
+
+}  // namespace
+
+bool WriteVarints32(absl::Span<const uint32_t> data, Writer& dest) {
+  return WriteVarintsImpl(data, dest);
+}
+
+bool WriteVarints64(absl::Span<const uint64_t> data, Writer& dest) {
+  return WriteVarintsImpl(data, dest);
+}
+
+bool WriteVarints32(absl::Span<const uint32_t> data, BackwardWriter& dest) {
+  return WriteVarintsImpl(data, dest);
+}
+
+bool WriteVarints64(absl::Span<const uint64_t> data, BackwardWriter& dest) {
+  return WriteVarintsImpl(data, dest);
+}
+
+char* WriteVarints32(absl::Span<const uint32_t> data, char* dest) {
+  return WriteVarintsImpl(data, dest);
+}
+
+char* WriteVarints64(absl::Span<const uint64_t> data, char* dest) {
+  return WriteVarintsImpl(data, dest);
+}
+
+}  // namespace riegeli
@@ -19,6 +19,7 @@
 #include <stdint.h>
 
 #include "absl/base/optimization.h"
+#include "absl/types/span.h"
 #include "riegeli/base/base.h"
 #include "riegeli/base/port.h"
 #include "riegeli/bytes/backward_writer.h"
@@ -37,6 +38,19 @@ bool WriteVarint64(uint64_t data, Writer& dest);
 bool WriteVarint32(uint32_t data, BackwardWriter& dest);
 bool WriteVarint64(uint64_t data, BackwardWriter& dest);
 
+// Writes an array of varints.
+//
+// This is faster than writing them individually. 7-bit groups of each value
+// are spread to bytes with a few shifts, and stored 8 bytes at a time.
+//
+// Return values:
+//  * `true`  - success (`dest.healthy()`)
+//  * `false` - failure (`!dest.healthy()`)
+bool WriteVarints32(absl::Span<const uint32_t> data, Writer& dest);
+bool WriteVarints64(absl::Span<const uint64_t> data, Writer& dest);
+bool WriteVarints32(absl::Span<const uint32_t> data, BackwardWriter& dest);
+bool WriteVarints64(absl::Span<const uint64_t> data, BackwardWriter& dest);
+
 // Returns the length needed to write a given value as a varint, which is at
 // most `kMaxLengthVarint{32,64}`.
 size_t LengthVarint32(uint32_t data);
@@ -50,6 +64,14 @@ size_t LengthVarint64(uint64_t data);
 char* WriteVarint32(uint32_t data, char* dest);
 char* WriteVarint64(uint64_t data, char* dest);
 
+// Writes an array of varints to an array.
+//
+// Writes the sum of `LengthVarint{32,64}()` of values in `data` to `dest[]`.
+//
+// Returns the updated `dest` after the written values.
+char* WriteVarints32(absl::Span<const uint32_t> data, char* dest);
+char* WriteVarints64(absl::Span<const uint64_t> data, char* dest);
+
 // Implementation details follow.
 
 inline bool WriteVarint32(uint32_t data, Writer& dest) {
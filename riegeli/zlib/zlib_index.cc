@@ -0,0 +1,201 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "riegeli/zlib/zlib_index.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/base/optimization.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/optional.h"
+#include "riegeli/base/base.h"
+#include "riegeli/bytes/reader.h"
+#include "riegeli/bytes/writer.h"
+#include "riegeli/varint/varint_reading.h"
+#include "riegeli/varint/varint_writing.h"
+
+namespace riegeli {
+
+// Before C++17 if a constexpr static data member is ODR-used, its definition at
+// namespace scope is required. Since C++17 these definitions are deprecated:
+// http://en.cppreference.com/w/cpp/language/static
+#if __cplusplus < 201703
+constexpr Position ZlibIndex::kDefaultSpacing;
+#endif
+
+namespace {
+
+// Maximum size of a deflate window.
+constexpr size_t kMaxWindowSize = size_t{1} << 15;
+
+}  // namespace
+
+size_t ZlibIndex::num_checkpoints() const {
+  RIEGELI_ASSERT(enabled())
+      << "Failed precondition of ZlibIndex::num_checkpoints(): index disabled";
+  absl::MutexLock lock(&repr_->mutex);
+  return repr_->checkpoints.size();
+}
+
+absl::optional<Position> ZlibIndex::size() const {
+  RIEGELI_ASSERT(enabled())
+      << "Failed precondition of ZlibIndex::size(): index disabled";
+  absl::MutexLock lock(&repr_->mutex);
+  return repr_->size;
+}
+
+absl::optional<ZlibIndex::Checkpoint> ZlibIndex::Find(Position pos) const {
+  absl::MutexLock lock(&repr_->mutex);
+  const std::vector<Checkpoint>& checkpoints = repr_->checkpoints;
+  const std::vector<Checkpoint>::const_iterator next = std::upper_bound(
+      checkpoints.begin(), checkpoints.end(), pos,
+      [](Position pos, const Checkpoint& checkpoint) {
+        return pos < checkpoint.decompressed_pos;
+      });
+  if (next == checkpoints.begin()) return absl::nullopt;
+  return *std::prev(next);
+}
+
+bool ZlibIndex::NeedsCheckpoint(Position pos) const {
+  absl::MutexLock lock(&repr_->mutex);
+  const std::vector<Checkpoint>& checkpoints = repr_->checkpoints;
+  const std::vector<Checkpoint>::const_iterator next = std::upper_bound(
+      checkpoints.begin(), checkpoints.end(), pos,
+      [](Position pos, const Checkpoint& checkpoint) {
+        return pos < checkpoint.decompressed_pos;
+      });
+  return NeedsCheckpointLocked(pos, next);
+}
+
+inline bool ZlibIndex::NeedsCheckpointLocked(
+    Position pos, std::vector<Checkpoint>::const_iterator next) const {
+  const std::vector<Checkpoint>& checkpoints = repr_->checkpoints;
+  // Checkpoints can be added out of order by readers decompressing different
+  // ranges of the stream, so both neighbors are checked.
+  return (next == checkpoints.begin() ||
+          pos - std::prev(next)->decompressed_pos >= repr_->spacing) &&
+         (next == checkpoints.end() ||
+          next->decompressed_pos - pos >= repr_->spacing);
+}
+
+void ZlibIndex::AddCheckpoint(Checkpoint&& checkpoint) {
+  absl::MutexLock lock(&repr_->mutex);
+  std::vector<Checkpoint>& checkpoints = repr_->checkpoints;
+  const std::vector<Checkpoint>::iterator next = std::upper_bound(
+      checkpoints.begin(), checkpoints.end(), checkpoint.decompressed_pos,
+      [](Position pos, const Checkpoint& checkpoint) {
+        return pos < checkpoint.decompressed_pos;
+      });
+  if (!NeedsCheckpointLocked(checkpoint.decompressed_pos, next)) return;
+  checkpoints.insert(next, std::move(checkpoint));
+}
+
+void ZlibIndex::SetSize(Position size) {
+  absl::MutexLock lock(&repr_->mutex);
+  repr_->size = size;
+}
+
+absl::Status ZlibIndex::Serialize(Writer& dest) const {
+  RIEGELI_ASSERT(enabled())
+      << "Failed precondition of ZlibIndex::Serialize(): index disabled";
+  absl::MutexLock lock(&repr_->mutex);
+  // Size is written as `size + 1`, with 0 meaning unknown.
+  if (ABSL_PREDICT_FALSE(
+          !WriteVarint64(repr_->spacing, dest) ||
+          !WriteVarint64(repr_->size == absl::nullopt ? 0 : *repr_->size + 1,
+                         dest) ||
+          !WriteVarint64(repr_->checkpoints.size(), dest))) {
+    return dest.status();
+  }
+  for (const Checkpoint& checkpoint : repr_->checkpoints) {
+    if (ABSL_PREDICT_FALSE(
+            !WriteVarint64(checkpoint.decompressed_pos, dest) ||
+            !WriteVarint64(checkpoint.compressed_pos, dest) ||
+            !WriteVarint32(IntCast<uint32_t>(checkpoint.bits), dest) ||
+            !WriteVarint32(IntCast<uint32_t>(checkpoint.trailer_size), dest) ||
+            !WriteVarint32(IntCast<uint32_t>(checkpoint.window.size()),
+                           dest) ||
+            !dest.Write(checkpoint.window))) {
+      return dest.status();
+    }
+  }
+  return absl::OkStatus();
+}
+
+absl::Status ZlibIndex::Parse(Reader& src) {
+  const auto invalid = [&src](absl::string_view message) -> absl::Status {
+    if (ABSL_PREDICT_FALSE(!src.healthy())) return src.status();
+    return absl::InvalidArgumentError(
+        absl::StrCat("Invalid ZlibIndex at byte ", src.pos(), ": ", message));
+  };
+  uint64_t spacing;
+  if (ABSL_PREDICT_FALSE(!ReadVarint64(src, spacing) || spacing == 0)) {
+    return invalid("reading spacing failed");
+  }
+  uint64_t size_plus_1;
+  if (ABSL_PREDICT_FALSE(!ReadVarint64(src, size_plus_1))) {
+    return invalid("reading size failed");
+  }
+  uint64_t num_checkpoints;
+  if (ABSL_PREDICT_FALSE(!ReadVarint64(src, num_checkpoints))) {
+    return invalid("reading number of checkpoints failed");
+  }
+  std::vector<Checkpoint> checkpoints;
+  for (uint64_t i = 0; i < num_checkpoints; ++i) {
+    Checkpoint checkpoint;
+    uint32_t bits, trailer_size, window_size;
+    if (ABSL_PREDICT_FALSE(
+            !ReadVarint64(src, checkpoint.decompressed_pos) ||
+            !ReadVarint64(src, checkpoint.compressed_pos) ||
+            !ReadVarint32(src, bits) || !ReadVarint32(src, trailer_size) ||
+            !ReadVarint32(src, window_size))) {
+      return invalid("reading checkpoint failed");
+    }
+    if (ABSL_PREDICT_FALSE(bits > 7 ||
+                           (trailer_size != 0 && trailer_size != 4 &&
+                            trailer_size != 8) ||
+                           window_size > kMaxWindowSize)) {
+      return invalid("checkpoint out of range");
+    }
+    if (ABSL_PREDICT_FALSE(!checkpoints.empty() &&
+                           checkpoint.decompressed_pos <=
+                               checkpoints.back().decompressed_pos)) {
+      return invalid("checkpoints not sorted");
+    }
+    checkpoint.bits = IntCast<int>(bits);
+    checkpoint.trailer_size = IntCast<int>(trailer_size);
+    if (ABSL_PREDICT_FALSE(!src.Read(window_size, checkpoint.window))) {
+      return invalid("reading window failed");
+    }
+    checkpoints.push_back(std::move(checkpoint));
+  }
+  repr_ = std::make_shared<Repr>(spacing);
+  absl::MutexLock lock(&repr_->mutex);
+  repr_->checkpoints = std::move(checkpoints);
+  if (size_plus_1 > 0) repr_->size = size_plus_1 - 1;
+  return absl::OkStatus();
+}
+
+}  // namespace riegeli
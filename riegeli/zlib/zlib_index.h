@@ -0,0 +1,179 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_ZLIB_ZLIB_INDEX_H_
+#define RIEGELI_ZLIB_ZLIB_INDEX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/status/status.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/optional.h"
+#include "riegeli/base/base.h"
+#include "riegeli/bytes/reader.h"
+#include "riegeli/bytes/writer.h"
+
+namespace riegeli {
+
+class ZlibReaderBase;
+
+// Stores an optional index of checkpoints in a Zlib-compressed stream, which
+// lets `ZlibReader` seek without decompressing the stream from the beginning.
+//
+// A checkpoint is recorded at a deflate block boundary about every `spacing()`
+// bytes of decompressed data. It holds the compressed and decompressed
+// positions, and the preceding window of up to 32KB of decompressed data.
+//
+// Checkpoints are added by a `ZlibReader` using the index while it decompresses
+// the stream sequentially, e.g. on a first pass, or can be loaded from a
+// sidecar written by `Serialize()`. An index must be used only with the stream
+// it was built for.
+//
+// A default-constructed `ZlibIndex` is disabled.
+//
+// Copying a `ZlibIndex` object is cheap, sharing the actual index, which is
+// thread-safe. A `ZlibIndex` can be used by several `ZlibReader`s reading the
+// same stream concurrently, e.g. `ZlibReader`s created by `NewReader()`.
+class ZlibIndex {
+ public:
+  // The default value of the constructor argument.
+  static constexpr Position kDefaultSpacing = Position{1} << 20;
+
+  // Creates a disabled `ZlibIndex`.
+  ZlibIndex() noexcept {}
+
+  // Creates an empty `ZlibIndex` which records checkpoints about every
+  // `spacing` bytes of decompressed data.
+  //
+  // Larger spacing reduces memory usage of the index (32KB per checkpoint);
+  // smaller spacing reduces the amount of data decompressed before reaching
+  // the target position of a seek.
+  //
+  // Precondition: `spacing > 0`
+  explicit ZlibIndex(Position spacing);
+
+  // Returns `true` if the index is enabled.
+  bool enabled() const { return repr_ != nullptr; }
+
+  // Returns the approximate distance between checkpoints, in bytes of
+  // decompressed data.
+  //
+  // Precondition: `enabled()`
+  Position spacing() const;
+
+  // Returns the number of checkpoints.
+  //
+  // Precondition: `enabled()`
+  size_t num_checkpoints() const;
+
+  // Returns the decompressed size of the stream if a `ZlibReader` has reached
+  // its end, otherwise `absl::nullopt`.
+  //
+  // Precondition: `enabled()`
+  absl::optional<Position> size() const;
+
+  // Writes the index to `dest`, e.g. to a sidecar file.
+  //
+  // Precondition: `enabled()`
+  //
+  // Returns status:
+  //  * `status.ok()`  - success
+  //  * `!status.ok()` - failure
+  absl::Status Serialize(Writer& dest) const;
+
+  // Replaces the index with one read from `src`, written by `Serialize()`.
+  // This enables the index.
+  //
+  // Returns status:
+  //  * `status.ok()`  - success
+  //  * `!status.ok()` - failure
+  absl::Status Parse(Reader& src);
+
+ private:
+  friend class ZlibReaderBase;
+
+  struct Checkpoint {
+    // Position of the checkpoint in decompressed data.
+    Position decompressed_pos = 0;
+    // Position of the first compressed byte not fully consumed, relative to
+    // the beginning of the compressed stream.
+    Position compressed_pos = 0;
+    // Number of bits of the byte before `compressed_pos` which belong to the
+    // data after the checkpoint (0..7).
+    int bits = 0;
+    // Size of the trailer of the current compressed stream: 0 for no header,
+    // 4 for Zlib header, 8 for Gzip header.
+    int trailer_size = 0;
+    // Up to 32KB of decompressed data before the checkpoint.
+    std::string window;
+  };
+
+  struct Repr {
+    explicit Repr(Position spacing) : spacing(spacing) {}
+
+    const Position spacing;
+    mutable absl::Mutex mutex;
+    // Sorted by `decompressed_pos`, at least `spacing` apart.
+    std::vector<Checkpoint> checkpoints ABSL_GUARDED_BY(mutex);
+    absl::optional<Position> size ABSL_GUARDED_BY(mutex);
+  };
+
+  // Returns the last checkpoint at or before `pos`, or `absl::nullopt` if
+  // there is none.
+  absl::optional<Checkpoint> Find(Position pos) const;
+
+  // Returns `true` if a checkpoint at `pos` should be added, because there is
+  // no checkpoint in the range (`pos - spacing()`..`pos + spacing()`).
+  //
+  // Block boundaries do not depend on where decompression started, so readers
+  // decompressing overlapping ranges of the stream agree on checkpoints.
+  bool NeedsCheckpoint(Position pos) const;
+
+  // Adds a checkpoint if `NeedsCheckpoint(checkpoint.decompressed_pos)`.
+  void AddCheckpoint(Checkpoint&& checkpoint);
+
+  // Implements `NeedsCheckpoint()`, given the first checkpoint after `pos`.
+  bool NeedsCheckpointLocked(Position pos,
+                             std::vector<Checkpoint>::const_iterator next) const
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(repr_->mutex);
+
+  // Records the decompressed size of the stream.
+  void SetSize(Position size);
+
+  std::shared_ptr<Repr> repr_;
+};
+
+// Implementation details follow.
+
+inline ZlibIndex::ZlibIndex(Position spacing)
+    : repr_(std::make_shared<Repr>(spacing)) {
+  RIEGELI_ASSERT_GT(spacing, 0u)
+      << "Failed precondition of ZlibIndex::ZlibIndex(): zero spacing";
+}
+
+inline Position ZlibIndex::spacing() const {
+  RIEGELI_ASSERT(enabled())
+      << "Failed precondition of ZlibIndex::spacing(): index disabled";
+  return repr_->spacing;
+}
+
+}  // namespace riegeli
+
+#endif  // RIEGELI_ZLIB_ZLIB_INDEX_H_
@@ -15,7 +15,9 @@
 #include "riegeli/zlib/zlib_reader.h"
 
 #include <stddef.h>
+#include <stdint.h>
 
+#include <limits>
 #include <memory>
 #include <string>
 #include <utility>
@@ -31,6 +33,7 @@
 #include "riegeli/base/status.h"
 #include "riegeli/bytes/buffered_reader.h"
 #include "riegeli/bytes/reader.h"
+#include "riegeli/zlib/zlib_index.h"
 #include "zconf.h"
 #include "zlib.h"
 
@@ -53,14 +56,15 @@ void ZlibReaderBase::Initialize(Reader* src) {
     return;
   }
   initial_compressed_pos_ = src->pos();
-  InitializeDecompressor();
+  detect_trailer_size_ = index_.enabled();
+  InitializeDecompressor(window_bits_);
 }
 
-inline void ZlibReaderBase::InitializeDecompressor() {
+inline void ZlibReaderBase::InitializeDecompressor(int window_bits) {
   decompressor_ = RecyclingPool<z_stream, ZStreamDeleter>::global().Get(
       [&] {
         std::unique_ptr<z_stream, ZStreamDeleter> ptr(new z_stream());
-        const int zlib_code = inflateInit2(ptr.get(), window_bits_);
+        const int zlib_code = inflateInit2(ptr.get(), window_bits);
         if (ABSL_PREDICT_FALSE(zlib_code != Z_OK)) {
           FailOperation(absl::StatusCode::kInternal, "inflateInit2()",
                         zlib_code);
@@ -68,7 +72,7 @@ inline void ZlibReaderBase::InitializeDecompressor() {
         return ptr;
       },
       [&](z_stream* ptr) {
-        const int zlib_code = inflateReset2(ptr, window_bits_);
+        const int zlib_code = inflateReset2(ptr, window_bits);
         if (ABSL_PREDICT_FALSE(zlib_code != Z_OK)) {
           FailOperation(absl::StatusCode::kInternal, "inflateReset2()",
                         zlib_code);
@@ -86,6 +90,7 @@ void ZlibReaderBase::Done() {
   BufferedReader::Done();
   decompressor_.reset();
   dictionary_ = ZlibDictionary();
+  index_ = ZlibIndex();
 }
 
 inline bool ZlibReaderBase::FailOperation(absl::StatusCode code,
@@ -163,6 +168,8 @@ bool ZlibReaderBase::ReadInternal(size_t min_length, size_t max_length,
   if (ABSL_PREDICT_FALSE(decompressor_ == nullptr)) return false;
   Reader& src = *src_reader();
   truncated_ = false;
+  // With an index, stop at deflate block boundaries to add checkpoints.
+  const int flush = index_.enabled() ? Z_BLOCK : Z_NO_FLUSH;
   decompressor_->next_out = reinterpret_cast<Bytef*>(dest);
   for (;;) {
     decompressor_->avail_out = SaturatingIntCast<uInt>(PtrDistance(
@@ -170,13 +177,25 @@ bool ZlibReaderBase::ReadInternal(size_t min_length, size_t max_length,
     decompressor_->next_in = const_cast<z_const Bytef*>(
         reinterpret_cast<const Bytef*>(src.cursor()));
     decompressor_->avail_in = SaturatingIntCast<uInt>(src.available());
-    if (decompressor_->avail_in > 0) stream_had_data_ = true;
-    const int result = inflate(decompressor_.get(), Z_NO_FLUSH);
+    if (decompressor_->avail_in > 0) {
+      stream_had_data_ = true;
+      if (detect_trailer_size_) DetectTrailerSize(src);
+    }
+    const int result = inflate(decompressor_.get(), flush);
     src.set_cursor(reinterpret_cast<const char*>(decompressor_->next_in));
     const size_t length_read =
         PtrDistance(dest, reinterpret_cast<char*>(decompressor_->next_out));
     switch (result) {
       case Z_OK:
+        if (index_.enabled()) {
+          // Bit 128 means a block boundary, bit 64 means that the last block
+          // was reached.
+          if ((decompressor_->data_type & (128 | 64)) == 128) {
+            MaybeAddCheckpoint(src, limit_pos() + length_read);
+          }
+          if (length_read >= min_length) break;
+          if (decompressor_->avail_in > 0) continue;
+        }
         if (length_read >= min_length) break;
         ABSL_FALLTHROUGH_INTENDED;
       case Z_BUF_ERROR:
@@ -187,22 +206,39 @@ bool ZlibReaderBase::ReadInternal(size_t min_length, size_t max_length,
           if (ABSL_PREDICT_FALSE(!src.healthy())) return Fail(src);
           if (ABSL_PREDICT_FALSE(!concatenate_ || stream_had_data_)) {
             truncated_ = true;
+          } else if (index_.enabled()) {
+            index_.SetSize(limit_pos());
           }
           return false;
         }
         continue;
       case Z_STREAM_END:
+        if (resumed_) {
+          // Raw decompression does not consume the trailer.
+          if (ABSL_PREDICT_FALSE(!src.Skip(IntCast<size_t>(trailer_size_)))) {
+            move_limit_pos(length_read);
+            if (ABSL_PREDICT_FALSE(!src.healthy())) return Fail(src);
+            truncated_ = true;
+            return false;
+          }
+        }
         if (concatenate_) {
-          const int zlib_code = inflateReset(decompressor_.get());
+          const int zlib_code =
+              resumed_ ? inflateReset2(decompressor_.get(), window_bits_)
+                       : inflateReset(decompressor_.get());
           if (ABSL_PREDICT_FALSE(zlib_code != Z_OK)) {
-            FailOperation(absl::StatusCode::kInternal, "inflateReset()",
+            FailOperation(absl::StatusCode::kInternal,
+                          resumed_ ? "inflateReset2()" : "inflateReset()",
                           zlib_code);
             break;
           }
+          resumed_ = false;
+          detect_trailer_size_ = index_.enabled();
           stream_had_data_ = false;
           if (length_read >= min_length) break;
           continue;
         }
+        if (index_.enabled()) index_.SetSize(limit_pos() + length_read);
         decompressor_.reset();
         break;
       case Z_NEED_DICT:
@@ -232,6 +268,101 @@ bool ZlibReaderBase::ReadInternal(size_t min_length, size_t max_length,
   }
 }
 
+inline void ZlibReaderBase::DetectTrailerSize(Reader& src) {
+  RIEGELI_ASSERT_GT(src.available(), 0u)
+      << "Failed precondition of ZlibReaderBase::DetectTrailerSize(): "
+         "no data available";
+  detect_trailer_size_ = false;
+  if (window_bits_ < 0) {
+    trailer_size_ = 0;
+  } else if (window_bits_ >= static_cast<int>(Header::kZlibOrGzip)) {
+    // Gzip header starts with 0x1f, which is an invalid first byte of Zlib
+    // header.
+    trailer_size_ = static_cast<uint8_t>(*src.cursor()) == 0x1f ? 8 : 4;
+  } else if (window_bits_ >= static_cast<int>(Header::kGzip)) {
+    trailer_size_ = 8;
+  } else {
+    trailer_size_ = 4;
+  }
+}
+
+inline void ZlibReaderBase::MaybeAddCheckpoint(Reader& src, Position pos) {
+  // A checkpoint at the beginning is not useful, and a checkpoint needs the
+  // trailer size of the current compressed stream.
+  if (pos == 0 || detect_trailer_size_ || !index_.NeedsCheckpoint(pos)) {
+    return;
+  }
+  ZlibIndex::Checkpoint checkpoint;
+  checkpoint.decompressed_pos = pos;
+  checkpoint.compressed_pos = src.pos() - initial_compressed_pos_;
+  checkpoint.bits = decompressor_->data_type & 7;
+  checkpoint.trailer_size = trailer_size_;
+  checkpoint.window.resize(size_t{1} << MAX_WBITS);
+  uInt window_size = 0;
+  const int zlib_code = inflateGetDictionary(
+      decompressor_.get(), reinterpret_cast<Bytef*>(&checkpoint.window[0]),
+      &window_size);
+  if (ABSL_PREDICT_FALSE(zlib_code != Z_OK)) return;
+  checkpoint.window.resize(window_size);
+  index_.AddCheckpoint(std::move(checkpoint));
+}
+
+bool ZlibReaderBase::SeekToCheckpoint(
+    const ZlibIndex::Checkpoint& checkpoint) {
+  Reader& src = *src_reader();
+  truncated_ = false;
+  stream_had_data_ = true;
+  set_buffer();
+  set_limit_pos(checkpoint.decompressed_pos);
+  decompressor_.reset();
+  // If the checkpoint is not at a byte boundary, some bits of the previous
+  // byte are needed.
+  if (ABSL_PREDICT_FALSE(
+          !src.Seek(initial_compressed_pos_ + checkpoint.compressed_pos -
+                    (checkpoint.bits > 0 ? 1 : 0)))) {
+    src.Fail(absl::DataLossError("Zlib-compressed stream got truncated"));
+    return Fail(src);
+  }
+  uint8_t byte = 0;
+  if (checkpoint.bits > 0) {
+    if (ABSL_PREDICT_FALSE(!src.ReadByte(byte))) {
+      src.Fail(absl::DataLossError("Zlib-compressed stream got truncated"));
+      return Fail(src);
+    }
+  }
+  InitializeDecompressor(-MAX_WBITS);
+  if (ABSL_PREDICT_FALSE(!healthy())) return false;
+  if (checkpoint.bits > 0) {
+    const int zlib_code = inflatePrime(decompressor_.get(), checkpoint.bits,
+                                       byte >> (8 - checkpoint.bits));
+    if (ABSL_PREDICT_FALSE(zlib_code != Z_OK)) {
+      return FailOperation(absl::StatusCode::kInternal, "inflatePrime()",
+                           zlib_code);
+    }
+  }
+  if (!checkpoint.window.empty()) {
+    const int zlib_code = inflateSetDictionary(
+        decompressor_.get(),
+        const_cast<z_const Bytef*>(
+            reinterpret_cast<const Bytef*>(checkpoint.window.data())),
+        SaturatingIntCast<uInt>(checkpoint.window.size()));
+    if (ABSL_PREDICT_FALSE(zlib_code != Z_OK)) {
+      return FailOperation(absl::StatusCode::kInternal,
+                           "inflateSetDictionary()", zlib_code);
+    }
+  }
+  resumed_ = true;
+  detect_trailer_size_ = false;
+  trailer_size_ = checkpoint.trailer_size;
+  return true;
+}
+
+bool ZlibReaderBase::SupportsRandomAccess() {
+  if (!index_.enabled()) return false;
+  Reader* const src = src_reader();
+  return src != nullptr && src->SupportsRandomAccess();
+}
+
 bool ZlibReaderBase::SupportsRewind() {
   Reader* const src = src_reader();
   return src != nullptr && src->SupportsRewind();
@@ -244,12 +375,27 @@ bool ZlibReaderBase::SeekBehindBuffer(Position new_pos) {
   RIEGELI_ASSERT_EQ(start_to_limit(), 0u)
       << "Failed precondition of BufferedReader::SeekBehindBuffer(): "
          "buffer not empty";
+  if (index_.enabled()) {
+    if (ABSL_PREDICT_FALSE(!healthy())) return false;
+    const absl::optional<ZlibIndex::Checkpoint> checkpoint =
+        index_.Find(new_pos);
+    // Use the checkpoint if seeking backwards, or if seeking forwards beyond
+    // the checkpoint.
+    if (checkpoint != absl::nullopt &&
+        (new_pos <= limit_pos() ||
+         checkpoint->decompressed_pos > limit_pos())) {
+      if (ABSL_PREDICT_FALSE(!SeekToCheckpoint(*checkpoint))) return false;
+      if (new_pos == limit_pos()) return true;
+      return BufferedReader::SeekBehindBuffer(new_pos);
+    }
+  }
   if (new_pos <= limit_pos()) {
     // Seeking backwards.
     if (ABSL_PREDICT_FALSE(!healthy())) return false;
     Reader& src = *src_reader();
     truncated_ = false;
     stream_had_data_ = false;
+    resumed_ = false;
     set_buffer();
     set_limit_pos(0);
     decompressor_.reset();
@@ -257,13 +403,31 @@ bool ZlibReaderBase::SeekBehindBuffer(Position new_pos) {
       src.Fail(absl::DataLossError("Zlib-compressed stream got truncated"));
       return Fail(src);
     }
-    InitializeDecompressor();
+    detect_trailer_size_ = index_.enabled();
+    InitializeDecompressor(window_bits_);
     if (ABSL_PREDICT_FALSE(!healthy())) return false;
     if (new_pos == 0) return true;
   }
   return BufferedReader::SeekBehindBuffer(new_pos);
 }
 
+bool ZlibReaderBase::SupportsSize() { return SupportsRandomAccess(); }
+
+absl::optional<Position> ZlibReaderBase::SizeImpl() {
+  if (ABSL_PREDICT_FALSE(!healthy())) return absl::nullopt;
+  if (ABSL_PREDICT_FALSE(!index_.enabled())) return BufferedReader::SizeImpl();
+  absl::optional<Position> size = index_.size();
+  if (size != absl::nullopt) return size;
+  // Decompress the rest of the stream, adding checkpoints on the way, and
+  // return to the current position using them.
+  const Position pos_before = pos();
+  Seek(std::numeric_limits<Position>::max());
+  if (ABSL_PREDICT_FALSE(!healthy())) return absl::nullopt;
+  size = pos();
+  if (ABSL_PREDICT_FALSE(!Seek(pos_before))) return absl::nullopt;
+  return size;
+}
+
 bool ZlibReaderBase::SupportsNewReader() {
   Reader* const src = src_reader();
   return src != nullptr && src->SupportsNewReader();
@@ -292,6 +456,7 @@ std::unique_ptr<Reader> ZlibReaderBase::NewReaderImpl(Position initial_pos) {
                               : static_cast<Header>(window_bits_ & ~15))
               .set_dictionary(dictionary_)
               .set_concatenate(concatenate_)
+              .set_index(index_)
               .set_size_hint(size_hint())
               .set_buffer_size(buffer_size()));
   reader->Seek(initial_pos);
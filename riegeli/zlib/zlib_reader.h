@@ -34,6 +34,7 @@
 #include "riegeli/bytes/buffered_reader.h"
 #include "riegeli/bytes/reader.h"
 #include "riegeli/zlib/zlib_dictionary.h"
+#include "riegeli/zlib/zlib_index.h"
 #include "zconf.h"
 #include "zlib.h"
 
@@ -140,6 +141,36 @@ class ZlibReaderBase : public BufferedReader {
     }
     bool concatenate() const { return concatenate_; }
 
+    // Index of checkpoints in the compressed stream, which lets `Seek()` and
+    // `NewReader()` start decompression from the nearest checkpoint instead of
+    // from the beginning of the stream. Checkpoints are added while reading.
+    //
+    // If the index is enabled and the compressed `Reader` supports random
+    // access, `ZlibReader` supports random access too, and `Size()` is
+    // supported (possibly decompressing the rest of the stream once).
+    //
+    // The index must have been built for the same compressed stream, e.g. by
+    // an earlier `ZlibReader` with the same options, or loaded by
+    // `ZlibIndex::Parse()`.
+    //
+    // Default: `ZlibIndex()` (disabled).
+    Options& set_index(const ZlibIndex& index) & {
+      index_ = index;
+      return *this;
+    }
+    Options& set_index(ZlibIndex&& index) & {
+      index_ = std::move(index);
+      return *this;
+    }
+    Options&& set_index(const ZlibIndex& index) && {
+      return std::move(set_index(index));
+    }
+    Options&& set_index(ZlibIndex&& index) && {
+      return std::move(set_index(std::move(index)));
+    }
+    ZlibIndex& index() { return index_; }
+    const ZlibIndex& index() const { return index_; }
+
     // Expected uncompressed size, or `absl::nullopt` if unknown. This may
     // improve performance.
     //
@@ -176,6 +207,7 @@ class ZlibReaderBase : public BufferedReader {
     Header header_ = kDefaultHeader;
     ZlibDictionary dictionary_;
     bool concatenate_ = false;
+    ZlibIndex index_;
     absl::optional<Position> size_hint_;
     size_t buffer_size_ = kDefaultBufferSize;
   };
@@ -196,14 +228,17 @@ class ZlibReaderBase : public BufferedReader {
     return truncated_;
   }
 
+  bool SupportsRandomAccess() override;
   bool SupportsRewind() override;
+  bool SupportsSize() override;
   bool SupportsNewReader() override;
 
  protected:
   explicit ZlibReaderBase(Closed) noexcept : BufferedReader(kClosed) {}
 
   explicit ZlibReaderBase(int window_bits, ZlibDictionary&& dictionary,
-                          bool concatenate, size_t buffer_size,
+                          bool concatenate, ZlibIndex&& index,
+                          size_t buffer_size,
                           absl::optional<Position> size_hint);
 
   ZlibReaderBase(ZlibReaderBase&& that) noexcept;
@@ -211,7 +246,8 @@ class ZlibReaderBase : public BufferedReader {
 
   void Reset(Closed);
   void Reset(int window_bits, ZlibDictionary&& dictionary, bool concatenate,
-             size_t buffer_size, absl::optional<Position> size_hint);
+             ZlibIndex&& index, size_t buffer_size,
+             absl::optional<Position> size_hint);
   static int GetWindowBits(const Options& options);
   void Initialize(Reader* src);
 
@@ -224,6 +260,7 @@ class ZlibReaderBase : public BufferedReader {
   bool PullSlow(size_t min_length, size_t recommended_length) override;
   bool ReadInternal(size_t min_length, size_t max_length, char* dest) override;
   bool SeekBehindBuffer(Position new_pos) override;
+  absl::optional<Position> SizeImpl() override;
   std::unique_ptr<Reader> NewReaderImpl(Position initial_pos) override;
 
  private:
@@ -235,7 +272,15 @@ class ZlibReaderBase : public BufferedReader {
     }
   };
 
-  void InitializeDecompressor();
+  void InitializeDecompressor(int window_bits);
+  // Determines `trailer_size_` when the header of a compressed stream is about
+  // to be decompressed from `src`.
+  void DetectTrailerSize(Reader& src);
+  // Adds a checkpoint at the current deflate block boundary to `index_` if
+  // needed.
+  void MaybeAddCheckpoint(Reader& src, Position pos);
+  // Restarts decompression from `checkpoint`.
+  bool SeekToCheckpoint(const ZlibIndex::Checkpoint& checkpoint);
   ABSL_ATTRIBUTE_COLD bool FailOperation(absl::StatusCode code,
                                          absl::string_view operation,
                                          int zlib_code);
@@ -252,6 +297,17 @@ class ZlibReaderBase : public BufferedReader {
   // legitimate, it does not imply that the source is truncated.
   bool stream_had_data_ = false;
   Position initial_compressed_pos_ = 0;
+  ZlibIndex index_;
+  // If `true`, decompression started from a checkpoint of `index_`, and
+  // `decompressor_` decompresses raw deflate data until the end of the current
+  // compressed stream, skipping its header and trailer.
+  bool resumed_ = false;
+  // If `true`, `trailer_size_` is not known yet for the current compressed
+  // stream.
+  bool detect_trailer_size_ = false;
+  // Size of the trailer of the current compressed stream: 0 for no header,
+  // 4 for Zlib header, 8 for Gzip header.
+  int trailer_size_ = 0;
   RecyclingPool<z_stream, ZStreamDeleter>::Handle decompressor_;
 };
 
@@ -334,12 +390,14 @@ explicit ZlibReader(std::tuple<SrcArgs...> src_args,
 
 inline ZlibReaderBase::ZlibReaderBase(int window_bits,
                                       ZlibDictionary&& dictionary,
-                                      bool concatenate, size_t buffer_size,
+                                      bool concatenate, ZlibIndex&& index,
+                                      size_t buffer_size,
                                       absl::optional<Position> size_hint)
     : BufferedReader(buffer_size, size_hint),
       dictionary_(std::move(dictionary)),
       window_bits_(window_bits),
-      concatenate_(concatenate) {}
+      concatenate_(concatenate),
+      index_(std::move(index)) {}
 
 inline ZlibReaderBase::ZlibReaderBase(ZlibReaderBase&& that) noexcept
     : BufferedReader(std::move(that)),
@@ -351,6 +409,10 @@ inline ZlibReaderBase::ZlibReaderBase(ZlibReaderBase&& that) noexcept
       truncated_(that.truncated_),
       stream_had_data_(that.stream_had_data_),
       initial_compressed_pos_(that.initial_compressed_pos_),
+      index_(std::move(that.index_)),
+      resumed_(that.resumed_),
+      detect_trailer_size_(that.detect_trailer_size_),
+      trailer_size_(that.trailer_size_),
       decompressor_(std::move(that.decompressor_)) {}
 
 inline ZlibReaderBase& ZlibReaderBase::operator=(
@@ -364,6 +426,10 @@ inline ZlibReaderBase& ZlibReaderBase::operator=(
   truncated_ = that.truncated_;
   stream_had_data_ = that.stream_had_data_;
   initial_compressed_pos_ = that.initial_compressed_pos_;
+  index_ = std::move(that.index_);
+  resumed_ = that.resumed_;
+  detect_trailer_size_ = that.detect_trailer_size_;
+  trailer_size_ = that.trailer_size_;
   decompressor_ = std::move(that.decompressor_);
   return *this;
 }
@@ -375,12 +441,17 @@ inline void ZlibReaderBase::Reset(Closed) {
   truncated_ = false;
   stream_had_data_ = false;
   initial_compressed_pos_ = 0;
+  resumed_ = false;
+  detect_trailer_size_ = false;
+  trailer_size_ = 0;
   decompressor_.reset();
   dictionary_ = ZlibDictionary();
+  index_ = ZlibIndex();
 }
 
 inline void ZlibReaderBase::Reset(int window_bits, ZlibDictionary&& dictionary,
-                                  bool concatenate, size_t buffer_size,
+                                  bool concatenate, ZlibIndex&& index,
+                                  size_t buffer_size,
                                   absl::optional<Position> size_hint) {
   BufferedReader::Reset(buffer_size, size_hint);
   window_bits_ = window_bits;
@@ -388,8 +459,12 @@ inline void ZlibReaderBase::Reset(int window_bits, ZlibDictionary&& dictionary,
   truncated_ = false;
   stream_had_data_ = false;
   initial_compressed_pos_ = 0;
+  resumed_ = false;
+  detect_trailer_size_ = false;
+  trailer_size_ = 0;
   decompressor_.reset();
   dictionary_ = std::move(dictionary);
+  index_ = std::move(index);
 }
 
 inline int ZlibReaderBase::GetWindowBits(const Options& options) {
@@ -405,7 +480,8 @@ inline int ZlibReaderBase::GetWindowBits(const Options& options) {
 template <typename Src>
 inline ZlibReader<Src>::ZlibReader(const Src& src, Options options)
     : ZlibReaderBase(GetWindowBits(options), std::move(options.dictionary()),
-                     options.concatenate(), options.buffer_size(),
+                     options.concatenate(), std::move(options.index()),
+                     options.buffer_size(),
                      options.size_hint()),
       src_(src) {
   Initialize(src_.get());
@@ -414,7 +490,8 @@ inline ZlibReader<Src>::ZlibReader(const Src& src, Options options)
 template <typename Src>
 inline ZlibReader<Src>::ZlibReader(Src&& src, Options options)
     : ZlibReaderBase(GetWindowBits(options), std::move(options.dictionary()),
-                     options.concatenate(), options.buffer_size(),
+                     options.concatenate(), std::move(options.index()),
+                     options.buffer_size(),
                      options.size_hint()),
       src_(std::move(src)) {
   Initialize(src_.get());
@@ -425,7 +502,8 @@ template <typename... SrcArgs>
 inline ZlibReader<Src>::ZlibReader(std::tuple<SrcArgs...> src_args,
                                    Options options)
     : ZlibReaderBase(GetWindowBits(options), std::move(options.dictionary()),
-                     options.concatenate(), options.buffer_size(),
+                     options.concatenate(), std::move(options.index()),
+                     options.buffer_size(),
                      options.size_hint()),
       src_(std::move(src_args)) {
   Initialize(src_.get());
@@ -456,7 +534,8 @@ inline void ZlibReader<Src>::Reset(Closed) {
 template <typename Src>
 inline void ZlibReader<Src>::Reset(const Src& src, Options options) {
   ZlibReaderBase::Reset(GetWindowBits(options), std::move(options.dictionary()),
-                        options.concatenate(), options.buffer_size(),
+                        options.concatenate(), std::move(options.index()),
+                        options.buffer_size(),
                         options.size_hint());
   src_.Reset(src);
   Initialize(src_.get());
@@ -465,7 +544,8 @@ inline void ZlibReader<Src>::Reset(const Src& src, Options options) {
 template <typename Src>
 inline void ZlibReader<Src>::Reset(Src&& src, Options options) {
   ZlibReaderBase::Reset(GetWindowBits(options), std::move(options.dictionary()),
-                        options.concatenate(), options.buffer_size(),
+                        options.concatenate(), std::move(options.index()),
+                        options.buffer_size(),
                         options.size_hint());
   src_.Reset(std::move(src));
   Initialize(src_.get());
@@ -476,7 +556,8 @@ template <typename... SrcArgs>
 inline void ZlibReader<Src>::Reset(std::tuple<SrcArgs...> src_args,
                                    Options options) {
   ZlibReaderBase::Reset(GetWindowBits(options), std::move(options.dictionary()),
-                        options.concatenate(), options.buffer_size(),
+                        options.concatenate(), std::move(options.index()),
+                        options.buffer_size(),
                         options.size_hint());
   src_.Reset(std::move(src_args));
   Initialize(src_.get());
@@ -15,20 +15,25 @@
 #include "riegeli/zlib/zlib_writer.h"
 
 #include <stddef.h>
+#include <stdint.h>
 
+#include <future>
 #include <limits>
 #include <memory>
 #include <string>
+#include <utility>
 
 #include "absl/base/optimization.h"
 #include "absl/status/status.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "riegeli/base/base.h"
+#include "riegeli/base/parallelism.h"
 #include "riegeli/base/recycling_pool.h"
 #include "riegeli/base/status.h"
 #include "riegeli/bytes/buffered_writer.h"
 #include "riegeli/bytes/writer.h"
+#include "riegeli/endian/endian_writing.h"
 #include "zconf.h"
 #include "zlib.h"
 
@@ -47,6 +52,41 @@ constexpr int ZlibWriterBase::Options::kDefaultWindowLog;
 constexpr ZlibWriterBase::Header ZlibWriterBase::Options::kDefaultHeader;
 #endif
 
+namespace {
+
+const char* ZlibErrorDetails(const char* msg, int zlib_code) {
+  if (msg != nullptr) return msg;
+  switch (zlib_code) {
+    case Z_STREAM_END:
+      return "stream end";
+    case Z_NEED_DICT:
+      return "need dictionary";
+    case Z_ERRNO:
+      return "file error";
+    case Z_STREAM_ERROR:
+      return "stream error";
+    case Z_DATA_ERROR:
+      return "data error";
+    case Z_MEM_ERROR:
+      return "insufficient memory";
+    case Z_BUF_ERROR:
+      return "buffer error";
+    case Z_VERSION_ERROR:
+      return "incompatible version";
+  }
+  return nullptr;
+}
+
+absl::Status ZlibError(absl::string_view operation, const char* msg,
+                       int zlib_code) {
+  std::string message = absl::StrCat(operation, " failed");
+  const char* const details = ZlibErrorDetails(msg, zlib_code);
+  if (details != nullptr) absl::StrAppend(&message, ": ", details);
+  return absl::InternalError(message);
+}
+
+}  // namespace
+
 void ZlibWriterBase::Initialize(Writer* dest, int compression_level,
                                 int window_bits) {
   RIEGELI_ASSERT(dest != nullptr)
@@ -55,6 +95,36 @@ void ZlibWriterBase::Initialize(Writer* dest, int compression_level,
     Fail(*dest);
     return;
   }
+  if (parallelism_ > 0) {
+    // Blocks are compressed as raw streams, and the header and trailer are
+    // written separately.
+    compression_level_ = compression_level;
+    if (window_bits < 0) {
+      header_ = Header::kRaw;
+      window_log_ = -window_bits;
+    } else if (window_bits > MAX_WBITS) {
+      header_ = Header::kGzip;
+      window_log_ = window_bits - static_cast<int>(Header::kGzip);
+    } else {
+      header_ = Header::kZlib;
+      window_log_ = window_bits;
+    }
+    if (header_ == Header::kGzip) {
+      if (ABSL_PREDICT_FALSE(!dictionary_.empty())) {
+        // `deflateSetDictionary()` fails in this case too.
+        Fail(ZlibError("deflateSetDictionary()", nullptr, Z_STREAM_ERROR));
+        return;
+      }
+      checksum_ = crc32(0, nullptr, 0);
+    } else {
+      checksum_ = adler32(0, nullptr, 0);
+    }
+    const size_t window_size = size_t{1} << window_log_;
+    const absl::string_view dictionary = dictionary_.data();
+    const size_t length = UnsignedMin(dictionary.size(), window_size);
+    history_.assign(dictionary.data() + dictionary.size() - length, length);
+    return;
+  }
   // Do not reduce `window_log` based on `size_hint`. An unexpected reduction
   // of `window_log` would break concatenation of compressed streams, because
   // Zlib decompressor rejects `window_log` in a subsequent header greater than
@@ -96,6 +166,12 @@ void ZlibWriterBase::DoneBehindBuffer(absl::string_view src) {
          "buffer not empty";
   if (ABSL_PREDICT_FALSE(!healthy())) return;
   Writer& dest = *dest_writer();
+  if (parallelism_ > 0) {
+    if (ABSL_PREDICT_FALSE(!ScheduleBlock(src, true, dest))) return;
+    if (ABSL_PREDICT_FALSE(!WritePendingBlocks(0, dest))) return;
+    WriteTrailer(dest);
+    return;
+  }
   WriteInternal(src, dest, Z_FINISH);
 }
 
@@ -103,6 +179,10 @@ void ZlibWriterBase::Done() {
   BufferedWriter::Done();
   compressor_.reset();
   dictionary_ = ZlibDictionary();
+  history_ = std::string();
+  // If `!healthy()`, blocks still being compressed are abandoned. They do not
+  // refer to `*this`.
+  pending_blocks_.clear();
 }
 
 bool ZlibWriterBase::FailOperation(absl::string_view operation, int zlib_code) {
@@ -110,38 +190,7 @@ bool ZlibWriterBase::FailOperation(absl::string_view operation, int zlib_code) {
       << "Failed precondition of ZlibWriterBase::FailOperation(): "
          "Object closed";
   Writer& dest = *dest_writer();
-  std::string message = absl::StrCat(operation, " failed");
-  const char* details = compressor_->msg;
-  if (details == nullptr) {
-    switch (zlib_code) {
-      case Z_STREAM_END:
-        details = "stream end";
-        break;
-      case Z_NEED_DICT:
-        details = "need dictionary";
-        break;
-      case Z_ERRNO:
-        details = "file error";
-        break;
-      case Z_STREAM_ERROR:
-        details = "stream error";
-        break;
-      case Z_DATA_ERROR:
-        details = "data error";
-        break;
-      case Z_MEM_ERROR:
-        details = "insufficient memory";
-        break;
-      case Z_BUF_ERROR:
-        details = "buffer error";
-        break;
-      case Z_VERSION_ERROR:
-        details = "incompatible version";
-        break;
-    }
-  }
-  if (details != nullptr) absl::StrAppend(&message, ": ", details);
-  return Fail(Annotate(absl::InternalError(message),
+  return Fail(Annotate(ZlibError(operation, compressor_->msg, zlib_code),
                        absl::StrCat("at byte ", dest.pos())));
 }
 
@@ -159,6 +208,16 @@ bool ZlibWriterBase::WriteInternal(absl::string_view src) {
   RIEGELI_ASSERT(healthy())
       << "Failed precondition of BufferedWriter::WriteInternal(): " << status();
   Writer& dest = *dest_writer();
+  if (parallelism_ > 0) {
+    while (src.size() > buffer_size()) {
+      if (ABSL_PREDICT_FALSE(
+              !ScheduleBlock(src.substr(0, buffer_size()), false, dest))) {
+        return false;
+      }
+      src.remove_prefix(buffer_size());
+    }
+    return ScheduleBlock(src, false, dest);
+  }
   return WriteInternal(src, dest, Z_NO_FLUSH);
 }
 
@@ -221,7 +280,253 @@ bool ZlibWriterBase::FlushBehindBuffer(absl::string_view src,
          "buffer not empty";
   if (ABSL_PREDICT_FALSE(!healthy())) return false;
   Writer& dest = *dest_writer();
+  if (parallelism_ > 0) {
+    // Each block ends with a sync flush, so writing all pending blocks is
+    // enough.
+    if (!src.empty()) {
+      if (ABSL_PREDICT_FALSE(!ScheduleBlock(src, false, dest))) return false;
+    }
+    return WritePendingBlocks(0, dest);
+  }
   return WriteInternal(src, dest, Z_SYNC_FLUSH);
 }
 
+bool ZlibWriterBase::ScheduleBlock(absl::string_view src, bool last,
+                                   Writer& dest) {
+  RIEGELI_ASSERT_GT(parallelism_, 0)
+      << "Failed precondition of ZlibWriterBase::ScheduleBlock(): "
+         "parallelism not enabled";
+  if (ABSL_PREDICT_FALSE(src.size() >
+                         std::numeric_limits<Position>::max() - start_pos())) {
+    return FailOverflow();
+  }
+  if (ABSL_PREDICT_FALSE(!WritePendingBlocks(
+          IntCast<size_t>(parallelism_) - 1, dest))) {
+    return false;
+  }
+  std::promise<CompressedBlock>* const promise =
+      new std::promise<CompressedBlock>();
+  pending_blocks_.push_back(promise->get_future());
+  internal::ThreadPool::global().Schedule(
+      [promise, compression_level = compression_level_,
+       window_log = window_log_, header = header_, dictionary = history_,
+       src = std::string(src), last] {
+        promise->set_value(CompressBlock(compression_level, window_log, header,
+                                         dictionary, src, last));
+        delete promise;
+      });
+  const size_t window_size = size_t{1} << window_log_;
+  if (src.size() >= window_size) {
+    history_.assign(src.data() + src.size() - window_size, window_size);
+  } else {
+    if (history_.size() + src.size() > window_size) {
+      history_.erase(0, history_.size() + src.size() - window_size);
+    }
+    history_.append(src.data(), src.size());
+  }
+  move_start_pos(src.size());
+  return true;
+}
+
+bool ZlibWriterBase::WritePendingBlocks(size_t max_pending, Writer& dest) {
+  while (pending_blocks_.size() > max_pending) {
+    const CompressedBlock block = pending_blocks_.front().get();
+    pending_blocks_.pop_front();
+    if (ABSL_PREDICT_FALSE(!block.status.ok())) {
+      return Fail(
+          Annotate(block.status, absl::StrCat("at byte ", dest.pos())));
+    }
+    if (!header_written_) {
+      if (ABSL_PREDICT_FALSE(!WriteHeader(dest))) return false;
+      header_written_ = true;
+    }
+    if (ABSL_PREDICT_FALSE(!dest.Write(block.data))) return Fail(dest);
+    if (header_ == Header::kGzip) {
+      checksum_ = crc32_combine(checksum_, block.checksum,
+                                IntCast<z_off_t>(block.uncompressed_size));
+    } else {
+      checksum_ = adler32_combine(checksum_, block.checksum,
+                                  IntCast<z_off_t>(block.uncompressed_size));
+    }
+  }
+  return true;
+}
+
+bool ZlibWriterBase::WriteHeader(Writer& dest) {
+  // Compression level flags as written by `deflate()`.
+  const int level_flags = compression_level_ < 2    ? 0
+                          : compression_level_ < 6  ? 1
+                          : compression_level_ == 6 ? 2
+                                                    : 3;
+  switch (header_) {
+    case Header::kZlib: {
+      uint32_t header = (Z_DEFLATED + ((window_log_ - 8) << 4)) << 8;
+      header |= level_flags << 6;
+      if (!dictionary_.empty()) header |= 0x20;  // `PRESET_DICT`
+      header += 31 - header % 31;
+      if (ABSL_PREDICT_FALSE(
+              !WriteBigEndian16(IntCast<uint16_t>(header), dest))) {
+        return Fail(dest);
+      }
+      if (!dictionary_.empty()) {
+        const absl::string_view dictionary = dictionary_.data();
+        const uLong dictionary_id = adler32_z(
+            adler32(0, nullptr, 0),
+            reinterpret_cast<const Bytef*>(dictionary.data()),
+            dictionary.size());
+        if (ABSL_PREDICT_FALSE(!WriteBigEndian32(
+                IntCast<uint32_t>(dictionary_id), dest))) {
+          return Fail(dest);
+        }
+      }
+      return true;
+    }
+    case Header::kGzip: {
+      // Magic, `Z_DEFLATED`, no flags, no modification time, extra flags, Unix.
+      const char extra_flags = compression_level_ == 9  ? 2
+                               : compression_level_ < 2 ? 4
+                                                        : 0;
+      const char header[10] = {'\x1f', '\x8b', Z_DEFLATED, 0, 0, 0, 0, 0,
+                               extra_flags, 3};
+      if (ABSL_PREDICT_FALSE(
+              !dest.Write(absl::string_view(header, sizeof(header))))) {
+        return Fail(dest);
+      }
+      return true;
+    }
+    case Header::kRaw:
+      return true;
+  }
+  RIEGELI_ASSERT_UNREACHABLE()
+      << "Unknown header: " << static_cast<int>(header_);
+}
+
+bool ZlibWriterBase::WriteTrailer(Writer& dest) {
+  switch (header_) {
+    case Header::kZlib:
+      if (ABSL_PREDICT_FALSE(
+              !WriteBigEndian32(IntCast<uint32_t>(checksum_), dest))) {
+        return Fail(dest);
+      }
+      return true;
+    case Header::kGzip:
+      if (ABSL_PREDICT_FALSE(
+              !WriteLittleEndian32(IntCast<uint32_t>(checksum_), dest) ||
+              !WriteLittleEndian32(static_cast<uint32_t>(start_pos()),
+                                   dest))) {
+        return Fail(dest);
+      }
+      return true;
+    case Header::kRaw:
+      return true;
+  }
+  RIEGELI_ASSERT_UNREACHABLE()
+      << "Unknown header: " << static_cast<int>(header_);
+}
+
+ZlibWriterBase::CompressedBlock ZlibWriterBase::CompressBlock(
+    int compression_level, int window_log, Header header,
+    absl::string_view dictionary, absl::string_view src, bool last) {
+  CompressedBlock block;
+  block.uncompressed_size = src.size();
+  block.checksum =
+      header == Header::kGzip
+          ? crc32_z(crc32(0, nullptr, 0),
+                    reinterpret_cast<const Bytef*>(src.data()), src.size())
+          : adler32_z(adler32(0, nullptr, 0),
+                      reinterpret_cast<const Bytef*>(src.data()), src.size());
+  const KeyedRecyclingPool<z_stream, ZStreamKey, ZStreamDeleter>::Handle
+      compressor = KeyedRecyclingPool<z_stream, ZStreamKey, ZStreamDeleter>::
+          global()
+              .Get(
+                  ZStreamKey{compression_level, -window_log},
+                  [&] {
+                    std::unique_ptr<z_stream, ZStreamDeleter> ptr(
+                        new z_stream());
+                    const int zlib_code = deflateInit2(
+                        ptr.get(), compression_level, Z_DEFLATED, -window_log,
+                        8, Z_DEFAULT_STRATEGY);
+                    if (ABSL_PREDICT_FALSE(zlib_code != Z_OK)) {
+                      block.status =
+                          ZlibError("deflateInit2()", ptr->msg, zlib_code);
+                    }
+                    return ptr;
+                  },
+                  [&](z_stream* ptr) {
+                    const int zlib_code = deflateReset(ptr);
+                    if (ABSL_PREDICT_FALSE(zlib_code != Z_OK)) {
+                      block.status =
+                          ZlibError("deflateReset()", ptr->msg, zlib_code);
+                    }
+                  });
+  if (ABSL_PREDICT_FALSE(!block.status.ok())) return block;
+  if (!dictionary.empty()) {
+    const int zlib_code = deflateSetDictionary(
+        compressor.get(),
+        const_cast<z_const Bytef*>(
+            reinterpret_cast<const Bytef*>(dictionary.data())),
+        SaturatingIntCast<uInt>(dictionary.size()));
+    if (ABSL_PREDICT_FALSE(zlib_code != Z_OK)) {
+      block.status =
+          ZlibError("deflateSetDictionary()", compressor->msg, zlib_code);
+      return block;
+    }
+  }
+  // A block other than the last one ends with a sync flush, which aligns it
+  // to a byte boundary without marking the end of the stream, so that blocks
+  // can be concatenated.
+  const int flush = last ? Z_FINISH : Z_SYNC_FLUSH;
+  block.data.resize(deflateBound(compressor.get(), SaturatingIntCast<uLong>(
+                                                       src.size())) +
+                    16);
+  size_t length_compressed = 0;
+  compressor->next_in =
+      const_cast<z_const Bytef*>(reinterpret_cast<const Bytef*>(src.data()));
+  for (;;) {
+    if (length_compressed == block.data.size()) {
+      block.data.resize(block.data.size() * 2);
+    }
+    size_t avail_in =
+        PtrDistance(reinterpret_cast<const char*>(compressor->next_in),
+                    src.data() + src.size());
+    int op = flush;
+    if (ABSL_PREDICT_FALSE(avail_in > std::numeric_limits<uInt>::max())) {
+      avail_in = size_t{std::numeric_limits<uInt>::max()};
+      op = Z_NO_FLUSH;
+    }
+    compressor->avail_in = IntCast<uInt>(avail_in);
+    compressor->next_out =
+        reinterpret_cast<Bytef*>(&block.data[0] + length_compressed);
+    compressor->avail_out =
+        SaturatingIntCast<uInt>(block.data.size() - length_compressed);
+    const int result = deflate(compressor.get(), op);
+    length_compressed =
+        PtrDistance(block.data.data(),
+                    reinterpret_cast<const char*>(compressor->next_out));
+    const size_t length_read = PtrDistance(
+        src.data(), reinterpret_cast<const char*>(compressor->next_in));
+    switch (result) {
+      case Z_OK:
+        if (compressor->avail_out == 0 ||
+            ABSL_PREDICT_FALSE(length_read < src.size())) {
+          continue;
+        }
+        break;
+      case Z_STREAM_END:
+        break;
+      case Z_BUF_ERROR:
+        RIEGELI_ASSERT_EQ(op, Z_SYNC_FLUSH)
+            << "deflate() returned an unexpected Z_BUF_ERROR";
+        break;
+      default:
+        block.status = ZlibError("deflate()", compressor->msg, result);
+        return block;
+    }
+    RIEGELI_ASSERT_EQ(length_read, src.size())
+        << "deflate() returned but there are still input data";
+    block.data.resize(length_compressed);
+    return block;
+  }
+}
+
 }  // namespace riegeli
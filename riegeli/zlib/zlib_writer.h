@@ -17,12 +17,16 @@
 
 #include <stddef.h>
 
+#include <deque>
+#include <future>
+#include <string>
 #include <tuple>
 #include <type_traits>
 #include <utility>
 
 #include "absl/base/attributes.h"
 #include "absl/base/optimization.h"
+#include "absl/status/status.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
 #include "riegeli/base/base.h"
@@ -153,6 +157,30 @@ class ZlibWriterBase : public BufferedWriter {
     }
     absl::optional<Position> size_hint() const { return size_hint_; }
 
+    // Maximum number of blocks being compressed in parallel in background.
+    // Larger parallelism can increase throughput, up to a point where it no
+    // longer matters; smaller parallelism reduces memory usage.
+    //
+    // If `parallelism > 0`, data are split into blocks of `buffer_size()`
+    // which are compressed independently, each primed with the preceding
+    // window of uncompressed data as a dictionary, like in pigz. The compressed
+    // stream remains readable by any Zlib decompressor, but compression density
+    // is slightly lower. Consider increasing `buffer_size()` to at least 128K.
+    //
+    // `parallelism` must be non-negative. Default: 0 (compress serially).
+    Options& set_parallelism(int parallelism) & {
+      RIEGELI_ASSERT_GE(parallelism, 0)
+          << "Failed precondition of "
+             "ZlibWriterBase::Options::set_parallelism(): "
+             "negative parallelism";
+      parallelism_ = parallelism;
+      return *this;
+    }
+    Options&& set_parallelism(int parallelism) && {
+      return std::move(set_parallelism(parallelism));
+    }
+    int parallelism() const { return parallelism_; }
+
     // Tunes how much data is buffered before calling the compression engine.
     //
     // Default: `kDefaultBufferSize` (64K).
@@ -175,6 +203,7 @@ class ZlibWriterBase : public BufferedWriter {
     Header header_ = kDefaultHeader;
     ZlibDictionary dictionary_;
     absl::optional<Position> size_hint_;
+    int parallelism_ = 0;
     size_t buffer_size_ = kDefaultBufferSize;
   };
 
@@ -185,14 +214,15 @@ class ZlibWriterBase : public BufferedWriter {
  protected:
   explicit ZlibWriterBase(Closed) noexcept : BufferedWriter(kClosed) {}
 
-  explicit ZlibWriterBase(ZlibDictionary&& dictionary, size_t buffer_size,
+  explicit ZlibWriterBase(ZlibDictionary&& dictionary, int parallelism,
+                          size_t buffer_size,
                           absl::optional<Position> size_hint);
 
   ZlibWriterBase(ZlibWriterBase&& that) noexcept;
   ZlibWriterBase& operator=(ZlibWriterBase&& that) noexcept;
 
   void Reset(Closed);
-  void Reset(ZlibDictionary&& dictionary, size_t buffer_size,
+  void Reset(ZlibDictionary&& dictionary, int parallelism, size_t buffer_size,
              absl::optional<Position> size_hint);
   static int GetWindowBits(const Options& options);
   void Initialize(Writer* dest, int compression_level, int window_bits);
@@ -235,12 +265,49 @@ class ZlibWriterBase : public BufferedWriter {
     int window_bits;
   };
 
+  // A block compressed in background if `parallelism_ > 0`.
+  struct CompressedBlock {
+    absl::Status status;
+    std::string data;
+    // CRC-32 for `Header::kGzip`, Adler-32 otherwise.
+    uLong checksum = 0;
+    size_t uncompressed_size = 0;
+  };
+
   ABSL_ATTRIBUTE_COLD bool FailOperation(absl::string_view operation,
                                          int zlib_code);
   bool WriteInternal(absl::string_view src, Writer& dest, int flush);
 
+  // Parallel compression, used if `parallelism_ > 0`.
+  //
+  // `ScheduleBlock()` starts compressing `src` in background, waiting for a
+  // pending block first if there are `parallelism_` of them.
+  // `WritePendingBlocks()` writes pending blocks to `dest` in order, leaving at
+  // most `max_pending` of them.
+  bool ScheduleBlock(absl::string_view src, bool last, Writer& dest);
+  bool WritePendingBlocks(size_t max_pending, Writer& dest);
+  bool WriteHeader(Writer& dest);
+  bool WriteTrailer(Writer& dest);
+  static CompressedBlock CompressBlock(int compression_level, int window_log,
+                                       Header header,
+                                       absl::string_view dictionary,
+                                       absl::string_view src, bool last);
+
   ZlibDictionary dictionary_;
   KeyedRecyclingPool<z_stream, ZStreamKey, ZStreamDeleter>::Handle compressor_;
+
+  // Fields used only if `parallelism_ > 0`.
+  int parallelism_ = 0;
+  int compression_level_ = 0;
+  int window_log_ = 0;
+  Header header_ = Header::kZlib;
+  bool header_written_ = false;
+  // Checksum of uncompressed data of blocks written so far.
+  uLong checksum_ = 0;
+  // Up to a window of uncompressed data preceding the next block, preceded by
+  // `dictionary_`, used as the dictionary of the next block.
+  std::string history_;
+  std::deque<std::future<CompressedBlock>> pending_blocks_;
 };
 
 // A `Writer` which compresses data with Zlib before passing it to another
@@ -321,17 +388,26 @@ explicit ZlibWriter(std::tuple<DestArgs...> dest_args,
 // Implementation details follow.
 
 inline ZlibWriterBase::ZlibWriterBase(ZlibDictionary&& dictionary,
-                                      size_t buffer_size,
+                                      int parallelism, size_t buffer_size,
                                       absl::optional<Position> size_hint)
     : BufferedWriter(buffer_size, size_hint),
-      dictionary_(std::move(dictionary)) {}
+      dictionary_(std::move(dictionary)),
+      parallelism_(parallelism) {}
 
 inline ZlibWriterBase::ZlibWriterBase(ZlibWriterBase&& that) noexcept
     : BufferedWriter(std::move(that)),
       // Using `that` after it was moved is correct because only the base class
       // part was moved.
       dictionary_(std::move(that.dictionary_)),
-      compressor_(std::move(that.compressor_)) {}
+      compressor_(std::move(that.compressor_)),
+      parallelism_(that.parallelism_),
+      compression_level_(that.compression_level_),
+      window_log_(that.window_log_),
+      header_(that.header_),
+      header_written_(that.header_written_),
+      checksum_(that.checksum_),
+      history_(std::move(that.history_)),
+      pending_blocks_(std::move(that.pending_blocks_)) {}
 
 inline ZlibWriterBase& ZlibWriterBase::operator=(
     ZlibWriterBase&& that) noexcept {
@@ -340,6 +416,14 @@ inline ZlibWriterBase& ZlibWriterBase::operator=(
   // was moved.
   dictionary_ = std::move(that.dictionary_);
   compressor_ = std::move(that.compressor_);
+  parallelism_ = that.parallelism_;
+  compression_level_ = that.compression_level_;
+  window_log_ = that.window_log_;
+  header_ = that.header_;
+  header_written_ = that.header_written_;
+  checksum_ = that.checksum_;
+  history_ = std::move(that.history_);
+  pending_blocks_ = std::move(that.pending_blocks_);
   return *this;
 }
 
@@ -347,14 +431,24 @@ inline void ZlibWriterBase::Reset(Closed) {
   BufferedWriter::Reset(kClosed);
   compressor_.reset();
   dictionary_ = ZlibDictionary();
+  parallelism_ = 0;
+  header_written_ = false;
+  checksum_ = 0;
+  history_ = std::string();
+  pending_blocks_.clear();
 }
 
-inline void ZlibWriterBase::Reset(ZlibDictionary&& dictionary,
+inline void ZlibWriterBase::Reset(ZlibDictionary&& dictionary, int parallelism,
                                   size_t buffer_size,
                                   absl::optional<Position> size_hint) {
   BufferedWriter::Reset(buffer_size, size_hint);
   compressor_.reset();
   dictionary_ = std::move(dictionary);
+  parallelism_ = parallelism;
+  header_written_ = false;
+  checksum_ = 0;
+  history_.clear();
+  pending_blocks_.clear();
 }
 
 inline int ZlibWriterBase::GetWindowBits(const Options& options) {
@@ -365,7 +459,8 @@ inline int ZlibWriterBase::GetWindowBits(const Options& options) {
 
 template <typename Dest>
 inline ZlibWriter<Dest>::ZlibWriter(const Dest& dest, Options options)
-    : ZlibWriterBase(std::move(options.dictionary()), options.buffer_size(),
+    : ZlibWriterBase(std::move(options.dictionary()),
+                     options.parallelism(), options.buffer_size(),
                      options.size_hint()),
       dest_(dest) {
   Initialize(dest_.get(), options.compression_level(), GetWindowBits(options));
@@ -373,7 +468,8 @@ inline ZlibWriter<Dest>::ZlibWriter(const Dest& dest, Options options)
 
 template <typename Dest>
 inline ZlibWriter<Dest>::ZlibWriter(Dest&& dest, Options options)
-    : ZlibWriterBase(std::move(options.dictionary()), options.buffer_size(),
+    : ZlibWriterBase(std::move(options.dictionary()),
+                     options.parallelism(), options.buffer_size(),
                      options.size_hint()),
       dest_(std::move(dest)) {
   Initialize(dest_.get(), options.compression_level(), GetWindowBits(options));
@@ -383,7 +479,8 @@ template <typename Dest>
 template <typename... DestArgs>
 inline ZlibWriter<Dest>::ZlibWriter(std::tuple<DestArgs...> dest_args,
                                     Options options)
-    : ZlibWriterBase(std::move(options.dictionary()), options.buffer_size(),
+    : ZlibWriterBase(std::move(options.dictionary()),
+                     options.parallelism(), options.buffer_size(),
                      options.size_hint()),
       dest_(std::move(dest_args)) {
   Initialize(dest_.get(), options.compression_level(), GetWindowBits(options));
@@ -414,7 +511,8 @@ inline void ZlibWriter<Dest>::Reset(Closed) {
 
 template <typename Dest>
 inline void ZlibWriter<Dest>::Reset(const Dest& dest, Options options) {
-  ZlibWriterBase::Reset(std::move(options.dictionary()), options.buffer_size(),
+  ZlibWriterBase::Reset(std::move(options.dictionary()),
+                        options.parallelism(), options.buffer_size(),
                         options.size_hint());
   dest_.Reset(dest);
   Initialize(dest_.get(), options.compression_level(), GetWindowBits(options));
@@ -422,7 +520,8 @@ inline void ZlibWriter<Dest>::Reset(const Dest& dest, Options options) {
 
 template <typename Dest>
 inline void ZlibWriter<Dest>::Reset(Dest&& dest, Options options) {
-  ZlibWriterBase::Reset(std::move(options.dictionary()), options.buffer_size(),
+  ZlibWriterBase::Reset(std::move(options.dictionary()),
+                        options.parallelism(), options.buffer_size(),
                         options.size_hint());
   dest_.Reset(std::move(dest));
   Initialize(dest_.get(), options.compression_level(), GetWindowBits(options));
@@ -432,7 +531,8 @@ template <typename Dest>
 template <typename... DestArgs>
 inline void ZlibWriter<Dest>::Reset(std::tuple<DestArgs...> dest_args,
                                     Options options) {
-  ZlibWriterBase::Reset(std::move(options.dictionary()), options.buffer_size(),
+  ZlibWriterBase::Reset(std::move(options.dictionary()),
+                        options.parallelism(), options.buffer_size(),
                         options.size_hint());
   dest_.Reset(std::move(dest_args));
   Initialize(dest_.get(), options.compression_level(), GetWindowBits(options));
@@ -19,21 +19,29 @@
 #include "riegeli/zstd/zstd_reader.h"
 
 #include <stddef.h>
+#include <stdint.h>
 
+#include <algorithm>
+#include <future>
 #include <limits>
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "absl/base/optimization.h"
 #include "absl/status/status.h"
 #include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
 #include "riegeli/base/base.h"
+#include "riegeli/base/parallelism.h"
 #include "riegeli/base/recycling_pool.h"
 #include "riegeli/base/status.h"
 #include "riegeli/bytes/buffered_reader.h"
 #include "riegeli/bytes/reader.h"
+#include "riegeli/endian/endian_reading.h"
+#include "riegeli/zstd/zstd_seekable_internal.h"
 #include "zstd.h"
 
 namespace riegeli {
@@ -46,9 +54,111 @@ void ZstdReaderBase::Initialize(Reader* src) {
     return;
   }
   initial_compressed_pos_ = src->pos();
+  if (seekable_ && !growing_source_ && src->SupportsRandomAccess()) {
+    if (ABSL_PREDICT_FALSE(!ReadSeekTable(*src))) return;
+  }
   InitializeDecompressor(*src);
 }
 
+bool ZstdReaderBase::ReadSeekTable(Reader& src) {
+  const absl::optional<Position> size = src.Size();
+  if (ABSL_PREDICT_FALSE(size == absl::nullopt)) return Fail(src);
+  if (*size < initial_compressed_pos_ + internal::kZstdSeekTableHeaderSize +
+                  internal::kZstdSeekTableFooterSize) {
+    // Too short to have a seek table.
+    return true;
+  }
+  uint32_t num_frames;
+  uint8_t descriptor;
+  uint32_t magic;
+  if (ABSL_PREDICT_FALSE(
+          !src.Seek(*size - internal::kZstdSeekTableFooterSize) ||
+          !ReadLittleEndian32(src, num_frames) || !src.ReadByte(descriptor) ||
+          !ReadLittleEndian32(src, magic))) {
+    src.Fail(absl::DataLossError("Zstd-compressed stream got truncated"));
+    return Fail(src);
+  }
+  if (magic != internal::kZstdSeekableMagic) {
+    // No seek table.
+    if (ABSL_PREDICT_FALSE(!src.Seek(initial_compressed_pos_))) {
+      src.Fail(absl::DataLossError("Zstd-compressed stream got truncated"));
+      return Fail(src);
+    }
+    return true;
+  }
+  if (ABSL_PREDICT_FALSE((descriptor & internal::kZstdSeekTableReservedBits) !=
+                         0)) {
+    return Fail(absl::InvalidArgumentError(
+        "Invalid Zstd seek table: reserved bits set"));
+  }
+  const bool has_checksums =
+      (descriptor & internal::kZstdSeekTableChecksumFlag) != 0;
+  const Position entry_size =
+      internal::kZstdSeekTableEntrySize +
+      (has_checksums ? internal::kZstdSeekTableChecksumSize : 0);
+  const Position table_size =
+      Position{num_frames} * entry_size + internal::kZstdSeekTableFooterSize;
+  if (ABSL_PREDICT_FALSE(table_size + internal::kZstdSeekTableHeaderSize >
+                         *size - initial_compressed_pos_)) {
+    return Fail(absl::InvalidArgumentError(
+        "Invalid Zstd seek table: larger than the compressed stream"));
+  }
+  const Position table_pos =
+      *size - table_size - internal::kZstdSeekTableHeaderSize;
+  uint32_t frame_magic, frame_size;
+  if (ABSL_PREDICT_FALSE(!src.Seek(table_pos) ||
+                         !ReadLittleEndian32(src, frame_magic) ||
+                         !ReadLittleEndian32(src, frame_size))) {
+    src.Fail(absl::DataLossError("Zstd-compressed stream got truncated"));
+    return Fail(src);
+  }
+  if (ABSL_PREDICT_FALSE(frame_magic != internal::kZstdSeekTableMagic ||
+                         frame_size != table_size)) {
+    return Fail(absl::InvalidArgumentError(
+        "Invalid Zstd seek table: invalid skippable frame header"));
+  }
+  std::shared_ptr<SeekTable> seek_table = std::make_shared<SeekTable>();
+  seek_table->compressed_pos.reserve(size_t{num_frames} + 1);
+  seek_table->decompressed_pos.reserve(size_t{num_frames} + 1);
+  seek_table->compressed_pos.push_back(0);
+  seek_table->decompressed_pos.push_back(0);
+  for (uint32_t i = 0; i < num_frames; ++i) {
+    uint32_t compressed_size, decompressed_size;
+    if (ABSL_PREDICT_FALSE(!ReadLittleEndian32(src, compressed_size) ||
+                           !ReadLittleEndian32(src, decompressed_size) ||
+                           (has_checksums &&
+                            !src.Skip(internal::kZstdSeekTableChecksumSize)))) {
+      src.Fail(absl::DataLossError("Zstd-compressed stream got truncated"));
+      return Fail(src);
+    }
+    seek_table->compressed_pos.push_back(seek_table->compressed_pos.back() +
+                                         compressed_size);
+    seek_table->decompressed_pos.push_back(
+        seek_table->decompressed_pos.back() + decompressed_size);
+  }
+  if (ABSL_PREDICT_FALSE(seek_table->compressed_pos.back() !=
+                         table_pos - initial_compressed_pos_)) {
+    return Fail(absl::InvalidArgumentError(
+        "Invalid Zstd seek table: frame sizes do not match the compressed "
+        "stream"));
+  }
+  if (ABSL_PREDICT_FALSE(!src.Seek(initial_compressed_pos_))) {
+    src.Fail(absl::DataLossError("Zstd-compressed stream got truncated"));
+    return Fail(src);
+  }
+  seek_table_ = std::move(seek_table);
+  return true;
+}
+
+inline void ZstdReaderBase::SetSeekTable(
+    std::shared_ptr<const SeekTable> seek_table) {
+  if (ABSL_PREDICT_FALSE(!healthy())) return;
+  seekable_ = true;
+  seek_table_ = std::move(seek_table);
+  uncompressed_size_ = seek_table_->decompressed_pos.back();
+  set_size_hint(UnsignedMax(Position{1}, *uncompressed_size_));
+}
+
 inline void ZstdReaderBase::InitializeDecompressor(Reader& src) {
   decompressor_ = RecyclingPool<ZSTD_DCtx, ZSTD_DCtxDeleter>::global().Get(
       [] {
@@ -104,7 +214,11 @@ inline void ZstdReaderBase::InitializeDecompressor(Reader& src) {
       return;
     }
   }
-  uncompressed_size_ = ZstdUncompressedSize(src);
+  if (seek_table_ != nullptr) {
+    uncompressed_size_ = seek_table_->decompressed_pos.back();
+  } else {
+    uncompressed_size_ = ZstdUncompressedSize(src);
+  }
   if (uncompressed_size_ != absl::nullopt) {
     // If `uncompressed_size_` is 0, set `size_hint` to 1, because the first
     // `Pull()` call will need a non-empty destination buffer before calling the
@@ -160,8 +274,30 @@ bool ZstdReaderBase::ReadInternal(size_t min_length, size_t max_length,
                          std::numeric_limits<Position>::max() - limit_pos())) {
     return FailOverflow();
   }
+  if (seek_table_ != nullptr) {
+    if (limit_pos() >= seek_table_->decompressed_pos.back()) {
+      // Do not decompress the seek table.
+      decompressor_.reset();
+      return false;
+    }
+    if (parallelism_ > 0) {
+      size_t length_read;
+      if (ABSL_PREDICT_FALSE(
+              !ReadFramesInParallel(max_length, dest, length_read))) {
+        return false;
+      }
+      if (length_read >= min_length) return true;
+      dest += length_read;
+      min_length -= length_read;
+      max_length -= length_read;
+      if (limit_pos() >= seek_table_->decompressed_pos.back()) {
+        decompressor_.reset();
+        return false;
+      }
+    }
+  }
   size_t effective_min_length = min_length;
-  if (just_initialized_ && !growing_source_ &&
+  if (just_initialized_ && !growing_source_ && seek_table_ == nullptr &&
       uncompressed_size_ != absl::nullopt &&
       max_length >= *uncompressed_size_) {
     // Avoid a memory copy from an internal buffer of the Zstd engine to `dest`
@@ -183,6 +319,15 @@ bool ZstdReaderBase::ReadInternal(size_t min_length, size_t max_length,
         ZSTD_decompressStream(decompressor_.get(), &output, &input);
     src.set_cursor(static_cast<const char*>(input.src) + input.pos);
     if (ABSL_PREDICT_FALSE(result == 0)) {
+      if (seek_table_ != nullptr &&
+          limit_pos() + output.pos < seek_table_->decompressed_pos.back()) {
+        // A frame of the seekable format ended, the next frame follows.
+        if (output.pos >= min_length) {
+          move_limit_pos(output.pos);
+          return true;
+        }
+        continue;
+      }
       decompressor_.reset();
       move_limit_pos(output.pos);
       return output.pos >= min_length;
@@ -218,6 +363,128 @@ bool ZstdReaderBase::ReadInternal(size_t min_length, size_t max_length,
   }
 }
 
+bool ZstdReaderBase::ReadFramesInParallel(size_t max_length, char* dest,
+                                          size_t& length_read) {
+  length_read = 0;
+  const SeekTable& seek_table = *seek_table_;
+  const std::vector<Position>& decompressed_pos = seek_table.decompressed_pos;
+  const std::vector<Position>::const_iterator first_iter = std::lower_bound(
+      decompressed_pos.begin(), decompressed_pos.end(), limit_pos());
+  if (first_iter == decompressed_pos.end() || *first_iter != limit_pos()) {
+    return true;
+  }
+  const size_t first =
+      IntCast<size_t>(first_iter - decompressed_pos.begin());
+  Reader& src = *src_reader();
+  // Decompression of the current frame must not have started.
+  if (src.pos() != initial_compressed_pos_ + seek_table.compressed_pos[first]) {
+    return true;
+  }
+  size_t last = first;
+  while (last + 1 < decompressed_pos.size() &&
+         decompressed_pos[last + 1] - limit_pos() <= max_length) {
+    ++last;
+  }
+  // Parallelism is not worth it for a single frame.
+  if (last - first < 2) return true;
+  std::string compressed;
+  if (ABSL_PREDICT_FALSE(!src.Read(
+          IntCast<size_t>(seek_table.compressed_pos[last] -
+                          seek_table.compressed_pos[first]),
+          compressed))) {
+    if (ABSL_PREDICT_FALSE(!src.healthy())) return Fail(src);
+    return Fail(Annotate(
+        absl::InvalidArgumentError("Truncated Zstd-compressed stream"),
+        absl::StrCat("at byte ", src.pos())));
+  }
+  std::shared_ptr<const ZSTD_DDict> prepared;
+  if (!dictionary_.empty()) {
+    prepared = dictionary_.PrepareDecompressionDictionary();
+    if (ABSL_PREDICT_FALSE(prepared == nullptr)) {
+      return Fail(absl::InternalError("ZSTD_createDDict_advanced() failed"));
+    }
+  }
+  // Each task decompresses every `num_tasks`-th frame. Tasks refer to local
+  // variables, which outlive them because all tasks are waited for.
+  const size_t num_tasks =
+      UnsignedMin(last - first, IntCast<size_t>(parallelism_));
+  std::vector<std::future<absl::Status>> results;
+  results.reserve(num_tasks);
+  for (size_t task = 0; task < num_tasks; ++task) {
+    std::promise<absl::Status>* const promise =
+        new std::promise<absl::Status>();
+    results.push_back(promise->get_future());
+    internal::ThreadPool::global().Schedule([promise, &seek_table, &compressed,
+                                             dest, &prepared, first, last,
+                                             task, num_tasks] {
+      absl::Status status;
+      for (size_t i = first + task; i < last; i += num_tasks) {
+        status = DecompressFrame(
+            absl::string_view(compressed)
+                .substr(IntCast<size_t>(seek_table.compressed_pos[i] -
+                                        seek_table.compressed_pos[first]),
+                        IntCast<size_t>(seek_table.compressed_pos[i + 1] -
+                                        seek_table.compressed_pos[i])),
+            dest + IntCast<size_t>(seek_table.decompressed_pos[i] -
+                                   seek_table.decompressed_pos[first]),
+            IntCast<size_t>(seek_table.decompressed_pos[i + 1] -
+                            seek_table.decompressed_pos[i]),
+            prepared.get());
+        if (ABSL_PREDICT_FALSE(!status.ok())) break;
+      }
+      promise->set_value(std::move(status));
+      delete promise;
+    });
+  }
+  absl::Status status;
+  for (std::future<absl::Status>& result : results) {
+    absl::Status task_status = result.get();
+    if (status.ok()) status = std::move(task_status);
+  }
+  if (ABSL_PREDICT_FALSE(!status.ok())) {
+    return Fail(Annotate(status, absl::StrCat("at byte ", src.pos())));
+  }
+  length_read =
+      IntCast<size_t>(decompressed_pos[last] - decompressed_pos[first]);
+  move_limit_pos(length_read);
+  return true;
+}
+
+absl::Status ZstdReaderBase::DecompressFrame(absl::string_view src, char* dest,
+                                             size_t dest_size,
+                                             const ZSTD_DDict* dictionary) {
+  const RecyclingPool<ZSTD_DCtx, ZSTD_DCtxDeleter>::Handle decompressor =
+      RecyclingPool<ZSTD_DCtx, ZSTD_DCtxDeleter>::global().Get(
+          [] {
+            return std::unique_ptr<ZSTD_DCtx, ZSTD_DCtxDeleter>(
+                ZSTD_createDCtx());
+          },
+          [](ZSTD_DCtx* decompressor) {
+            const size_t result =
+                ZSTD_DCtx_reset(decompressor, ZSTD_reset_session_and_parameters);
+            RIEGELI_ASSERT(!ZSTD_isError(result))
+                << "ZSTD_DCtx_reset() failed: " << ZSTD_getErrorName(result);
+          });
+  if (ABSL_PREDICT_FALSE(decompressor == nullptr)) {
+    return absl::InternalError("ZSTD_createDCtx() failed");
+  }
+  const size_t result =
+      dictionary == nullptr
+          ? ZSTD_decompressDCtx(decompressor.get(), dest, dest_size,
+                                src.data(), src.size())
+          : ZSTD_decompress_usingDDict(decompressor.get(), dest, dest_size,
+                                       src.data(), src.size(), dictionary);
+  if (ABSL_PREDICT_FALSE(ZSTD_isError(result))) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "ZSTD_decompressDCtx() failed: ", ZSTD_getErrorName(result)));
+  }
+  if (ABSL_PREDICT_FALSE(result != dest_size)) {
+    return absl::InvalidArgumentError(
+        "Zstd frame size does not match the seek table");
+  }
+  return absl::OkStatus();
+}
+
 bool ZstdReaderBase::SupportsRewind() {
   Reader* const src = src_reader();
   return src != nullptr && src->SupportsRewind();
@@ -230,6 +497,27 @@ bool ZstdReaderBase::SeekBehindBuffer(Position new_pos) {
   RIEGELI_ASSERT_EQ(start_to_limit(), 0u)
       << "Failed precondition of BufferedReader::SeekBehindBuffer(): "
          "buffer not empty";
+  if (seek_table_ != nullptr && seek_table_->decompressed_pos.size() > 1) {
+    if (ABSL_PREDICT_FALSE(!healthy())) return false;
+    const std::vector<Position>& decompressed_pos =
+        seek_table_->decompressed_pos;
+    // The last frame starting at or before `new_pos`, or the last frame if
+    // `new_pos` is beyond the end. `decompressed_pos` ends with the end of the
+    // last frame, which is not a beginning of a frame.
+    const size_t frame_index =
+        IntCast<size_t>(std::upper_bound(decompressed_pos.begin(),
+                                         decompressed_pos.end() - 1, new_pos) -
+                        decompressed_pos.begin()) -
+        1;
+    // Use the frame if seeking backwards, or if seeking forwards beyond the
+    // frame.
+    if (new_pos <= limit_pos() ||
+        decompressed_pos[frame_index] > limit_pos()) {
+      if (ABSL_PREDICT_FALSE(!SeekToFrame(frame_index))) return false;
+      if (new_pos == limit_pos()) return true;
+    }
+    return BufferedReader::SeekBehindBuffer(new_pos);
+  }
   if (new_pos <= limit_pos()) {
     // Seeking backwards.
     if (ABSL_PREDICT_FALSE(!healthy())) return false;
@@ -249,6 +537,21 @@ bool ZstdReaderBase::SeekBehindBuffer(Position new_pos) {
   return BufferedReader::SeekBehindBuffer(new_pos);
 }
 
+bool ZstdReaderBase::SeekToFrame(size_t frame_index) {
+  Reader& src = *src_reader();
+  truncated_ = false;
+  set_buffer();
+  set_limit_pos(seek_table_->decompressed_pos[frame_index]);
+  decompressor_.reset();
+  if (ABSL_PREDICT_FALSE(!src.Seek(initial_compressed_pos_ +
+                                   seek_table_->compressed_pos[frame_index]))) {
+    src.Fail(absl::DataLossError("Zstd-compressed stream got truncated"));
+    return Fail(src);
+  }
+  InitializeDecompressor(src);
+  return healthy();
+}
+
 absl::optional<Position> ZstdReaderBase::SizeImpl() {
   if (ABSL_PREDICT_FALSE(!healthy())) return absl::nullopt;
   if (ABSL_PREDICT_FALSE(uncompressed_size_ == absl::nullopt)) {
@@ -273,13 +576,18 @@ std::unique_ptr<Reader> ZstdReaderBase::NewReaderImpl(Position initial_pos) {
     Fail(src);
     return nullptr;
   }
-  std::unique_ptr<Reader> reader =
+  // The seek table is shared instead of being read again.
+  std::unique_ptr<ZstdReaderBase> reader =
       std::make_unique<ZstdReader<std::unique_ptr<Reader>>>(
-          std::move(compressed_reader), ZstdReaderBase::Options()
-                                            .set_growing_source(growing_source_)
-                                            .set_dictionary(dictionary_)
-                                            .set_size_hint(size_hint())
-                                            .set_buffer_size(buffer_size()));
+          std::move(compressed_reader),
+          ZstdReaderBase::Options()
+              .set_growing_source(growing_source_)
+              .set_dictionary(dictionary_)
+              .set_seekable(seekable_ && seek_table_ == nullptr)
+              .set_parallelism(parallelism_)
+              .set_size_hint(size_hint())
+              .set_buffer_size(buffer_size()));
+  if (seek_table_ != nullptr) reader->SetSeekTable(seek_table_);
   reader->Seek(initial_pos);
   return reader;
 }
@@ -21,9 +21,12 @@
 #include <tuple>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "absl/base/attributes.h"
 #include "absl/base/optimization.h"
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
 #include "riegeli/base/base.h"
 #include "riegeli/base/dependency.h"
@@ -77,6 +80,48 @@ class ZstdReaderBase : public BufferedReader {
     ZstdDictionary& dictionary() { return dictionary_; }
     const ZstdDictionary& dictionary() const { return dictionary_; }
 
+    // If `true` and the compressed `Reader` supports random access, looks for
+    // a seek table at the end of the source, written with
+    // `ZstdWriterBase::Options::set_seekable_frame_size()` or by another
+    // encoder of the Zstd seekable format.
+    //
+    // If the seek table is found, all frames are decompressed, and
+    // `ZstdReader` supports random access, `Size()`, and `NewReader()` by
+    // decompressing from the nearest frame. Otherwise the source is read as
+    // usual.
+    //
+    // Ignored if `growing_source()` is `true`.
+    //
+    // Default: `false`.
+    Options& set_seekable(bool seekable) & {
+      seekable_ = seekable;
+      return *this;
+    }
+    Options&& set_seekable(bool seekable) && {
+      return std::move(set_seekable(seekable));
+    }
+    bool seekable() const { return seekable_; }
+
+    // Number of background threads which decompress frames in parallel, if a
+    // seek table is found (see `seekable()`). This applies to reads into a
+    // large destination, which covers several whole frames, e.g. by
+    // `Read()` to a large array or `Copy()`.
+    //
+    // `parallelism` must be non-negative. Default: 0 (decompress in the calling
+    // thread).
+    Options& set_parallelism(int parallelism) & {
+      RIEGELI_ASSERT_GE(parallelism, 0)
+          << "Failed precondition of "
+             "ZstdReaderBase::Options::set_parallelism(): "
+             "negative parallelism";
+      parallelism_ = parallelism;
+      return *this;
+    }
+    Options&& set_parallelism(int parallelism) && {
+      return std::move(set_parallelism(parallelism));
+    }
+    int parallelism() const { return parallelism_; }
+
     // Expected uncompressed size, or `absl::nullopt` if unknown. This may
     // improve performance.
     //
@@ -112,6 +157,8 @@ class ZstdReaderBase : public BufferedReader {
    private:
     bool growing_source_ = false;
     ZstdDictionary dictionary_;
+    bool seekable_ = false;
+    int parallelism_ = 0;
     absl::optional<Position> size_hint_;
     size_t buffer_size_ = DefaultBufferSize();
   };
@@ -125,6 +172,7 @@ class ZstdReaderBase : public BufferedReader {
   // does not grow, `Close()` will fail.
   bool truncated() const { return truncated_; }
 
+  bool SupportsRandomAccess() override { return seek_table_ != nullptr; }
   bool SupportsRewind() override;
   bool SupportsSize() override { return uncompressed_size_ != absl::nullopt; }
   bool SupportsNewReader() override;
@@ -133,15 +181,16 @@ class ZstdReaderBase : public BufferedReader {
   explicit ZstdReaderBase(Closed) noexcept : BufferedReader(kClosed) {}
 
   explicit ZstdReaderBase(bool growing_source, ZstdDictionary&& dictionary,
-                          size_t buffer_size,
+                          bool seekable, int parallelism, size_t buffer_size,
                           absl::optional<Position> size_hint);
 
   ZstdReaderBase(ZstdReaderBase&& that) noexcept;
   ZstdReaderBase& operator=(ZstdReaderBase&& that) noexcept;
 
   void Reset(Closed);
-  void Reset(bool growing_source, ZstdDictionary&& dictionary,
-             size_t buffer_size, absl::optional<Position> size_hint);
+  void Reset(bool growing_source, ZstdDictionary&& dictionary, bool seekable,
+             int parallelism, size_t buffer_size,
+             absl::optional<Position> size_hint);
   void Initialize(Reader* src);
 
   void Done() override;
@@ -161,7 +210,32 @@ class ZstdReaderBase : public BufferedReader {
     void operator()(ZSTD_DCtx* ptr) const { ZSTD_freeDCtx(ptr); }
   };
 
+  // Positions of frame boundaries of the Zstd seekable format, relative to
+  // the beginning of the compressed stream and of the decompressed data, with
+  // the end of the last frame as the last element.
+  struct SeekTable {
+    std::vector<Position> compressed_pos;
+    std::vector<Position> decompressed_pos;
+  };
+
   void InitializeDecompressor(Reader& src);
+  // Reads the seek table from the end of `src` if it is present, and returns
+  // to the current position.
+  bool ReadSeekTable(Reader& src);
+  // Uses a seek table already read by another `ZstdReader` of the same source,
+  // instead of `ReadSeekTable()`.
+  void SetSeekTable(std::shared_ptr<const SeekTable> seek_table);
+  // Restarts decompression at the beginning of the frame with the given index.
+  bool SeekToFrame(size_t frame_index);
+  // Decompresses whole frames starting from the current position to `dest`
+  // in parallel, if the current position is at a frame boundary and
+  // `max_length` covers several frames. Sets `length_read` to the length
+  // decompressed, possibly 0.
+  bool ReadFramesInParallel(size_t max_length, char* dest,
+                            size_t& length_read);
+  static absl::Status DecompressFrame(absl::string_view src, char* dest,
+                                      size_t dest_size,
+                                      const ZSTD_DDict* dictionary);
 
   // If `true`, supports decompressing as much as possible from a truncated
   // source, then retrying when the source has grown.
@@ -173,6 +247,8 @@ class ZstdReaderBase : public BufferedReader {
   // will fail.
   bool truncated_ = false;
   ZstdDictionary dictionary_;
+  bool seekable_ = false;
+  int parallelism_ = 0;
   Position initial_compressed_pos_ = 0;
   // If `healthy()` but `decompressor_ == nullptr` then all data have been
   // decompressed. In this case `ZSTD_decompressStream()` must not be called
@@ -180,6 +256,8 @@ class ZstdReaderBase : public BufferedReader {
   RecyclingPool<ZSTD_DCtx, ZSTD_DCtxDeleter>::Handle decompressor_;
   // Uncompressed size, if known.
   absl::optional<Position> uncompressed_size_;
+  // Seek table of the Zstd seekable format, if present.
+  std::shared_ptr<const SeekTable> seek_table_;
 };
 
 // A `Reader` which decompresses data with Zstd after getting it from another
@@ -269,11 +347,14 @@ absl::optional<Position> ZstdUncompressedSize(Reader& src);
 
 inline ZstdReaderBase::ZstdReaderBase(bool growing_source,
                                       ZstdDictionary&& dictionary,
+                                      bool seekable, int parallelism,
                                       size_t buffer_size,
                                       absl::optional<Position> size_hint)
     : BufferedReader(buffer_size, size_hint),
       growing_source_(growing_source),
-      dictionary_(std::move(dictionary)) {}
+      dictionary_(std::move(dictionary)),
+      seekable_(seekable),
+      parallelism_(parallelism) {}
 
 inline ZstdReaderBase::ZstdReaderBase(ZstdReaderBase&& that) noexcept
     : BufferedReader(std::move(that)),
@@ -283,9 +364,12 @@ inline ZstdReaderBase::ZstdReaderBase(ZstdReaderBase&& that) noexcept
       just_initialized_(that.just_initialized_),
       truncated_(that.truncated_),
       dictionary_(std::move(that.dictionary_)),
+      seekable_(that.seekable_),
+      parallelism_(that.parallelism_),
       initial_compressed_pos_(that.initial_compressed_pos_),
       decompressor_(std::move(that.decompressor_)),
-      uncompressed_size_(that.uncompressed_size_) {}
+      uncompressed_size_(that.uncompressed_size_),
+      seek_table_(std::move(that.seek_table_)) {}
 
 inline ZstdReaderBase& ZstdReaderBase::operator=(
     ZstdReaderBase&& that) noexcept {
@@ -296,9 +380,12 @@ inline ZstdReaderBase& ZstdReaderBase::operator=(
   just_initialized_ = that.just_initialized_;
   truncated_ = that.truncated_;
   dictionary_ = std::move(that.dictionary_);
+  seekable_ = that.seekable_;
+  parallelism_ = that.parallelism_;
   initial_compressed_pos_ = that.initial_compressed_pos_;
   decompressor_ = std::move(that.decompressor_);
   uncompressed_size_ = that.uncompressed_size_;
+  seek_table_ = std::move(that.seek_table_);
   return *this;
 }
 
@@ -307,29 +394,36 @@ inline void ZstdReaderBase::Reset(Closed) {
   growing_source_ = false;
   just_initialized_ = false;
   truncated_ = false;
+  seekable_ = false;
+  parallelism_ = 0;
   initial_compressed_pos_ = 0;
   decompressor_.reset();
   dictionary_ = ZstdDictionary();
   uncompressed_size_ = absl::nullopt;
+  seek_table_.reset();
 }
 
 inline void ZstdReaderBase::Reset(bool growing_source,
-                                  ZstdDictionary&& dictionary,
-                                  size_t buffer_size,
+                                  ZstdDictionary&& dictionary, bool seekable,
+                                  int parallelism, size_t buffer_size,
                                   absl::optional<Position> size_hint) {
   BufferedReader::Reset(buffer_size, size_hint);
   growing_source_ = growing_source;
   just_initialized_ = false;
   truncated_ = false;
+  seekable_ = seekable;
+  parallelism_ = parallelism;
   initial_compressed_pos_ = 0;
   decompressor_.reset();
   dictionary_ = std::move(dictionary);
   uncompressed_size_ = absl::nullopt;
+  seek_table_.reset();
 }
 
 template <typename Src>
 inline ZstdReader<Src>::ZstdReader(const Src& src, Options options)
     : ZstdReaderBase(options.growing_source(), std::move(options.dictionary()),
+                     options.seekable(), options.parallelism(),
                      options.buffer_size(), options.size_hint()),
       src_(src) {
   Initialize(src_.get());
@@ -338,6 +432,7 @@ inline ZstdReader<Src>::ZstdReader(const Src& src, Options options)
 template <typename Src>
 inline ZstdReader<Src>::ZstdReader(Src&& src, Options options)
     : ZstdReaderBase(options.growing_source(), std::move(options.dictionary()),
+                     options.seekable(), options.parallelism(),
                      options.buffer_size(), options.size_hint()),
       src_(std::move(src)) {
   Initialize(src_.get());
@@ -348,6 +443,7 @@ template <typename... SrcArgs>
 inline ZstdReader<Src>::ZstdReader(std::tuple<SrcArgs...> src_args,
                                    Options options)
     : ZstdReaderBase(options.growing_source(), std::move(options.dictionary()),
+                     options.seekable(), options.parallelism(),
                      options.buffer_size(), options.size_hint()),
       src_(std::move(src_args)) {
   Initialize(src_.get());
@@ -378,7 +474,8 @@ inline void ZstdReader<Src>::Reset(Closed) {
 template <typename Src>
 inline void ZstdReader<Src>::Reset(const Src& src, Options options) {
   ZstdReaderBase::Reset(options.growing_source(),
-                        std::move(options.dictionary()), options.buffer_size(),
+                        std::move(options.dictionary()), options.seekable(),
+                        options.parallelism(), options.buffer_size(),
                         options.size_hint());
   src_.Reset(src);
   Initialize(src_.get());
@@ -387,7 +484,8 @@ inline void ZstdReader<Src>::Reset(const Src& src, Options options) {
 template <typename Src>
 inline void ZstdReader<Src>::Reset(Src&& src, Options options) {
   ZstdReaderBase::Reset(options.growing_source(),
-                        std::move(options.dictionary()), options.buffer_size(),
+                        std::move(options.dictionary()), options.seekable(),
+                        options.parallelism(), options.buffer_size(),
                         options.size_hint());
   src_.Reset(std::move(src));
   Initialize(src_.get());
@@ -398,7 +496,8 @@ template <typename... SrcArgs>
 inline void ZstdReader<Src>::Reset(std::tuple<SrcArgs...> src_args,
                                    Options options) {
   ZstdReaderBase::Reset(options.growing_source(),
-                        std::move(options.dictionary()), options.buffer_size(),
+                        std::move(options.dictionary()), options.seekable(),
+                        options.parallelism(), options.buffer_size(),
                         options.size_hint());
   src_.Reset(std::move(src_args));
   Initialize(src_.get());
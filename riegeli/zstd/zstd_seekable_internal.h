@@ -0,0 +1,54 @@
+// Copyright 2022 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RIEGELI_ZSTD_ZSTD_SEEKABLE_INTERNAL_H_
+#define RIEGELI_ZSTD_ZSTD_SEEKABLE_INTERNAL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "riegeli/base/base.h"
+
+namespace riegeli {
+namespace internal {
+
+// Constants of the Zstd seekable format: independent Zstd frames followed by a
+// skippable frame containing a seek table, see
+// https://github.com/facebook/zstd/blob/dev/contrib/seekable_format/zstd_seekable_compression_format.md
+//
+// The seek table consists of the skippable frame header (magic number and
+// frame size, 4 bytes each), entries for each frame (compressed size and
+// decompressed size, 4 bytes each, optionally followed by a checksum), and the
+// footer (number of frames, 4 bytes; descriptor, 1 byte; seekable magic
+// number, 4 bytes). All integers are little endian.
+
+RIEGELI_INTERNAL_INLINE_CONSTEXPR(uint32_t, kZstdSeekTableMagic, 0x184D2A5E);
+RIEGELI_INTERNAL_INLINE_CONSTEXPR(uint32_t, kZstdSeekableMagic, 0x8F92EAB1);
+RIEGELI_INTERNAL_INLINE_CONSTEXPR(size_t, kZstdSeekTableHeaderSize, 8);
+RIEGELI_INTERNAL_INLINE_CONSTEXPR(size_t, kZstdSeekTableEntrySize, 8);
+RIEGELI_INTERNAL_INLINE_CONSTEXPR(size_t, kZstdSeekTableChecksumSize, 4);
+RIEGELI_INTERNAL_INLINE_CONSTEXPR(size_t, kZstdSeekTableFooterSize, 9);
+
+// Bits of the seek table descriptor.
+RIEGELI_INTERNAL_INLINE_CONSTEXPR(uint8_t, kZstdSeekTableChecksumFlag, 0x80);
+RIEGELI_INTERNAL_INLINE_CONSTEXPR(uint8_t, kZstdSeekTableReservedBits, 0x7c);
+
+// Maximum decompressed size of a frame.
+RIEGELI_INTERNAL_INLINE_CONSTEXPR(size_t, kZstdSeekableMaxFrameSize,
+                                  size_t{1} << 30);
+
+}  // namespace internal
+}  // namespace riegeli
+
+#endif  // RIEGELI_ZSTD_ZSTD_SEEKABLE_INTERNAL_H_
@@ -19,10 +19,12 @@
 #include "riegeli/zstd/zstd_writer.h"
 
 #include <stddef.h>
+#include <stdint.h>
 
 #include <limits>
 #include <memory>
 #include <string>
+#include <utility>
 
 #include "absl/base/optimization.h"
 #include "absl/status/status.h"
@@ -34,6 +36,8 @@
 #include "riegeli/base/status.h"
 #include "riegeli/bytes/buffered_writer.h"
 #include "riegeli/bytes/writer.h"
+#include "riegeli/endian/endian_writing.h"
+#include "riegeli/zstd/zstd_seekable_internal.h"
 #include "zstd.h"
 
 namespace riegeli {
@@ -47,32 +51,79 @@ constexpr int ZstdWriterBase::Options::kMaxCompressionLevel;
 constexpr int ZstdWriterBase::Options::kDefaultCompressionLevel;
 constexpr int ZstdWriterBase::Options::kMinWindowLog;
 constexpr int ZstdWriterBase::Options::kMaxWindowLog;
+constexpr int ZstdWriterBase::Options::kMinOverlapLog;
+constexpr int ZstdWriterBase::Options::kMaxOverlapLog;
+constexpr size_t ZstdWriterBase::Options::kMaxSeekableFrameSize;
 #endif
 
 void ZstdWriterBase::Initialize(Writer* dest, int compression_level,
                                 absl::optional<int> window_log,
                                 bool store_checksum,
-                                absl::optional<Position> size_hint) {
+                                absl::optional<Position> size_hint,
+                                int parallelism,
+                                absl::optional<size_t> job_size,
+                                absl::optional<int> overlap_log) {
   RIEGELI_ASSERT(dest != nullptr)
       << "Failed precondition of ZstdWriter: null Writer pointer";
   if (ABSL_PREDICT_FALSE(!dest->healthy())) {
     Fail(*dest);
     return;
   }
-  compressor_ = RecyclingPool<ZSTD_CCtx, ZSTD_CCtxDeleter>::global().Get(
-      [] {
-        return std::unique_ptr<ZSTD_CCtx, ZSTD_CCtxDeleter>(ZSTD_createCCtx());
-      },
-      [](ZSTD_CCtx* compressor) {
-        const size_t result =
-            ZSTD_CCtx_reset(compressor, ZSTD_reset_session_and_parameters);
-        RIEGELI_ASSERT(!ZSTD_isError(result))
-            << "ZSTD_CCtx_reset() failed: " << ZSTD_getErrorName(result);
-      });
+  frame_start_compressed_pos_ = dest->pos();
+  compressor_ =
+      KeyedRecyclingPool<ZSTD_CCtx, int, ZSTD_CCtxDeleter>::global().Get(
+          parallelism,
+          [] {
+            return std::unique_ptr<ZSTD_CCtx, ZSTD_CCtxDeleter>(
+                ZSTD_createCCtx());
+          },
+          [](ZSTD_CCtx* compressor) {
+            // Resetting parameters keeps background threads allocated, so
+            // that they can be reused after `ZSTD_c_nbWorkers` is set again.
+            const size_t result =
+                ZSTD_CCtx_reset(compressor, ZSTD_reset_session_and_parameters);
+            RIEGELI_ASSERT(!ZSTD_isError(result))
+                << "ZSTD_CCtx_reset() failed: " << ZSTD_getErrorName(result);
+          });
   if (ABSL_PREDICT_FALSE(compressor_ == nullptr)) {
     Fail(absl::InternalError("ZSTD_createCCtx() failed"));
     return;
   }
+  if (parallelism > 0) {
+    // Set `ZSTD_c_nbWorkers` first because other multithreading parameters
+    // are meaningful only with background threads.
+    {
+      const size_t result = ZSTD_CCtx_setParameter(
+          compressor_.get(), ZSTD_c_nbWorkers, parallelism);
+      if (ABSL_PREDICT_FALSE(ZSTD_isError(result))) {
+        Fail(absl::InternalError(
+            absl::StrCat("ZSTD_CCtx_setParameter(ZSTD_c_nbWorkers) failed: ",
+                         ZSTD_getErrorName(result))));
+        return;
+      }
+    }
+    if (job_size != absl::nullopt) {
+      const size_t result =
+          ZSTD_CCtx_setParameter(compressor_.get(), ZSTD_c_jobSize,
+                                 SaturatingIntCast<int>(*job_size));
+      if (ABSL_PREDICT_FALSE(ZSTD_isError(result))) {
+        Fail(absl::InternalError(
+            absl::StrCat("ZSTD_CCtx_setParameter(ZSTD_c_jobSize) failed: ",
+                         ZSTD_getErrorName(result))));
+        return;
+      }
+    }
+    if (overlap_log != absl::nullopt) {
+      const size_t result = ZSTD_CCtx_setParameter(
+          compressor_.get(), ZSTD_c_overlapLog, *overlap_log);
+      if (ABSL_PREDICT_FALSE(ZSTD_isError(result))) {
+        Fail(absl::InternalError(
+            absl::StrCat("ZSTD_CCtx_setParameter(ZSTD_c_overlapLog) failed: ",
+                         ZSTD_getErrorName(result))));
+        return;
+      }
+    }
+  }
   {
     const size_t result = ZSTD_CCtx_setParameter(
         compressor_.get(), ZSTD_c_compressionLevel, compression_level);
@@ -103,7 +154,9 @@ void ZstdWriterBase::Initialize(Writer* dest, int compression_level,
       return;
     }
   }
-  if (pledged_size_ != absl::nullopt) {
+  if (pledged_size_ != absl::nullopt && seekable_frame_size_ == absl::nullopt) {
+    // With the seekable format the pledged size would apply to the first
+    // frame, so it is used only as a size hint.
     const size_t result = ZSTD_CCtx_setPledgedSrcSize(
         compressor_.get(), IntCast<unsigned long long>(*pledged_size_));
     if (ABSL_PREDICT_FALSE(ZSTD_isError(result))) {
@@ -206,6 +259,92 @@ bool ZstdWriterBase::WriteInternal(absl::string_view src, Writer& dest,
       }
     }
   }
+  if (seekable_frame_size_ != absl::nullopt) {
+    return WriteSeekable(src, dest, end_op);
+  }
+  if (ABSL_PREDICT_FALSE(!CompressInternal(src, dest, end_op))) return false;
+  if (end_op == ZSTD_e_end) compressor_.reset();
+  return true;
+}
+
+bool ZstdWriterBase::WriteSeekable(absl::string_view src, Writer& dest,
+                                   ZSTD_EndDirective end_op) {
+  RIEGELI_ASSERT(seekable_frame_size_ != absl::nullopt)
+      << "Failed precondition of ZstdWriterBase::WriteSeekable(): "
+         "seekable format not enabled";
+  // End frames which become full.
+  for (;;) {
+    const size_t remaining =
+        *seekable_frame_size_ - IntCast<size_t>(start_pos() - frame_start_pos_);
+    if (src.size() < remaining) break;
+    if (ABSL_PREDICT_FALSE(
+            !CompressInternal(src.substr(0, remaining), dest, ZSTD_e_end))) {
+      return false;
+    }
+    AddSeekableFrame(dest);
+    src.remove_prefix(remaining);
+  }
+  if (end_op == ZSTD_e_end) {
+    // End the last frame unless it would be empty. An empty stream consists of
+    // one empty frame.
+    if (start_pos() + src.size() > frame_start_pos_ || seek_table_.empty()) {
+      if (ABSL_PREDICT_FALSE(!CompressInternal(src, dest, ZSTD_e_end))) {
+        return false;
+      }
+      AddSeekableFrame(dest);
+    }
+    if (ABSL_PREDICT_FALSE(!WriteSeekTable(dest))) return false;
+    compressor_.reset();
+    return true;
+  }
+  // Do not start a frame just to flush it.
+  if (start_pos() + src.size() == frame_start_pos_) return true;
+  return CompressInternal(src, dest, end_op);
+}
+
+inline void ZstdWriterBase::AddSeekableFrame(Writer& dest) {
+  seek_table_.emplace_back(
+      IntCast<uint32_t>(dest.pos() - frame_start_compressed_pos_),
+      IntCast<uint32_t>(start_pos() - frame_start_pos_));
+  frame_start_pos_ = start_pos();
+  frame_start_compressed_pos_ = dest.pos();
+}
+
+inline bool ZstdWriterBase::WriteSeekTable(Writer& dest) {
+  const size_t entries_size =
+      seek_table_.size() * internal::kZstdSeekTableEntrySize;
+  if (ABSL_PREDICT_FALSE(
+          seek_table_.size() > std::numeric_limits<uint32_t>::max() ||
+          entries_size > std::numeric_limits<uint32_t>::max() -
+                             internal::kZstdSeekTableFooterSize)) {
+    return Fail(absl::ResourceExhaustedError("Zstd seek table too large"));
+  }
+  if (ABSL_PREDICT_FALSE(
+          !WriteLittleEndian32(internal::kZstdSeekTableMagic, dest) ||
+          !WriteLittleEndian32(
+              IntCast<uint32_t>(entries_size +
+                                internal::kZstdSeekTableFooterSize),
+              dest))) {
+    return Fail(dest);
+  }
+  for (const std::pair<uint32_t, uint32_t>& entry : seek_table_) {
+    if (ABSL_PREDICT_FALSE(!WriteLittleEndian32(entry.first, dest) ||
+                           !WriteLittleEndian32(entry.second, dest))) {
+      return Fail(dest);
+    }
+  }
+  if (ABSL_PREDICT_FALSE(
+          !WriteLittleEndian32(IntCast<uint32_t>(seek_table_.size()), dest) ||
+          !dest.WriteByte(0) ||
+          !WriteLittleEndian32(internal::kZstdSeekableMagic, dest))) {
+    return Fail(dest);
+  }
+  return true;
+}
+
+inline bool ZstdWriterBase::CompressInternal(absl::string_view src,
+                                             Writer& dest,
+                                             ZSTD_EndDirective end_op) {
   ZSTD_inBuffer input = {src.data(), src.size(), 0};
   for (;;) {
     ZSTD_outBuffer output = {dest.cursor(), dest.available(), 0};
@@ -216,7 +355,6 @@ bool ZstdWriterBase::WriteInternal(absl::string_view src, Writer& dest,
       RIEGELI_ASSERT_EQ(input.pos, input.size)
           << "ZSTD_compressStream2() returned 0 but there are still input data";
       move_start_pos(input.pos);
-      if (end_op == ZSTD_e_end) compressor_.reset();
       return true;
     }
     if (ABSL_PREDICT_FALSE(ZSTD_isError(result))) {
@@ -226,11 +364,14 @@ bool ZstdWriterBase::WriteInternal(absl::string_view src, Writer& dest,
           absl::StrCat("at byte ", dest.pos())));
     }
     if (output.pos < output.size) {
-      RIEGELI_ASSERT_EQ(input.pos, input.size)
-          << "ZSTD_compressStream2() returned but there are still input data "
-             "and output space";
-      move_start_pos(input.pos);
-      return true;
+      if (end_op == ZSTD_e_continue && input.pos == input.size) {
+        move_start_pos(input.pos);
+        return true;
+      }
+      // With background threads `ZSTD_compressStream2()` can return before
+      // consuming all input or before completing a flush even if there is
+      // output space. Call it again, it blocks until progress can be made.
+      continue;
     }
     if (ABSL_PREDICT_FALSE(!dest.Push(1, result))) return Fail(dest);
   }
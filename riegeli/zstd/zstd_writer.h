@@ -16,10 +16,12 @@
 #define RIEGELI_ZSTD_ZSTD_WRITER_H_
 
 #include <stddef.h>
+#include <stdint.h>
 
 #include <tuple>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "absl/base/attributes.h"
 #include "absl/base/optimization.h"
@@ -32,6 +34,7 @@
 #include "riegeli/bytes/buffered_writer.h"
 #include "riegeli/bytes/writer.h"
 #include "riegeli/zstd/zstd_dictionary.h"
+#include "riegeli/zstd/zstd_seekable_internal.h"
 #include "zstd.h"
 
 namespace riegeli {
@@ -194,6 +197,126 @@ class ZstdWriterBase : public BufferedWriter {
     }
     bool reserve_max_size() const { return reserve_max_size_; }
 
+    // Number of background threads which Zstd uses to compress a single stream
+    // in parallel. Larger parallelism can increase throughput when compressing
+    // large amounts of data, at the cost of memory usage and a slightly lower
+    // compression density.
+    //
+    // If `parallelism > 0`, `Flush()` waits for background threads to finish
+    // compressing data written so far.
+    //
+    // Compressors with background threads are expensive to create. They are
+    // recycled only among `ZstdWriter`s with the same `parallelism`.
+    //
+    // `parallelism` must be non-negative. Default: 0 (compress in the calling
+    // thread).
+    Options& set_parallelism(int parallelism) & {
+      RIEGELI_ASSERT_GE(parallelism, 0)
+          << "Failed precondition of "
+             "ZstdWriterBase::Options::set_parallelism(): "
+             "negative parallelism";
+      parallelism_ = parallelism;
+      return *this;
+    }
+    Options&& set_parallelism(int parallelism) && {
+      return std::move(set_parallelism(parallelism));
+    }
+    int parallelism() const { return parallelism_; }
+
+    // Size of a unit of work compressed by a single background thread. This
+    // is meaningful only if `parallelism() > 0`.
+    //
+    // Special value `absl::nullopt` means to derive `job_size` from
+    // `compression_level` and `window_log`.
+    //
+    // `job_size` must be `absl::nullopt` or positive. Zstd adjusts it to
+    // its supported range. Default: `absl::nullopt`.
+    Options& set_job_size(absl::optional<size_t> job_size) & {
+      if (job_size != absl::nullopt) {
+        RIEGELI_ASSERT_GT(*job_size, 0u)
+            << "Failed precondition of "
+               "ZstdWriterBase::Options::set_job_size(): "
+               "zero job size";
+      }
+      job_size_ = job_size;
+      return *this;
+    }
+    Options&& set_job_size(absl::optional<size_t> job_size) && {
+      return std::move(set_job_size(job_size));
+    }
+    absl::optional<size_t> job_size() const { return job_size_; }
+
+    // Logarithm of the amount of data from the previous job reloaded by the
+    // next job, relative to the window size (1 = no overlap, 9 = full window).
+    // This tunes the tradeoff between compression density and compression
+    // speed with `parallelism() > 0` (higher = better density but slower).
+    //
+    // Special value `absl::nullopt` means to derive `overlap_log` from
+    // `compression_level`.
+    //
+    // `overlap_log` must be `absl::nullopt` or between `kMinOverlapLog` (1)
+    // and `kMaxOverlapLog` (9). Default: `absl::nullopt`.
+    static constexpr int kMinOverlapLog = 1;
+    static constexpr int kMaxOverlapLog = 9;  // `ZSTD_OVERLAPLOG_MAX`
+    Options& set_overlap_log(absl::optional<int> overlap_log) & {
+      if (overlap_log != absl::nullopt) {
+        RIEGELI_ASSERT_GE(*overlap_log, kMinOverlapLog)
+            << "Failed precondition of "
+               "ZstdWriterBase::Options::set_overlap_log(): "
+               "overlap log out of range";
+        RIEGELI_ASSERT_LE(*overlap_log, kMaxOverlapLog)
+            << "Failed precondition of "
+               "ZstdWriterBase::Options::set_overlap_log(): "
+               "overlap log out of range";
+      }
+      overlap_log_ = overlap_log;
+      return *this;
+    }
+    Options&& set_overlap_log(absl::optional<int> overlap_log) && {
+      return std::move(set_overlap_log(overlap_log));
+    }
+    absl::optional<int> overlap_log() const { return overlap_log_; }
+
+    // If not `absl::nullopt`, writes the Zstd seekable format: data are split
+    // into independent frames of `seekable_frame_size` bytes of uncompressed
+    // data (except that the last frame can be shorter), followed by a seek
+    // table. This lets `ZstdReader` with `ZstdReaderBase::Options::seekable()`
+    // seek by decompressing from the nearest frame, and decompress frames in
+    // parallel. Other Zstd decoders decompress the concatenated frames as usual
+    // and skip the seek table.
+    //
+    // Smaller frames make seeking faster, at the cost of compression density.
+    //
+    // If `pledged_size()` is not `absl::nullopt`, it is verified but it is not
+    // stored in the compressed stream.
+    //
+    // `seekable_frame_size` must be `absl::nullopt` or between 1 and
+    // `kMaxSeekableFrameSize` (1G). Default: `absl::nullopt`.
+    static constexpr size_t kMaxSeekableFrameSize =
+        internal::kZstdSeekableMaxFrameSize;
+    Options& set_seekable_frame_size(
+        absl::optional<size_t> seekable_frame_size) & {
+      if (seekable_frame_size != absl::nullopt) {
+        RIEGELI_ASSERT_GT(*seekable_frame_size, 0u)
+            << "Failed precondition of "
+               "ZstdWriterBase::Options::set_seekable_frame_size(): "
+               "zero frame size";
+        RIEGELI_ASSERT_LE(*seekable_frame_size, kMaxSeekableFrameSize)
+            << "Failed precondition of "
+               "ZstdWriterBase::Options::set_seekable_frame_size(): "
+               "frame size out of range";
+      }
+      seekable_frame_size_ = seekable_frame_size;
+      return *this;
+    }
+    Options&& set_seekable_frame_size(
+        absl::optional<size_t> seekable_frame_size) && {
+      return std::move(set_seekable_frame_size(seekable_frame_size));
+    }
+    absl::optional<size_t> seekable_frame_size() const {
+      return seekable_frame_size_;
+    }
+
     // Tunes how much data is buffered before calling the compression engine.
     //
     // If `reserve_max_size()` is `true`, `pledged_size()`, if not
@@ -229,6 +352,10 @@ class ZstdWriterBase : public BufferedWriter {
     absl::optional<Position> pledged_size_;
     absl::optional<Position> size_hint_;
     bool reserve_max_size_ = false;
+    int parallelism_ = 0;
+    absl::optional<size_t> job_size_;
+    absl::optional<int> overlap_log_;
+    absl::optional<size_t> seekable_frame_size_;
     size_t buffer_size_ = DefaultBufferSize();
   };
 
@@ -242,7 +369,8 @@ class ZstdWriterBase : public BufferedWriter {
   explicit ZstdWriterBase(ZstdDictionary&& dictionary, size_t buffer_size,
                           absl::optional<Position> pledged_size,
                           absl::optional<Position> size_hint,
-                          bool reserve_max_size);
+                          bool reserve_max_size,
+                          absl::optional<size_t> seekable_frame_size);
 
   ZstdWriterBase(ZstdWriterBase&& that) noexcept;
   ZstdWriterBase& operator=(ZstdWriterBase&& that) noexcept;
@@ -250,10 +378,13 @@ class ZstdWriterBase : public BufferedWriter {
   void Reset(Closed);
   void Reset(ZstdDictionary&& dictionary, size_t buffer_size,
              absl::optional<Position> pledged_size,
-             absl::optional<Position> size_hint, bool reserve_max_size);
+             absl::optional<Position> size_hint, bool reserve_max_size,
+             absl::optional<size_t> seekable_frame_size);
   void Initialize(Writer* dest, int compression_level,
                   absl::optional<int> window_log, bool store_checksum,
-                  absl::optional<Position> size_hint);
+                  absl::optional<Position> size_hint, int parallelism,
+                  absl::optional<size_t> job_size,
+                  absl::optional<int> overlap_log);
 
   void DoneBehindBuffer(absl::string_view src) override;
   void Done() override;
@@ -272,13 +403,31 @@ class ZstdWriterBase : public BufferedWriter {
 
   bool WriteInternal(absl::string_view src, Writer& dest,
                      ZSTD_EndDirective end_op);
+  bool WriteSeekable(absl::string_view src, Writer& dest,
+                     ZSTD_EndDirective end_op);
+  bool CompressInternal(absl::string_view src, Writer& dest,
+                        ZSTD_EndDirective end_op);
+  // Records the frame which has just been ended in `seek_table_`.
+  void AddSeekableFrame(Writer& dest);
+  bool WriteSeekTable(Writer& dest);
 
   ZstdDictionary dictionary_;
   absl::optional<Position> pledged_size_;
   bool reserve_max_size_ = false;
+  absl::optional<size_t> seekable_frame_size_;
+  // Uncompressed and compressed position of the beginning of the current
+  // frame, if `seekable_frame_size_ != absl::nullopt`.
+  Position frame_start_pos_ = 0;
+  Position frame_start_compressed_pos_ = 0;
+  // Compressed and uncompressed sizes of frames written so far, if
+  // `seekable_frame_size_ != absl::nullopt`.
+  std::vector<std::pair<uint32_t, uint32_t>> seek_table_;
   // If `healthy()` but `compressor_ == nullptr` then `*pledged_size_` has been
   // reached. In this case `ZSTD_compressStream()` must not be called again.
-  RecyclingPool<ZSTD_CCtx, ZSTD_CCtxDeleter>::Handle compressor_;
+  //
+  // Compressors are keyed by `parallelism`, so that background threads owned
+  // by a compressor are reused only with the same number of threads.
+  KeyedRecyclingPool<ZSTD_CCtx, int, ZSTD_CCtxDeleter>::Handle compressor_;
 };
 
 // A `Writer` which compresses data with Zstd before passing it to another
@@ -362,11 +511,13 @@ inline ZstdWriterBase::ZstdWriterBase(ZstdDictionary&& dictionary,
                                       size_t buffer_size,
                                       absl::optional<Position> pledged_size,
                                       absl::optional<Position> size_hint,
-                                      bool reserve_max_size)
+                                      bool reserve_max_size,
+                                      absl::optional<size_t> seekable_frame_size)
     : BufferedWriter(buffer_size, size_hint),
       dictionary_(std::move(dictionary)),
       pledged_size_(pledged_size),
-      reserve_max_size_(reserve_max_size) {}
+      reserve_max_size_(reserve_max_size),
+      seekable_frame_size_(seekable_frame_size) {}
 
 inline ZstdWriterBase::ZstdWriterBase(ZstdWriterBase&& that) noexcept
     : BufferedWriter(std::move(that)),
@@ -375,6 +526,10 @@ inline ZstdWriterBase::ZstdWriterBase(ZstdWriterBase&& that) noexcept
       dictionary_(std::move(that.dictionary_)),
       pledged_size_(that.pledged_size_),
       reserve_max_size_(that.reserve_max_size_),
+      seekable_frame_size_(that.seekable_frame_size_),
+      frame_start_pos_(that.frame_start_pos_),
+      frame_start_compressed_pos_(that.frame_start_compressed_pos_),
+      seek_table_(std::move(that.seek_table_)),
       compressor_(std::move(that.compressor_)) {}
 
 inline ZstdWriterBase& ZstdWriterBase::operator=(
@@ -385,6 +540,10 @@ inline ZstdWriterBase& ZstdWriterBase::operator=(
   dictionary_ = std::move(that.dictionary_);
   pledged_size_ = std::move(that.pledged_size_);
   reserve_max_size_ = that.reserve_max_size_;
+  seekable_frame_size_ = that.seekable_frame_size_;
+  frame_start_pos_ = that.frame_start_pos_;
+  frame_start_compressed_pos_ = that.frame_start_compressed_pos_;
+  seek_table_ = std::move(that.seek_table_);
   compressor_ = std::move(that.compressor_);
   return *this;
 }
@@ -393,6 +552,10 @@ inline void ZstdWriterBase::Reset(Closed) {
   BufferedWriter::Reset(kClosed);
   pledged_size_ = absl::nullopt;
   reserve_max_size_ = false;
+  seekable_frame_size_ = absl::nullopt;
+  frame_start_pos_ = 0;
+  frame_start_compressed_pos_ = 0;
+  seek_table_ = std::vector<std::pair<uint32_t, uint32_t>>();
   compressor_.reset();
   dictionary_ = ZstdDictionary();
 }
@@ -401,10 +564,15 @@ inline void ZstdWriterBase::Reset(ZstdDictionary&& dictionary,
                                   size_t buffer_size,
                                   absl::optional<Position> pledged_size,
                                   absl::optional<Position> size_hint,
-                                  bool reserve_max_size) {
+                                  bool reserve_max_size,
+                                  absl::optional<size_t> seekable_frame_size) {
   BufferedWriter::Reset(buffer_size, size_hint);
   pledged_size_ = pledged_size;
   reserve_max_size_ = reserve_max_size;
+  seekable_frame_size_ = seekable_frame_size;
+  frame_start_pos_ = 0;
+  frame_start_compressed_pos_ = 0;
+  seek_table_.clear();
   compressor_.reset();
   dictionary_ = ZstdDictionary();
 }
@@ -413,20 +581,24 @@ template <typename Dest>
 inline ZstdWriter<Dest>::ZstdWriter(const Dest& dest, Options options)
     : ZstdWriterBase(std::move(options.dictionary()),
                      options.effective_buffer_size(), options.pledged_size(),
-                     options.effective_size_hint(), options.reserve_max_size()),
+                     options.effective_size_hint(), options.reserve_max_size(),
+                     options.seekable_frame_size()),
       dest_(dest) {
   Initialize(dest_.get(), options.compression_level(), options.window_log(),
-             options.store_checksum(), options.effective_size_hint());
+             options.store_checksum(), options.effective_size_hint(),
+             options.parallelism(), options.job_size(), options.overlap_log());
 }
 
 template <typename Dest>
 inline ZstdWriter<Dest>::ZstdWriter(Dest&& dest, Options options)
     : ZstdWriterBase(std::move(options.dictionary()),
                      options.effective_buffer_size(), options.pledged_size(),
-                     options.effective_size_hint(), options.reserve_max_size()),
+                     options.effective_size_hint(), options.reserve_max_size(),
+                     options.seekable_frame_size()),
       dest_(std::move(dest)) {
   Initialize(dest_.get(), options.compression_level(), options.window_log(),
-             options.store_checksum(), options.effective_size_hint());
+             options.store_checksum(), options.effective_size_hint(),
+             options.parallelism(), options.job_size(), options.overlap_log());
 }
 
 template <typename Dest>
@@ -435,10 +607,12 @@ inline ZstdWriter<Dest>::ZstdWriter(std::tuple<DestArgs...> dest_args,
                                     Options options)
     : ZstdWriterBase(std::move(options.dictionary()),
                      options.effective_buffer_size(), options.pledged_size(),
-                     options.effective_size_hint(), options.reserve_max_size()),
+                     options.effective_size_hint(), options.reserve_max_size(),
+                     options.seekable_frame_size()),
       dest_(std::move(dest_args)) {
   Initialize(dest_.get(), options.compression_level(), options.window_log(),
-             options.store_checksum(), options.effective_size_hint());
+             options.store_checksum(), options.effective_size_hint(),
+             options.parallelism(), options.job_size(), options.overlap_log());
 }
 
 template <typename Dest>
@@ -469,10 +643,12 @@ inline void ZstdWriter<Dest>::Reset(const Dest& dest, Options options) {
   ZstdWriterBase::Reset(std::move(options.dictionary()),
                         options.effective_buffer_size(), options.pledged_size(),
                         options.effective_size_hint(),
-                        options.reserve_max_size());
+                        options.reserve_max_size(),
+                        options.seekable_frame_size());
   dest_.Reset(dest);
   Initialize(dest_.get(), options.compression_level(), options.window_log(),
-             options.store_checksum(), options.effective_size_hint());
+             options.store_checksum(), options.effective_size_hint(),
+             options.parallelism(), options.job_size(), options.overlap_log());
 }
 
 template <typename Dest>
@@ -480,10 +656,12 @@ inline void ZstdWriter<Dest>::Reset(Dest&& dest, Options options) {
   ZstdWriterBase::Reset(std::move(options.dictionary()),
                         options.effective_buffer_size(), options.pledged_size(),
                         options.effective_size_hint(),
-                        options.reserve_max_size());
+                        options.reserve_max_size(),
+                        options.seekable_frame_size());
   dest_.Reset(std::move(dest));
   Initialize(dest_.get(), options.compression_level(), options.window_log(),
-             options.store_checksum(), options.effective_size_hint());
+             options.store_checksum(), options.effective_size_hint(),
+             options.parallelism(), options.job_size(), options.overlap_log());
 }
 
 template <typename Dest>
@@ -493,10 +671,12 @@ inline void ZstdWriter<Dest>::Reset(std::tuple<DestArgs...> dest_args,
   ZstdWriterBase::Reset(std::move(options.dictionary()),
                         options.effective_buffer_size(), options.pledged_size(),
                         options.effective_size_hint(),
-                        options.reserve_max_size());
+                        options.reserve_max_size(),
+                        options.seekable_frame_size());
   dest_.Reset(std::move(dest_args));
   Initialize(dest_.get(), options.compression_level(), options.window_log(),
-             options.store_checksum(), options.effective_size_hint());
+             options.store_checksum(), options.effective_size_hint(),
+             options.parallelism(), options.job_size(), options.overlap_log());
 }
 
 template <typename Dest>